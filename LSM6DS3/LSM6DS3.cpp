@@ -1,9 +1,44 @@
 #include "LSM6DS3.h"
 
-LSM6DS3::LSM6DS3(PinName sda, PinName scl, uint8_t xgAddr) : i2c(sda, scl)
+LSM6DS3::LSM6DS3(PinName sda, PinName scl, uint8_t xgAddr)
 {
-    // xgAddress will store the 7-bit I2C address, if using I2C.
-    xgAddress = xgAddr;
+    // The I2C bus and transport are owned by this object
+    ownedI2C = new I2C(sda, scl);
+    ownedI2C->frequency(400000);                // Fast mode, the LSM6DS3 maximum
+    ownedBus = new LSM6DS3_I2C(*ownedI2C, xgAddr);
+    bus = ownedBus;
+}
+
+LSM6DS3::LSM6DS3(PinName mosi, PinName miso, PinName sclk, PinName cs, int hz)
+{
+    ownedI2C = NULL;
+    ownedBus = new LSM6DS3_SPI(mosi, miso, sclk, cs, hz);
+    bus = ownedBus;
+}
+
+LSM6DS3::LSM6DS3(LSM6DS3Transport &transport)
+{
+    ownedI2C = NULL;
+    ownedBus = NULL;
+    bus = &transport;
+}
+
+LSM6DS3::~LSM6DS3()
+{
+    delete ownedBus;
+    delete ownedI2C;
+}
+
+void LSM6DS3::writeReg(uint8_t reg, uint8_t value)
+{
+    bus->write(reg, &value, 1);
+}
+
+uint8_t LSM6DS3::readReg(uint8_t reg)
+{
+    uint8_t value = 0;
+    bus->read(reg, &value, 1);
+    return value;
 }
 
 uint16_t LSM6DS3::begin(gyro_scale gScl, accel_scale aScl,  
@@ -22,17 +57,11 @@ uint16_t LSM6DS3::begin(gyro_scale gScl, accel_scale aScl,
     
     // To verify communication, we can read from the WHO_AM_I register of
     // each device. Store those in a variable so we can return them.
-    // The start of the addresses we want to read from
-    char cmd[2] = {
-        WHO_AM_I_REG,
-        0
-    };
-
-    // Write the address we are going to read from and don't end the transaction
-    i2c.write(xgAddress, cmd, 1, true);
-    // Read in all the 8 bits of data
-    i2c.read(xgAddress, cmd+1, 1);
-    uint8_t xgTest = cmd[1];                    // Read the accel/gyro WHO_AM_I
+    uint8_t xgTest = readReg(WHO_AM_I_REG);     // Read the accel/gyro WHO_AM_I
+    
+    // Burst reads need address auto-increment, and block data update keeps
+    // the low and high bytes of a sample together
+    writeReg(CTRL3_C, CTRL3_C_BDU | CTRL3_C_IF_INC);
         
     // Gyro initialization stuff:
     initGyro(); // This will "turn on" the gyro. Setting up interrupts, etc.
@@ -53,79 +82,34 @@ uint16_t LSM6DS3::begin(gyro_scale gScl, accel_scale aScl,
 
 void LSM6DS3::initGyro()
 {
-    char cmd[4] = {
-        CTRL2_G,
-        (const char)(gScale | G_ODR_104),
-        0,          // Default data out and int out
-        0           // Default power mode and high pass settings
-    };
-
-    // Write the data to the gyro control registers
-    i2c.write(xgAddress, cmd, 4);
+    writeReg(CTRL2_G, gScale | G_ODR_104);
+    // Default data out and int out
+    writeReg(CTRL4_C, 0);
 }
 
 void LSM6DS3::initAccel()
 {
-    char cmd[4] = {
-        CTRL1_XL,
-        0x38,       // Enable all axis and don't decimate data in out Registers
-        (const char)((A_ODR_104 << 5) | (aScale << 3) | (A_BW_AUTO_SCALE)),   // 119 Hz ODR, set scale, and auto BW
-        0           // Default resolution mode and filtering settings
-    };
-
-    // Write the data to the accel control registers
-    i2c.write(xgAddress, cmd, 4);
+    // Enable all axis, 104 Hz ODR, set scale, and auto BW
+    writeReg(CTRL9_XL, 0x38);
+    writeReg(CTRL1_XL, (A_ODR_104 << 4) | (aScale << 2) | A_BW_AUTO_SCALE);
 }
 
 void LSM6DS3::initIntr()
 {
-    char cmd[2];
-    
-    cmd[0] = TAP_CFG;
-    cmd[1] = 0x0E;
-    i2c.write(xgAddress, cmd, 2);
-    cmd[0] = TAP_THS_6D;
-    cmd[1] = 0x03;
-    i2c.write(xgAddress, cmd, 2);
-    cmd[0] = INT_DUR2;
-    cmd[1] = 0x7F;
-    i2c.write(xgAddress, cmd, 2);
-    cmd[0] = WAKE_UP_THS;
-    cmd[1] = 0x80;
-    i2c.write(xgAddress, cmd, 2);
-    cmd[0] = MD1_CFG;
-    cmd[1] = 0x48;
-    i2c.write(xgAddress, cmd, 2);
+    writeReg(TAP_CFG, 0x0E);
+    writeReg(TAP_THS_6D, 0x03);
+    writeReg(INT_DUR2, 0x7F);
+    writeReg(WAKE_UP_THS, 0x80);
+    writeReg(MD1_CFG, 0x48);
 }
 
 void LSM6DS3::readAccel()
 {
     // The data we are going to read from the accel
-    char data[6];
-
-    // Set addresses
-    char subAddressXL = OUTX_L_XL;
-    char subAddressXH = OUTX_H_XL;
-    char subAddressYL = OUTY_L_XL;
-    char subAddressYH = OUTY_H_XL;
-    char subAddressZL = OUTZ_L_XL;
-    char subAddressZH = OUTZ_H_XL;
-
-    // Write the address we are going to read from and don't end the transaction
-    i2c.write(xgAddress, &subAddressXL, 1, true);
-    // Read in register containing the axes data and alocated to the correct index
-    i2c.read(xgAddress, data, 1);
-    
-    i2c.write(xgAddress, &subAddressXH, 1, true);
-    i2c.read(xgAddress, (data + 1), 1);
-    i2c.write(xgAddress, &subAddressYL, 1, true);
-    i2c.read(xgAddress, (data + 2), 1);
-    i2c.write(xgAddress, &subAddressYH, 1, true);
-    i2c.read(xgAddress, (data + 3), 1);
-    i2c.write(xgAddress, &subAddressZL, 1, true);
-    i2c.read(xgAddress, (data + 4), 1);
-    i2c.write(xgAddress, &subAddressZH, 1, true);
-    i2c.read(xgAddress, (data + 5), 1);
+    uint8_t data[6];
+
+    // Read the six axes registers in one burst
+    bus->read(OUTX_L_XL, data, 6);
 
     // Reassemble the data and convert to g
     ax_raw = data[0] | (data[1] << 8);
@@ -136,33 +120,41 @@ void LSM6DS3::readAccel()
     az = az_raw * aRes;
 }
 
-void LSM6DS3::readIntr()
+int LSM6DS3::readAll()
 {
-    char data[1];
-    char subAddress = TAP_SRC;
+    // Gyro (OUTX_L_G..OUTZ_H_G) is followed by accel (OUTX_L_XL..OUTZ_H_XL)
+    uint8_t data[12];
+
+    int err = bus->read(OUTX_L_G, data, 12);
+    if (err != 0)
+        return err;
 
-    i2c.write(xgAddress, &subAddress, 1, true);
-    i2c.read(xgAddress, data, 1);
+    gx_raw = data[0] | (data[1] << 8);
+    gy_raw = data[2] | (data[3] << 8);
+    gz_raw = data[4] | (data[5] << 8);
+    ax_raw = data[6] | (data[7] << 8);
+    ay_raw = data[8] | (data[9] << 8);
+    az_raw = data[10] | (data[11] << 8);
+    gx = gx_raw * gRes;
+    gy = gy_raw * gRes;
+    gz = gz_raw * gRes;
+    ax = ax_raw * aRes;
+    ay = ay_raw * aRes;
+    az = az_raw * aRes;
+    return 0;
+}
 
-    intr = (float)data[0];
+void LSM6DS3::readIntr()
+{
+    intr = (float)readReg(TAP_SRC);
 }
 
 void LSM6DS3::readTemp()
 {
     // The data we are going to read from the temp
-    char data[2];
-
-    // Set addresses
-    char subAddressL = OUT_TEMP_L;
-    char subAddressH = OUT_TEMP_H;
+    uint8_t data[2];
 
-    // Write the address we are going to read from and don't end the transaction
-    i2c.write(xgAddress, &subAddressL, 1, true);
-    // Read in register containing the temperature data and alocated to the correct index
-    i2c.read(xgAddress, data, 1);
-    
-    i2c.write(xgAddress, &subAddressH, 1, true);
-    i2c.read(xgAddress, (data + 1), 1);
+    bus->read(OUT_TEMP_L, data, 2);
 
     // Temperature is a 12-bit signed integer   
     temperature_raw = data[0] | (data[1] << 8);
@@ -175,31 +167,10 @@ void LSM6DS3::readTemp()
 void LSM6DS3::readGyro()
 {
     // The data we are going to read from the gyro
-    char data[6];
-
-    // Set addresses
-    char subAddressXL = OUTX_L_G;
-    char subAddressXH = OUTX_H_G;
-    char subAddressYL = OUTY_L_G;
-    char subAddressYH = OUTY_H_G;
-    char subAddressZL = OUTZ_L_G;
-    char subAddressZH = OUTZ_H_G;
-
-    // Write the address we are going to read from and don't end the transaction
-    i2c.write(xgAddress, &subAddressXL, 1, true);
-    // Read in register containing the axes data and alocated to the correct index
-    i2c.read(xgAddress, data, 1);
-    
-    i2c.write(xgAddress, &subAddressXH, 1, true);
-    i2c.read(xgAddress, (data + 1), 1);
-    i2c.write(xgAddress, &subAddressYL, 1, true);
-    i2c.read(xgAddress, (data + 2), 1);
-    i2c.write(xgAddress, &subAddressYH, 1, true);
-    i2c.read(xgAddress, (data + 3), 1);
-    i2c.write(xgAddress, &subAddressZL, 1, true);
-    i2c.read(xgAddress, (data + 4), 1);
-    i2c.write(xgAddress, &subAddressZH, 1, true);
-    i2c.read(xgAddress, (data + 5), 1);
+    uint8_t data[6];
+
+    // Read the six axes registers in one burst
+    bus->read(OUTX_L_G, data, 6);
 
     // Reassemble the data and convert to degrees/sec
     gx_raw = data[0] | (data[1] << 8);
@@ -212,24 +183,15 @@ void LSM6DS3::readGyro()
 
 void LSM6DS3::setGyroScale(gyro_scale gScl)
 {
-    // The start of the addresses we want to read from
-    char cmd[2] = {
-        CTRL2_G,
-        0
-    };
-
-    // Write the address we are going to read from and don't end the transaction
-    i2c.write(xgAddress, cmd, 1, true);
-    // Read in all the 8 bits of data
-    i2c.read(xgAddress, cmd+1, 1);
+    uint8_t ctrl = readReg(CTRL2_G);
 
     // Then mask out the gyro scale bits:
-    cmd[1] &= 0xFF^(0x3 << 3);
+    ctrl &= 0xFF^(0x3 << 2);
     // Then shift in our new scale bits:
-    cmd[1] |= gScl << 3;
+    ctrl |= gScl;
 
     // Write the gyroscale out to the gyro
-    i2c.write(xgAddress, cmd, 2);
+    writeReg(CTRL2_G, ctrl);
     
     // We've updated the sensor, but we also need to update our class variables
     // First update gScale:
@@ -240,24 +202,15 @@ void LSM6DS3::setGyroScale(gyro_scale gScl)
 
 void LSM6DS3::setAccelScale(accel_scale aScl)
 {
-    // The start of the addresses we want to read from
-    char cmd[2] = {
-        CTRL1_XL,
-        0
-    };
-
-    // Write the address we are going to read from and don't end the transaction
-    i2c.write(xgAddress, cmd, 1, true);
-    // Read in all the 8 bits of data
-    i2c.read(xgAddress, cmd+1, 1);
+    uint8_t ctrl = readReg(CTRL1_XL);
 
     // Then mask out the accel scale bits:
-    cmd[1] &= 0xFF^(0x3 << 3);
+    ctrl &= 0xFF^(0x3 << 2);
     // Then shift in our new scale bits:
-    cmd[1] |= aScl << 3;
+    ctrl |= aScl << 2;
 
     // Write the accelscale out to the accel
-    i2c.write(xgAddress, cmd, 2);
+    writeReg(CTRL1_XL, ctrl);
     
     // We've updated the sensor, but we also need to update our class variables
     // First update aScale:
@@ -268,88 +221,60 @@ void LSM6DS3::setAccelScale(accel_scale aScl)
 
 void LSM6DS3::setGyroODR(gyro_odr gRate)
 {
-    // The start of the addresses we want to read from
-    char cmd[2] = {
-        CTRL2_G,
-        0
-    };
-    
     // Set low power based on ODR, else keep sensor on high performance
-    if(gRate == G_ODR_13_BW_0 | gRate == G_ODR_26_BW_2 | gRate == G_ODR_52_BW_16) {
-        char cmdLow[2] ={
-            CTRL7_G,
-            1
-        };
-        
-        i2c.write(xgAddress, cmdLow, 2);
-    }
-    else {
-        char cmdLow[2] ={
-            CTRL7_G,
-            0
-        };
-        
-        i2c.write(xgAddress, cmdLow, 2);
-    }
+    if(gRate == G_ODR_13_BW_0 || gRate == G_ODR_26_BW_2 || gRate == G_ODR_52_BW_16)
+        writeReg(CTRL7_G, 0x80);
+    else
+        writeReg(CTRL7_G, 0);
 
-    // Write the address we are going to read from and don't end the transaction
-    i2c.write(xgAddress, cmd, 1, true);
-    // Read in all the 8 bits of data
-    i2c.read(xgAddress, cmd+1, 1);
+    uint8_t ctrl = readReg(CTRL2_G);
 
     // Then mask out the gyro odr bits:
-    cmd[1] &= (0x3 << 3);
+    ctrl &= 0x0F;
     // Then shift in our new odr bits:
-    cmd[1] |= gRate;
+    ctrl |= gRate;
 
     // Write the gyroodr out to the gyro
-    i2c.write(xgAddress, cmd, 2);
+    writeReg(CTRL2_G, ctrl);
 }
 
 void LSM6DS3::setAccelODR(accel_odr aRate)
 {
-    // The start of the addresses we want to read from
-    char cmd[2] = {
-        CTRL1_XL,
-        0
-    };
-    
     // Set low power based on ODR, else keep sensor on high performance
-    if(aRate == A_ODR_13 | aRate == A_ODR_26 | aRate == A_ODR_52) {
-        char cmdLow[2] ={
-            CTRL6_C,
-            1
-        };
-        
-        i2c.write(xgAddress, cmdLow, 2);
-    }
-    else {
-        char cmdLow[2] ={
-            CTRL6_C,
-            0
-        };
-        
-        i2c.write(xgAddress, cmdLow, 2);
-    }
+    if(aRate == A_ODR_13 || aRate == A_ODR_26 || aRate == A_ODR_52)
+        writeReg(CTRL6_C, 0x10);
+    else
+        writeReg(CTRL6_C, 0);
 
-    // Write the address we are going to read from and don't end the transaction
-    i2c.write(xgAddress, cmd, 1, true);
-    // Read in all the 8 bits of data
-    i2c.read(xgAddress, cmd+1, 1);
+    uint8_t ctrl = readReg(CTRL1_XL);
 
     // Then mask out the accel odr bits:
-    cmd[1] &= 0xFF^(0x7 << 5);
+    ctrl &= 0x0F;
     // Then shift in our new odr bits:
-    cmd[1] |= aRate << 5;
+    ctrl |= aRate << 4;
 
     // Write the accelodr out to the accel
-    i2c.write(xgAddress, cmd, 2);
+    writeReg(CTRL1_XL, ctrl);
+}
+
+void LSM6DS3::setWakeUp(uint8_t threshold, uint8_t duration)
+{
+    // Keep the single/double tap enable bits of WAKE_UP_THS
+    writeReg(WAKE_UP_THS, (readReg(WAKE_UP_THS) & 0xC0) | (threshold & 0x3F));
+    writeReg(WAKE_UP_DUR, (readReg(WAKE_UP_DUR) & 0x9F) | ((duration & 0x03) << 5));
+
+    uint8_t md1 = readReg(MD1_CFG);
+    if (threshold)
+        md1 |= MD1_INT1_WU;
+    else
+        md1 &= ~MD1_INT1_WU;
+    writeReg(MD1_CFG, md1);
 }
 
 void LSM6DS3::calcgRes()
 {
     // Possible gyro scales (and their register bit settings) are:
-    // 245 DPS (00), 500 DPS (01), 2000 DPS (10).
+    // 245 DPS (00), 500 DPS (01), 1000 DPS (10), 2000 DPS (11).
     switch (gScale)
     {
         case G_SCALE_245DPS:
@@ -358,6 +283,9 @@ void LSM6DS3::calcgRes()
         case G_SCALE_500DPS:
             gRes = 500.0 / 32768.0;
             break;
+        case G_SCALE_1000DPS:
+            gRes = 1000.0 / 32768.0;
+            break;
         case G_SCALE_2000DPS:
             gRes = 2000.0 / 32768.0;
             break;
@@ -367,7 +295,7 @@ void LSM6DS3::calcgRes()
 void LSM6DS3::calcaRes()
 {
     // Possible accelerometer scales (and their register bit settings) are:
-    // 2 g (000), 4g (001), 6g (010) 8g (011), 16g (100).
+    // 2 g (00), 16 g (01), 4 g (10), 8 g (11).
     switch (aScale)
     {
         case A_SCALE_2G:
@@ -383,4 +311,4 @@ void LSM6DS3::calcaRes()
             aRes = 16.0 / 32768.0;
             break;
     }
-}
\ No newline at end of file
+}
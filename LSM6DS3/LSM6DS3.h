@@ -4,6 +4,8 @@
 #define _LSM6DS3_H__
 
 #include "mbed.h"
+#include "LSM6DS3Transport.h"
+#include "LSM6DS3Bus.h"
 
 /////////////////////////////////////////
 // LSM6DS3 Accel/Gyro (XL/G) Registers //
@@ -86,6 +88,13 @@
 // Possible I2C addresses for the accel/gyro
 #define LSM6DS3_AG_I2C_ADDR(sa0) ((sa0) ? 0xD6 : 0xD4)
 
+// CTRL3_C bits
+#define CTRL3_C_BDU           0x40        // Block data update (no torn reads)
+#define CTRL3_C_IF_INC        0x04        // Register address auto-increment
+
+// MD1_CFG bits
+#define MD1_INT1_WU           0x20        // Wake-up event on INT1
+
 /**
  * LSM6DS3 Class - driver for the 9 DoF IMU
  */
@@ -96,10 +105,10 @@ public:
     /// gyro_scale defines the possible full-scale ranges of the gyroscope:
     enum gyro_scale
     {
-        G_SCALE_245DPS = 0x0 << 3,     // 00 << 3: +/- 245 degrees per second
-        G_SCALE_500DPS = 0x1 << 3,     // 01 << 3: +/- 500 dps
-        G_SCALE_1000DPS = 0x2 << 3,    // 10 << 3: +/- 1000 dps
-        G_SCALE_2000DPS = 0x3 << 3     // 11 << 3: +/- 2000 dps
+        G_SCALE_245DPS = 0x0 << 2,     // 00 << 2: +/- 245 degrees per second
+        G_SCALE_500DPS = 0x1 << 2,     // 01 << 2: +/- 500 dps
+        G_SCALE_1000DPS = 0x2 << 2,    // 10 << 2: +/- 1000 dps
+        G_SCALE_2000DPS = 0x3 << 2     // 11 << 2: +/- 2000 dps
     };
 
     /// gyro_odr defines all possible data rate/bandwidth combos of the gyro:
@@ -169,17 +178,32 @@ public:
     float intr;
 
     
-    /**  LSM6DS3 -- LSM6DS3 class constructor
+    /**  LSM6DS3 -- LSM6DS3 class constructor (I2C)
     *  The constructor will set up a handful of private variables, and set the
     *  communication mode as well.
     *  Input:
-    *   - interface = Either MODE_SPI or MODE_I2C, whichever you're using
-    *               to talk to the IC.
-    *   - xgAddr = If MODE_I2C, this is the I2C address of the accel/gyro.
-    *               If MODE_SPI, this is the chip select pin of the accel/gyro (CS_A/G)
+    *   - sda, scl = I2C pins, the bus is owned by this object.
+    *   - xgAddr = I2C address of the accel/gyro.
     */
     LSM6DS3(PinName sda, PinName scl, uint8_t xgAddr = LSM6DS3_AG_I2C_ADDR(1));
     
+    /**  LSM6DS3 -- LSM6DS3 class constructor (SPI)
+    *  Input:
+    *   - mosi, miso, sclk = SPI pins, the bus is owned by this object.
+    *   - cs = Chip select pin of the accel/gyro (CS_A/G).
+    *   - hz = SPI clock, up to 10 MHz.
+    */
+    LSM6DS3(PinName mosi, PinName miso, PinName sclk, PinName cs, int hz = 10000000);
+    
+    /**  LSM6DS3 -- LSM6DS3 class constructor (any transport)
+    *  Input:
+    *   - transport = Register access to the IC, e.g. an LSM6DS3_I2C on a shared
+    *               bus or a mock. Must outlive this object.
+    */
+    LSM6DS3(LSM6DS3Transport &transport);
+    
+    ~LSM6DS3();
+    
     /**  begin() -- Initialize the gyro, and accelerometer.
     *  This will set up the scale and output rate of each sensor. It'll also
     *  "turn on" every sensor and every axis of every sensor.
@@ -213,6 +237,13 @@ public:
     */
     void readAccel();
     
+    /**  readAll() -- Read the gyroscope and accelerometer output registers.
+    *  All twelve registers are contiguous, so this is a single bus burst.
+    *  Updates the same variables as readGyro() and readAccel().
+    *  Output: 0 on success, non-zero on bus error.
+    */
+    int readAll();
+    
     /**  readTemp() -- Read the temperature output register.
     *  This function will read two temperature output registers.
     *  The combined readings are stored in the class' temperature variables. Read
@@ -255,15 +286,27 @@ public:
     */
     void setAccelODR(accel_odr aRate);
 
+    /**  setWakeUp() -- Route the wake-up event (acceleration slope) to INT1.
+    *  The tap events initIntr() routes there stay on INT1 too.
+    *  Input:
+    *   - threshold = Slope that wakes up, 1 LSB = full scale / 64 (62.5 mg
+    *       at 2 g), 0 takes the wake-up event off INT1.
+    *   - duration = Samples at the accel ODR above the threshold (0 to 3).
+    */
+    void setWakeUp(uint8_t threshold, uint8_t duration);
+
 
 private:    
-    /**  xgAddress store the I2C address
-    *  for each sensor.
-    */
-    uint8_t xgAddress;
+    // Register access (I2C or SPI)
+    LSM6DS3Transport *bus;
+    
+    // Bus objects created by the pin constructors, NULL otherwise
+    I2C *ownedI2C;
+    LSM6DS3Transport *ownedBus;
     
-    // I2C bus
-    I2C i2c;
+    /**  writeReg() / readReg() -- Single register access through the transport */
+    void writeReg(uint8_t reg, uint8_t value);
+    uint8_t readReg(uint8_t reg);
 
     /**  gScale, and aScale store the current scale range for each 
     *  sensor. Should be updated whenever that value changes.
@@ -0,0 +1,88 @@
+#include "LSM6DS3Bus.h"
+
+LSM6DS3_I2C::LSM6DS3_I2C(I2C &i2c, uint8_t xgAddr) : i2c(i2c), xgAddress(xgAddr)
+{
+}
+
+int LSM6DS3_I2C::write(uint8_t reg, const uint8_t *data, int len)
+{
+    char cmd[LSM6DS3_MAX_BURST + 1];
+
+    if (len > LSM6DS3_MAX_BURST)
+        return -1;
+
+    // Register address followed by the data, in a single transaction
+    cmd[0] = reg;
+    memcpy(cmd + 1, data, len);
+    return i2c.write(xgAddress, cmd, len + 1);
+}
+
+int LSM6DS3_I2C::read(uint8_t reg, uint8_t *data, int len)
+{
+    char subAddress = reg;
+
+    // Write the address we are going to read from and don't end the transaction
+    if (i2c.write(xgAddress, &subAddress, 1, true) != 0)
+        return -1;
+    // Read all the registers in one burst
+    return i2c.read(xgAddress, (char *)data, len);
+}
+
+LSM6DS3_SPI::LSM6DS3_SPI(PinName mosi, PinName miso, PinName sclk, PinName cs, int hz) :
+    spi(mosi, miso, sclk), cs(cs, 1)
+{
+    spi.format(8, 3);
+    spi.frequency(hz);
+}
+
+int LSM6DS3_SPI::write(uint8_t reg, const uint8_t *data, int len)
+{
+    spi.lock();
+    cs = 0;
+    spi.write(reg & ~LSM6DS3_SPI_READ);
+    spi.write((const char *)data, len, NULL, 0);
+    cs = 1;
+    spi.unlock();
+    return 0;
+}
+
+int LSM6DS3_SPI::read(uint8_t reg, uint8_t *data, int len)
+{
+    spi.lock();
+    cs = 0;
+    spi.write(reg | LSM6DS3_SPI_READ);
+    spi.write(NULL, 0, (char *)data, len);
+    cs = 1;
+    spi.unlock();
+    return 0;
+}
+
+#if DEVICE_SPI_ASYNCH
+int LSM6DS3_SPI::read_async(uint8_t reg, uint8_t *data, int len, const event_callback_t &callback)
+{
+    if (len > LSM6DS3_MAX_BURST)
+        return -1;
+
+    // Address byte, then dummy bytes while the registers are clocked out
+    memset(tx_buf, 0, len + 1);
+    tx_buf[0] = reg | LSM6DS3_SPI_READ;
+    async_data = data;
+    async_len = len;
+    async_callback = callback;
+
+    cs = 0;
+    int err = spi.transfer(tx_buf, len + 1, rx_buf, len + 1, event_callback_t(this, &LSM6DS3_SPI::async_done), SPI_EVENT_ALL);
+    if (err != 0)
+        cs = 1;
+    return err;
+}
+
+void LSM6DS3_SPI::async_done(int event)
+{
+    cs = 1;
+    // First received byte was clocked during the address byte
+    memcpy(async_data, rx_buf + 1, async_len);
+    if (async_callback)
+        async_callback.call(event);
+}
+#endif
@@ -0,0 +1,62 @@
+#ifndef _LSM6DS3_BUS_H__
+#define _LSM6DS3_BUS_H__
+
+#include "mbed.h"
+#include "LSM6DS3Transport.h"
+
+#define LSM6DS3_MAX_BURST     16          // Longest register burst (bytes)
+#define LSM6DS3_SPI_READ      0x80        // SPI read bit in the address byte
+
+/**
+ * LSM6DS3_I2C - I2C transport (up to 400 kHz).
+ * The I2C object may be shared with other devices on the same bus.
+ */
+class LSM6DS3_I2C : public LSM6DS3Transport
+{
+public:
+    /**  xgAddr = 8-bit I2C address of the accel/gyro, see LSM6DS3_AG_I2C_ADDR() */
+    LSM6DS3_I2C(I2C &i2c, uint8_t xgAddr);
+
+    virtual int write(uint8_t reg, const uint8_t *data, int len);
+    virtual int read(uint8_t reg, uint8_t *data, int len);
+
+private:
+    I2C &i2c;
+    uint8_t xgAddress;
+};
+
+/**
+ * LSM6DS3_SPI - 4-wire SPI transport (mode 3, up to 10 MHz).
+ */
+class LSM6DS3_SPI : public LSM6DS3Transport
+{
+public:
+    LSM6DS3_SPI(PinName mosi, PinName miso, PinName sclk, PinName cs, int hz = 10000000);
+
+    virtual int write(uint8_t reg, const uint8_t *data, int len);
+    virtual int read(uint8_t reg, uint8_t *data, int len);
+
+#if DEVICE_SPI_ASYNCH
+    /**  read_async() -- Start a non-blocking burst read with SPI::transfer.
+    *  data must stay valid until callback is called (from interrupt context)
+    *  with SPI_EVENT_COMPLETE or an error event.
+    *  Output: 0 if the transfer was started.
+    */
+    int read_async(uint8_t reg, uint8_t *data, int len, const event_callback_t &callback);
+#endif
+
+private:
+    SPI spi;
+    DigitalOut cs;
+#if DEVICE_SPI_ASYNCH
+    uint8_t tx_buf[LSM6DS3_MAX_BURST + 1];
+    uint8_t rx_buf[LSM6DS3_MAX_BURST + 1];
+    uint8_t *async_data;
+    int async_len;
+    event_callback_t async_callback;
+
+    void async_done(int event);
+#endif
+};
+
+#endif // _LSM6DS3_BUS_H //
@@ -0,0 +1,28 @@
+#ifndef _LSM6DS3_TRANSPORT_H__
+#define _LSM6DS3_TRANSPORT_H__
+
+#include <stdint.h>
+
+/**
+ * LSM6DS3Transport - register access to the LSM6DS3, independent of the bus.
+ * Multi-byte accesses rely on the register address auto-increment (IF_INC in
+ * CTRL3_C, enabled by LSM6DS3::begin()). Implement it to run the driver over
+ * another bus or against a mock on the host.
+ */
+class LSM6DS3Transport
+{
+public:
+    virtual ~LSM6DS3Transport() {}
+
+    /**  write() -- Write len bytes to consecutive registers starting at reg.
+    *  Output: 0 on success, non-zero on bus error.
+    */
+    virtual int write(uint8_t reg, const uint8_t *data, int len) = 0;
+
+    /**  read() -- Read len bytes from consecutive registers starting at reg.
+    *  Output: 0 on success, non-zero on bus error.
+    */
+    virtual int read(uint8_t reg, uint8_t *data, int len) = 0;
+};
+
+#endif // _LSM6DS3_TRANSPORT_H //
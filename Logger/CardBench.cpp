@@ -0,0 +1,146 @@
+#include "CardBench.h"
+#include "mbed.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+CardBench::CardBench() : valid(false), scratch(NULL), scratch_size(0)
+{
+    memset(results, 0, sizeof(results));
+}
+
+bool CardBench::run(const char *path)
+{
+    valid = true;
+    for (int i = 0; i < BENCH_SIZES; i++)
+    {
+        if (!probe(path, 512 << i, &results[i]))
+            valid = false;
+    }
+    return valid;
+}
+
+bool CardBench::probe(const char *path, uint16_t block, result_t *r)
+{
+    const uint32_t writes = BENCH_BYTES / block;
+    const uint32_t rank = writes / 100 + 1;         // p99 is the rank-th longest write
+    uint32_t top[BENCH_TOP];                        // Longest writes, longest first
+    uint32_t begin, t0, dt;
+    uint8_t *buf;
+    FILE *f;
+    Timer t;
+
+    memset(r, 0, sizeof(*r));
+    memset(top, 0, sizeof(top));
+    r->block = block;
+
+    f = fopen(path, "r+");                          // Overwrite in place, no cluster allocation
+    if (f == NULL)
+        f = fopen(path, "w");                       // First boot with this card
+    if (scratch != NULL)
+        buf = (scratch_size >= block) ? scratch : NULL;
+    else
+        buf = (uint8_t *)malloc(block);             // Freed before the run buffers are allocated
+    if (f == NULL || buf == NULL)
+    {
+        r->err = (f == NULL) ? errno : ENOMEM;
+        if (f != NULL)
+            fclose(f);
+        if (scratch == NULL)
+            free(buf);
+        return false;
+    }
+    setvbuf(f, NULL, _IONBF, 0);                    // Every write goes to the file system as is
+    memset(buf, 0x55, block);
+
+    t.start();
+    begin = t.read_us();
+    for (uint32_t i = 0; i < writes; i++)
+    {
+        t0 = t.read_us();
+        if (fwrite(buf, 1, block, f) != block)
+        {
+            r->err = errno ? errno : EIO;
+            break;
+        }
+        dt = t.read_us() - t0;
+
+        /* Insertion into the longest ones */
+        for (uint32_t j = 0; j < rank; j++)
+        {
+            if (dt > top[j])
+            {
+                memmove(&top[j + 1], &top[j], (rank - 1 - j) * sizeof(top[0]));
+                top[j] = dt;
+                break;
+            }
+        }
+    }
+    t0 = t.read_us();
+    fflush(f);
+    fsync(fileno(f));
+    r->sync_us = t.read_us() - t0;
+    dt = t.read_us() - begin;
+
+    r->throughput = dt ? (uint64_t)BENCH_BYTES * 1000000 / dt : 0;
+    r->p99_us = top[rank - 1];
+    r->max_us = top[0];
+    if (scratch == NULL)
+        free(buf);
+    fclose(f);
+    return r->err == 0;
+}
+
+CardBench::choice_t CardBench::choose(uint16_t max_freq, uint32_t sample_bytes, uint32_t buffer_depth) const
+{
+    choice_t c;
+    uint16_t freq = max_freq;
+
+    memset(&c, 0, sizeof(c));
+    c.sample_freq = max_freq;
+    c.buffer_depth = buffer_depth;
+    if (!valid)
+        return c;
+
+    /* Highest rate with a size that fits, the shortest stall among those */
+    for (bool last = false; !last; freq /= 2)
+    {
+        last = (freq / 2 < BENCH_MIN_FREQ);
+        for (int i = 0; i < BENCH_SIZES; i++)
+        {
+            const result_t *r = &results[i];
+            uint32_t stall = ((r->max_us > r->sync_us) ? r->max_us : r->sync_us) * BENCH_STALL_MARGIN;
+            uint32_t needed = (uint64_t)stall * freq / 1000000 + 1;
+            bool fits = needed <= buffer_depth && (uint64_t)r->max_us * freq * 100 <= 1000000ULL * BENCH_TICK_MAX &&
+                        (uint64_t)sample_bytes * freq * 100 <= (uint64_t)r->throughput * BENCH_LOAD_MAX;
+
+            /* At the lowest rate, anything beats nothing */
+            if ((fits && (!c.fits || stall < c.stall_us)) || (last && !c.fits && (c.block == 0 || stall < c.stall_us)))
+            {
+                c.sample_freq = freq;
+                c.block = r->block;
+                c.stall_us = stall;
+                c.buffer_needed = needed;
+                c.fits = fits;
+            }
+        }
+        if (c.fits)
+            break;
+    }
+    return c;
+}
+
+void CardBench::write(FILE *fp, const choice_t &choice) const
+{
+    fprintf(fp, "block throughput_Bps p99_us max_us sync_us err\n");
+    for (int i = 0; i < BENCH_SIZES; i++)
+    {
+        const result_t *r = &results[i];
+
+        fprintf(fp, "%u %lu %lu %lu %lu %d\n", r->block, (unsigned long)r->throughput, (unsigned long)r->p99_us,
+                (unsigned long)r->max_us, (unsigned long)r->sync_us, r->err);
+    }
+    fprintf(fp, "sample_freq %u\nblock %u\nstall_us %lu\nbuffer_needed %lu\nbuffer_depth %lu\nfits %d\n",
+            choice.sample_freq, choice.block, (unsigned long)choice.stall_us, (unsigned long)choice.buffer_needed,
+            (unsigned long)choice.buffer_depth, choice.fits ? 1 : 0);
+}
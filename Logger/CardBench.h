@@ -0,0 +1,95 @@
+/*
+    Boot-time card write benchmark.
+    Writes a scratch file (".bench" in the card root, skipped when the RUN
+    folders are counted) sequentially with each candidate write size, timing
+    every write and the final sync. The file is created once and overwritten
+    in place on later boots, so the probe measures the card and not the FAT
+    allocation. From the throughput and worst write of each size, choose()
+    picks the highest sample rate at which, for some write size:
+     - the card sustains the data rate with margin,
+     - the worst stall, with margin, fits in the acquisition buffer,
+     - the worst write is shorter than a sample period: the loop acquires
+       between writes and remembers only one pending tick, so a longer write
+       loses ticks whatever the buffer depth.
+    Among those sizes it takes the one with the shortest stall.
+*/
+
+#ifndef CARD_BENCH_H
+#define CARD_BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define BENCH_SIZES 3                               // Write sizes probed: 512, 1024, 2048 bytes
+#define BENCH_MAX_BLOCK (512 << (BENCH_SIZES - 1))  // Largest write size probed
+#define BENCH_BYTES 65536                           // Written per size
+#define BENCH_STALL_MARGIN 2                        // Worst stall assumed, x the worst measured
+#define BENCH_LOAD_MAX 50                           // Data rate limit, % of the measured throughput
+#define BENCH_TICK_MAX 80                           // Worst write limit, % of the sample period
+#define BENCH_MIN_FREQ 25                           // Lowest sample rate chosen
+#define BENCH_TOP (BENCH_BYTES / 512 / 100 + 1)     // Longest writes kept for the 99th percentile
+
+class CardBench
+{
+public:
+    /* Measurements of one write size */
+    struct result_t
+    {
+        uint16_t block;                             // Bytes per write
+        uint32_t throughput;                        // Bytes per second, sync included
+        uint32_t p99_us;                            // Write latency percentile
+        uint32_t max_us;                            // Worst write
+        uint32_t sync_us;                           // Final fflush + fsync
+        int err;                                    // 0, or the errno of a failed write
+    };
+
+    /* Parameters chosen for the run */
+    struct choice_t
+    {
+        uint16_t sample_freq;                       // Hz
+        uint16_t block;                             // Card write size (stdio buffer of the part files)
+        uint32_t stall_us;                          // Worst stall planned for (margin included)
+        uint32_t buffer_needed;                     // Packets buffered during that stall
+        uint32_t buffer_depth;                      // Packets the buffer holds
+        bool fits;                                  // false: not even BENCH_MIN_FREQ fits, use it anyway
+    };
+
+    /**  CardBench -- class constructor */
+    CardBench();
+
+    /**  run() -- Probe every write size on the scratch file path.
+    *  Output: false if the file can't be opened or a write failed.
+    */
+    bool run(const char *path);
+
+    /**  set_buffer() -- Scratch memory for the writes (at least the largest
+    *  size, BENCH_MAX_BLOCK bytes) instead of a heap block per size. Its
+    *  contents are overwritten.
+    */
+    void set_buffer(uint8_t *memory, uint16_t size) { scratch = memory; scratch_size = size; }
+
+    /**  choose() -- Parameters for the run, from the last run().
+    *  Input:
+    *   - max_freq = Configured sample rate, only divided by powers of two.
+    *   - sample_bytes = Card bytes per sample (upper bound).
+    *   - buffer_depth = Acquisition buffer capacity in samples.
+    *  Without valid measurements the configured rate is kept and block is 0.
+    */
+    choice_t choose(uint16_t max_freq, uint32_t sample_bytes, uint32_t buffer_depth) const;
+
+    /**  write() -- Measurements and choice as text (RUNx/bench.txt). */
+    void write(FILE *fp, const choice_t &choice) const;
+
+    /** Measurements of size index i (block 512 << i) */
+    const result_t &result(int i) const { return results[i]; }
+
+private:
+    result_t results[BENCH_SIZES];
+    bool valid;
+    uint8_t *scratch;                               // set_buffer() memory, NULL for the heap
+    uint16_t scratch_size;
+
+    bool probe(const char *path, uint16_t block, result_t *r);
+};
+
+#endif // CARD_BENCH_H
@@ -0,0 +1,67 @@
+#include "CardLayout.h"
+#include <string.h>
+
+CardLayout::CardLayout() : status_valid(false), layout_valid(false), is_aligned(false)
+{
+    memset(&status, 0, sizeof(status));
+    memset(&layout, 0, sizeof(layout));
+}
+
+bool CardLayout::probe(SDBlockDevice &sd)
+{
+    status_valid = sd.read_sd_status(&status) == 0;
+    return status_valid;
+}
+
+uint32_t CardLayout::au() const
+{
+    return (status_valid && status.au_size != 0) ? (uint32_t)status.au_size : LAYOUT_DEFAULT_AU;
+}
+
+uint32_t CardLayout::alignment() const
+{
+    uint32_t align = LAYOUT_MAX_ALIGN;
+
+    while (align > 512 && au() % align != 0)
+        align /= 2;
+    return align;
+}
+
+int CardLayout::format(FATFileSystem &fs, mbed::BlockDevice *bd)
+{
+    uint32_t align = alignment();
+    uint32_t cluster;
+    int err = -1;
+
+    cluster = (au() < LAYOUT_MAX_CLUSTER) ? au() : LAYOUT_MAX_CLUSTER;
+    for (; err != 0 && cluster >= LAYOUT_MIN_CLUSTER; cluster /= 2)
+        err = fs.reformat(bd, cluster, align);
+    if (err != 0)
+        err = fs.reformat(bd, 0, align);            // Small volume: FAT picks the cluster
+    return err;
+}
+
+bool CardLayout::verify(FATFileSystem &fs)
+{
+    layout_valid = fs.get_layout(&layout) == 0;
+    is_aligned = layout_valid && layout.fat_start % alignment() == 0 && layout.data_start % alignment() == 0 &&
+                 layout.cluster_size != 0 && au() % layout.cluster_size == 0;
+    return is_aligned;
+}
+
+void CardLayout::write(FILE *fp) const
+{
+    fprintf(fp, "au_kb %lu%s\n", (unsigned long)(au() / 1024), (status_valid && status.au_size != 0) ? "" : " (assumed)");
+    if (status_valid)
+        fprintf(fp, "erase_aus %u erase_timeout_s %u erase_offset_s %u speed_class %u\n", status.erase_aus,
+                status.erase_timeout_s, status.erase_offset_s, status.speed_class);
+    if (!layout_valid)
+        return;
+    fprintf(fp, "fat%d cluster_kb %lu clusters %lu\n", layout.fat_type, (unsigned long)(layout.cluster_size / 1024),
+            (unsigned long)layout.clusters);
+    fprintf(fp, "fat_sector %lu au_offset %lu\n", (unsigned long)(layout.fat_start / 512),
+            (unsigned long)(layout.fat_start % alignment() / 512));
+    fprintf(fp, "data_sector %lu au_offset %lu\n", (unsigned long)(layout.data_start / 512),
+            (unsigned long)(layout.data_start % alignment() / 512));
+    fprintf(fp, "aligned %d\n", is_aligned ? 1 : 0);
+}
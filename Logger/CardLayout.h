@@ -0,0 +1,68 @@
+/*
+    FAT layout on the card's allocation units.
+    The card's flash is managed in allocation units (AU, usually 4 MB on
+    SDHC), given by its SD Status register. A card writes sequential whole
+    AUs fastest, a cluster straddling two AUs costs both their write
+    overhead. format() puts the FAT and the first cluster on AU boundaries
+    and picks the largest cluster (up to LAYOUT_MAX_CLUSTER) that divides
+    the AU: the fewest FAT updates and cluster allocations for long
+    sequential files, and whole clusters never span two AUs.
+    verify() checks the layout of the mounted file system against the AU,
+    whoever formatted the card.
+*/
+
+#ifndef CARD_LAYOUT_H
+#define CARD_LAYOUT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "SDBlockDevice.h"
+#include "FATFileSystem.h"
+
+#define LAYOUT_MAX_CLUSTER 32768                    // Largest cluster (FATFileSystem::format limit)
+#define LAYOUT_MIN_CLUSTER 4096                     // Smallest cluster tried before the FAT default
+#define LAYOUT_MAX_ALIGN (16UL * 1024 * 1024)       // Largest FAT alignment (32768 sectors)
+#define LAYOUT_DEFAULT_AU (4UL * 1024 * 1024)       // Assumed when the card gives no AU
+
+class CardLayout
+{
+public:
+    /**  CardLayout -- class constructor */
+    CardLayout();
+
+    /**  probe() -- Read the AU and erase geometry of the initialized card.
+    *  Output: false if the SD Status can't be read, LAYOUT_DEFAULT_AU is then assumed.
+    */
+    bool probe(SDBlockDevice &sd);
+
+    /**  format() -- Format bd for logging and mount it: FAT and data area
+    *  aligned to the AU, clusters as large as possible, smaller ones if
+    *  the volume is too small for them.
+    *  Output: 0, or the error of the last attempt.
+    */
+    int format(FATFileSystem &fs, mbed::BlockDevice *bd);
+
+    /**  verify() -- Read the layout of the mounted file system.
+    *  Output: true if the FAT and the data area start on the boundaries
+    *  format() aligns them to (alignment()) and the clusters divide the AU.
+    */
+    bool verify(FATFileSystem &fs);
+
+    /**  write() -- Card geometry and layout as text (RUNx/card.txt). */
+    void write(FILE *fp) const;
+
+    /** AU in bytes (given or assumed), result of the last verify() */
+    uint32_t au() const;
+    /** Largest power of two dividing the AU, up to LAYOUT_MAX_ALIGN (12, 24 MB AUs are not powers of two) */
+    uint32_t alignment() const;
+    bool aligned() const { return is_aligned; }
+
+private:
+    SDBlockDevice::sd_status_t status;
+    bool status_valid;
+    FATFileSystem::layout_t layout;
+    bool layout_valid;
+    bool is_aligned;
+};
+
+#endif // CARD_LAYOUT_H
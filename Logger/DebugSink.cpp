@@ -0,0 +1,106 @@
+#include "DebugSink.h"
+
+DebugSink::DebugSink(PinName tx, PinName rx, int baud, uint32_t rate) : uart(tx, rx, baud), rate(rate),
+    tokens(rate), last_refill(us_ticker_read()), drops(0), sending(false)
+{
+}
+
+bool DebugSink::reserve(uint32_t len)
+{
+    if (rate != 0)
+    {
+        /* Refill the budget with the time elapsed since the last call */
+        uint32_t now = us_ticker_read();
+        uint32_t refill = (uint64_t)(now - last_refill) * rate / 1000000;
+
+        if (refill > 0)
+        {
+            tokens = (tokens + refill > rate) ? rate : tokens + refill;
+            last_refill = now;
+        }
+        if (tokens < len)
+        {
+            drops += len;
+            return false;
+        }
+    }
+
+    if (space() < len)
+    {
+        drops += len;
+        return false;
+    }
+
+    if (rate != 0)
+        tokens -= len;
+    return true;
+}
+
+bool DebugSink::putc(char c)
+{
+    if (!reserve(1))
+        return false;
+
+    ring.push(c);
+    kick();
+    return true;
+}
+
+int DebugSink::printf(const char *format, ...)
+{
+    char line[DEBUG_LINE_SIZE];
+    va_list args;
+
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if (len < 0)
+        return 0;
+    if (len >= (int)sizeof(line))
+        len = sizeof(line) - 1;                     // Truncated
+
+    return write(line, len) ? len : 0;
+}
+
+bool DebugSink::write(const void *data, uint32_t len)
+{
+    const char *bytes = (const char *)data;
+
+    if (!reserve(len))
+        return false;
+
+    for (uint32_t i = 0; i < len; i++)
+        ring.push(bytes[i]);
+    kick();
+    return true;
+}
+
+void DebugSink::kick()
+{
+    core_util_critical_section_enter();
+    if (!sending)
+    {
+        sending = true;
+        uart.attach(callback(this, &DebugSink::txISR), SerialBase::TxIrq);
+    }
+    core_util_critical_section_exit();
+}
+
+void DebugSink::txISR()
+{
+    char c;
+
+    /* Fill the data register while the UART accepts bytes */
+    while (uart.writeable())
+    {
+        if (!ring.pop(c))
+        {
+            /* Nothing left: disable the TX interrupt until the next kick() */
+            uart.attach(NULL, SerialBase::TxIrq);
+            sending = false;
+            return;
+        }
+        uart.putc(c);
+    }
+}
@@ -0,0 +1,70 @@
+/*
+    Non-blocking debug/telemetry UART channel.
+    Bytes are queued in a RAM ring buffer and sent by the UART TX interrupt, so
+    callers never wait for the line. Output is rate limited (token bucket) and
+    whatever doesn't fit in the ring or in the budget is dropped and counted.
+*/
+
+#ifndef DEBUG_SINK_H
+#define DEBUG_SINK_H
+
+#include "mbed.h"
+
+#define DEBUG_BUFFER_SIZE 256                       // TX ring buffer (bytes)
+#define DEBUG_LINE_SIZE 64                          // Longest printf() output
+#define DEBUG_BAUD 115200
+#define DEBUG_RATE 2000                             // Default budget (bytes/s)
+
+class DebugSink
+{
+public:
+    /**  DebugSink -- class constructor
+    *  Input:
+    *   - tx, rx = UART pins.
+    *   - baud = UART baud rate.
+    *   - rate = Maximum average output in bytes/s, 0 for no limit.
+    */
+    DebugSink(PinName tx, PinName rx, int baud = DEBUG_BAUD, uint32_t rate = DEBUG_RATE);
+
+    /**  putc() -- Queue a byte.
+    *  Output: false if it was dropped.
+    */
+    bool putc(char c);
+
+    /**  printf() -- Queue a formatted message (at most DEBUG_LINE_SIZE bytes).
+    *  The message is queued whole or dropped whole.
+    *  Output: number of bytes queued.
+    */
+    int printf(const char *format, ...) MBED_PRINTF_METHOD(1, 2);
+
+    /**  write() -- Queue a block of bytes, whole or not at all.
+    *  Output: false if it was dropped.
+    */
+    bool write(const void *data, uint32_t len);
+
+    /** Free space in the ring buffer, in bytes */
+    uint32_t space() const { return DEBUG_BUFFER_SIZE - ring.size(); }
+
+    /** Bytes dropped since start */
+    uint32_t dropped() const { return drops; }
+
+private:
+    RawSerial uart;
+    CircularBuffer<char, DEBUG_BUFFER_SIZE> ring;
+    uint32_t rate;                                  // Budget (bytes/s)
+    uint32_t tokens;                                // Bytes that can still be sent
+    uint32_t last_refill;                           // us_ticker_read() at last refill
+    volatile uint32_t drops;
+    volatile bool sending;                          // TX interrupt enabled
+
+    /** Reserve len bytes of budget and ring space */
+    bool reserve(uint32_t len);
+
+    /** Enable the TX interrupt if it's idle */
+    void kick();
+
+    /** TX empty interrupt: send next byte or stop */
+    void txISR();
+};
+
+#endif // DEBUG_SINK_H
@@ -0,0 +1,105 @@
+#include "Decimator.h"
+
+/* Inverse sinc^3 compensator (Q15, symmetric, sums to 1.0) */
+static const int16_t comp_coef[COMP_TAPS / 2 + 1] = { 1874, -6980, 7659, 27662 };
+
+Decimator::Decimator(uint8_t ratio)
+{
+    set_ratio(ratio);
+}
+
+void Decimator::set_ratio(uint8_t r)
+{
+    if (r < 1)
+        r = 1;
+    if (r > DECIMATOR_MAX_RATIO)
+        r = DECIMATOR_MAX_RATIO;
+
+    ratio = r;
+    norm = (1 << 24) / ((int32_t)r * r * r);
+    reset();
+}
+
+void Decimator::reset()
+{
+    for (int i = 0; i < CIC_ORDER; i++)
+    {
+        integ[i] = 0;
+        comb[i] = 0;
+    }
+    for (int i = 0; i < COMP_TAPS; i++)
+        fir[i] = 0;
+    phase = 0;
+    fir_pos = 0;
+}
+
+int16_t Decimator::compensate(int32_t x)
+{
+    fir[fir_pos] = x;
+
+    /* Symmetric taps: add the mirrored samples before multiplying */
+    int32_t acc = 1 << 14;
+    uint8_t a = fir_pos, b = fir_pos + 1;
+    if (b == COMP_TAPS)
+        b = 0;
+    for (int k = 0; k < COMP_TAPS / 2; k++)
+    {
+        /* a walks back from the newest sample, b forward from the oldest */
+        acc += ((int32_t)fir[a] + fir[b]) * comp_coef[k];
+        a = (a == 0) ? COMP_TAPS - 1 : a - 1;
+        b = (b == COMP_TAPS - 1) ? 0 : b + 1;
+    }
+    acc += (int32_t)fir[a] * comp_coef[COMP_TAPS / 2];
+
+    fir_pos = (fir_pos == COMP_TAPS - 1) ? 0 : fir_pos + 1;
+
+    acc >>= 15;
+    if (acc > 32767)
+        acc = 32767;
+    if (acc < -32768)
+        acc = -32768;
+    return acc;
+}
+
+bool Decimator::put(int16_t in, int16_t &out)
+{
+    if (ratio == 1)
+    {
+        out = in;
+        return true;
+    }
+
+    /* Integrators, at the input rate */
+    integ[0] += (uint32_t)(int32_t)in;
+    integ[1] += integ[0];
+    integ[2] += integ[1];
+
+    if (++phase < ratio)
+        return false;
+    phase = 0;
+
+    /* Combs, at the output rate */
+    uint32_t v = integ[2];
+    for (int i = 0; i < CIC_ORDER; i++)
+    {
+        uint32_t d = v - comb[i];
+        comb[i] = v;
+        v = d;
+    }
+
+    int32_t cic = ((int64_t)(int32_t)v * norm) >> 24;
+    out = compensate(cic);
+    return true;
+}
+
+uint32_t Decimator::process(const int16_t *in, uint32_t n, int16_t *out)
+{
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (put(in[i], out[count]))
+            count++;
+    }
+    return count;
+}
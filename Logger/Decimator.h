@@ -0,0 +1,62 @@
+/*
+    Fixed-point decimation filter for oversampled channels.
+    A 3rd order CIC filter decimates by the channel ratio, then a 7-tap FIR
+    running at the output rate compensates the CIC passband droop and adds
+    stop band attenuation. Response relative to the output rate fs:
+    within 0.6 dB up to 0.2 fs, -0.7 dB at 0.25 fs, -16 dB at 0.4 fs and
+    below -24 dB from 0.5 fs (aliasing band).
+    Group delay is 3 output samples plus (ratio - 1) * 3 / 2 input samples.
+    Integer only (no FPU on the Cortex-M3), no dependency on mbed so it can be
+    built on the host ("tools/decim_bench.cpp").
+*/
+
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <stdint.h>
+
+#define CIC_ORDER 3
+#define COMP_TAPS 7
+#define DECIMATOR_MAX_RATIO 16                      // CIC gain (ratio^3) must fit the 32-bit registers
+
+class Decimator
+{
+public:
+    /**  Decimator -- class constructor
+    *  Input:
+    *   - ratio = Decimation ratio, 1 (pass-through) to DECIMATOR_MAX_RATIO.
+    */
+    Decimator(uint8_t ratio = 1);
+
+    /**  set_ratio() -- Change the decimation ratio. Resets the filter state. */
+    void set_ratio(uint8_t ratio);
+    uint8_t get_ratio() const { return ratio; }
+
+    /**  reset() -- Clear the filter state (e.g. at the start of a run). */
+    void reset();
+
+    /**  put() -- Feed one input sample.
+    *  Output: true when a decimated sample was written to out (every ratio inputs).
+    */
+    bool put(int16_t in, int16_t &out);
+
+    /**  process() -- Filter a block of samples.
+    *  out must have room for n / ratio + 1 samples.
+    *  Output: number of samples written to out.
+    */
+    uint32_t process(const int16_t *in, uint32_t n, int16_t *out);
+
+private:
+    uint8_t ratio;
+    uint8_t phase;                                  // Inputs since the last output
+    uint32_t integ[CIC_ORDER];                      // Integrators (wrap-around arithmetic)
+    uint32_t comb[CIC_ORDER];                       // Comb delays
+    int32_t norm;                                   // 2^24 / ratio^3, CIC gain correction
+    int16_t fir[COMP_TAPS];                         // Compensator delay line
+    uint8_t fir_pos;
+
+    /** Compensator FIR, one output rate sample */
+    int16_t compensate(int32_t x);
+};
+
+#endif // DECIMATOR_H
@@ -0,0 +1,101 @@
+#include "EventCapture.h"
+
+EventCapture::EventCapture(uint16_t rate, uint16_t threshold) : state(ARMED), pending(0), head(0),
+    fill(0), start(0), pre(0), remaining(0), rate(rate), threshold_sq((uint32_t)threshold * threshold),
+    source(0), trigger_time(0), events(0), encoder(block, sizeof(block))
+{
+}
+
+void EventCapture::trigger()
+{
+    if (state == ARMED)
+        pending = EVENT_SRC_HARDWARE;
+}
+
+void EventCapture::add(uint32_t time_ms, const rec_imu_t &frame)
+{
+    if (state == DUMP)
+        return;                                     // Window frozen until written
+
+    ring[head].time_ms = time_ms;
+    ring[head].imu = frame;
+
+    if (state == ARMED)
+    {
+        /* Software threshold on |a|^2, no sqrt needed */
+        if (threshold_sq != 0 && pending == 0)
+        {
+            uint32_t mag_sq = 0;
+            for (int i = 0; i < 3; i++)
+                mag_sq += (uint32_t)((int32_t)frame.acc[i] * frame.acc[i]);
+            if (mag_sq > threshold_sq)
+                pending = EVENT_SRC_THRESHOLD;
+        }
+
+        if (pending != 0)
+        {
+            /* This frame is the first post-trigger frame */
+            pre = (fill < EVENT_PRE) ? fill : EVENT_PRE;
+            start = (head + EVENT_RING - pre) % EVENT_RING;
+            source = pending;
+            pending = 0;
+            trigger_time = time_ms;
+            remaining = EVENT_POST;
+            state = POST;
+        }
+        else if (fill < EVENT_RING)
+        {
+            fill++;
+        }
+    }
+
+    head = (head + 1) % EVENT_RING;
+
+    if (state == POST && --remaining == 0)
+    {
+        remaining = pre + EVENT_POST;
+        state = DUMP;
+        events++;
+    }
+}
+
+bool EventCapture::write(FILE *fp, uint32_t max_frames)
+{
+    if (state != DUMP)
+        return true;
+
+    if (remaining == pre + EVENT_POST)
+    {
+        /* Start of the event file */
+        rec_event_t ev = { trigger_time, pre, EVENT_POST, rate, source, 0 };
+
+        encoder.begin(rate);
+        encoder.put(REC_EVENT, trigger_time, &ev);
+        fwrite(encoder.data(), 1, encoder.length(), fp);
+        encoder.clear();
+    }
+
+    while (remaining > 0 && max_frames-- > 0)
+    {
+        const frame_t &f = ring[start];
+
+        if (!encoder.put(REC_IMU, f.time_ms, &f.imu))
+        {
+            fwrite(encoder.data(), 1, encoder.length(), fp);
+            encoder.clear();
+            encoder.put(REC_IMU, f.time_ms, &f.imu);
+        }
+        start = (start + 1) % EVENT_RING;
+        remaining--;
+    }
+    fwrite(encoder.data(), 1, encoder.length(), fp);
+    encoder.clear();
+
+    if (remaining > 0)
+        return false;
+
+    /* Window written, start over with an empty ring */
+    fill = 0;
+    state = ARMED;
+    return true;
+}
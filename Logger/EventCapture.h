@@ -0,0 +1,80 @@
+/*
+    Pre-trigger event capture.
+    Every raw IMU frame (acquisition rate, before decimation) goes into a RAM
+    ring. When the LSM6DS3 interrupt or the software acceleration threshold
+    fires, the last EVENT_PRE frames plus the next EVENT_POST frames are kept
+    and then written, a few at a time, to a separate event file while the
+    normal log continues. Frames arriving while a window is being written are
+    not captured.
+*/
+
+#ifndef EVENT_CAPTURE_H
+#define EVENT_CAPTURE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "RecordEncoder.h"
+
+#define EVENT_PRE 96                                // Frames kept before the trigger
+#define EVENT_POST 160                              // Frames kept from the trigger on
+#define EVENT_RING (EVENT_PRE + EVENT_POST)         // 16 bytes per frame
+
+class EventCapture
+{
+public:
+    /**  EventCapture -- class constructor
+    *  Input:
+    *   - rate = Frame rate (Hz), stored in the event file.
+    *   - threshold = Acceleration magnitude that triggers a capture (raw counts),
+    *       0 to use only the hardware interrupt.
+    */
+    EventCapture(uint16_t rate, uint16_t threshold);
+
+    /**  trigger() -- Request a capture (safe to call from an ISR). */
+    void trigger();
+
+    /**  add() -- Add a raw IMU frame. Checks the software threshold. */
+    void add(uint32_t time_ms, const rec_imu_t &frame);
+
+    /**  set_rate() -- Frame rate stored in the next event files (Hz). */
+    void set_rate(uint16_t frame_rate) { rate = frame_rate; }
+
+    /**  ready() -- A complete window is waiting to be written. */
+    bool ready() const { return state == DUMP; }
+
+    /**  write() -- Write up to max_frames of the window to fp.
+    *  The first call writes the file header and the REC_EVENT record.
+    *  Output: true when the whole window was written (capture is armed again).
+    */
+    bool write(FILE *fp, uint32_t max_frames);
+
+    /** Windows captured since start */
+    uint32_t count() const { return events; }
+
+private:
+    enum capture_state { ARMED, POST, DUMP };
+
+    struct frame_t
+    {
+        uint32_t time_ms;
+        rec_imu_t imu;
+    };
+
+    frame_t ring[EVENT_RING];
+    volatile capture_state state;
+    volatile uint8_t pending;                       // EVENT_SRC_* of a trigger not handled yet
+    uint16_t head;                                  // Next slot to write
+    uint16_t fill;                                  // Valid frames in the ring (ARMED)
+    uint16_t start;                                 // First frame of the window
+    uint16_t pre;                                   // Frames before the trigger
+    uint16_t remaining;                             // POST: frames still to capture, DUMP: to write
+    uint16_t rate;
+    uint32_t threshold_sq;
+    uint8_t source;
+    uint32_t trigger_time;
+    uint32_t events;
+    uint8_t block[64];                              // Encoder buffer for the event file
+    RecordEncoder encoder;
+};
+
+#endif // EVENT_CAPTURE_H
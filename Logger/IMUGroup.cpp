@@ -0,0 +1,70 @@
+#include "IMUGroup.h"
+
+#define LSM6DS3_WHO_AM_I 0x69
+
+IMUGroup::IMUGroup(I2C *bus) : bus(bus), count(0), mask(0)
+{
+}
+
+int IMUGroup::add(LSM6DS3 &imu)
+{
+    if (count >= IMU_GROUP_MAX)
+        return -1;
+
+    dev[count] = &imu;
+    return count++;
+}
+
+uint8_t IMUGroup::begin(LSM6DS3::gyro_scale gScl, LSM6DS3::accel_scale aScl,
+                        LSM6DS3::gyro_odr gODR, LSM6DS3::accel_odr aODR)
+{
+    mask = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (dev[i]->begin(gScl, aScl, gODR, aODR) == LSM6DS3_WHO_AM_I)
+            mask |= 1 << i;
+    }
+    return mask;
+}
+
+uint8_t IMUGroup::sample(rec_imu_t *imu, int16_t *offset_us)
+{
+    uint32_t mid[IMU_GROUP_MAX];
+    uint8_t ok = 0;
+
+    if (bus != NULL)
+        bus->lock();
+
+    uint32_t start = us_ticker_read();
+    for (int i = 0; i < count; i++)
+    {
+        if (!(mask & (1 << i)))
+            continue;
+
+        uint32_t t0 = us_ticker_read();
+        if (dev[i]->readAll() == 0)
+        {
+            uint32_t t1 = us_ticker_read();
+
+            imu[i].acc[0] = dev[i]->ax_raw;
+            imu[i].acc[1] = dev[i]->ay_raw;
+            imu[i].acc[2] = dev[i]->az_raw;
+            imu[i].gyr[0] = dev[i]->gx_raw;
+            imu[i].gyr[1] = dev[i]->gy_raw;
+            imu[i].gyr[2] = dev[i]->gz_raw;
+            mid[i] = t0 + (t1 - t0) / 2;
+            ok |= 1 << i;
+        }
+    }
+    uint32_t end = us_ticker_read();
+
+    if (bus != NULL)
+        bus->unlock();
+
+    /* Offsets from the middle of the burst */
+    uint32_t center = start + (end - start) / 2;
+    for (int i = 0; i < count; i++)
+        offset_us[i] = (ok & (1 << i)) ? (int16_t)(int32_t)(mid[i] - center) : 0;
+
+    return ok;
+}
@@ -0,0 +1,55 @@
+/*
+    Group of LSM6DS3 sampled together.
+    The devices share one bus; on each tick their gyro+accel registers are read
+    back-to-back, one 12-byte burst per device, with the bus held for the
+    whole group. The read time of each device is kept as an offset from the
+    middle of the group burst, so the samples can be aligned on the host.
+*/
+
+#ifndef IMU_GROUP_H
+#define IMU_GROUP_H
+
+#include "mbed.h"
+#include "LSM6DS3.h"
+#include "log_record.h"
+
+class IMUGroup
+{
+public:
+    /**  IMUGroup -- class constructor
+    *  Input:
+    *   - bus = Shared I2C bus, locked during the group burst (NULL if not shared).
+    */
+    IMUGroup(I2C *bus = NULL);
+
+    /**  add() -- Add a device to the group (up to IMU_GROUP_MAX).
+    *  Output: index of the device, -1 if the group is full.
+    */
+    int add(LSM6DS3 &imu);
+
+    /**  begin() -- Initialize every device with the same settings.
+    *  Output: mask of the devices that answered WHO_AM_I.
+    */
+    uint8_t begin(LSM6DS3::gyro_scale gScl, LSM6DS3::accel_scale aScl,
+                  LSM6DS3::gyro_odr gODR, LSM6DS3::accel_odr aODR);
+
+    /**  sample() -- Read every connected device in one bus burst.
+    *  Input:
+    *   - imu = Receives the raw readings, indexed like add().
+    *   - offset_us = Receives each device read time relative to the burst middle.
+    *  Output: mask of the devices read successfully.
+    */
+    uint8_t sample(rec_imu_t *imu, int16_t *offset_us);
+
+    /** Devices in the group and the mask of the connected ones */
+    uint8_t size() const { return count; }
+    uint8_t connected() const { return mask; }
+
+private:
+    LSM6DS3 *dev[IMU_GROUP_MAX];
+    I2C *bus;
+    uint8_t count;
+    uint8_t mask;
+};
+
+#endif // IMU_GROUP_H
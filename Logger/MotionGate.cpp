@@ -0,0 +1,62 @@
+#include "MotionGate.h"
+
+MotionGate::MotionGate(uint16_t threshold, uint32_t idle_ms) :
+    threshold(threshold), idle_ms(idle_ms)
+{
+    reset(0);
+}
+
+void MotionGate::reset(uint32_t now_ms)
+{
+    last_motion = now_ms;
+    moved = false;
+    is_idle = false;
+    has_ref = false;
+}
+
+bool MotionGate::wake()
+{
+    bool was_idle;
+
+    core_util_critical_section_enter();             // The ISR and sample() end an idle period once
+    was_idle = is_idle;
+    moved = true;
+    is_idle = false;
+    core_util_critical_section_exit();
+    return was_idle;
+}
+
+bool MotionGate::sample(const rec_imu_t &frame)
+{
+    bool motion = !has_ref;
+
+    for (int i = 0; i < 3 && !motion; i++)
+    {
+        int32_t change = (int32_t)frame.acc[i] - ref_acc[i];
+
+        motion = change > threshold || change < -(int32_t)threshold;
+    }
+    if (!motion)
+        return false;
+    for (int i = 0; i < 3; i++)
+        ref_acc[i] = frame.acc[i];
+    if (!has_ref)
+    {
+        has_ref = true;                             // First frame is the reference, not motion
+        return false;
+    }
+    return wake();
+}
+
+bool MotionGate::idle_due(uint32_t now_ms)
+{
+    if (moved)
+    {
+        moved = false;
+        last_motion = now_ms;
+    }
+    if (is_idle || now_ms - last_motion < idle_ms)
+        return false;
+    is_idle = true;
+    return true;
+}
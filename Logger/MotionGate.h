@@ -0,0 +1,62 @@
+/*
+    Motion gating of the acquisition rate.
+    Motion is the LSM6DS3 wake-up interrupt (slope of the acceleration over
+    its threshold, at the sensor ODR) or an IMU sample of the logger whose
+    acceleration is the same threshold away from the last one that moved,
+    whatever the rate it comes at. After idle_ms without motion the logger drops to
+    its idle rate (or pauses), and the first motion brings it back to the
+    full rate: the wake-up interrupt at once, from its ISR, the IMU samples
+    at the next idle sample.
+    The sensor keeps its ODR: its own inactivity mode would change it under
+    the logger and the IMU decimation.
+*/
+
+#ifndef MOTION_GATE_H
+#define MOTION_GATE_H
+
+#include <stdint.h>
+#include "mbed.h"
+#include "log_record.h"
+
+class MotionGate
+{
+public:
+    /**  MotionGate -- class constructor
+    *  Input:
+    *   - threshold = Acceleration change between two samples that is motion (raw counts).
+    *   - idle_ms = Time without motion before going idle.
+    */
+    MotionGate(uint16_t threshold, uint32_t idle_ms);
+
+    /**  reset() -- Active, last motion now (start of a run). */
+    void reset(uint32_t now_ms);
+
+    /**  wake() -- Motion from the wake-up interrupt (safe to call from an ISR).
+    *  Output: true if this ends an idle period (restore the full rate).
+    */
+    bool wake();
+
+    /**  sample() -- Check a raw IMU frame against the last one that moved.
+    *  Output: true if it moved and this ends an idle period.
+    */
+    bool sample(const rec_imu_t &frame);
+
+    /**  idle_due() -- Time the motion, once per loop.
+    *  Output: true once, when idle_ms went by without motion (lower the rate).
+    */
+    bool idle_due(uint32_t now_ms);
+
+    /** No motion for idle_ms, not woken up since */
+    bool idle() const { return is_idle; }
+
+private:
+    uint16_t threshold;
+    uint32_t idle_ms;
+    uint32_t last_motion;                           // Time of the last motion seen by idle_due()
+    volatile bool moved;                            // Motion since the last idle_due()
+    volatile bool is_idle;
+    int16_t ref_acc[3];                             // Acceleration at the last motion of sample()
+    bool has_ref;
+};
+
+#endif // MOTION_GATE_H
@@ -0,0 +1,154 @@
+#include "PartRotator.h"
+#include "mbed.h"
+#include <string.h>
+
+PartRotator::PartRotator(uint32_t max_bytes, uint32_t max_ms, uint32_t block, bool prealloc) : max_bytes(max_bytes),
+    max_ms(max_ms), block(block), prealloc(prealloc && max_bytes != 0), buffer(0), buffers(NULL), buffers_size(0), fp_buffer(0), part_num(0), fp(NULL),
+    bytes_written(0), start_ms(0), next(NULL), next_size(0), prev(NULL), prev_step(CLOSE_NONE), late_rotations(0),
+    late_counted(false), closed(false)
+{
+    dir[0] = '\0';
+}
+
+void PartRotator::part_name(char *name, size_t size, uint16_t num) const
+{
+    snprintf(name, size, "%s%s%u", dir, "/part", num);
+}
+
+void PartRotator::set_buffers(uint8_t *memory, uint16_t size)
+{
+    buffers = memory;
+    buffers_size = size;
+}
+
+FILE *PartRotator::open_part(uint16_t num, uint8_t slot)
+{
+    char name[PART_NAME_SIZE];
+    FILE *f;
+
+    part_name(name, sizeof(name), num);
+    f = fopen(name, "w");                           // Not "a": appending would write after the pre-sized area
+    if (f != NULL && buffers != NULL)
+        setvbuf(f, (char *)buffers + slot * buffers_size, _IOFBF, (buffer != 0 && buffer < buffers_size) ? buffer : buffers_size);
+    else if (f != NULL && buffer != 0)
+        setvbuf(f, NULL, _IOFBF, buffer);
+    return f;
+}
+
+FILE *PartRotator::begin(const char *path, uint32_t now_ms, uint16_t buffer_size)
+{
+    snprintf(dir, sizeof(dir), "%s", path);
+    buffer = buffer_size;
+    part_num = 1;
+    bytes_written = 0;
+    start_ms = now_ms;
+    fp_buffer = 0;
+    fp = open_part(part_num, fp_buffer);
+    if (fp != NULL && prealloc)
+        ftruncate(fileno(fp), max_bytes);
+    return fp;
+}
+
+bool PartRotator::ready() const
+{
+    return next != NULL && (!prealloc || next_size >= max_bytes) && prev == NULL;
+}
+
+bool PartRotator::due(uint32_t now_ms)
+{
+    if (closed || fp == NULL)
+        return false;
+    if (!((max_bytes != 0 && bytes_written + block > max_bytes) || (max_ms != 0 && now_ms - start_ms >= max_ms)))
+        return false;
+    if (!ready())
+    {
+        if (!late_counted)
+            late_rotations++;                       // The current part grows past the limit meanwhile
+        late_counted = true;
+        return false;
+    }
+    return true;
+}
+
+FILE *PartRotator::rotate(uint32_t now_ms)
+{
+    prev = fp;
+    prev_step = CLOSE_FLUSH;
+    fp = next;
+    fp_buffer ^= 1;                                 // The previous part keeps its buffer until closed
+    next = NULL;
+    next_size = 0;
+    part_num++;
+    bytes_written = 0;
+    start_ms = now_ms;
+    late_counted = false;
+    return fp;
+}
+
+bool PartRotator::idle()
+{
+    if (closed || fp == NULL)
+        return false;
+
+    /* Previous part: flush, cut the unused pre-sized space, close */
+    if (prev != NULL)
+    {
+        switch (prev_step)
+        {
+            case CLOSE_FLUSH:
+                fflush(prev);
+                prev_step = CLOSE_TRUNCATE;
+                break;
+            case CLOSE_TRUNCATE:
+                if (prealloc)
+                    ftruncate(fileno(prev), ftell(prev));
+                prev_step = CLOSE_FILE;
+                break;
+            default:
+                fclose(prev);
+                prev = NULL;
+                prev_step = CLOSE_NONE;
+                break;
+        }
+        return true;
+    }
+
+    /* Next part: create, then allocate a step at a time */
+    if (next == NULL && (max_bytes != 0 || max_ms != 0))
+    {
+        next = open_part(part_num + 1, fp_buffer ^ 1);
+        next_size = 0;
+        return next != NULL;
+    }
+    if (next != NULL && prealloc && next_size < max_bytes)
+    {
+        next_size = (max_bytes - next_size > PART_PREALLOC_STEP) ? next_size + PART_PREALLOC_STEP : max_bytes;
+        ftruncate(fileno(next), next_size);
+        return true;
+    }
+    return false;
+}
+
+void PartRotator::end()
+{
+    char name[PART_NAME_SIZE];
+
+    while (prev != NULL)
+        idle();
+    if (fp != NULL && !closed)
+    {
+        fflush(fp);
+        if (prealloc)
+            ftruncate(fileno(fp), ftell(fp));
+        fclose(fp);
+    }
+    if (next != NULL)
+    {
+        fclose(next);
+        part_name(name, sizeof(name), part_num + 1);
+        remove(name);
+    }
+    fp = NULL;
+    next = NULL;
+    closed = true;
+}
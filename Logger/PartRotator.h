@@ -0,0 +1,108 @@
+/*
+    Part file rotation without stalls.
+    The next part file is created and pre-sized (its clusters allocated)
+    ahead of time, one card operation per idle() call, and the previous part
+    is flushed, cut to its length and closed the same way. The switch itself,
+    between two blocks, only swaps the FILE pointer: the new part starts at
+    offset 0 and its writes need no cluster allocation.
+    If the next part isn't ready when the limit is reached (idle() wasn't
+    called often enough), the current part just grows past it.
+    After a power loss, a pre-sized part keeps its pre-sized length, with
+    stale card data after the last record.
+*/
+
+#ifndef PART_ROTATOR_H
+#define PART_ROTATOR_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define PART_PREALLOC_STEP 32768                    // Bytes allocated to the next part per idle() call
+#define PART_DIR_SIZE   16                          // Run folder path, with its terminator
+#define PART_NAME_SIZE  (PART_DIR_SIZE + sizeof("/part") - 1 + 5)  // "dir/partN", N up to 65535
+
+class PartRotator
+{
+public:
+    /**  PartRotator -- class constructor
+    *  Input:
+    *   - max_bytes = Part size limit, 0 for none. Parts are pre-sized to it.
+    *   - max_ms = Part duration limit, 0 for none.
+    *   - block = Largest single write, a part is switched before it would pass max_bytes.
+    *   - prealloc = Pre-size the parts (not on littlefs, which writes the extension).
+    */
+    PartRotator(uint32_t max_bytes, uint32_t max_ms, uint32_t block, bool prealloc = true);
+
+    /**  begin() -- Open and pre-size dir/part1 (blocking, before acquisition).
+    *  Input:
+    *   - buffer = stdio buffer size of the parts, 0 for the default.
+    *  Output: the part1 stream, NULL if it can't be opened.
+    */
+    FILE *begin(const char *dir, uint32_t now_ms, uint16_t buffer = 0);
+
+    /**  set_buffers() -- stdio buffers of the parts in static memory instead of
+    *  the heap: memory holds two of size bytes, for the current part and the
+    *  next (or previous) one. Call before begin(), whose buffer is then at
+    *  most size (size for 0).
+    */
+    void set_buffers(uint8_t *memory, uint16_t size);
+
+    /**  written() -- Account bytes written to the current part. */
+    void written(uint32_t bytes) { bytes_written += bytes; }
+
+    /**  due() -- A limit is reached and the next part is ready: flush the
+    *  encoder block and rotate(). A limit reached before the next part is
+    *  ready is counted as a late rotation.
+    */
+    bool due(uint32_t now_ms);
+
+    /**  rotate() -- Switch to the next part, the current one is closed by idle().
+    *  Output: the new stream.
+    */
+    FILE *rotate(uint32_t now_ms);
+
+    /**  idle() -- One step of background work: close the previous part,
+    *  create the next one, or extend it by PART_PREALLOC_STEP.
+    *  Output: false if there was nothing to do.
+    */
+    bool idle();
+
+    /**  end() -- Close the current part at its length and delete the unused next
+    *  one. Writes to the stream afterwards fail.
+    */
+    void end();
+
+    /** Number of the current part (1 = part1) and rotations not done on time */
+    uint16_t part() const { return part_num; }
+    uint32_t late() const { return late_rotations; }
+
+private:
+    enum close_step { CLOSE_NONE, CLOSE_FLUSH, CLOSE_TRUNCATE, CLOSE_FILE };
+
+    uint32_t max_bytes;
+    uint32_t max_ms;
+    uint32_t block;
+    bool prealloc;
+    uint16_t buffer;
+    uint8_t *buffers;                               // Static stdio buffers, NULL for the heap
+    uint16_t buffers_size;
+    uint8_t fp_buffer;                              // Static buffer of the current part (0 or 1)
+    char dir[PART_DIR_SIZE];
+    uint16_t part_num;
+    FILE *fp;                                       // Current part
+    uint32_t bytes_written;                         // To the current part
+    uint32_t start_ms;                              // Current part start
+    FILE *next;                                     // Next part, being pre-sized
+    uint32_t next_size;
+    FILE *prev;                                     // Previous part, being closed
+    close_step prev_step;
+    uint32_t late_rotations;
+    bool late_counted;                              // Current limit reached, counted in late_rotations
+    bool closed;                                    // end() was called
+
+    bool ready() const;
+    FILE *open_part(uint16_t num, uint8_t slot);
+    void part_name(char *name, size_t size, uint16_t num) const;
+};
+
+#endif // PART_ROTATOR_H
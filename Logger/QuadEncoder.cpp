@@ -0,0 +1,55 @@
+#include "QuadEncoder.h"
+
+QuadEncoder::QuadEncoder() : timer(0), latched(0), latched_us(0)
+{
+    reset(0);
+}
+
+bool QuadEncoder::begin(PinName ch1, PinName ch2)
+{
+    timer = qenc_timer_init(ch1, ch2, QENC_FILTER);
+    reset(latched_us);
+    return timer != 0;
+}
+
+void QuadEncoder::reset(uint32_t now_us)
+{
+    core_util_critical_section_enter();
+    if (timer)
+        latched = qenc_timer_count(timer);
+    latched_us = now_us;
+    core_util_critical_section_exit();
+
+    last = latched;
+    pos = 0;
+    vel = 0;
+    for (int i = 0; i < QENC_WINDOW; i++)
+    {
+        window_pos[i] = 0;
+        window_us[i] = now_us;
+    }
+    index = 0;
+}
+
+void QuadEncoder::update()
+{
+    uint16_t count;
+    uint32_t us;
+
+    core_util_critical_section_enter();             // Count and time of the same latch()
+    count = latched;
+    us = latched_us;
+    core_util_critical_section_exit();
+
+    pos += (int16_t)(uint16_t)(count - last);       // Wrap-around difference, either direction
+    last = count;
+
+    /* Over the oldest update of the window, 0 if no tick went by since */
+    int32_t moved = pos - window_pos[index];
+    uint32_t elapsed = us - window_us[index];
+
+    vel = elapsed ? (int32_t)((int64_t)moved * 1000000 / elapsed) : 0;
+    window_pos[index] = pos;
+    window_us[index] = us;
+    index = (index + 1) % QENC_WINDOW;
+}
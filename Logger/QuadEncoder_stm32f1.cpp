@@ -0,0 +1,61 @@
+/*
+    STM32F1 timer in encoder mode for QuadEncoder: the pins and their timer
+    come from the target's PWM pin map (with the AFIO remap it gives), the
+    inputs are plain pulled-up inputs read by the timer.
+*/
+
+#if defined(TARGET_STM32F1)
+
+#include "QuadEncoder.h"
+#include "pinmap.h"
+#include "PeripheralPins.h"
+#include "pin_device.h"
+
+static bool qenc_pin(PinName pin, int channel)
+{
+    int function = pinmap_find_function(pin, PinMap_PWM);
+
+    if (function == (int)NC || STM_PIN_CHANNEL(function) != channel || STM_PIN_INVERTED(function))
+        return false;
+    pin_function(pin, STM_PIN_DATA(STM_MODE_INPUT, GPIO_PULLUP, 0));
+    stm_pin_SetAFPin(NULL, pin, STM_PIN_AFNUM(function));  // Timer remap, the pin stays an input
+    return true;
+}
+
+uint32_t qenc_timer_init(PinName ch1, PinName ch2, uint8_t filter)
+{
+    uint32_t timer = pinmap_find_peripheral(ch1, PinMap_PWM);
+    TIM_TypeDef *tim = (TIM_TypeDef *)timer;
+
+    if (timer == (uint32_t)NC || pinmap_find_peripheral(ch2, PinMap_PWM) != timer)
+        return 0;
+    switch (timer)
+    {
+        case PWM_1: __HAL_RCC_TIM1_CLK_ENABLE(); break;
+        case PWM_2: __HAL_RCC_TIM2_CLK_ENABLE(); break;
+        case PWM_3: __HAL_RCC_TIM3_CLK_ENABLE(); break;
+        default: return 0;                          // TIM4 runs the us_ticker
+    }
+    if (!qenc_pin(ch1, 1) || !qenc_pin(ch2, 2))
+        return 0;
+
+    tim->CR1 = 0;
+    tim->SMCR = TIM_SMCR_SMS_1 | TIM_SMCR_SMS_0;    // Encoder mode 3: count on both edges of TI1 and TI2
+    tim->CCMR1 = TIM_CCMR1_CC1S_0 | TIM_CCMR1_CC2S_0 |  // IC1 on TI1, IC2 on TI2
+                 ((uint32_t)filter << TIM_CCMR1_IC1F_Pos) | ((uint32_t)filter << TIM_CCMR1_IC2F_Pos);
+    tim->CCER = 0;                                  // Rising polarity on both, no inversion
+    tim->DIER = 0;                                  // No interrupt
+    tim->PSC = 0;
+    tim->ARR = 0xFFFF;
+    tim->EGR = TIM_EGR_UG;
+    tim->CNT = 0;
+    tim->CR1 = TIM_CR1_CEN;
+    return timer;
+}
+
+uint16_t qenc_timer_count(uint32_t timer)
+{
+    return ((TIM_TypeDef *)timer)->CNT;
+}
+
+#endif // TARGET_STM32F1
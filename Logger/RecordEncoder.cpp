@@ -0,0 +1,89 @@
+#include "RecordEncoder.h"
+#include "platform/mbed_assert.h"
+#include <stddef.h>
+#include <string.h>
+
+RecordEncoder::RecordEncoder(uint8_t *buf, uint32_t size) : buf(buf), size(size), len(0),
+    last_time(0), has_time(false), run_id(0), seq(0), mark(0), marked(false)
+{
+}
+
+void RecordEncoder::begin(uint16_t sample_freq, uint32_t run_id)
+{
+    log_header_t header;
+
+    header.magic = LOG_MAGIC;
+    header.version = LOG_VERSION;
+    header.sample_freq = sample_freq;
+    header.run_id = run_id;
+
+    memcpy(buf, &header, sizeof(header));
+    len = sizeof(header);
+    has_time = false;
+    this->run_id = run_id;
+    seq = 0;
+    marked = false;
+}
+
+bool RecordEncoder::put(uint8_t tag, uint32_t time_ms, const void *payload)
+{
+    uint32_t dt = time_ms - last_time;
+    uint8_t payload_size = (tag < REC_NUM_TAGS) ? rec_payload_size[tag] : 0;
+
+    MBED_ASSERT(payload_size != 0);                 // Unknown tag
+    if (payload_size == 0)
+        return true;                                // Dropped when asserts are compiled out, the stream stays valid
+
+    bool sync = !has_time || (time_ms < last_time) || (dt > REC_MAX_DT);
+    bool new_mark = run_id != 0 && !marked;
+    uint32_t needed = 2 + payload_size + (sync ? 1 + sizeof(rec_time_t) : 0) + (new_mark ? 1 + sizeof(rec_mark_t) : 0);
+
+    if (len + needed > size)
+        return false;
+
+    if (new_mark)
+    {
+        /* First record of the block, its length is filled in as records are added */
+        rec_mark_t rec = { run_id, seq++, 0 };
+
+        mark = len;
+        buf[len++] = REC_MARK | REC_SAME_TIME;
+        memcpy(buf + len, &rec, sizeof(rec));
+        len += sizeof(rec);
+        marked = true;
+    }
+
+    if (sync)
+    {
+        /* Gap too long for dt, resynchronize with an absolute timestamp */
+        rec_time_t rec = { time_ms };
+
+        buf[len++] = REC_TIME | REC_SAME_TIME;
+        memcpy(buf + len, &rec, sizeof(rec));
+        len += sizeof(rec);
+        dt = 0;
+    }
+
+    if (dt == 0)
+    {
+        buf[len++] = tag | REC_SAME_TIME;
+    }
+    else
+    {
+        buf[len++] = tag;
+        buf[len++] = (uint8_t)dt;
+    }
+    memcpy(buf + len, payload, payload_size);
+    len += payload_size;
+
+    if (marked)
+    {
+        uint16_t length = len - mark;
+
+        memcpy(buf + mark + 1 + offsetof(rec_mark_t, length), &length, sizeof(length));
+    }
+
+    last_time = time_ms;
+    has_time = true;
+    return true;
+}
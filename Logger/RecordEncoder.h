@@ -0,0 +1,62 @@
+/*
+    Encoder for the tagged record stream described in "log_record.h".
+    Records are appended to a caller-supplied block buffer, which is written to
+    the card as a whole when full.
+*/
+
+#ifndef RECORD_ENCODER_H
+#define RECORD_ENCODER_H
+
+#include <stdint.h>
+#include "log_record.h"
+
+class RecordEncoder
+{
+public:
+    /**  RecordEncoder -- class constructor
+    *  Input:
+    *   - buf = Block buffer that receives the encoded records.
+    *   - size = Size of buf in bytes, at least sizeof(log_header_t) + REC_MAX_SIZE,
+    *     plus 1 + sizeof(rec_mark_t) for files with block markers.
+    */
+    RecordEncoder(uint8_t *buf, uint32_t size);
+
+    /**  begin() -- Start a new file.
+    *  Clears the buffer, writes the file header and forgets the last timestamp,
+    *  so the next record is preceded by an absolute REC_TIME.
+    *  Input:
+    *   - sample_freq = Nominal sample rate of the header.
+    *   - run_id = Id of the run, not 0 to start every block with a REC_MARK
+    *     record (part files, see "log_record.h").
+    */
+    void begin(uint16_t sample_freq, uint32_t run_id = 0);
+
+    /**  put() -- Append a record.
+    *  Input:
+    *   - tag = Record type (REC_*), payload must have rec_payload_size[tag] bytes.
+    *     An unknown tag asserts, or the record is dropped if asserts are compiled out.
+    *   - time_ms = Timestamp of the record.
+    *  Output: false if the buffer doesn't have room for it (flush and retry).
+    */
+    bool put(uint8_t tag, uint32_t time_ms, const void *payload);
+
+    /** Encoded data and its length */
+    const uint8_t *data() const { return buf; }
+    uint32_t length() const { return len; }
+
+    /** Drop the encoded data, keeping the timestamp reference; the next block gets its own marker */
+    void clear() { len = 0; marked = false; }
+
+private:
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t len;
+    uint32_t last_time;                             // Timestamp of the last record
+    bool has_time;                                  // last_time is known by the reader
+    uint32_t run_id;                                // Of the REC_MARK records, 0 = none
+    uint16_t seq;                                   // Number of the next block
+    uint32_t mark;                                  // Offset of this block's REC_MARK in buf
+    bool marked;                                    // This block has its REC_MARK
+};
+
+#endif // RECORD_ENCODER_H
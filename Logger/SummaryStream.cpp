@@ -0,0 +1,142 @@
+#include "SummaryStream.h"
+#include <string.h>
+
+/* Floor of the square root, bit by bit (no libm on the target) */
+static uint32_t isqrt64(uint64_t x)
+{
+    uint64_t root = 0, bit = 1ULL << 62;
+
+    while (bit > x)
+        bit >>= 2;
+    while (bit)
+    {
+        if (x >= root + bit)
+        {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+            root >>= 1;
+        bit >>= 2;
+    }
+    return (uint32_t)root;
+}
+
+SummaryStream::SummaryStream(uint8_t *buf, uint32_t size, uint32_t window_ms) :
+    encoder(buf, size), fp(NULL), window_ms(window_ms), start_ms(0), last_ms(0), count(0), part(0),
+    mask(0), closed(0)
+{
+}
+
+void SummaryStream::begin(FILE *file, uint16_t sample_freq)
+{
+    fp = file;
+    encoder.begin(sample_freq);
+    count = 0;
+    closed = 0;
+}
+
+void SummaryStream::sample(uint32_t time_ms, uint16_t sample_part, const rec_imu_t *imu,
+                           const rec_analog_t *analog, const rec_pulses_t *pulses,
+                           const int32_t *velocity, uint8_t encoders)
+{
+    if (count && time_ms - start_ms >= window_ms)
+        close_window();
+    if (count == 0)
+    {
+        start_ms = time_ms - time_ms % window_ms;
+        part = sample_part;
+        mask = 0;
+    }
+    last_ms = time_ms;
+    count++;
+
+    if (imu != NULL)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            add(SUM_ACC_X + i, imu->acc[i]);
+            add(SUM_GYR_X + i, imu->gyr[i]);
+        }
+    }
+    if (analog != NULL)
+    {
+        for (int i = 0; i < 3; i++)
+            add(SUM_ANALOG0 + i, analog->analog[i]);
+    }
+    if (pulses != NULL)
+    {
+        add(SUM_PULSES1, pulses->pulses[0]);
+        add(SUM_PULSES2, pulses->pulses[1]);
+    }
+    for (int i = 0; i < encoders && i < QENC_MAX; i++)
+        add(SUM_QENC0 + i, velocity[i]);
+}
+
+void SummaryStream::end()
+{
+    if (count)
+        close_window();
+    write_block();
+}
+
+void SummaryStream::add(int ch, int32_t value)
+{
+    channel_t *c = &channel[ch];
+
+    if (!(mask & (1 << ch)))
+    {
+        mask |= 1 << ch;
+        c->min = c->max = value;
+        c->sum = 0;
+        c->sum_sq = 0;
+    }
+    if (value < c->min)
+        c->min = value;
+    if (value > c->max)
+        c->max = value;
+    c->sum += value;
+    c->sum_sq += (uint64_t)((int64_t)value * value);
+}
+
+void SummaryStream::close_window()
+{
+    rec_window_t window;
+
+    window.count = count;
+    window.part = part;
+    window.last_ms = last_ms;
+    put(REC_WINDOW, &window);
+
+    for (int ch = 0; ch < SUM_CHANNELS; ch++)
+    {
+        const channel_t *c = &channel[ch];
+        rec_summary_t summary;
+
+        if (!(mask & (1 << ch)))
+            continue;
+        memset(&summary, 0, sizeof(summary));
+        summary.channel = ch;
+        summary.min = c->min;
+        summary.max = c->max;
+        summary.mean = (int32_t)(c->sum / count);
+        summary.rms = isqrt64(c->sum_sq / count);
+        put(REC_SUMMARY, &summary);
+    }
+    count = 0;
+    closed++;
+}
+
+/* All the records of a window carry its start time */
+void SummaryStream::put(uint8_t tag, const void *payload)
+{
+    while (!encoder.put(tag, start_ms, payload))
+        write_block();
+}
+
+void SummaryStream::write_block()
+{
+    if (fp != NULL && encoder.length() > 0)
+        fwrite(encoder.data(), 1, encoder.length(), fp);
+    encoder.clear();
+}
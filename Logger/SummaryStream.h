@@ -0,0 +1,76 @@
+/*
+    Rolling summary of the stored samples.
+    Every channel (first LSM6DS3, analog inputs, pulses, encoder velocities)
+    keeps its min, max, sum and sum of squares over a window of window_ms,
+    aligned to multiples of it. When a sample falls past the window, a
+    REC_WINDOW record and a REC_SUMMARY record (min, max, mean, RMS) per
+    channel are encoded into a small block, handed to the summary file's
+    stdio buffer when full, which writes whole sectors. That is about 270
+    bytes per window: a 30 min run at 1 s windows is about 480 KB, against
+    12 MB of raw records.
+    REC_WINDOW gives the part file of the window's first sample, so a
+    viewer only decodes the parts it zooms into ("tools/summary_view.c").
+*/
+
+#ifndef SUMMARY_STREAM_H
+#define SUMMARY_STREAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "RecordEncoder.h"
+
+#define SUMMARY_BLOCK 64                            // Encoder block, the file's stdio buffer gathers the sectors
+
+class SummaryStream
+{
+public:
+    /**  SummaryStream -- class constructor
+    *  Input:
+    *   - buf = Block buffer of the summary file, at least sizeof(log_header_t) + REC_MAX_SIZE.
+    *   - size = Size of buf in bytes.
+    *   - window_ms = Window length.
+    */
+    SummaryStream(uint8_t *buf, uint32_t size, uint32_t window_ms);
+
+    /**  begin() -- Start the summary file (file header), NULL to only accumulate. */
+    void begin(FILE *fp, uint16_t sample_freq);
+
+    /**  sample() -- Add a stored sample.
+    *  Channels passed as NULL are left out of the window.
+    *  Input:
+    *   - part = Part file the sample is stored in.
+    *   - velocity = Velocity of each encoder, encoders of them.
+    */
+    void sample(uint32_t time_ms, uint16_t part, const rec_imu_t *imu, const rec_analog_t *analog,
+                const rec_pulses_t *pulses, const int32_t *velocity, uint8_t encoders);
+
+    /**  end() -- Encode the open window and write what's left (run end). */
+    void end();
+
+    /** Windows encoded since begin() */
+    uint32_t windows() const { return closed; }
+
+private:
+    struct channel_t
+    {
+        int32_t min, max;
+        int64_t sum;
+        uint64_t sum_sq;
+    };
+
+    RecordEncoder encoder;
+    FILE *fp;
+    uint32_t window_ms;
+    uint32_t start_ms, last_ms;                     // Window start (aligned), last sample in it
+    uint16_t count, part;
+    uint16_t mask;                                  // Channels in the window, bit per SUM_*
+    uint32_t closed;
+    channel_t channel[SUM_CHANNELS];
+
+    void add(int ch, int32_t value);
+    void close_window();
+    void put(uint8_t tag, const void *payload);
+    void write_block();
+};
+
+#endif // SUMMARY_STREAM_H
@@ -0,0 +1,73 @@
+#include "Telemetry.h"
+
+Telemetry::Telemetry(DebugSink &sink, uint8_t decimation, uint8_t channels) : sink(sink),
+    decimation(decimation), channels(channels), countdown(0), seq(0), frames_sent(0), frames_dropped(0)
+{
+    pulses_acc[0] = 0;
+    pulses_acc[1] = 0;
+}
+
+void Telemetry::sample(uint32_t time_ms, const rec_imu_t *imu, const rec_analog_t *analog, const rec_pulses_t *pulses)
+{
+    uint8_t frame[TLM_MAX_FRAME];
+    uint8_t wire[TLM_MAX_WIRE];
+    uint8_t present = 0;
+    uint32_t len = TLM_HEADER_SIZE;
+
+    if (pulses != NULL)
+    {
+        pulses_acc[0] += pulses->pulses[0];
+        pulses_acc[1] += pulses->pulses[1];
+    }
+
+    if (countdown > 0)
+    {
+        countdown--;
+        return;
+    }
+    countdown = decimation - 1;
+
+    /* Payloads of the selected channels, in TLM_CH_* bit order */
+    if ((channels & TLM_CH_IMU) && imu != NULL)
+    {
+        memcpy(frame + len, imu, sizeof(*imu));
+        len += sizeof(*imu);
+        present |= TLM_CH_IMU;
+    }
+    if ((channels & TLM_CH_ANALOG) && analog != NULL)
+    {
+        memcpy(frame + len, analog, sizeof(*analog));
+        len += sizeof(*analog);
+        present |= TLM_CH_ANALOG;
+    }
+    if (channels & TLM_CH_PULSES)
+    {
+        rec_pulses_t acc;
+
+        acc.pulses[0] = pulses_acc[0] > 0xFFFF ? 0xFFFF : pulses_acc[0];
+        acc.pulses[1] = pulses_acc[1] > 0xFFFF ? 0xFFFF : pulses_acc[1];
+        memcpy(frame + len, &acc, sizeof(acc));
+        len += sizeof(acc);
+        present |= TLM_CH_PULSES;
+        pulses_acc[0] = 0;
+        pulses_acc[1] = 0;
+    }
+
+    frame[0] = TLM_TYPE_SAMPLE;
+    frame[1] = seq++;
+    frame[2] = present;
+    memcpy(frame + 3, &time_ms, sizeof(time_ms));
+
+    uint16_t crc = crc16_ccitt(frame, len);
+    frame[len++] = crc >> 8;
+    frame[len++] = crc & 0xFF;
+
+    uint32_t wire_len = cobs_encode(frame, len, wire);
+    wire[wire_len++] = 0x00;
+
+    /* Queue whole or drop, the receiver sees the gap in seq */
+    if (sink.write(wire, wire_len))
+        frames_sent++;
+    else
+        frames_dropped++;
+}
@@ -0,0 +1,49 @@
+/*
+    Live binary telemetry over the debug UART.
+    Every TELEMETRY_DECIMATION-th sample the selected channels are packed in a
+    frame (see "telemetry_frame.h"), COBS encoded and queued on the DebugSink.
+    A frame is only queued if it fits the sink's ring and rate budget, otherwise
+    it is dropped, so telemetry never delays acquisition or the SD writer.
+*/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "DebugSink.h"
+#include "telemetry_frame.h"
+
+#define TELEMETRY_DECIMATION 10                     // Send 1 of every N samples (20 Hz at 200 Hz)
+
+class Telemetry
+{
+public:
+    /**  Telemetry -- class constructor
+    *  Input:
+    *   - sink = UART channel the frames are queued on.
+    *   - decimation = Send one of every decimation samples.
+    *   - channels = TLM_CH_* mask of the channels to send.
+    */
+    Telemetry(DebugSink &sink, uint8_t decimation = TELEMETRY_DECIMATION, uint8_t channels = TLM_CH_ALL);
+
+    /**  sample() -- Offer an acquired sample.
+    *  Channels passed as NULL are left out of the frame. Pulses are accumulated
+    *  over the skipped samples, so the frame holds the count since the last one.
+    */
+    void sample(uint32_t time_ms, const rec_imu_t *imu, const rec_analog_t *analog, const rec_pulses_t *pulses);
+
+    /** Frames sent and dropped since start */
+    uint32_t sent() const { return frames_sent; }
+    uint32_t dropped() const { return frames_dropped; }
+
+private:
+    DebugSink &sink;
+    uint8_t decimation;
+    uint8_t channels;
+    uint8_t countdown;                              // Samples until the next frame
+    uint8_t seq;                                    // Frame sequence number
+    uint32_t pulses_acc[2];                         // Pulses since the last frame
+    uint32_t frames_sent;
+    uint32_t frames_dropped;
+};
+
+#endif // TELEMETRY_H
@@ -0,0 +1,59 @@
+#include "Trace.h"
+
+TraceBuffer::TraceBuffer() : head(0), tail(0), lost_entries(0)
+{
+}
+
+bool TraceBuffer::begin(FILE *fp)
+{
+    trace_header_t header;
+
+#ifdef DWT
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+    head = 0;
+    tail = 0;
+    lost_entries = 0;
+    if (fp == NULL)
+        return false;
+
+    header.magic = TRACE_MAGIC;
+    header.version = TRACE_VERSION;
+    header.num_ids = TRACE_NUM_IDS;
+    header.clock_hz = TRACE_CLOCK_HZ;
+    return fwrite(&header, sizeof(header), 1, fp) == 1;
+}
+
+bool TraceBuffer::dump(FILE *fp)
+{
+    uint32_t end = head;                            // Later entries go to the next dump
+    uint32_t n = end - tail;
+    uint32_t first, count;
+    bool ok = true;
+
+    /* After an overrun only the newest half is kept, the other one takes the
+    tracepoints of the write itself */
+    if (n > TRACE_RING)
+    {
+        trace_entry_t lost = { ring[(end - TRACE_RING / 2) & (TRACE_RING - 1)].cycles, 0, TRACE_KIND_LOST, 0 };
+
+        lost.arg = (n - TRACE_RING / 2 > 0xFFFF) ? 0xFFFF : n - TRACE_RING / 2;
+        lost_entries += n - TRACE_RING / 2;
+        tail = end - TRACE_RING / 2;
+        n = TRACE_RING / 2;
+        if (fp != NULL)
+            ok = fwrite(&lost, sizeof(lost), 1, fp) == 1;
+    }
+
+    /* At most two pieces: up to the end of the ring, then from its start */
+    first = tail & (TRACE_RING - 1);
+    count = (n < TRACE_RING - first) ? n : TRACE_RING - first;
+    if (fp != NULL && count > 0)
+        ok = fwrite(&ring[first], sizeof(trace_entry_t), count, fp) == count && ok;
+    if (fp != NULL && n > count)
+        ok = fwrite(&ring[0], sizeof(trace_entry_t), n - count, fp) == n - count && ok;
+    tail = end;
+    return ok && fp != NULL;
+}
@@ -0,0 +1,72 @@
+/*
+    Hot-path tracepoints.
+    A tracepoint stores (id, kind, arg, cycle counter) as an 8 byte entry in a
+    static RAM ring: a read of the DWT cycle counter, an atomic increment for
+    the slot and one store, so ISRs can take them too. The main loop dumps the
+    ring to RUNx/trace when half of it is taken and at run end, and
+    "tools/trace_view.c" turns the dump into a Chrome trace timeline and
+    per-span latency percentiles (format in "trace_format.h").
+    The tracepoints themselves are macros of main.cpp that compile to nothing
+    when TRACE is 0.
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "mbed.h"
+#include "platform/mbed_atomic.h"
+#include "trace_format.h"
+
+#ifndef TRACE_RING
+#define TRACE_RING 128                              // Entries, power of two (8 bytes each)
+#endif
+
+#ifndef TRACE_CLOCK
+#define TRACE_CLOCK()   (DWT->CYCCNT)               // Core cycles, started by begin()
+#define TRACE_CLOCK_HZ  SystemCoreClock
+#endif
+
+class TraceBuffer
+{
+public:
+    /**  TraceBuffer -- class constructor */
+    TraceBuffer();
+
+    /**  begin() -- Start the cycle counter, empty the ring and write the dump
+    *  header to fp (NULL to trace without a dump, lost entries are counted).
+    *  Output: true if the header was written.
+    */
+    bool begin(FILE *fp);
+
+    /**  put() -- Take a tracepoint (safe to call from an ISR). */
+    void put(uint8_t id, uint8_t kind, uint16_t arg = 0)
+    {
+        trace_entry_t e = { TRACE_CLOCK(), id, kind, arg };
+
+        ring[(core_util_atomic_incr_u32(&head, 1) - 1) & (TRACE_RING - 1)] = e;
+    }
+
+    /**  pending() -- Entries taken since the last dump (may exceed TRACE_RING). */
+    uint32_t pending() const { return head - tail; }
+
+    /**  dump() -- Write the pending entries to fp. After an overrun, only the
+    *  newest TRACE_RING/2 ones, preceded by a TRACE_KIND_LOST entry. Tracepoints
+    *  taken meanwhile are kept for the next dump, unless they wrap around onto
+    *  the entries being written.
+    *  Output: false on a write error (the entries are dropped anyway).
+    */
+    bool dump(FILE *fp);
+
+    /** Entries overwritten before they were dumped */
+    uint32_t lost() const { return lost_entries; }
+
+private:
+    trace_entry_t ring[TRACE_RING];
+    volatile uint32_t head;                         // Entries taken since begin()
+    uint32_t tail;                                  // Entries dumped (or lost) since begin()
+    uint32_t lost_entries;
+};
+
+#endif // TRACE_H
@@ -0,0 +1,226 @@
+/*
+    Tagged record stream format (shared by the logger and "read_struct2.0.c").
+
+    Each data file starts with a log_header_t followed by a stream of records:
+
+        [tag:1][dt:1][payload:rec_payload_size[tag]]
+
+    tag: record type (REC_*). If REC_SAME_TIME is set in the tag the record has
+         the same timestamp as the previous one and the dt byte is omitted.
+    dt:  time since the previous record, in ms. When the gap doesn't fit in a
+         byte a REC_TIME record with the absolute timestamp is written first.
+
+    Every payload has a fixed size given by rec_payload_size, so the reader can
+    skip or demultiplex records without parsing them. Multi-byte fields are
+    little-endian, as on the STM32.
+    A channel is only written when it carries information (IMU connected,
+    pulses counted, analog value changed, encoder moved), instead of one full packet_t per sample.
+    The sample rate is the header's sample_freq until a REC_RATE record
+    changes it (motion gating).
+    The summary file of a run has the same format, with a REC_WINDOW record
+    per window followed by a REC_SUMMARY record per channel.
+
+    In a part file (header run_id not 0) every block written to the card starts
+    with a REC_MARK record repeating the run_id, numbering the block and giving
+    its length. A pre-allocated part keeps stale card data after its last block
+    when the power is lost, so the reader stops at the first block whose marker
+    is missing or belongs to another run (rec_mark_valid()).
+*/
+
+#ifndef LOG_RECORD_H
+#define LOG_RECORD_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define LOG_MAGIC           0x474C424D              // "MBLG" in little-endian
+#define LOG_VERSION         3
+#define LOG_HEADER_V2_SIZE  8                       // Header of version 2 files, without run_id
+#define REC_SAME_TIME       0x80                    // Tag flag: no dt byte, same timestamp
+#define REC_TAG_MASK        0x7F
+#define REC_MAX_DT          0xFF                    // Longest gap encodable in dt (ms)
+
+/* File header */
+typedef struct
+{
+    uint32_t magic;                                 // LOG_MAGIC
+    uint16_t version;                               // LOG_VERSION
+    uint16_t sample_freq;                           // Nominal sample rate (Hz)
+    uint32_t run_id;                                // Id of the run in its REC_MARK records, 0 = no markers (version 3)
+} log_header_t;
+
+#define LOG_HEADER_SIZE(version)    ((version) >= 3 ? sizeof(log_header_t) : LOG_HEADER_V2_SIZE)
+
+/* Record types */
+enum rec_tag
+{
+    REC_TIME = 0x01,                                // Absolute timestamp
+    REC_IMU = 0x02,                                 // LSM6DS3 accelerometer and gyroscope
+    REC_ANALOG = 0x03,                              // Analog inputs
+    REC_PULSES = 0x04,                              // Frequency channels
+    REC_EVENT = 0x05,                               // Event capture window (event files)
+    REC_IMU_GROUP = 0x06,                           // Several LSM6DS3 sampled in the same tick
+    REC_QENC = 0x07,                                // Quadrature encoder 0
+    REC_QENC1 = 0x08,                               // Quadrature encoder 1 (tag REC_QENC + i for encoder i)
+    REC_RATE = 0x09,                                // Sample rate change
+    REC_WINDOW = 0x0A,                              // Summary window, at its start time (summary file)
+    REC_SUMMARY = 0x0B,                             // Statistics of one channel over the window (summary file)
+    REC_MARK = 0x0C,                                // Start of a block of a part, always with REC_SAME_TIME
+    REC_NUM_TAGS
+};
+
+/* Payloads */
+typedef struct
+{
+    uint32_t time_stamp;                            // ms since run start
+} rec_time_t;
+
+typedef struct
+{
+    int16_t acc[3];                                 // x, y, z raw accelerometer
+    int16_t gyr[3];                                 // x, y, z raw gyroscope
+} rec_imu_t;
+
+typedef struct
+{
+    uint16_t analog[3];
+} rec_analog_t;
+
+typedef struct
+{
+    uint16_t pulses[2];
+} rec_pulses_t;
+
+typedef struct
+{
+    uint32_t trigger_time;                          // ms since run start
+    uint16_t pre;                                   // IMU records before the trigger
+    uint16_t post;                                  // IMU records from the trigger on
+    uint16_t rate;                                  // IMU record rate (Hz)
+    uint8_t source;                                 // EVENT_SRC_*
+    uint8_t reserved;
+} rec_event_t;
+
+#define IMU_GROUP_MAX       2                       // Devices in a REC_IMU_GROUP record
+
+typedef struct
+{
+    uint8_t mask;                                   // Bit i set: imu[i] is valid
+    uint8_t reserved;
+    int16_t offset_us[IMU_GROUP_MAX];               // Read time of imu[i] relative to the middle of its bus burst,
+                                                    // from the last raw read of the decimation, not the record time
+    rec_imu_t imu[IMU_GROUP_MAX];
+} rec_imu_group_t;
+
+#define QENC_MAX            2                       // Encoders, one tag each from REC_QENC
+
+typedef struct
+{
+    int32_t position;                               // Counts since the run start (x4 resolution)
+    int32_t velocity;                               // Counts/s
+} rec_qenc_t;
+
+typedef struct
+{
+    uint16_t rate;                                  // Sample rate from this record on (Hz), 0 = paused
+    uint8_t cause;                                  // RATE_*
+    uint8_t reserved;
+} rec_rate_t;
+
+#define RATE_RESTATED       0                       // Rate in effect, at the start of a part
+#define RATE_IDLE           1                       // No motion for the idle time
+#define RATE_WAKE_INT       2                       // LSM6DS3 wake-up interrupt
+#define RATE_WAKE_DATA      3                       // Acceleration change in the IMU samples
+
+typedef struct
+{
+    uint16_t count;                                 // Samples in the window
+    uint16_t part;                                  // Part file of its first sample (partN)
+    uint32_t last_ms;                               // Time of its last sample
+} rec_window_t;
+
+/* Summary channels */
+enum sum_channel
+{
+    SUM_ACC_X, SUM_ACC_Y, SUM_ACC_Z,                // First LSM6DS3, raw
+    SUM_GYR_X, SUM_GYR_Y, SUM_GYR_Z,
+    SUM_ANALOG0, SUM_ANALOG1, SUM_ANALOG2,
+    SUM_PULSES1, SUM_PULSES2,                       // Pulses per sample
+    SUM_QENC0, SUM_QENC1,                           // Encoder velocity (counts/s)
+    SUM_CHANNELS
+};
+
+typedef struct
+{
+    uint8_t channel;                                // SUM_*
+    uint8_t reserved[3];
+    int32_t min;
+    int32_t max;
+    int32_t mean;
+    uint32_t rms;                                   // Root mean square (not centered on the mean)
+} rec_summary_t;
+
+typedef struct
+{
+    uint32_t run_id;                                // log_header_t run_id
+    uint16_t seq;                                   // Block number in the file, from 0
+    uint16_t length;                                // Bytes of the block from this record on
+} rec_mark_t;
+
+#define EVENT_SRC_HARDWARE  1                       // LSM6DS3 interrupt pin
+#define EVENT_SRC_THRESHOLD 2                       // Software acceleration threshold
+
+/* Payload size of each tag, 0 for unknown tags */
+static const uint8_t rec_payload_size[REC_NUM_TAGS] =
+{
+    0,                                              // 0x00 (invalid)
+    sizeof(rec_time_t),                             // REC_TIME
+    sizeof(rec_imu_t),                              // REC_IMU
+    sizeof(rec_analog_t),                           // REC_ANALOG
+    sizeof(rec_pulses_t),                           // REC_PULSES
+    sizeof(rec_event_t),                            // REC_EVENT
+    sizeof(rec_imu_group_t),                        // REC_IMU_GROUP
+    sizeof(rec_qenc_t),                             // REC_QENC
+    sizeof(rec_qenc_t),                             // REC_QENC1
+    sizeof(rec_rate_t),                             // REC_RATE
+    sizeof(rec_window_t),                           // REC_WINDOW
+    sizeof(rec_summary_t),                          // REC_SUMMARY
+    sizeof(rec_mark_t),                             // REC_MARK
+};
+
+#define REC_MAX_SIZE        (2 + sizeof(rec_imu_group_t))   // Largest record (tag + dt + payload)
+
+/* Reader side of the block markers */
+typedef struct
+{
+    uint32_t run_id;                                // From the header, 0 = file without markers
+    uint32_t next;                                  // Stream offset (after the header) of the next REC_MARK
+    uint16_t seq;                                   // Its block number
+} rec_mark_check_t;
+
+/**  rec_mark_valid() -- Check the record at stream offset pos against the block markers.
+*  Input:
+*   - check = Marker state, zeroed but for run_id before the first record.
+*   - pos = Offset of the record from the end of the header.
+*   - rec = The record, avail bytes of it readable.
+*  Output: 0 if the file's own data ended before it (missing or foreign marker).
+*/
+static inline int rec_mark_valid(rec_mark_check_t *check, uint32_t pos, const uint8_t *rec, uint32_t avail)
+{
+    rec_mark_t mark;
+
+    if (check->run_id == 0)
+        return 1;
+    if (pos < check->next)
+        return (rec[0] & REC_TAG_MASK) != REC_MARK;
+    if (pos > check->next || avail < 1 + sizeof(mark) || rec[0] != (REC_MARK | REC_SAME_TIME))
+        return 0;                                   // Record across the block end, or no marker
+    memcpy(&mark, rec + 1, sizeof(mark));
+    if (mark.run_id != check->run_id || mark.seq != check->seq || mark.length < 1 + sizeof(mark))
+        return 0;
+    check->next = pos + mark.length;
+    check->seq++;
+    return 1;
+}
+
+#endif // LOG_RECORD_H
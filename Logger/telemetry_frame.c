@@ -0,0 +1,67 @@
+#include "telemetry_frame.h"
+
+uint16_t crc16_ccitt(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    size_t i;
+    int bit;
+
+    for (i = 0; i < len; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+    return crc;
+}
+
+size_t cobs_encode(const uint8_t *src, size_t len, uint8_t *dst)
+{
+    size_t code_pos = 0, out = 1, i;
+    uint8_t code = 1;
+
+    for (i = 0; i < len; i++)
+    {
+        if (src[i] != 0)
+        {
+            dst[out++] = src[i];
+            code++;
+        }
+        if (src[i] == 0 || code == 0xFF)
+        {
+            /* Close the current block */
+            dst[code_pos] = code;
+            code_pos = out++;
+            code = 1;
+        }
+    }
+    dst[code_pos] = code;
+    return out;
+}
+
+size_t cobs_decode(const uint8_t *src, size_t len, uint8_t *dst, size_t size)
+{
+    size_t in = 0, out = 0;
+
+    while (in < len)
+    {
+        uint8_t code = src[in++];
+        uint8_t i;
+
+        if (code == 0 || in + code - 1 > len)
+            return 0;
+        for (i = 1; i < code; i++)
+        {
+            if (out >= size)
+                return 0;
+            dst[out++] = src[in++];
+        }
+        if (code != 0xFF && in < len)
+        {
+            if (out >= size)
+                return 0;
+            dst[out++] = 0;
+        }
+    }
+    return out;
+}
@@ -0,0 +1,54 @@
+/*
+    Live telemetry frame format (shared by the logger and "tools/telemetry_rx.c").
+
+    A frame carries a subset of the channels of one (decimated) sample:
+
+        [type:1][seq:1][channels:1][time_stamp:4][payloads...][crc:2]
+
+    payloads are the log_record.h payloads of the channels whose TLM_CH_* bit is
+    set in channels, in bit order. crc is CRC-16/CCITT-FALSE over everything
+    before it. On the wire each frame is COBS encoded and terminated by 0x00, so
+    the receiver resynchronizes on the next zero after any error.
+*/
+
+#ifndef TELEMETRY_FRAME_H
+#define TELEMETRY_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "log_record.h"
+
+#define TLM_TYPE_SAMPLE     0x01
+
+#define TLM_CH_IMU          0x01
+#define TLM_CH_ANALOG       0x02
+#define TLM_CH_PULSES       0x04
+#define TLM_CH_ALL          (TLM_CH_IMU | TLM_CH_ANALOG | TLM_CH_PULSES)
+
+#define TLM_HEADER_SIZE     7
+#define TLM_MAX_FRAME       (TLM_HEADER_SIZE + sizeof(rec_imu_t) + sizeof(rec_analog_t) + sizeof(rec_pulses_t) + 2)
+#define TLM_MAX_WIRE        (TLM_MAX_FRAME + TLM_MAX_FRAME / 254 + 2)   // COBS overhead + delimiter
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**  crc16_ccitt() -- CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) */
+uint16_t crc16_ccitt(const uint8_t *data, size_t len);
+
+/**  cobs_encode() -- COBS encode len bytes of src into dst.
+*  dst must have room for len + len / 254 + 1 bytes. The 0x00 delimiter is not added.
+*  Output: encoded length.
+*/
+size_t cobs_encode(const uint8_t *src, size_t len, uint8_t *dst);
+
+/**  cobs_decode() -- Decode a COBS block (without delimiter) into dst.
+*  Output: decoded length, or 0 if the block is malformed or doesn't fit in size.
+*/
+size_t cobs_decode(const uint8_t *src, size_t len, uint8_t *dst, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRY_FRAME_H
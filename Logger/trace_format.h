@@ -0,0 +1,64 @@
+/*
+    Tracepoint dump format (shared by the logger and "tools/trace_view.c").
+
+    RUNx/trace is a trace_header_t followed by trace_entry_t records in the
+    order they were taken. Spans are a TRACE_KIND_BEGIN and a TRACE_KIND_END
+    of the same id, marks are single events. A TRACE_KIND_LOST entry stands
+    for arg entries overwritten before they could be written (the spans open
+    at that point are not closed).
+*/
+
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <stdint.h>
+
+#define TRACE_MAGIC         0x31435254              // "TRC1"
+#define TRACE_VERSION       1
+
+/* Tracepoint ids: X(id, name) */
+#define TRACE_IDS(X) \
+    X(TICK,         "tick")         /* Mark: acquisition tick (ISR) */ \
+    X(IMU,          "imu_read")     /* I2C burst of all the LSM6DS3, arg = mask */ \
+    X(ADC,          "adc_read")     /* The three analog inputs */ \
+    X(PUSH,         "buffer_push")  /* arg = buffer depth before the push */ \
+    X(STORE,        "store_packet") /* Encoding, including any block write */ \
+    X(FWRITE,       "fwrite")       /* Block to the file, arg = bytes */ \
+    X(SYNC,         "fsync")        /* fflush and fsync every SAVE_WHEN packets */ \
+    X(OVERFLOW,     "overflow")     /* Mark: buffer full, file closed */ \
+    X(EVENT_WRITE,  "event_write")  /* Event capture frames to their file */ \
+    X(CARD_READ,    "card_read")    /* Block device operations, arg = sectors */ \
+    X(CARD_PROGRAM, "card_program") \
+    X(CARD_ERASE,   "card_erase") \
+    X(CARD_SYNC,    "card_sync") \
+    X(DUMP,         "trace_dump")   /* Ring to RUNx/trace, arg = entries */
+
+#define TRACE_ID_ENUM(id, name) TRACE_##id,
+enum trace_id { TRACE_IDS(TRACE_ID_ENUM) TRACE_NUM_IDS };
+#undef TRACE_ID_ENUM
+
+enum trace_kind
+{
+    TRACE_KIND_BEGIN = 0,
+    TRACE_KIND_END,
+    TRACE_KIND_MARK,
+    TRACE_KIND_LOST
+};
+
+typedef struct
+{
+    uint32_t magic;                                 // TRACE_MAGIC
+    uint16_t version;                               // TRACE_VERSION
+    uint16_t num_ids;                               // TRACE_NUM_IDS of the writer
+    uint32_t clock_hz;                              // Rate of trace_entry_t.cycles
+} trace_header_t;
+
+typedef struct
+{
+    uint32_t cycles;                                // Cycle counter, wraps around
+    uint8_t id;                                     // trace_id
+    uint8_t kind;                                   // trace_kind
+    uint16_t arg;
+} trace_entry_t;
+
+#endif // TRACE_FORMAT_H
@@ -1,11 +1,13 @@
 /*
     Data Logger implementation in STM32F103C8T6.
     Inputs:
-        1x External Accelerometer and Gyroscope (LSM6DS3)
+        1x (or NUM_IMUS) External Accelerometer and Gyroscope (LSM6DS3)
         x3 Analog Inputs;
         x2 Digital (Frequency) Inputs;
+        x1 (or ENCODERS) Quadrature Encoders, counted by timers;
     In this set, it is designed for a 200Hz sample rate.
-    All the data are saved periodically (every 0.25s) to a folder in the SD card.
+    All the data are saved periodically (every 0.25s) to a folder in the SD card,
+    as a tagged record stream (see "Logger/log_record.h").
     To read the data, use the file "read_struct2.0.c" in the folder results.
     
    Implemented by Einstein "Hashtag" Gustavo(Electronics Coordinator 2019) at Mangue Baja Team, UFPE.
@@ -18,82 +20,283 @@
 #include <errno.h>
 #include "SDBlockDevice.h"
 #include "FATFileSystem.h"
+#include "LittleFileSystem.h"
+#include "ProfilingBlockDevice.h"
+#include "BufferedBlockDevice.h"
 #include "LSM6DS3.h"
+#include "RecordEncoder.h"
+#include "DebugSink.h"
+#include "Telemetry.h"
+#include "Decimator.h"
+#include "EventCapture.h"
+#include "IMUGroup.h"
+#include "Trace.h"
+#include "CardBench.h"
+#include "PartRotator.h"
+#include "CardLayout.h"
+#include "QuadEncoder.h"
+#include "MotionGate.h"
+#include "SummaryStream.h"
 
 #define BUFFER_SIZE 200                         // Acquisition buffer
-#define SAVE_WHEN 50                            // Number of packets to save (fail safe)
+#define SAVE_WHEN 50                            // Number of packets to save (fail safe, littlefs sync)
+#define PART_MAX_KB 2048                        // Part file size limit (0 = none), pre-allocated on FAT
+#define PART_MAX_S 0                            // Part file duration limit in seconds (0 = none)
 #define SAMPLE_FREQ 200                         // Frequency in Hz
+#define BLOCK_SIZE 512                          // Encoded data written to the card at once
+#define NUM_IMUS 1                              // LSM6DS3 on the I2C bus (second one with SA0 low)
+#define OVERSAMPLE 1                            // Acquisition ticks per stored sample (1 = no oversampling)
+#define IMU_DECIMATION OVERSAMPLE               // IMU samples per stored sample, must divide OVERSAMPLE
+#define ADC_DECIMATION OVERSAMPLE               // ADC samples per stored sample, must divide OVERSAMPLE
+#define ENCODERS 1                              // Quadrature encoders: TIM1 (PA_8, PA_9), then TIM2 (PA_0, PA_1, replaces the debug wave)
+#define EVENT_CAPTURE 0                         // Pre/post-trigger IMU windows at acquisition rate to RUNx/eventY
+#define EVENT_THRESHOLD 24576                   // Software trigger, |acc| in raw counts (1.5 g at 2 g scale)
+#define MOTION_GATE 0                           // Idle rate without motion, full rate on the LSM6DS3 wake-up (INT1, PB_7)
+#define MOTION_THS 2                            // Motion, acceleration change in 1/64 of full scale (62.5 mg at 2 g)
+#define MOTION_IDLE_S 30                        // Seconds without motion before the idle rate
+#define MOTION_IDLE_HZ 10                       // Idle sample rate (0 = paused until the wake-up interrupt)
+#define SUMMARY_MS 1000                         // Window of the per-channel min/max/mean/RMS in RUNx/summary (0 = none)
+#define TELEMETRY 0                             // Live binary telemetry on the debug UART (replaces debug chars)
+#define STORAGE_LITTLEFS 0                      // littlefs instead of FAT on the card (power-loss resilient, see README)
+#define STORAGE_PROFILE 1                       // Time the card operations, summary in RUNx/storage.txt at run end
+#define STORAGE_CRC 1                           // CRC16 on card data blocks, CRC7 on commands (slice-by-4 with drivers.crc-slices 4)
+#define STORAGE_CACHE 0                         // Sectors of write-back cache merged into multi-block writes (0 = none, 512 B of RAM each)
+#define CARD_BENCH 0                            // Boot-time card write probe, may lower the sample rate (see RUNx/bench.txt)
+#define TRACE 0                                 // Hot-path tracepoints to RUNx/trace: 1 = streamed, 2 = last TRACE_RING at run end (1 KB of RAM)
+#define STATIC_MEMORY 1                         // stdio, cache and benchmark buffers in static arrays, heap check at run end (RUNx/memory.txt)
 
 /* Debug */
-PwmOut signal_wave(PB_3);                           // Debug wave to test frequency channels
+#if ENCODERS < 2
+PwmOut signal_wave(PB_3);                           // Debug wave to test frequency channels (TIM2)
+#endif
 
 /* I/O */
-Serial pc(PA_2, PA_3);                              // Debug purposes
-LSM6DS3 LSM6DS3(PB_9, PB_8);                        // Gyroscope/Accelerometer declaration (SDA,SCL)
-SDBlockDevice   sd(PB_15, PB_14, PB_13, PB_12);     // mosi, miso, sck, cs
+DebugSink pc(PA_2, PA_3);                           // Debug purposes (non-blocking, rate limited)
+#if TELEMETRY
+Telemetry telemetry(pc);                            // Decimated samples to "tools/telemetry_rx.c"
+#endif
+I2C imu_bus(PB_9, PB_8);                            // Gyroscope/Accelerometer bus (SDA,SCL)
+LSM6DS3_I2C imu0_if(imu_bus, LSM6DS3_AG_I2C_ADDR(1));
+LSM6DS3 imu0(imu0_if);                              // Gyroscope/Accelerometer declaration, or (MOSI,MISO,SCK,CS) for SPI
+#if NUM_IMUS > 1
+LSM6DS3_I2C imu1_if(imu_bus, LSM6DS3_AG_I2C_ADDR(0));
+LSM6DS3 imu1(imu1_if);                              // Second Gyroscope/Accelerometer (swingarm)
+#endif
+IMUGroup imus(&imu_bus);                            // All the LSM6DS3, read in one bus burst
+SDBlockDevice   sd(PB_15, PB_14, PB_13, PB_12, 1000000, STORAGE_CRC);  // mosi, miso, sck, cs, hz, crc
+#if STORAGE_PROFILE
+ProfilingBlockDevice card(&sd);                     // Latency histograms of the card operations
+#else
+BlockDevice &card = sd;
+#endif
+#if STORAGE_CACHE && STATIC_MEMORY
+uint8_t cache_buffer[(STORAGE_CACHE + 1) * 512];    // Write cache and read buffer of storage
+BufferedBlockDevice storage(&card, STORAGE_CACHE, cache_buffer, sizeof(cache_buffer));
+#elif STORAGE_CACHE
+BufferedBlockDevice storage(&card, STORAGE_CACHE);  // Adjacent sectors programmed in one CMD25
+#else
+BlockDevice &storage = card;
+#endif
+#if STORAGE_LITTLEFS
+LittleFileSystem fileSystem("sd");                  // Geometry in mbed_app.json
+#else
 FATFileSystem   fileSystem("sd");
+const char *const private_files[] = { "part", "event", NULL };  // Own sector buffer (FF_FS_FILEBUF), see README
+CardLayout      layout;                             // FAT aligned to the card allocation units
+#endif
 DigitalOut warning(PA_15);                          // When device is ready, led is permanently OFF
 DigitalOut logging(PA_12);                          // When data is beign acquired, led is ON
 InterruptIn start(PB_4,PullUp);                            // Press button to start/stop acquisition
 InterruptIn freq_chan1(PB_5,PullUp);                       // Frequency channel 1
 InterruptIn freq_chan2(PB_6,PullUp);                       // Frequency channel 2
+#if EVENT_CAPTURE || MOTION_GATE
+InterruptIn imu_int1(PB_7);                                // LSM6DS3 INT1 (tap and wake-up events)
+#endif
+#if EVENT_CAPTURE
+EventCapture events(SAMPLE_FREQ*IMU_DECIMATION, EVENT_THRESHOLD);  // Frames at the raw IMU read rate
+#endif
 AnalogIn pot0(PB_1),
          pot1(PB_0),
          pot2(PA_7);
+#if ENCODERS
+const PinName qenc_pins[QENC_MAX][2] = { { PA_8, PA_9 }, { PA_0, PA_1 } };   // CH1, CH2 of TIM1 and TIM2
+QuadEncoder qenc[ENCODERS];                         // Timers in encoder mode, latched by the acquisition ISR
+#endif
+#if MOTION_GATE
+MotionGate gate(MOTION_THS*512, MOTION_IDLE_S*1000UL);   // Same threshold as the LSM6DS3 wake-up, in raw counts
+#endif
+PartRotator parts(PART_MAX_KB*1024UL, PART_MAX_S*1000UL, BLOCK_SIZE, !STORAGE_LITTLEFS);  // partX files of the run
+#if CARD_BENCH
+CardBench bench;                                    // Write throughput and stalls of this card
+#endif
+#if STATIC_MEMORY
+#if CARD_BENCH
+#define PART_BUFFER BENCH_MAX_BLOCK                 // Largest write size the benchmark can choose
+#else
+#define PART_BUFFER BLOCK_SIZE
+#endif
+uint8_t part_buffers[2*PART_BUFFER];                // stdio buffers of two parts (also the benchmark scratch)
+uint8_t event_buffer[BLOCK_SIZE];                   // stdio buffer of the event file
+uint8_t text_buffer[128];                           // stdio buffer of the text files, one open at a time
+#if SUMMARY_MS
+uint8_t summary_buffer[BLOCK_SIZE];                 // stdio buffer of the summary file
+#endif
+mbed_stats_heap_t heap_start;                       // Heap when the acquisition starts
+#define STDIO_BUFFER(buf) buf, sizeof(buf)          // open_file() arguments
+#else
+#define STDIO_BUFFER(buf) NULL, 0
+#endif
+#if SUMMARY_MS
+uint8_t summary_block[SUMMARY_BLOCK];               // Summary records being encoded
+SummaryStream summary(summary_block, SUMMARY_BLOCK, SUMMARY_MS);  // Envelopes of the run, see "tools/summary_view.c"
+#endif
+#if TRACE
+TraceBuffer trace;                                  // Tracepoint ring, see "tools/trace_view.c"
+#define TRACE_BEGIN(id, arg)    trace.put(TRACE_##id, TRACE_KIND_BEGIN, arg)
+#define TRACE_END(id)           trace.put(TRACE_##id, TRACE_KIND_END)
+#define TRACE_MARK(id, arg)     trace.put(TRACE_##id, TRACE_KIND_MARK, arg)
+#else
+#define TRACE_BEGIN(id, arg)
+#define TRACE_END(id)
+#define TRACE_MARK(id, arg)
+#endif
 
 /* Data structure */
 typedef struct
 {
-    int16_t acclsmx;
-    int16_t acclsmy;
-    int16_t acclsmz;
-    int16_t anglsmx;
-    int16_t anglsmy;
-    int16_t anglsmz;
+    rec_imu_t imu[NUM_IMUS];
+    int16_t imu_offset_us[NUM_IMUS];
     uint16_t analog0;
     uint16_t analog1;
     uint16_t analog2;
     uint16_t pulses_chan1;
     uint16_t pulses_chan2;
+#if ENCODERS
+    int32_t qenc_position[ENCODERS];
+    int32_t qenc_velocity[ENCODERS];
+#endif
     uint32_t time_stamp;
 } packet_t;
 
+/* Acquisition rate change, written in-band before the first packet at the new rate */
+typedef struct
+{
+    uint32_t time_ms;
+    rec_rate_t rate;
+} rate_change_t;
+
 
 Timer t;                                        // Device timer
 Ticker acq;                                     // Acquisition timer interrupt source
 CircularBuffer<packet_t, BUFFER_SIZE> buffer;   // Acquisition buffer
+uint8_t block[BLOCK_SIZE];                      // Record stream block buffer
+RecordEncoder encoder(block, BLOCK_SIZE);       // Packet to record stream encoder
+rec_analog_t last_analog;                       // Last analog record written
+rec_qenc_t last_qenc[QENC_MAX];                 // Last record of each encoder written
+#if MOTION_GATE
+CircularBuffer<rate_change_t, 4> rate_changes;  // Rate changes not in the log yet (set_rate())
+uint16_t log_rate,                              // Rate of the last packets stored
+         part_rate;                             // Rate the current part states
+#endif
+Decimator imu_dec[NUM_IMUS][6];                 // Decimation filters (acc xyz, gyro xyz)
+Decimator adc_dec[3];                           // Decimation filters (analog inputs)
+uint8_t acq_tick = 0;                           // Acquisition ticks in the current stored sample
+uint16_t sample_freq = SAMPLE_FREQ;             // Stored sample rate (lowered by CARD_BENCH if the card is slow)
 int buffer_counter = 0;                         // Packet currently in buffer
 int err;                                        // SD library utility
-bool running = false;                           // Device status
-bool StorageTrigger = false;
+volatile bool running = false;                  // Device status (changed by ISR)
+volatile bool StorageTrigger = false;
 uint16_t pulse_counter1 = 0,
          pulse_counter2 = 0,                    // Frequency counter variables
-         acc_addr = 0;                          // LSM6DS3 address, if not connected address is 0 and data is not stored
+         imu_mask = 0;                          // Connected LSM6DS3 (bit per device), data is only stored for these
 
 void sampleISR();                               // Data acquisition ISR
 uint32_t count_files_in_sd(const char *fsrc);   // Compute number of files in SD
 void freq_channel1_ISR();                       // Frequency counter ISR, channel 1
 void freq_channel2_ISR();                       // Frequency counter ISR, channel 2
 void toggle_logging();                          // Start button ISR
+void imu_event_ISR();                           // LSM6DS3 interrupt ISR
+#if MOTION_GATE
+void set_rate(uint16_t rate, uint8_t cause);    // Acquisition rate (0 = paused) and its rate record
+void store_rate_changes(uint32_t time_ms, FILE *fp);  // Rate records up to time_ms
+#endif
+void store_packet(const packet_t *pck, FILE *fp);   // Encode packet and write full blocks
+void flush_block(FILE *fp);                     // Write pending encoded data
+void write_storage_health(const char *dir);     // Card operation summary of the run
+FILE* open_file(const char *name, uint8_t *buf, size_t size);   // fopen "w", stdio buffer in buf (NULL: heap)
+void write_memory_report(const char *dir);      // Heap use since the acquisition start
+#if TRACE && STORAGE_PROFILE
+void trace_card(ProfilingBlockDevice::profile_op op, bool done, bd_size_t size);  // Card operation tracepoints
+#endif
 
 int main()
 {   
     pc.printf("\r\nDebug 1\r\n");
     logging = 0;                                // logging led OFF
-    int num_parts = 0,                          // Number of parts already saved
-        num_files = 0,                          // Number of files in SD
+    int num_files = 0,                          // Number of files in SD
         svd_pck = 0;                            // Number of saved packets (in current part)
+#if EVENT_CAPTURE
+    int num_events = 0;                         // Number of event files saved
+#endif
     char name_dir[12];                          // Name of current folder (new RUN)
-    char name_file[20];                         // Name of current file (partX)
+    uint32_t run_id;                            // In the header and block markers of its parts
+    char name_file[24];                         // Name of current file (eventX, bench.txt, trace)
     FILE* fp;                                   
+    FILE* efp = NULL;                           // Event file being written
+#if CARD_BENCH
+    CardBench::choice_t bench_choice;           // Sample rate and write size for this card
+#endif
+#if TRACE
+    FILE* tfp;                                  // Tracepoint dump
+#endif
+#if SUMMARY_MS
+    FILE* sfp;                                  // Summary of the run
+#endif
     packet_t temp;
+#if ENCODERS < 2
     signal_wave.period_us(50);
     signal_wave.write(0.5f);
+#endif
+    
     
+    /* Initialize accelerometers (fastest ODR when they are oversampled) */
+    imu_bus.frequency(400000);
+    imus.add(imu0);
+#if NUM_IMUS > 1
+    imus.add(imu1);
+#endif
+    if (IMU_DECIMATION > 1)
+        imu_mask = imus.begin(LSM6DS3::G_SCALE_245DPS, LSM6DS3::A_SCALE_2G, \
+                              LSM6DS3::G_ODR_1660, LSM6DS3::A_ODR_1660);
+    else
+        imu_mask = imus.begin(LSM6DS3::G_SCALE_245DPS, LSM6DS3::A_SCALE_2G, \
+                              LSM6DS3::G_ODR_208, LSM6DS3::A_ODR_208);
+#if MOTION_GATE
+    if (imu_mask & 1)
+        imu0.setWakeUp(MOTION_THS, 0);          // Wake-up on INT1, with the taps
+#endif
+    for (int d = 0; d < NUM_IMUS; d++)
+        for (int i = 0; i < 6; i++)
+            imu_dec[d][i].set_ratio(IMU_DECIMATION);
+    for (int i = 0; i < 3; i++)
+        adc_dec[i].set_ratio(ADC_DECIMATION);
+#if ENCODERS
+    for (int i = 0; i < ENCODERS && i < QENC_MAX; i++)
+    {
+        if (!qenc[i].begin(qenc_pins[i][0], qenc_pins[i][1]))
+            pc.printf("Encoder %d: pins without an encoder timer\r\n", i);
+    }
+#endif
     
-    /* Initialize accelerometer */
-    acc_addr = LSM6DS3.begin(LSM6DS3.G_SCALE_245DPS, LSM6DS3.A_SCALE_2G, \
-                             LSM6DS3.G_ODR_208, LSM6DS3.A_ODR_208);
+#if STATIC_MEMORY
+    parts.set_buffers(part_buffers, PART_BUFFER);
+#if CARD_BENCH
+    bench.set_buffer(part_buffers, sizeof(part_buffers));  // Not in use before the run
+#endif
+#endif
+#if !STORAGE_LITTLEFS
+    fileSystem.set_private_buffers(private_files);  // Current part, next part and event file append without sharing the FAT window
+#endif
     
     /* Wait for SD mount */
     do
@@ -102,7 +305,7 @@ int main()
         pc.printf("Mounting the filesystem... ");
         fflush(stdout);
 
-        err = fileSystem.mount(&sd);
+        err = fileSystem.mount(&storage);
         pc.printf("%s\n", (err ? "Fail :(" : "OK"));
         if (err)
         {
@@ -110,7 +313,12 @@ int main()
             this should only happen on the first boot */
             pc.printf("No filesystem found, formatting... ");
             fflush(stdout);
-            err = fileSystem.reformat(&sd);
+#if STORAGE_LITTLEFS
+            err = fileSystem.reformat(&storage);
+#else
+            layout.probe(sd);
+            err = layout.format(fileSystem, &storage);  // FAT and clusters on the card AUs
+#endif
             pc.printf("%s\n", (err ? "Fail :(" : "OK"));
             if (err) 
             {
@@ -119,8 +327,27 @@ int main()
         }
     }while(err);
     
+#if !STORAGE_LITTLEFS
+    /* Check where the FAT sits on the card AUs (cards formatted elsewhere too) */
+    layout.probe(sd);
+    layout.verify(fileSystem);
+    pc.printf("AU %lu KB, FAT %s\r\n", (unsigned long)(layout.au() / 1024), layout.aligned() ? "aligned" : "NOT aligned");
+#endif
+    
     pc.printf("\r\nDebug 2\r\n");
     
+#if CARD_BENCH
+    /* Measure the card, then log as fast as it allows (at most SAMPLE_FREQ) */
+    pc.printf("Card benchmark... ");
+    bench.run("/sd/.bench");                    // Hidden, not counted as a RUN folder
+    bench_choice = bench.choose(SAMPLE_FREQ, sizeof(packet_t), BUFFER_SIZE);
+    sample_freq = bench_choice.sample_freq;
+    pc.printf("%d Hz, %d B writes%s\r\n", sample_freq, bench_choice.block, bench_choice.fits ? "" : " (too slow)");
+#if EVENT_CAPTURE
+    events.set_rate(sample_freq*IMU_DECIMATION);
+#endif
+#endif
+    
     pc.printf("\r\nDebug 3\r\n");
     
     num_files = count_files_in_sd("/sd");
@@ -134,113 +361,525 @@ int main()
     while(!running)                                 // Wait button press
     {                                
         warning = 1;                                
-        pc.printf("\r\nrunning=%d\r\n", running);   // For some reason if this line is empty the code doesn't run
+        pc.printf("\r\nrunning=%d\r\n", running);   // Rate limited, most of these are dropped
     }
     
     /* Create RUN directory */
     mkdir(name_dir, 0777);
+    run_id = ((uint32_t)(num_files + 1) << 24) ^ us_ticker_read();  // Button press time tells runs apart
+    if (run_id == 0)
+        run_id = 1;
     warning = 0;                                // Warning led OFF
-    //sprintf(name_file, "%s%s%d", name_dir, "/part", num_parts++);
-    sprintf(name_file, "%s%s%d", name_dir, "/part", num_parts+1);
-    fp = fopen(name_file, "a");                 // Creates first data file
+#if CARD_BENCH
+    fp = parts.begin(name_dir, 0, bench_choice.block);  // Creates first data file, with the card write size
+    sprintf(name_file, "%s%s", name_dir, "/bench.txt");
+    FILE* bfp = open_file(name_file, STDIO_BUFFER(text_buffer));
+    if (bfp != NULL)
+    {
+        bench.write(bfp, bench_choice);
+        fclose(bfp);
+    }
+#else
+    fp = parts.begin(name_dir, 0);              // Creates first data file
+#endif
+#if !STORAGE_LITTLEFS
+    sprintf(name_file, "%s%s", name_dir, "/card.txt");
+    FILE* cfp = open_file(name_file, STDIO_BUFFER(text_buffer));
+    if (cfp != NULL)
+    {
+        layout.write(cfp);
+        fclose(cfp);
+    }
+#endif
+    encoder.begin(sample_freq, run_id);         // File header
+    memset(&last_analog, 0, sizeof(last_analog));  // Reader starts every file with analog at 0
+    memset(last_qenc, 0, sizeof(last_qenc));    // and the encoders at 0
+#if ENCODERS
+    for (int i = 0; i < ENCODERS; i++)
+        qenc[i].reset(us_ticker_read());        // Positions from the run start
+#endif
+#if MOTION_GATE
+    log_rate = part_rate = sample_freq;
+#endif
+#if SUMMARY_MS
+    sprintf(name_file, "%s%s", name_dir, "/summary");
+    sfp = open_file(name_file, STDIO_BUFFER(summary_buffer));
+    summary.begin(sfp, sample_freq);
+#endif
+#if TRACE
+    sprintf(name_file, "%s%s", name_dir, "/trace");
+    tfp = fopen(name_file, "w");
+    if (tfp != NULL)
+        setvbuf(tfp, NULL, _IONBF, 0);          // Dumps are whole sectors of entries, no stdio buffer in RAM
+    trace.begin(tfp);
+#if STORAGE_PROFILE
+    card.attach(trace_card);
+#endif
+#endif
+#if STORAGE_PROFILE
+    card.reset();                               // Profile the run only
+#endif
+#if STORAGE_CACHE
+    storage.reset_cache_stats();
+#endif
     t.start();                                  // Start device timer
     freq_chan1.fall(&freq_channel1_ISR);
     freq_chan2.fall(&freq_channel2_ISR);
-    acq.attach(&sampleISR, 1.0/SAMPLE_FREQ);    // Start data acquisition
+#if MOTION_GATE
+    gate.reset(t.read_ms());
+#endif
+#if EVENT_CAPTURE || MOTION_GATE
+    imu_int1.rise(&imu_event_ISR);
+#endif
+#if STATIC_MEMORY
+    mbed_stats_heap_get(&heap_start);           // Nothing may be allocated from here on
+#endif
+    acq.attach(&sampleISR, 1.0/(sample_freq*OVERSAMPLE));  // Start data acquisition
     logging = 1;                                // logging led ON
         
     while(running)
     {
         if(StorageTrigger)
         {   
-            packet_t acq_pck;                                  // Current data packet
+            static packet_t acq_pck;                           // Current data packet
             static uint16_t last_acq = t.read_ms();            // Time of last acquisition                   
+            int16_t out;
+            
+            StorageTrigger = false;
+            acq_tick++;
 
-            /* Store LSM6DS3 data if it's connected */
-            if (acc_addr != 0)
+            /* Store LSM6DS3 data if they are connected */
+            if (imu_mask != 0)
             {
-                LSM6DS3.readAccel();                    // Read Accelerometer data
-                LSM6DS3.readGyro();                     // Read Gyroscope data
-        
-                acq_pck.acclsmx = LSM6DS3.ax_raw;
-                acq_pck.acclsmy = LSM6DS3.ay_raw;   
-                acq_pck.acclsmz = LSM6DS3.az_raw;
-                acq_pck.anglsmx = LSM6DS3.gx_raw;
-                acq_pck.anglsmy = LSM6DS3.gy_raw;
-                acq_pck.anglsmz = LSM6DS3.gz_raw;
+                if (acq_tick % (OVERSAMPLE / IMU_DECIMATION) == 0)
+                {
+                    static rec_imu_t frame[NUM_IMUS];   // Last good read of each device
+                    
+                    TRACE_BEGIN(IMU, imu_mask);
+#if EVENT_CAPTURE || MOTION_GATE
+                    uint8_t read_ok = imus.sample(frame, acq_pck.imu_offset_us);  // Bit set per device read
+#else
+                    imus.sample(frame, acq_pck.imu_offset_us);  // Read all Accelerometer and Gyroscope data
+#endif
+                    TRACE_END(IMU);
+#if EVENT_CAPTURE
+                    if (read_ok & 1)
+                        events.add(t.read_ms(), frame[0]);  // Raw frame, before decimation
+#endif
+#if MOTION_GATE
+                    if ((read_ok & 1) && gate.sample(frame[0]))
+                        set_rate(sample_freq, RATE_WAKE_DATA);  // Moved while idle
+#endif
+                    
+                    /* Decimated outputs come out together on the last tick, a failed read
+                       repeats the device's last good frame to keep the filters in step */
+                    for (int d = 0; d < NUM_IMUS; d++)
+                    {
+                        for (int i = 0; i < 3; i++)
+                        {
+                            if (imu_dec[d][i].put(frame[d].acc[i], out)) acq_pck.imu[d].acc[i] = out;
+                            if (imu_dec[d][i + 3].put(frame[d].gyr[i], out)) acq_pck.imu[d].gyr[i] = out;
+                        }
+                    }
+                }
             }
             else
             {
-                acq_pck.acclsmx = 0;
-                acq_pck.acclsmy = 0;   
-                acq_pck.acclsmz = 0;
-                acq_pck.anglsmx = 0;
-                acq_pck.anglsmy = 0;
-                acq_pck.anglsmz = 0;
+                memset(acq_pck.imu, 0, sizeof(acq_pck.imu));
+                memset(acq_pck.imu_offset_us, 0, sizeof(acq_pck.imu_offset_us));
             }
-                
-            acq_pck.analog0 = pot0.read_u16();          // Read analog sensor 0            
-            acq_pck.analog1 = pot1.read_u16();          // Read analog sensor 1
-            acq_pck.analog2 = pot2.read_u16();          // Read analog sensor 2
-            acq_pck.pulses_chan1 = pulse_counter1;      // Store frequence channel 1
-            acq_pck.pulses_chan2 = pulse_counter2;      // Store frequence channel 2
-            acq_pck.time_stamp = t.read_ms();           // Timestamp of data acquistion
-    
-            pulse_counter1= 0;
-            pulse_counter2= 0;
-            buffer.push(acq_pck);
-            buffer_counter++;
+            
+            /* Analog inputs are offset to signed for the filters */
+            if (acq_tick % (OVERSAMPLE / ADC_DECIMATION) == 0)
+            {
+                TRACE_BEGIN(ADC, 0);
+                if (adc_dec[0].put(pot0.read_u16() - 32768, out)) acq_pck.analog0 = out + 32768;   // Read analog sensor 0
+                if (adc_dec[1].put(pot1.read_u16() - 32768, out)) acq_pck.analog1 = out + 32768;   // Read analog sensor 1
+                if (adc_dec[2].put(pot2.read_u16() - 32768, out)) acq_pck.analog2 = out + 32768;   // Read analog sensor 2
+                TRACE_END(ADC);
+            }
+            
+            /* Stored sample complete */
+            if (acq_tick == OVERSAMPLE)
+            {
+                acq_tick = 0;
+                acq_pck.pulses_chan1 = pulse_counter1;      // Store frequence channel 1
+                acq_pck.pulses_chan2 = pulse_counter2;      // Store frequence channel 2
+#if ENCODERS
+                for (int i = 0; i < ENCODERS; i++)
+                {
+                    qenc[i].update();                       // Position at the last tick
+                    acq_pck.qenc_position[i] = qenc[i].position();
+                    acq_pck.qenc_velocity[i] = qenc[i].velocity();
+                }
+#endif
+                acq_pck.time_stamp = t.read_ms();           // Timestamp of data acquistion
         
-            StorageTrigger = false;
+                pulse_counter1= 0;
+                pulse_counter2= 0;
+                TRACE_BEGIN(PUSH, buffer.size());
+                buffer.push(acq_pck);
+                TRACE_END(PUSH);
+                buffer_counter++;
+            }
         }
 
         if(buffer.full())
         {
-            fclose(fp);
+            if(fp != NULL)                      // Stop logging: the buffer stays full from here on
+            {
+                TRACE_MARK(OVERFLOW, 0);
+                flush_block(fp);
+                parts.end();
+                fp = NULL;
+            }
             warning = 1;                        // Turn warning led ON if buffer gets full (abnormal situation)
-            pc.putc('X');                       // Debug message
+#if !TELEMETRY
+            pc.putc('X');                       // Debug message (dropped if the UART is busy)
+#endif
         }
         else if(!buffer.empty())
         {   
+#if !TELEMETRY
             pc.putc('G');                       // Debug message
+#endif
             
             /* Remove packet from buffer and writes it to file */
             buffer.pop(temp);                
             buffer_counter--;
-            fwrite((void *)&temp, sizeof(packet_t), 1, fp);
+            TRACE_BEGIN(STORE, 0);
+            store_packet(&temp, fp);
+            TRACE_END(STORE);
             svd_pck++;
             
-            /* Create new data file 
-            (Deactivated because the code doesn't works fine doing that so many times) */
+#if STORAGE_LITTLEFS
+            /* littlefs only keeps synced data after a power loss. Not on FAT: a sync costs
+               three card operations and the pre-sized part's length is known anyway */
             if(svd_pck == SAVE_WHEN)
             {   
-                //fclose(fp);
-                //sprintf(name_file, "%s%s%d", name_dir, "/part", num_parts++);
-                //t2 = t.read_ms();
-                //fp = fopen(name_file, "w");
-                //printf("t2=%d\r\n",(t.read_ms()-t2));
-                //pc.printf("%d\r\n", buffer_counter);  // Debug message
+                TRACE_BEGIN(SYNC, 0);
+                fflush(fp);                     // Commit what was written so far
+                fsync(fileno(fp));
+                TRACE_END(SYNC);
+                svd_pck = 0;
+            }
+#endif
+            
+            /* New data file between two blocks, already created and allocated */
+            if(parts.due(t.read_ms()))
+            {
+                flush_block(fp);
+                fp = parts.rotate(t.read_ms());
+                encoder.begin(sample_freq, run_id);  // File header
+                memset(&last_analog, 0, sizeof(last_analog));
+                memset(last_qenc, 0, sizeof(last_qenc));
+#if MOTION_GATE
+                part_rate = sample_freq;        // As the header states it
+#endif
                 svd_pck = 0;
             }
         }
         
+        /* Close the previous part, create and allocate the next one, a step at a time */
+        if(buffer.size() < BUFFER_SIZE/4)
+            parts.idle();
+        
+#if MOTION_GATE
+        /* Idle rate after MOTION_IDLE_S without motion */
+        if(imu_mask & 1)
+        {
+            core_util_critical_section_enter(); // No wake-up between the decision and the rate
+            if(gate.idle_due(t.read_ms()))
+                set_rate(MOTION_IDLE_HZ, RATE_IDLE);
+            core_util_critical_section_exit();
+        }
+#endif
+        
+#if EVENT_CAPTURE
+        /* Write captured windows a few frames at a time, only while the log buffer is not busy */
+        if(events.ready() && buffer.size() < BUFFER_SIZE/4)
+        {
+            if(efp == NULL)
+            {
+                snprintf(name_file, sizeof(name_file), "%s%s%d", name_dir, "/event", ++num_events);
+                efp = open_file(name_file, STDIO_BUFFER(event_buffer));
+            }
+            TRACE_BEGIN(EVENT_WRITE, 0);
+            if(efp != NULL && events.write(efp, 16))
+            {
+                fclose(efp);
+                efp = NULL;
+            }
+            TRACE_END(EVENT_WRITE);
+        }
+#endif
+        
+#if TRACE == 1
+        /* Dump the tracepoints when half the ring is taken, only while the log buffer is not busy */
+        if(trace.pending() >= TRACE_RING/2 && buffer.size() < BUFFER_SIZE/4)
+        {
+            TRACE_BEGIN(DUMP, trace.pending());
+            trace.dump(tfp);
+            TRACE_END(DUMP);
+        }
+#endif
+        
         /* Software debounce for start button */
         if((t.read_ms() > 10) && (t.read_ms() < 1000))
             start.fall(toggle_logging);
     }
     
     /* Reset device if start button is pressed while logging */
-    fclose(fp);
+#if MOTION_GATE
+    store_rate_changes(t.read_ms(), fp);        // Changes after the last packet
+#endif
+    flush_block(fp);
+    parts.end();
+    if(efp != NULL)
+        fclose(efp);
+#if SUMMARY_MS
+    summary.end();
+    if(sfp != NULL)
+        fclose(sfp);
+#endif
+#if TRACE
+    trace.dump(tfp);
+    if(tfp != NULL)
+        fclose(tfp);
+#endif
+    write_storage_health(name_dir);
+    write_memory_report(name_dir);
     logging = 0;
     NVIC_SystemReset();
     return 0;
 }
 
+void store_packet(const packet_t *pck, FILE *fp)
+{
+    rec_analog_t analog;
+    rec_pulses_t pulses;
+    
+    analog.analog[0] = pck->analog0;
+    analog.analog[1] = pck->analog1;
+    analog.analog[2] = pck->analog2;
+    pulses.pulses[0] = pck->pulses_chan1;
+    pulses.pulses[1] = pck->pulses_chan2;
+    
+#if MOTION_GATE
+    store_rate_changes(pck->time_stamp, fp);    // Rate of this packet
+#endif
+    
+#if TELEMETRY
+    telemetry.sample(pck->time_stamp, (imu_mask & 1) ? &pck->imu[0] : NULL, &analog, &pulses);
+#endif
+#if SUMMARY_MS
+#if ENCODERS
+    const int32_t *velocity = pck->qenc_velocity;
+#else
+    const int32_t *velocity = NULL;
+#endif
+    summary.sample(pck->time_stamp, parts.part(), (imu_mask & 1) ? &pck->imu[0] : NULL, &analog, &pulses,
+                   velocity, ENCODERS);
+#endif
+    
+    /* IMU record only if a LSM6DS3 is connected, group record when more than the first one */
+    if (imu_mask == 1)
+    {
+        while (!encoder.put(REC_IMU, pck->time_stamp, &pck->imu[0]))
+            flush_block(fp);
+    }
+    else if (imu_mask != 0)
+    {
+        rec_imu_group_t group;
+        
+        memset(&group, 0, sizeof(group));
+        group.mask = imu_mask;
+        for (int d = 0; d < NUM_IMUS && d < IMU_GROUP_MAX; d++)
+        {
+            group.imu[d] = pck->imu[d];
+            group.offset_us[d] = pck->imu_offset_us[d];
+        }
+        while (!encoder.put(REC_IMU_GROUP, pck->time_stamp, &group))
+            flush_block(fp);
+    }
+    
+    /* Analog record only when some input changed (the reader holds the last value) */
+    if (memcmp(&analog, &last_analog, sizeof(analog)) != 0)
+    {
+        while (!encoder.put(REC_ANALOG, pck->time_stamp, &analog))
+            flush_block(fp);
+        last_analog = analog;
+    }
+    
+    /* Pulses record only if something was counted */
+    if (pck->pulses_chan1 || pck->pulses_chan2)
+    {
+        while (!encoder.put(REC_PULSES, pck->time_stamp, &pulses))
+            flush_block(fp);
+    }
+    
+#if ENCODERS
+    /* Encoder records only for the encoders that moved or changed speed */
+    for (int i = 0; i < ENCODERS && i < QENC_MAX; i++)
+    {
+        rec_qenc_t qenc_rec;
+        
+        qenc_rec.position = pck->qenc_position[i];
+        qenc_rec.velocity = pck->qenc_velocity[i];
+        if (memcmp(&qenc_rec, &last_qenc[i], sizeof(qenc_rec)) != 0)
+        {
+            while (!encoder.put(REC_QENC + i, pck->time_stamp, &qenc_rec))
+                flush_block(fp);
+            last_qenc[i] = qenc_rec;
+        }
+    }
+#endif
+}
+
+#if MOTION_GATE
+void store_rate_changes(uint32_t time_ms, FILE *fp)
+{
+    rate_change_t change;
+    
+    if (fp == NULL)                             // Part closed on overflow
+        return;
+    
+    /* A new part starts at the header rate, restate the one in effect */
+    if (part_rate != log_rate)
+    {
+        change.rate.rate = log_rate;
+        change.rate.cause = RATE_RESTATED;
+        change.rate.reserved = 0;
+        while (!encoder.put(REC_RATE, time_ms, &change.rate))
+            flush_block(fp);
+        part_rate = log_rate;
+    }
+    
+    while (rate_changes.peek(change) && change.time_ms <= time_ms)
+    {
+        rate_changes.pop(change);
+        while (!encoder.put(REC_RATE, change.time_ms, &change.rate))
+            flush_block(fp);
+        log_rate = part_rate = change.rate.rate;
+    }
+}
+#endif
+
+void flush_block(FILE *fp)
+{
+    if (fp != NULL && encoder.length() > 0)     // Dropped once the part was closed on overflow
+    {
+        TRACE_BEGIN(FWRITE, encoder.length());
+        fwrite(encoder.data(), 1, encoder.length(), fp);
+        TRACE_END(FWRITE);
+        parts.written(encoder.length());
+    }
+    encoder.clear();
+}
+
+void write_storage_health(const char *dir)
+{
+#if STORAGE_PROFILE
+    static const char *op_names[ProfilingBlockDevice::PROFILE_OPS] = { "read", "program", "erase", "sync" };
+    static ProfilingBlockDevice::profile_t profile;
+    char name[24];
+    FILE *f;
+#if STORAGE_CACHE
+    BufferedBlockDevice::cache_stats_t cache;
+    
+    storage.get_cache_stats(&cache);
+#endif
+    
+    card.snapshot(&profile);                    // Before the summary itself is written
+    sprintf(name, "%s%s", dir, "/storage.txt");
+    f = open_file(name, STDIO_BUFFER(text_buffer));
+    if (f == NULL)
+        return;
+    
+    fprintf(f, "elapsed_ms %lu\n", (unsigned long)(profile.elapsed_us / 1000));
+    fprintf(f, "op count errors bytes ops_per_s mean_us max_us histogram(bucket n: 2^n..2^(n+1) us)\n");
+    for (int op = 0; op < ProfilingBlockDevice::PROFILE_OPS; op++)
+    {
+        const ProfilingBlockDevice::op_profile_t *p = &profile.op[op];
+        
+        fprintf(f, "%s %lu %lu %lu %lu %lu %lu", op_names[op], (unsigned long)p->count, (unsigned long)p->errors,
+                (unsigned long)p->bytes,
+                (unsigned long)(profile.elapsed_us ? (uint64_t)p->count * 1000000 / profile.elapsed_us : 0),
+                (unsigned long)(p->count ? p->total_us / p->count : 0), (unsigned long)p->max_us);
+        for (int b = 0; b < MBED_PROFILING_BD_BUCKETS; b++)
+        {
+            if (p->histogram[b])
+                fprintf(f, " %d:%lu", b, (unsigned long)p->histogram[b]);
+        }
+        fprintf(f, "\n");
+    }
+    fprintf(f, "parts %u late_rotations %lu\n", parts.part(), (unsigned long)parts.late());
+#if STORAGE_CACHE
+    fprintf(f, "cache flushes %lu programs %lu sectors %lu max_run %lu fills %lu bypassed %lu\n",
+            (unsigned long)cache.flushes, (unsigned long)cache.programs, (unsigned long)cache.programmed_units,
+            (unsigned long)cache.max_run, (unsigned long)cache.fills, (unsigned long)cache.bypassed);
+#endif
+    fclose(f);
+#else
+    (void)dir;
+#endif
+}
+
+FILE* open_file(const char *name, uint8_t *buf, size_t size)
+{
+    FILE* f = fopen(name, "w");
+    
+    if (f != NULL && buf != NULL)
+        setvbuf(f, (char *)buf, _IOFBF, size);  // Before the first write allocates one
+    return f;
+}
+
+void write_memory_report(const char *dir)
+{
+#if STATIC_MEMORY
+    mbed_stats_heap_t heap;
+    char name[24];
+    FILE *f;
+    
+    mbed_stats_heap_get(&heap);                 // Before the report itself is written
+    pc.printf("Heap %lu B, %lu B allocated during the run\r\n", (unsigned long)heap.current_size,
+              (unsigned long)(heap.total_size - heap_start.total_size));
+    sprintf(name, "%s%s", dir, "/memory.txt");
+    f = open_file(name, STDIO_BUFFER(text_buffer));
+    if (f == NULL)
+        return;
+    
+    fprintf(f, "start current %lu max %lu blocks %lu\n", (unsigned long)heap_start.current_size,
+            (unsigned long)heap_start.max_size, (unsigned long)heap_start.alloc_cnt);
+    fprintf(f, "end current %lu max %lu blocks %lu\n", (unsigned long)heap.current_size,
+            (unsigned long)heap.max_size, (unsigned long)heap.alloc_cnt);
+    fprintf(f, "run allocated %lu failed %lu\n", (unsigned long)(heap.total_size - heap_start.total_size),
+            (unsigned long)(heap.alloc_fail_cnt - heap_start.alloc_fail_cnt));
+    fclose(f);
+#else
+    (void)dir;
+#endif
+}
+
 void sampleISR()
 {
+    TRACE_MARK(TICK, 0);
+#if ENCODERS
+    uint32_t now_us = us_ticker_read();
+    
+    for (int i = 0; i < ENCODERS; i++)
+        qenc[i].latch(now_us);                  // Counter at the tick, a register read
+#endif
     StorageTrigger = true;
 }
 
+#if TRACE && STORAGE_PROFILE
+void trace_card(ProfilingBlockDevice::profile_op op, bool done, bd_size_t size)
+{
+    trace.put(TRACE_CARD_READ + op, done ? TRACE_KIND_END : TRACE_KIND_BEGIN, size / 512);
+}
+#endif
+
 uint32_t count_files_in_sd(const char *fsrc)
 {   
     DIR *d = opendir(fsrc);
@@ -249,7 +888,7 @@ uint32_t count_files_in_sd(const char *fsrc)
     
     while ((p = readdir(d)) != NULL)   
     {
-        if(strcmp(p->d_name, ".Trash-1000"))
+        if(p->d_name[0] != '.')                 // ".Trash-1000", and littlefs "." and ".."
             counter++;
     }
     closedir(d);
@@ -266,6 +905,37 @@ void freq_channel2_ISR()
     pulse_counter2++;
 }
 
+void imu_event_ISR()
+{
+#if MOTION_GATE
+    /* INT1 also carries the wake-ups: event capture keeps its software threshold only */
+    if (gate.wake())
+        set_rate(sample_freq, RATE_WAKE_INT);   // Full rate from the next tick
+#elif EVENT_CAPTURE
+    events.trigger();
+#endif
+}
+
+#if MOTION_GATE
+void set_rate(uint16_t rate, uint8_t cause)
+{
+    rate_change_t change;
+    
+    if (rate)
+        acq.attach_us(&sampleISR, 1000000 / (rate * OVERSAMPLE));
+    else
+        acq.detach();
+#if EVENT_CAPTURE
+    events.set_rate(rate * IMU_DECIMATION);
+#endif
+    change.time_ms = t.read_ms();
+    change.rate.rate = rate;
+    change.rate.cause = cause;
+    change.rate.reserved = 0;
+    rate_changes.push(change);                  // Stored before the next packet (store_packet())
+}
+#endif
+
 void toggle_logging()
 {
     running = !running;
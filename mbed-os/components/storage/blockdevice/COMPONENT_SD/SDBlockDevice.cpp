@@ -230,6 +230,7 @@ using namespace mbed;
 
 /*  CRC Enable  */
 #define CRC_ENABLE               (0)         /*!< CRC 1 - Enable 0 - Disable */
+#define CRC_CHUNK                (64)        /*!< Data bytes transferred between CRC16 updates */
 
 /* Control Tokens   */
 #define SPI_DATA_RESPONSE_MASK   (0x1F)
@@ -637,6 +638,43 @@ const char *SDBlockDevice::get_type() const
     return "SD";
 }
 
+int SDBlockDevice::read_sd_status(sd_status_t *status)
+{
+    // AU_SIZE codes 1 to 15, in KB
+    static const uint32_t au_kb[16] = { 0, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096,
+                                        8192, 12288, 16384, 24576, 32768, 65536
+                                      };
+    static const uint8_t speed_classes[5] = { 0, 2, 4, 6, 10 };
+    uint8_t reg[64];
+
+    lock();
+    if (!_is_initialized) {
+        unlock();
+        return SD_BLOCK_DEVICE_ERROR_NO_INIT;
+    }
+
+    // ACMD13, Response R2 (R1 byte + status byte) then a 64-byte block
+    int err = _cmd(ACMD13_SD_STATUS, 0x0, 1);
+    if (BD_ERROR_OK == err) {
+        err = _read_bytes(reg, sizeof(reg));
+    }
+    unlock();
+    if (err) {
+        debug_if(SD_DBG, "SD Status read failed: %d\n", err);
+        return err;
+    }
+
+    // Bit n of the register is in reg[63 - n / 8]
+    status->au_size = (mbed::bd_size_t)au_kb[reg[10] >> 4] * 1024;     // AU_SIZE     : [431:428]
+    status->erase_aus = ((uint16_t)reg[11] << 8) | reg[12];            // ERASE_SIZE  : [423:408]
+    status->erase_timeout_s = reg[13] >> 2;                            // ERASE_TIMEOUT : [407:402]
+    status->erase_offset_s = reg[13] & 0x3;                            // ERASE_OFFSET : [401:400]
+    status->speed_class = (reg[8] < 5) ? speed_classes[reg[8]] : 0;    // SPEED_CLASS : [447:440]
+    debug_if(SD_DBG, "AU: %" PRIu64 " bytes, erase %u AUs in %u s\n", status->au_size, status->erase_aus,
+             status->erase_timeout_s);
+    return BD_ERROR_OK;
+}
+
 void SDBlockDevice::debug(bool dbg)
 {
     _dbg = dbg;
@@ -826,7 +864,7 @@ int SDBlockDevice::_cmd(SDBlockDevice::cmdSupported cmd, uint32_t arg, bool isAc
     }
 
     // Do not deselect card if read is in progress.
-    if (((CMD9_SEND_CSD == cmd) || (ACMD22_SEND_NUM_WR_BLOCKS == cmd) ||
+    if (((CMD9_SEND_CSD == cmd) || (ACMD22_SEND_NUM_WR_BLOCKS == cmd) || (ACMD13_SD_STATUS == cmd) ||
             (CMD24_WRITE_BLOCK == cmd) || (CMD25_WRITE_MULTIPLE_BLOCK == cmd) ||
             (CMD17_READ_SINGLE_BLOCK == cmd) || (CMD18_READ_MULTIPLE_BLOCK == cmd))
             && (BD_ERROR_OK == status)) {
@@ -925,8 +963,23 @@ int SDBlockDevice::_read(uint8_t *buffer, uint32_t length)
         return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
     }
 
-    // read data
-    _spi.write(NULL, 0, (char *)buffer, length);
+#if MBED_CONF_SD_CRC_ENABLED
+    uint32_t crc_result;
+    if (_crc_on) {
+        // read data, updating the checksum after each chunk received
+        _crc16.compute_partial_start(&crc_result);
+        for (uint32_t i = 0; i < length; i += CRC_CHUNK) {
+            uint32_t chunk = (length - i < CRC_CHUNK) ? length - i : CRC_CHUNK;
+            _spi.write(NULL, 0, (char *)buffer + i, chunk);
+            _crc16.compute_partial((void *)(buffer + i), chunk, &crc_result);
+        }
+        _crc16.compute_partial_stop(&crc_result);
+    } else
+#endif
+    {
+        // read data
+        _spi.write(NULL, 0, (char *)buffer, length);
+    }
 
     // Read the CRC16 checksum for the data block
     crc = (_spi.write(SPI_FILL_CHAR) << 8);
@@ -934,9 +987,7 @@ int SDBlockDevice::_read(uint8_t *buffer, uint32_t length)
 
 #if MBED_CONF_SD_CRC_ENABLED
     if (_crc_on) {
-        uint32_t crc_result;
-        // Compute and verify checksum
-        _crc16.compute((void *)buffer, length, &crc_result);
+        // Verify checksum
         if ((uint16_t)crc_result != crc) {
             debug_if(SD_DBG, "_read_bytes: Invalid CRC received 0x%" PRIx16 " result of computation 0x%" PRIx16 "\n",
                      crc, (uint16_t)crc_result);
@@ -957,15 +1008,22 @@ uint8_t SDBlockDevice::_write(const uint8_t *buffer, uint8_t token, uint32_t len
     // indicate start of block
     _spi.write(token);
 
-    // write the data
-    _spi.write((char *)buffer, length, NULL, 0);
-
 #if MBED_CONF_SD_CRC_ENABLED
     if (_crc_on) {
-        // Compute CRC
-        _crc16.compute((void *)buffer, length, &crc);
-    }
+        // write the data, updating the CRC after each chunk sent
+        _crc16.compute_partial_start(&crc);
+        for (uint32_t i = 0; i < length; i += CRC_CHUNK) {
+            uint32_t chunk = (length - i < CRC_CHUNK) ? length - i : CRC_CHUNK;
+            _spi.write((char *)buffer + i, chunk, NULL, 0);
+            _crc16.compute_partial((void *)(buffer + i), chunk, &crc);
+        }
+        _crc16.compute_partial_stop(&crc);
+    } else
 #endif
+    {
+        // write the data
+        _spi.write((char *)buffer, length, NULL, 0);
+    }
 
     // write the checksum CRC16
     _spi.write(crc >> 8);
@@ -151,6 +151,29 @@ public:
      */
     virtual const char *get_type() const;
 
+    /** Allocation unit and erase geometry of the card, from the SD Status register */
+    struct sd_status_t {
+        mbed::bd_size_t au_size;    ///< Allocation unit (AU) in bytes, 0 if the card doesn't give it
+        uint16_t erase_aus;         ///< AUs erased within erase_timeout_s, 0 if not given
+        uint8_t erase_timeout_s;    ///< Timeout of an erase of erase_aus AUs
+        uint8_t erase_offset_s;     ///< Fixed part of any erase time
+        uint8_t speed_class;        ///< 0, 2, 4, 6 or 10
+    };
+
+    /** Read the SD Status register (ACMD13)
+     *
+     *  Writes sequential in whole AUs are the cheapest for the card, file
+     *  system structures should be aligned to them (see FATFileSystem::format).
+     *
+     *  @param status   Destination of the decoded fields
+     *  @return         BD_ERROR_OK(0) - success
+     *                  SD_BLOCK_DEVICE_ERROR_NO_INIT - device is not initialized
+     *                  SD_BLOCK_DEVICE_ERROR_UNSUPPORTED - unsupported command (SD 1.x card)
+     *                  SD_BLOCK_DEVICE_ERROR_NO_RESPONSE - no data block
+     *                  SD_BLOCK_DEVICE_ERROR_CRC - crc error
+     */
+    int read_sd_status(sd_status_t *status);
+
 private:
     /* Commands : Listed below are commands supported
      * in SPI mode for SD card : Only Mandatory ones
@@ -57,7 +57,9 @@ extern SingletonPtr<PlatformMutex> mbed_crc_mutex;
  *  are tried (you can find list of supported polynomials here ::crc_polynomial). If the selected
  *  configuration is supported, it will accelerate the software computations. If ROM tables
  *  are not available for the selected polynomial, then CRC is computed at run time bit by bit
- *  for all data input.
+ *  for all data input. With the `drivers.crc-slices` configuration set to 4, the 16-bit CCITT
+ *  polynomial (SD card data blocks) is computed four bytes at a time from four tables
+ *  (slice-by-4, 1.5 KB of ROM more).
  *  @note Synchronization level: Thread safe
  *
  *  @tparam  polynomial CRC polynomial value in hex
@@ -481,7 +483,19 @@ private:
             }
         } else if (width <= 16) {
             uint16_t *crc_table = (uint16_t *)_crc_table;
-            for (crc_data_size_t byte = 0; byte < size; byte++) {
+            crc_data_size_t byte = 0;
+#if MBED_CONF_DRIVERS_CRC_SLICES == 4
+            if ((POLY_16BIT_CCITT == polynomial) && (16 == width) && !_reflect_data) {
+                // Slice-by-4: four bytes per step, the CRC only depends on the first two
+                for (; byte + 4 <= size; byte += 4) {
+                    p_crc = Table_CRC_16bit_CCITT_Slice4[2][(data[byte] ^ (p_crc >> 8)) & 0xff] ^
+                            Table_CRC_16bit_CCITT_Slice4[1][(data[byte + 1] ^ p_crc) & 0xff] ^
+                            Table_CRC_16bit_CCITT_Slice4[0][data[byte + 2]] ^
+                            crc_table[data[byte + 3]];
+                }
+            }
+#endif
+            for (; byte < size; byte++) {
                 data_byte = reflect_bytes(data[byte]) ^ (p_crc >> (width - 8));
                 p_crc = crc_table[data_byte] ^ (p_crc << 8);
             }
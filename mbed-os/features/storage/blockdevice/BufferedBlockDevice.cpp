@@ -27,10 +27,20 @@ static inline uint32_t align_down(bd_size_t val, bd_size_t size)
     return val / size * size;
 }
 
-BufferedBlockDevice::BufferedBlockDevice(BlockDevice *bd)
-    : _bd(bd), _bd_program_size(0), _bd_read_size(0), _write_cache_addr(0), _write_cache_valid(false),
-      _write_cache(0), _read_buf(0), _init_ref_count(0), _is_initialized(false)
+// Bits first to first + count - 1
+static inline uint32_t unit_mask(bd_size_t first, bd_size_t count)
 {
+    return (count >= 32 ? 0xFFFFFFFFUL : ((1UL << count) - 1)) << first;
+}
+
+BufferedBlockDevice::BufferedBlockDevice(BlockDevice *bd, bd_size_t cache_units, void *buffer, bd_size_t buffer_size)
+    : _bd(bd), _bd_program_size(0), _bd_read_size(0), _bd_size(0), _cache_units(cache_units),
+      _write_cache_addr(0), _valid_units(0), _dirty_units(0), _write_cache(0), _read_buf(0),
+      _buffer(static_cast<uint8_t *>(buffer)), _buffer_size(buffer_size), _own_buffers(false),
+      _init_ref_count(0), _is_initialized(false)
+{
+    MBED_ASSERT(cache_units >= 1 && cache_units <= 32);
+    reset_cache_stats();
 }
 
 BufferedBlockDevice::~BufferedBlockDevice()
@@ -55,12 +65,14 @@ int BufferedBlockDevice::init()
     _bd_program_size = _bd->get_program_size();
     _bd_size = _bd->size();
 
-    if (!_write_cache) {
-        _write_cache = new uint8_t[_bd_program_size];
-    }
-
-    if (!_read_buf) {
+    if (_buffer && _buffer_size >= _bd_program_size * _cache_units + _bd_read_size) {
+        _write_cache = _buffer;
+        _read_buf = _buffer + _bd_program_size * _cache_units;
+        _own_buffers = false;
+    } else {
+        _write_cache = new uint8_t[_bd_program_size * _cache_units];
         _read_buf = new uint8_t[_bd_read_size];
+        _own_buffers = true;
     }
 
     invalidate_write_cache();
@@ -81,12 +93,18 @@ int BufferedBlockDevice::deinit()
         return BD_ERROR_OK;
     }
 
-    delete[] _write_cache;
+    // Dirty data would be lost with the cache
+    int flush_err = flush();
+
+    if (_own_buffers) {
+        delete[] _write_cache;
+        delete[] _read_buf;
+    }
     _write_cache = 0;
-    delete[] _read_buf;
     _read_buf = 0;
     _is_initialized = false;
-    return _bd->deinit();
+    int err = _bd->deinit();
+    return flush_err ? flush_err : err;
 }
 
 int BufferedBlockDevice::flush()
@@ -96,12 +114,34 @@ int BufferedBlockDevice::flush()
         return BD_ERROR_DEVICE_ERROR;
     }
 
-    if (_write_cache_valid) {
-        int ret = _bd->program(_write_cache, _write_cache_addr, _bd_program_size);
+    if (!_dirty_units) {
+        return 0;
+    }
+
+    // One program per run of adjacent dirty units
+    _stats.flushes++;
+    for (bd_size_t unit = 0; unit < _cache_units;) {
+        if (!(_dirty_units & unit_mask(unit, 1))) {
+            unit++;
+            continue;
+        }
+
+        bd_size_t run = 1;
+        while (unit + run < _cache_units && (_dirty_units & unit_mask(unit + run, 1))) {
+            run++;
+        }
+
+        int ret = _bd->program(_write_cache + unit * _bd_program_size,
+                               _write_cache_addr + unit * _bd_program_size, run * _bd_program_size);
         if (ret) {
             return ret;
         }
-        invalidate_write_cache();
+        _dirty_units &= ~unit_mask(unit, run);
+
+        _stats.programs++;
+        _stats.programmed_units += run;
+        _stats.max_run = std::max(_stats.max_run, (uint32_t)run);
+        unit += run;
     }
     return 0;
 }
@@ -109,7 +149,29 @@ int BufferedBlockDevice::flush()
 void BufferedBlockDevice::invalidate_write_cache()
 {
     _write_cache_addr = _bd_size;
-    _write_cache_valid = false;
+    _valid_units = 0;
+    _dirty_units = 0;
+}
+
+void BufferedBlockDevice::discard_write_cache(bd_addr_t addr, bd_size_t size)
+{
+    for (bd_size_t unit = 0; unit < _cache_units; unit++) {
+        bd_addr_t unit_addr = _write_cache_addr + unit * _bd_program_size;
+        if (unit_addr < addr + size && unit_addr + _bd_program_size > addr) {
+            _valid_units &= ~unit_mask(unit, 1);
+            _dirty_units &= ~unit_mask(unit, 1);
+        }
+    }
+}
+
+void BufferedBlockDevice::get_cache_stats(cache_stats_t *stats) const
+{
+    *stats = _stats;
+}
+
+void BufferedBlockDevice::reset_cache_stats()
+{
+    memset(&_stats, 0, sizeof(_stats));
 }
 
 int BufferedBlockDevice::sync()
@@ -133,9 +195,11 @@ int BufferedBlockDevice::read(void *b, bd_addr_t addr, bd_size_t size)
     }
 
     MBED_ASSERT(_write_cache && _read_buf);
+    bd_size_t cache_size = _cache_units * _bd_program_size;
+
     // Common case - no need to involve write cache or read buffer
     if (_bd->is_valid_read(addr, size) &&
-            ((addr + size <= _write_cache_addr) || (addr > _write_cache_addr + _bd_program_size))) {
+            ((addr + size <= _write_cache_addr) || (addr >= _write_cache_addr + cache_size))) {
         return _bd->read(b, addr, size);
     }
 
@@ -147,11 +211,14 @@ int BufferedBlockDevice::read(void *b, bd_addr_t addr, bd_size_t size)
         bool read_from_bd = true;
         if (addr < _write_cache_addr) {
             chunk = std::min(size, _write_cache_addr - addr);
-        } else if ((addr >= _write_cache_addr) && (addr < _write_cache_addr + _bd_program_size)) {
-            // One case we need to take our data from cache
-            chunk = std::min(size, _bd_program_size - addr % _bd_program_size);
-            memcpy(buf, _write_cache + addr % _bd_program_size, chunk);
-            read_from_bd = false;
+        } else if (addr < _write_cache_addr + cache_size) {
+            // Units held in the cache are newer than the underlying BD, the others are read through
+            bd_size_t offs_in_cache = addr - _write_cache_addr;
+            chunk = std::min(size, _bd_program_size - offs_in_cache % _bd_program_size);
+            if (_valid_units & unit_mask(offs_in_cache / _bd_program_size, 1)) {
+                memcpy(buf, _write_cache + offs_in_cache, chunk);
+                read_from_bd = false;
+            }
         } else {
             chunk = size;
         }
@@ -191,64 +258,61 @@ int BufferedBlockDevice::program(const void *b, bd_addr_t addr, bd_size_t size)
     MBED_ASSERT(_write_cache);
 
     int ret;
-
-    bd_addr_t aligned_addr = align_down(addr, _bd_program_size);
-
+    bd_size_t cache_size = _cache_units * _bd_program_size;
     const uint8_t *buf = static_cast <const uint8_t *>(b);
 
-    // Need to flush if moved to another program unit
-    if (aligned_addr != _write_cache_addr) {
-        ret = flush();
-        if (ret) {
-            return ret;
-        }
-        _write_cache_addr = aligned_addr;
-    }
-
-    // Write logic: Keep data in cache as long as we don't reach the end of the program unit.
-    // Otherwise, program to the underlying BD.
+    // Write logic: Keep data in cache until a program falls outside of it or on sync,
+    // then program each run of adjacent dirty units at once.
     while (size) {
-        _write_cache_addr = align_down(addr, _bd_program_size);
-        bd_addr_t offs_in_buf = addr - _write_cache_addr;
-        bd_size_t chunk;
-        if (offs_in_buf) {
-            chunk = std::min(_bd_program_size - offs_in_buf, size);
-        } else if (size >= _bd_program_size) {
-            chunk = align_down(size, _bd_program_size);
-        } else {
-            chunk = size;
-        }
+        bd_addr_t aligned_addr = align_down(addr, _bd_program_size);
+        bd_size_t offs_in_buf = addr - aligned_addr;
 
-        const uint8_t *prog_buf;
-        if (chunk < _bd_program_size) {
-            // If cache not valid, and program doesn't cover an entire unit, it means we need to
-            // read it from the underlying BD
-            if (!_write_cache_valid) {
-                ret = _bd->read(_write_cache, _write_cache_addr, _bd_program_size);
-                if (ret) {
-                    return ret;
-                }
+        // Aligned programs that would fill the whole cache go straight to the underlying BD
+        if (!offs_in_buf && size >= cache_size) {
+            bd_size_t chunk = align_down(size, _bd_program_size);
+            ret = flush();
+            if (ret) {
+                return ret;
             }
-            memcpy(_write_cache + offs_in_buf, buf, chunk);
-            prog_buf = _write_cache;
-        } else {
-            prog_buf = buf;
+            discard_write_cache(addr, chunk);
+            ret = _bd->program(buf, addr, chunk);
+            if (ret) {
+                return ret;
+            }
+            _stats.bypassed++;
+
+            buf += chunk;
+            addr += chunk;
+            size -= chunk;
+            continue;
         }
 
-        // Only program if we reached the end of a program unit
-        if (!((offs_in_buf + chunk) % _bd_program_size)) {
-            ret = _bd->program(prog_buf, _write_cache_addr, std::max(chunk, _bd_program_size));
+        // Need to flush if moved out of the cache, which then starts at this unit
+        if (aligned_addr < _write_cache_addr || aligned_addr >= _write_cache_addr + cache_size) {
+            ret = flush();
             if (ret) {
                 return ret;
             }
-            ret = _bd->sync();
+            _write_cache_addr = aligned_addr;
+            _valid_units = 0;
+        }
+
+        bd_size_t unit = (aligned_addr - _write_cache_addr) / _bd_program_size;
+        bd_size_t chunk = std::min(_bd_program_size - offs_in_buf, size);
+        uint8_t *unit_buf = _write_cache + unit * _bd_program_size;
+
+        // If the unit is not cached and the program doesn't cover it entirely, it means we
+        // need to read it from the underlying BD
+        if (chunk < _bd_program_size && !(_valid_units & unit_mask(unit, 1))) {
+            ret = _bd->read(unit_buf, aligned_addr, _bd_program_size);
             if (ret) {
                 return ret;
             }
-            invalidate_write_cache();
-        } else {
-            _write_cache_valid = true;
+            _stats.fills++;
         }
+        memcpy(unit_buf + offs_in_buf, buf, chunk);
+        _valid_units |= unit_mask(unit, 1);
+        _dirty_units |= unit_mask(unit, 1);
 
         buf += chunk;
         addr += chunk;
@@ -265,9 +329,7 @@ int BufferedBlockDevice::erase(bd_addr_t addr, bd_size_t size)
         return BD_ERROR_DEVICE_ERROR;
     }
 
-    if ((_write_cache_addr >= addr) && (_write_cache_addr <= addr + size)) {
-        invalidate_write_cache();
-    }
+    discard_write_cache(addr, size);
     return _bd->erase(addr, size);
 }
 
@@ -278,9 +340,7 @@ int BufferedBlockDevice::trim(bd_addr_t addr, bd_size_t size)
         return BD_ERROR_DEVICE_ERROR;
     }
 
-    if ((_write_cache_addr >= addr) && (_write_cache_addr <= addr + size)) {
-        invalidate_write_cache();
-    }
+    discard_write_cache(addr, size);
     return _bd->trim(addr, size);
 }
 
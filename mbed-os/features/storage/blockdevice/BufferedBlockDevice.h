@@ -27,19 +27,40 @@
 #define MBED_BUFFERED_BLOCK_DEVICE_H
 
 #include "BlockDevice.h"
+#include <stddef.h>
 
 namespace mbed {
 
 /** Block device for allowing minimal read and program sizes (of 1) for the underlying BD,
  *  using a buffer on the heap.
+ *
+ *  The buffer is a write-back cache of one or more consecutive program units. Programs
+ *  are kept in it until one falls outside of it or until sync, then each run of adjacent
+ *  dirty units is written with a single program of the underlying BD (a multi-block
+ *  write on SD cards). Reads of cached units are served from the cache.
  */
 class BufferedBlockDevice : public BlockDevice {
 public:
+    /** Write cache statistics */
+    struct cache_stats_t {
+        uint32_t flushes;           ///< Flushes that had dirty units
+        uint32_t programs;          ///< Programs of the underlying BD from the cache
+        uint32_t programmed_units;  ///< Program units written by those programs
+        uint32_t max_run;           ///< Most units written by a single program
+        uint32_t fills;             ///< Units read from the underlying BD to complete a partial program
+        uint32_t bypassed;          ///< Programs larger than the cache, sent directly
+    };
+
     /** Lifetime of a memory-buffered block device wrapping an underlying block device
      *
-     *  @param bd        Block device to back the BufferedBlockDevice
+     *  @param bd           Block device to back the BufferedBlockDevice
+     *  @param cache_units  Program units held by the write cache, 1 to 32
+     *  @param buffer       Memory for the write cache and the read buffer,
+     *                      (cache_units + 1) program or read units. NULL, or
+     *                      too small for the device, to allocate them at init.
+     *  @param buffer_size  Size of buffer in bytes
      */
-    BufferedBlockDevice(BlockDevice *bd);
+    BufferedBlockDevice(BlockDevice *bd, bd_size_t cache_units = 1, void *buffer = NULL, bd_size_t buffer_size = 0);
 
     /** Lifetime of the memory-buffered block device
      */
@@ -52,6 +73,8 @@ public:
     virtual int init();
 
     /** Deinitialize the buffered-memory block device and its underlying block device
+     *
+     *  Data still in the write cache is programmed first.
      *
      *  @return         0 on success or a negative error code on failure
      */
@@ -159,17 +182,33 @@ public:
      */
     virtual const char *get_type() const;
 
+    /** Get the write cache statistics since the last reset
+     *
+     *  @param stats    Receives the statistics
+     */
+    void get_cache_stats(cache_stats_t *stats) const;
+
+    /** Reset the write cache statistics to zero
+     */
+    void reset_cache_stats();
+
 protected:
     BlockDevice *_bd;
     bd_size_t _bd_program_size;
     bd_size_t _bd_read_size;
     bd_size_t _bd_size;
+    bd_size_t _cache_units;
     bd_size_t _write_cache_addr;
-    bool _write_cache_valid;
+    uint32_t _valid_units;
+    uint32_t _dirty_units;
     uint8_t *_write_cache;
     uint8_t *_read_buf;
+    uint8_t *_buffer;
+    bd_size_t _buffer_size;
+    bool _own_buffers;
     uint32_t _init_ref_count;
     bool _is_initialized;
+    cache_stats_t _stats;
 
 #if !(DOXYGEN_ONLY)
     /** Flush data in cache
@@ -183,6 +222,13 @@ protected:
      *  @return         none
      */
     void invalidate_write_cache();
+
+    /** Drop the cached units in a range, without programming them
+     *
+     *  @param addr     Start of the range
+     *  @param size     Size of the range in bytes
+     */
+    void discard_write_cache(bd_addr_t addr, bd_size_t size);
 #endif //#if !(DOXYGEN_ONLY)
 };
 } // namespace mbed
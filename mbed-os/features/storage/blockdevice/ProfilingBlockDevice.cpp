@@ -16,15 +16,73 @@
 
 #include "ProfilingBlockDevice.h"
 #include "stddef.h"
+#include <string.h>
+#if DEVICE_USTICKER
+#include "hal/us_ticker_api.h"
+#endif
 
 namespace mbed {
 
 ProfilingBlockDevice::ProfilingBlockDevice(BlockDevice *bd)
     : _bd(bd)
-    , _read_count(0)
-    , _program_count(0)
-    , _erase_count(0)
+#if DEVICE_USTICKER
+    , _clock(us_ticker_read)
+#endif
 {
+    reset();
+}
+
+ProfilingBlockDevice::ProfilingBlockDevice(BlockDevice *bd, mbed::Callback<uint32_t()> clock)
+    : _bd(bd)
+    , _clock(clock)
+{
+    reset();
+}
+
+uint32_t ProfilingBlockDevice::now()
+{
+    uint32_t now_us = _clock ? _clock() : 0;
+
+    // Accumulated here, the 32-bit clock only has to not wrap between operations
+    _profile.elapsed_us += now_us - _last_us;
+    _last_us = now_us;
+    return now_us;
+}
+
+uint32_t ProfilingBlockDevice::begin(profile_op op, bd_size_t size)
+{
+    if (_hook) {
+        _hook(op, false, size);
+    }
+    return now();
+}
+
+int ProfilingBlockDevice::record(profile_op op, uint32_t start, bd_size_t size, int err)
+{
+    op_profile_t *p = &_profile.op[op];
+    uint32_t latency = now() - start;
+    int bucket = 0;
+
+    if (_hook) {
+        _hook(op, true, size);
+    }
+
+    if (err) {
+        p->errors++;
+        return err;
+    }
+
+    while ((latency >> (bucket + 1)) != 0 && bucket < MBED_PROFILING_BD_BUCKETS - 1) {
+        bucket++;
+    }
+    p->count++;
+    p->bytes += size;
+    p->total_us += latency;
+    p->histogram[bucket]++;
+    if (latency > p->max_us) {
+        p->max_us = latency;
+    }
+    return err;
 }
 
 int ProfilingBlockDevice::init()
@@ -39,34 +97,26 @@ int ProfilingBlockDevice::deinit()
 
 int ProfilingBlockDevice::sync()
 {
-    return _bd->sync();
+    uint32_t start = begin(PROFILE_SYNC, 0);
+    return record(PROFILE_SYNC, start, 0, _bd->sync());
 }
 
 int ProfilingBlockDevice::read(void *b, bd_addr_t addr, bd_size_t size)
 {
-    int err = _bd->read(b, addr, size);
-    if (!err) {
-        _read_count += size;
-    }
-    return err;
+    uint32_t start = begin(PROFILE_READ, size);
+    return record(PROFILE_READ, start, size, _bd->read(b, addr, size));
 }
 
 int ProfilingBlockDevice::program(const void *b, bd_addr_t addr, bd_size_t size)
 {
-    int err = _bd->program(b, addr, size);
-    if (!err) {
-        _program_count += size;
-    }
-    return err;
+    uint32_t start = begin(PROFILE_PROGRAM, size);
+    return record(PROFILE_PROGRAM, start, size, _bd->program(b, addr, size));
 }
 
 int ProfilingBlockDevice::erase(bd_addr_t addr, bd_size_t size)
 {
-    int err = _bd->erase(addr, size);
-    if (!err) {
-        _erase_count += size;
-    }
-    return err;
+    uint32_t start = begin(PROFILE_ERASE, size);
+    return record(PROFILE_ERASE, start, size, _bd->erase(addr, size));
 }
 
 bd_size_t ProfilingBlockDevice::get_read_size() const
@@ -101,24 +151,48 @@ bd_size_t ProfilingBlockDevice::size() const
 
 void ProfilingBlockDevice::reset()
 {
-    _read_count = 0;
-    _program_count = 0;
-    _erase_count = 0;
+    memset(&_profile, 0, sizeof(_profile));
+    _last_us = _clock ? _clock() : 0;
+}
+
+void ProfilingBlockDevice::snapshot(profile_t *profile)
+{
+    now();
+    *profile = _profile;
+}
+
+uint32_t ProfilingBlockDevice::get_max_latency(profile_op op) const
+{
+    return _profile.op[op].max_us;
+}
+
+void ProfilingBlockDevice::attach(mbed::Callback<void(profile_op, bool, bd_size_t)> func)
+{
+    _hook = func;
+}
+
+uint32_t ProfilingBlockDevice::get_ops_per_second(profile_op op)
+{
+    now();
+    if (_profile.elapsed_us == 0) {
+        return 0;
+    }
+    return (uint64_t)_profile.op[op].count * 1000000 / _profile.elapsed_us;
 }
 
 bd_size_t ProfilingBlockDevice::get_read_count() const
 {
-    return _read_count;
+    return _profile.op[PROFILE_READ].bytes;
 }
 
 bd_size_t ProfilingBlockDevice::get_program_count() const
 {
-    return _program_count;
+    return _profile.op[PROFILE_PROGRAM].bytes;
 }
 
 bd_size_t ProfilingBlockDevice::get_erase_count() const
 {
-    return _erase_count;
+    return _profile.op[PROFILE_ERASE].bytes;
 }
 
 const char *ProfilingBlockDevice::get_type() const
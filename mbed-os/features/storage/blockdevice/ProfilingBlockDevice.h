@@ -27,20 +27,68 @@
 #define MBED_PROFILING_BLOCK_DEVICE_H
 
 #include "BlockDevice.h"
+#include "platform/Callback.h"
+
+#ifndef MBED_PROFILING_BD_BUCKETS
+/** Number of latency histogram buckets, bucket n counts latencies in
+ *  [2^n, 2^(n+1)) us and the last one everything longer
+ */
+#define MBED_PROFILING_BD_BUCKETS 20
+#endif
 
 namespace mbed {
 
 
 /** Block device for measuring storage operations of another block device
+ *
+ *  Besides byte counts, every operation is timed with a microsecond clock
+ *  into a log2 latency histogram, so stalls of the underlying device can be
+ *  told apart from slow throughput.
  */
 class ProfilingBlockDevice : public BlockDevice {
 public:
+    /** Operations that are profiled */
+    enum profile_op {
+        PROFILE_READ = 0,
+        PROFILE_PROGRAM,
+        PROFILE_ERASE,
+        PROFILE_SYNC,
+        PROFILE_OPS
+    };
+
+    /** Profile of one kind of operation */
+    struct op_profile_t {
+        uint32_t count;                                 ///< Successful operations
+        uint32_t errors;                                ///< Failed operations
+        bd_size_t bytes;                                ///< Bytes read, programmed or erased
+        uint64_t total_us;                              ///< Sum of the latencies
+        uint32_t max_us;                                ///< Worst latency
+        uint32_t histogram[MBED_PROFILING_BD_BUCKETS];  ///< Latency histogram, see MBED_PROFILING_BD_BUCKETS
+    };
+
+    /** Profile of all the operations since the last reset */
+    struct profile_t {
+        op_profile_t op[PROFILE_OPS];                   ///< Indexed by profile_op
+        uint64_t elapsed_us;                            ///< Time since the last reset
+    };
+
     /** Lifetime of the memory block device
+     *
+     *  Operations are timed with the microsecond ticker when the target has
+     *  one, otherwise only counted.
      *
      *  @param bd       Block device to back the ProfilingBlockDevice
      */
     ProfilingBlockDevice(BlockDevice *bd);
 
+    /** Lifetime of the memory block device with a given clock
+     *
+     *  @param bd       Block device to back the ProfilingBlockDevice
+     *  @param clock    Microsecond clock, may wrap around at 32 bits.
+     *                  A virtual clock allows deterministic host profiling
+     */
+    ProfilingBlockDevice(BlockDevice *bd, mbed::Callback<uint32_t()> clock);
+
     /** Lifetime of a block device
      */
     virtual ~ProfilingBlockDevice() {};
@@ -141,10 +189,38 @@ public:
      */
     virtual bd_size_t size() const;
 
-    /** Reset the current profile counts to zero
+    /** Reset the current profile counts and histograms to zero
      */
     void reset();
 
+    /** Get a copy of the current profile
+     *
+     *  @param profile  Receives the counts, histograms and elapsed time
+     */
+    void snapshot(profile_t *profile);
+
+    /** Get the worst latency of an operation since the last reset
+     *
+     *  @param op       Operation type
+     *  @return         Latency in microseconds
+     */
+    uint32_t get_max_latency(profile_op op) const;
+
+    /** Get the average rate of an operation since the last reset
+     *
+     *  @param op       Operation type
+     *  @return         Successful operations per second
+     */
+    uint32_t get_ops_per_second(profile_op op);
+
+    /** Call a function at the start and at the end of every operation
+     *
+     *  @param func     Called with the operation, false at its start or true
+     *                  at its end, and its size in bytes. For tracing, it
+     *                  runs inside the operation and must be short
+     */
+    void attach(mbed::Callback<void(profile_op, bool, bd_size_t)> func);
+
     /** Get number of bytes that have been read from the block device
      *
      *  @return The number of bytes that have been read from the block device
@@ -170,10 +246,15 @@ public:
     virtual const char *get_type() const;
 
 private:
+    uint32_t now();
+    uint32_t begin(profile_op op, bd_size_t size);
+    int record(profile_op op, uint32_t start, bd_size_t size, int err);
+
     BlockDevice *_bd;
-    bd_size_t _read_count;
-    bd_size_t _program_count;
-    bd_size_t _erase_count;
+    mbed::Callback<uint32_t()> _clock;
+    mbed::Callback<void(profile_op, bool, bd_size_t)> _hook;
+    uint32_t _last_us;
+    profile_t _profile;
 };
 
 } // namespace mbed
@@ -0,0 +1,181 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2019 Mangue Baja Team, UFPE
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SDTimingBlockDevice.h"
+#include <stddef.h>
+
+namespace mbed {
+
+// Start token and CRC sent with each sector
+static const bd_size_t sector_overhead = 3;
+static const bd_size_t sector_size = 512;
+
+SDTimingBlockDevice::SDTimingBlockDevice(BlockDevice *bd, const timing_t &timing)
+    : _bd(bd)
+    , _timing(timing)
+    , _now_us(0)
+    , _gc_bytes(0)
+    , _gc_count(0)
+    , _spike_count(0)
+    , _stall_us(0)
+    , _random(timing.seed ? timing.seed : 1)
+{
+}
+
+int SDTimingBlockDevice::init()
+{
+    return _bd->init();
+}
+
+int SDTimingBlockDevice::deinit()
+{
+    return _bd->deinit();
+}
+
+int SDTimingBlockDevice::sync()
+{
+    return _bd->sync();
+}
+
+int SDTimingBlockDevice::read(void *b, bd_addr_t addr, bd_size_t size)
+{
+    bd_size_t sectors = (size + sector_size - 1) / sector_size;
+
+    _now_us += _timing.cmd_us + sectors * _timing.read_access_us + transfer_us(size);
+    return _bd->read(b, addr, size);
+}
+
+int SDTimingBlockDevice::program(const void *b, bd_addr_t addr, bd_size_t size)
+{
+    bd_size_t sectors = (size + sector_size - 1) / sector_size;
+
+    _now_us += _timing.cmd_us + _timing.program_cmd_busy_us + sectors * _timing.program_busy_us +
+               transfer_us(size);
+
+    if (_timing.gc_interval) {
+        _gc_bytes += size;
+        while (_gc_bytes >= _timing.gc_interval) {
+            _gc_bytes -= _timing.gc_interval;
+            _gc_count++;
+            _now_us += _timing.gc_stall_us;
+            _stall_us += _timing.gc_stall_us;
+        }
+    }
+
+    if (_timing.spike_chance && (random() & 0xFFFF) < _timing.spike_chance) {
+        uint32_t spike = _timing.spike_min_us;
+        if (_timing.spike_max_us > _timing.spike_min_us) {
+            spike += random() % (_timing.spike_max_us - _timing.spike_min_us + 1);
+        }
+        _spike_count++;
+        _now_us += spike;
+        _stall_us += spike;
+    }
+
+    return _bd->program(b, addr, size);
+}
+
+int SDTimingBlockDevice::erase(bd_addr_t addr, bd_size_t size)
+{
+    return _bd->erase(addr, size);
+}
+
+bd_size_t SDTimingBlockDevice::get_read_size() const
+{
+    return _bd->get_read_size();
+}
+
+bd_size_t SDTimingBlockDevice::get_program_size() const
+{
+    return _bd->get_program_size();
+}
+
+bd_size_t SDTimingBlockDevice::get_erase_size() const
+{
+    return _bd->get_erase_size();
+}
+
+bd_size_t SDTimingBlockDevice::get_erase_size(bd_addr_t addr) const
+{
+    return _bd->get_erase_size(addr);
+}
+
+int SDTimingBlockDevice::get_erase_value() const
+{
+    return _bd->get_erase_value();
+}
+
+bd_size_t SDTimingBlockDevice::size() const
+{
+    return _bd->size();
+}
+
+const char *SDTimingBlockDevice::get_type() const
+{
+    if (_bd != NULL) {
+        return _bd->get_type();
+    }
+
+    return NULL;
+}
+
+uint64_t SDTimingBlockDevice::now() const
+{
+    return _now_us;
+}
+
+uint32_t SDTimingBlockDevice::clock()
+{
+    return (uint32_t)_now_us;
+}
+
+void SDTimingBlockDevice::advance(uint32_t us)
+{
+    _now_us += us;
+}
+
+uint32_t SDTimingBlockDevice::get_gc_count() const
+{
+    return _gc_count;
+}
+
+uint32_t SDTimingBlockDevice::get_spike_count() const
+{
+    return _spike_count;
+}
+
+uint64_t SDTimingBlockDevice::get_stall_time() const
+{
+    return _stall_us;
+}
+
+uint64_t SDTimingBlockDevice::transfer_us(bd_size_t size) const
+{
+    bd_size_t sectors = (size + sector_size - 1) / sector_size;
+
+    return (uint64_t)(size + sectors * sector_overhead) * 8 * 1000000 / _timing.spi_hz;
+}
+
+uint32_t SDTimingBlockDevice::random()
+{
+    // xorshift32, same sequence on every platform
+    _random ^= _random << 13;
+    _random ^= _random >> 17;
+    _random ^= _random << 5;
+    return _random;
+}
+
+} // namespace mbed
@@ -0,0 +1,234 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2019 Mangue Baja Team, UFPE
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** \addtogroup storage */
+/** @{*/
+
+#ifndef MBED_SD_TIMING_BLOCK_DEVICE_H
+#define MBED_SD_TIMING_BLOCK_DEVICE_H
+
+#include "BlockDevice.h"
+
+namespace mbed {
+
+/** SD card timing simulating block device
+ *
+ *  Decorator for another block device (usually a HeapBlockDevice) that keeps
+ *  a virtual clock advanced by what each operation would take on an SD card
+ *  in SPI mode:
+ *  - every command pays a fixed overhead, one command per call, so a
+ *    multi-sector read or program is a single CMD18/CMD25 transfer
+ *  - data moves at the SPI clock, with the token and CRC of each sector
+ *  - reads wait an access time and programs a busy time per sector, plus
+ *    one per program command (the card committing the write)
+ *  - every gc_interval programmed bytes the card stalls for gc_stall_us,
+ *    like the internal garbage collection of real cards
+ *  - programs may also hit a random busy spike, from a seeded generator
+ *
+ *  Data is stored unchanged in the underlying device. Runs are deterministic
+ *  for a given timing, seed and workload, so storage changes can be
+ *  benchmarked and regression-tested on a host.
+ */
+class SDTimingBlockDevice : public BlockDevice {
+public:
+    /** Timing parameters, the defaults are a typical card on a 1 MHz bus */
+    struct timing_t {
+        uint32_t spi_hz;                ///< SPI clock
+        uint32_t cmd_us;                ///< Command, response and token wait, per call
+        uint32_t read_access_us;        ///< Access time per sector read
+        uint32_t program_busy_us;       ///< Busy time per sector programmed
+        uint32_t program_cmd_busy_us;   ///< Busy time per program command
+        uint32_t gc_interval;           ///< Programmed bytes between GC stalls, 0 for none
+        uint32_t gc_stall_us;           ///< Length of a GC stall
+        uint32_t spike_chance;          ///< Chance of a busy spike per program, in 1/65536
+        uint32_t spike_min_us;          ///< Shortest busy spike
+        uint32_t spike_max_us;          ///< Longest busy spike
+        uint32_t seed;                  ///< Seed of the spike generator
+
+        timing_t()
+            : spi_hz(1000000), cmd_us(100), read_access_us(100), program_busy_us(250),
+              program_cmd_busy_us(500), gc_interval(0), gc_stall_us(0), spike_chance(0), spike_min_us(0),
+              spike_max_us(0), seed(1)
+        {
+        }
+    };
+
+    /** Lifetime of the block device
+     *
+     *  @param bd       Block device that stores the data
+     *  @param timing   Timing parameters
+     */
+    SDTimingBlockDevice(BlockDevice *bd, const timing_t &timing = timing_t());
+    virtual ~SDTimingBlockDevice() {};
+
+    /** Initialize a block device
+     *
+     *  @return         0 on success or a negative error code on failure
+     *  @note Init and deinit take no virtual time
+     */
+    virtual int init();
+
+    /** Deinitialize a block device
+     *
+     *  @return         0 on success or a negative error code on failure
+     */
+    virtual int deinit();
+
+    /** Ensure data on storage is in sync with the driver
+     *
+     *  @return         0 on success or a negative error code on failure
+     */
+    virtual int sync();
+
+    /** Read blocks from a block device
+     *
+     *  @param buffer   Buffer to read blocks into
+     *  @param addr     Address of block to begin reading from
+     *  @param size     Size to read in bytes, must be a multiple of read block size
+     *  @return         0 on success or a negative error code on failure
+     */
+    virtual int read(void *buffer, bd_addr_t addr, bd_size_t size);
+
+    /** Program blocks to a block device
+     *
+     *  @param buffer   Buffer of data to write to blocks
+     *  @param addr     Address of block to begin writing to
+     *  @param size     Size to write in bytes, must be a multiple of program block size
+     *  @return         0 on success or a negative error code on failure
+     */
+    virtual int program(const void *buffer, bd_addr_t addr, bd_size_t size);
+
+    /** Erase blocks on a block device
+     *
+     *  @param addr     Address of block to begin erasing
+     *  @param size     Size to erase in bytes, must be a multiple of erase block size
+     *  @return         0 on success or a negative error code on failure
+     *  @note Takes no virtual time, erase is a no-op in SDBlockDevice
+     */
+    virtual int erase(bd_addr_t addr, bd_size_t size);
+
+    /** Get the size of a readable block
+     *
+     *  @return         Size of a readable block in bytes
+     */
+    virtual bd_size_t get_read_size() const;
+
+    /** Get the size of a programmable block
+     *
+     *  @return         Size of a programmable block in bytes
+     */
+    virtual bd_size_t get_program_size() const;
+
+    /** Get the size of an erasable block
+     *
+     *  @return         Size of an erasable block in bytes
+     */
+    virtual bd_size_t get_erase_size() const;
+
+    /** Get the size of an erasable block given address
+     *
+     *  @param addr     Address within the erasable block
+     *  @return         Size of an erasable block in bytes
+     */
+    virtual bd_size_t get_erase_size(bd_addr_t addr) const;
+
+    /** Get the value of storage when erased
+     *
+     *  @return         The value of storage when erased, or -1 if you can't
+     *                  rely on the value of erased storage
+     */
+    virtual int get_erase_value() const;
+
+    /** Get the total size of the underlying device
+     *
+     *  @return         Size of the underlying device in bytes
+     */
+    virtual bd_size_t size() const;
+
+    /** Get the BlockDevice class type.
+     *
+     *  @return         A string represent the BlockDevice class type.
+     */
+    virtual const char *get_type() const;
+
+    /** Get the virtual time
+     *
+     *  @return         Microseconds since construction
+     */
+    uint64_t now() const;
+
+    /** Get the virtual time as a 32-bit microsecond clock
+     *
+     *  Can be given to a ProfilingBlockDevice stacked on top.
+     *
+     *  @return         Microseconds since construction, wrapping around
+     */
+    uint32_t clock();
+
+    /** Let virtual time pass without card activity
+     *
+     *  @param us       Microseconds of idle time
+     */
+    void advance(uint32_t us);
+
+    /** Get the number of GC stalls so far
+     *
+     *  @return         Number of GC stalls
+     */
+    uint32_t get_gc_count() const;
+
+    /** Get the number of busy spikes so far
+     *
+     *  @return         Number of busy spikes
+     */
+    uint32_t get_spike_count() const;
+
+    /** Get the virtual time lost to GC stalls and busy spikes
+     *
+     *  @return         Microseconds
+     */
+    uint64_t get_stall_time() const;
+
+private:
+    uint64_t transfer_us(bd_size_t size) const;
+    uint32_t random();
+
+    BlockDevice *_bd;
+    timing_t _timing;
+    uint64_t _now_us;
+    uint32_t _gc_bytes;
+    uint32_t _gc_count;
+    uint32_t _spike_count;
+    uint64_t _stall_us;
+    uint32_t _random;
+};
+
+} // namespace mbed
+
+// Added "using" for backwards compatibility
+#ifndef MBED_NO_GLOBAL_USING_DIRECTIVE
+using mbed::SDTimingBlockDevice;
+#endif
+
+#endif
+
+/** @}*/
@@ -18,6 +18,11 @@
 #include "filesystem/File.h"
 #include "filesystem/FileSystem.h"
 #include <errno.h>
+#if MBED_CONF_FILESYSTEM_HANDLE_POOL
+#include "platform/mbed_assert.h"
+#include "platform/PlatformMutex.h"
+#include "platform/SingletonPtr.h"
+#endif
 
 namespace mbed {
 
@@ -150,11 +155,74 @@ public:
         delete this;
         return err;
     }
+
+#if MBED_CONF_FILESYSTEM_HANDLE_POOL
+    static void *operator new(size_t size) throw();
+    static void operator delete(void *p);
+#endif
+};
+
+#if MBED_CONF_FILESYSTEM_HANDLE_POOL
+// Open files and directories share a static pool instead of the heap,
+// new gives NULL when all MBED_CONF_FILESYSTEM_HANDLE_POOL are open
+union handle_t {
+    char file[sizeof(Managed<File>)];
+    char dir[sizeof(Managed<Dir>)];
+    void *align;
+    uint64_t align64;
 };
 
+static handle_t _handles[MBED_CONF_FILESYSTEM_HANDLE_POOL];
+static bool _handle_used[MBED_CONF_FILESYSTEM_HANDLE_POOL];
+static SingletonPtr<PlatformMutex> _handle_mutex;
+
+static void *handle_alloc(size_t size)
+{
+    void *p = NULL;
+
+    MBED_ASSERT(size <= sizeof(handle_t));
+    _handle_mutex->lock();
+    for (int i = 0; i < MBED_CONF_FILESYSTEM_HANDLE_POOL; i++) {
+        if (!_handle_used[i]) {
+            _handle_used[i] = true;
+            p = &_handles[i];
+            break;
+        }
+    }
+    _handle_mutex->unlock();
+    return p;
+}
+
+static void handle_free(void *p)
+{
+    _handle_mutex->lock();
+    for (int i = 0; i < MBED_CONF_FILESYSTEM_HANDLE_POOL; i++) {
+        if (p == &_handles[i]) {
+            _handle_used[i] = false;
+        }
+    }
+    _handle_mutex->unlock();
+}
+
+template <typename F>
+void *Managed<F>::operator new(size_t size) throw()
+{
+    return handle_alloc(size);
+}
+
+template <typename F>
+void Managed<F>::operator delete(void *p)
+{
+    handle_free(p);
+}
+#endif
+
 int FileSystem::open(FileHandle **file, const char *path, int flags)
 {
     File *f = new Managed<File>;
+    if (!f) {
+        return -ENOMEM;
+    }
     int err = f->open(this, path, flags);
     if (err) {
         delete f;
@@ -168,6 +236,9 @@ int FileSystem::open(FileHandle **file, const char *path, int flags)
 int FileSystem::open(DirHandle **dir, const char *path)
 {
     Dir *d = new Managed<Dir>;
+    if (!d) {
+        return -ENOMEM;
+    }
     int err = d->open(this, path);
     if (err) {
         delete d;
@@ -232,6 +232,19 @@
 #endif
 
 
+/* File data path: the common window of the volume or a private buffer of the file */
+#if !FF_FS_TINY
+#define WIN_FILE(fp)	0				/* Every file has its private buffer */
+#define FILE_BUF(fp)	((fp)->buf)
+#elif FF_FS_FILEBUF
+#define WIN_FILE(fp)	(!(fp)->buf)	/* Files not given a buffer by f_setbuf() use win[] */
+#define FILE_BUF(fp)	((fp)->buf)
+#else
+#define WIN_FILE(fp)	1				/* Every file uses win[] */
+#define FILE_BUF(fp)	((BYTE*)0)
+#endif
+
+
 /* Timestamp */
 #if FF_FS_NORTC == 1
 #if FF_NORTC_YEAR < 1980 || FF_NORTC_YEAR > 2107 || FF_NORTC_MON < 1 || FF_NORTC_MON > 12 || FF_NORTC_MDAY < 1 || FF_NORTC_MDAY > 31
@@ -3708,6 +3721,8 @@ FRESULT f_open (
 				return FR_NOT_ENOUGH_CORE;
 #endif
 			mem_set(fp->buf, 0, FF_MAX_SS);	/* Clear sector buffer */
+#elif FF_FS_FILEBUF
+			fp->buf = 0;			/* File data goes through win[] until f_setbuf() */
 #endif
 			if ((mode & FA_SEEKEND) && fp->obj.objsize > 0) {	/* Seek to end of file if FA_OPEN_APPEND is specified */
 				fp->fptr = fp->obj.objsize;			/* Offset to seek */
@@ -3801,40 +3816,38 @@ FRESULT f_read (
 				}
 				if (disk_read(fs->pdrv, rbuff, sect, cc) != RES_OK) ABORT(fs, FR_DISK_ERR);
 #if !FF_FS_READONLY && FF_FS_MINIMIZE <= 2		/* Replace one of the read sectors with cached data if it contains a dirty sector */
-#if FF_FS_TINY
-				if (fs->wflag && fs->winsect - sect < cc) {
-					mem_cpy(rbuff + ((fs->winsect - sect) * SS(fs)), fs->win, SS(fs));
-				}
-#else
-				if ((fp->flag & FA_DIRTY) && fp->sect - sect < cc) {
-					mem_cpy(rbuff + ((fp->sect - sect) * SS(fs)), fp->buf, SS(fs));
+				if (WIN_FILE(fp)) {
+					if (fs->wflag && fs->winsect - sect < cc) {
+						mem_cpy(rbuff + ((fs->winsect - sect) * SS(fs)), fs->win, SS(fs));
+					}
+				} else {
+					if ((fp->flag & FA_DIRTY) && fp->sect - sect < cc) {
+						mem_cpy(rbuff + ((fp->sect - sect) * SS(fs)), FILE_BUF(fp), SS(fs));
+					}
 				}
-#endif
 #endif
 				rcnt = SS(fs) * cc;				/* Number of bytes transferred */
 				continue;
 			}
-#if !FF_FS_TINY
-			if (fp->sect != sect) {			/* Load data sector if not in cache */
+			if (!WIN_FILE(fp) && fp->sect != sect) {	/* Load data sector if not in cache */
 #if !FF_FS_READONLY
 				if (fp->flag & FA_DIRTY) {		/* Write-back dirty sector cache */
-					if (disk_write(fs->pdrv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
+					if (disk_write(fs->pdrv, FILE_BUF(fp), fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
 					fp->flag &= (BYTE)~FA_DIRTY;
 				}
 #endif
-				if (disk_read(fs->pdrv, fp->buf, sect, 1) != RES_OK)	ABORT(fs, FR_DISK_ERR);	/* Fill sector cache */
+				if (disk_read(fs->pdrv, FILE_BUF(fp), sect, 1) != RES_OK)	ABORT(fs, FR_DISK_ERR);	/* Fill sector cache */
 			}
-#endif
 			fp->sect = sect;
 		}
 		rcnt = SS(fs) - (UINT)fp->fptr % SS(fs);	/* Number of bytes left in the sector */
 		if (rcnt > btr) rcnt = btr;					/* Clip it by btr if needed */
-#if FF_FS_TINY
-		if (move_window(fs, fp->sect) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Move sector window */
-		mem_cpy(rbuff, fs->win + fp->fptr % SS(fs), rcnt);	/* Extract partial sector */
-#else
-		mem_cpy(rbuff, fp->buf + fp->fptr % SS(fs), rcnt);	/* Extract partial sector */
-#endif
+		if (WIN_FILE(fp)) {
+			if (move_window(fs, fp->sect) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Move sector window */
+			mem_cpy(rbuff, fs->win + fp->fptr % SS(fs), rcnt);	/* Extract partial sector */
+		} else {
+			mem_cpy(rbuff, FILE_BUF(fp) + fp->fptr % SS(fs), rcnt);	/* Extract partial sector */
+		}
 	}
 
 	LEAVE_FF(fs, FR_OK);
@@ -3904,14 +3917,12 @@ FRESULT f_write (
                 }
 #endif
 			}
-#if FF_FS_TINY
-			if (fs->winsect == fp->sect && sync_window(fs) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Write-back sector cache */
-#else
-			if (fp->flag & FA_DIRTY) {		/* Write-back sector cache */
-				if (disk_write(fs->pdrv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
+			if (WIN_FILE(fp)) {
+				if (fs->winsect == fp->sect && sync_window(fs) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Write-back sector cache */
+			} else if (fp->flag & FA_DIRTY) {	/* Write-back sector cache */
+				if (disk_write(fs->pdrv, FILE_BUF(fp), fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
 				fp->flag &= (BYTE)~FA_DIRTY;
 			}
-#endif
 			sect = clst2sect(fs, fp->clust);	/* Get current sector */
 			if (sect == 0) ABORT(fs, FR_INT_ERR);
 			sect += csect;
@@ -3922,17 +3933,17 @@ FRESULT f_write (
 				}
 				if (disk_write(fs->pdrv, wbuff, sect, cc) != RES_OK) ABORT(fs, FR_DISK_ERR);
 #if FF_FS_MINIMIZE <= 2
-#if FF_FS_TINY
-				if (fs->winsect - sect < cc) {	/* Refill sector cache if it gets invalidated by the direct write */
-					mem_cpy(fs->win, wbuff + ((fs->winsect - sect) * SS(fs)), SS(fs));
-					fs->wflag = 0;
-				}
-#else
-				if (fp->sect - sect < cc) { /* Refill sector cache if it gets invalidated by the direct write */
-					mem_cpy(fp->buf, wbuff + ((fp->sect - sect) * SS(fs)), SS(fs));
-					fp->flag &= (BYTE)~FA_DIRTY;
+				if (WIN_FILE(fp)) {
+					if (fs->winsect - sect < cc) {	/* Refill sector cache if it gets invalidated by the direct write */
+						mem_cpy(fs->win, wbuff + ((fs->winsect - sect) * SS(fs)), SS(fs));
+						fs->wflag = 0;
+					}
+				} else {
+					if (fp->sect - sect < cc) { /* Refill sector cache if it gets invalidated by the direct write */
+						mem_cpy(FILE_BUF(fp), wbuff + ((fp->sect - sect) * SS(fs)), SS(fs));
+						fp->flag &= (BYTE)~FA_DIRTY;
+					}
 				}
-#endif
 #endif
 				wcnt = SS(fs) * cc;		/* Number of bytes transferred */
 #if FLUSH_ON_NEW_SECTOR
@@ -3940,30 +3951,28 @@ FRESULT f_write (
 #endif
 				continue;
 			}
-#if FF_FS_TINY
-			if (fp->fptr >= fp->obj.objsize) {	/* Avoid silly cache filling on the growing edge */
-				if (sync_window(fs) != FR_OK) ABORT(fs, FR_DISK_ERR);
-				fs->winsect = sect;
-			}
-#else
-			if (fp->sect != sect && 		/* Fill sector cache with file data */
+			if (WIN_FILE(fp)) {
+				if (fp->fptr >= fp->obj.objsize) {	/* Avoid silly cache filling on the growing edge */
+					if (sync_window(fs) != FR_OK) ABORT(fs, FR_DISK_ERR);
+					fs->winsect = sect;
+				}
+			} else if (fp->sect != sect && 		/* Fill sector cache with file data */
 				fp->fptr < fp->obj.objsize &&
-				disk_read(fs->pdrv, fp->buf, sect, 1) != RES_OK) {
+				disk_read(fs->pdrv, FILE_BUF(fp), sect, 1) != RES_OK) {
 					ABORT(fs, FR_DISK_ERR);
 			}
-#endif
 			fp->sect = sect;
 		}
 		wcnt = SS(fs) - (UINT)fp->fptr % SS(fs);	/* Number of bytes left in the sector */
 		if (wcnt > btw) wcnt = btw;					/* Clip it by btw if needed */
-#if FF_FS_TINY
-		if (move_window(fs, fp->sect) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Move sector window */
-		mem_cpy(fs->win + fp->fptr % SS(fs), wbuff, wcnt);	/* Fit data to the sector */
-		fs->wflag = 1;
-#else
-		mem_cpy(fp->buf + fp->fptr % SS(fs), wbuff, wcnt);	/* Fit data to the sector */
-		fp->flag |= FA_DIRTY;
-#endif
+		if (WIN_FILE(fp)) {
+			if (move_window(fs, fp->sect) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Move sector window */
+			mem_cpy(fs->win + fp->fptr % SS(fs), wbuff, wcnt);	/* Fit data to the sector */
+			fs->wflag = 1;
+		} else {
+			mem_cpy(FILE_BUF(fp) + fp->fptr % SS(fs), wbuff, wcnt);	/* Fit data to the sector */
+			fp->flag |= FA_DIRTY;
+		}
 	}
 
 	fp->flag |= FA_MODIFIED;				/* Set file change flag */
@@ -3995,12 +4004,10 @@ FRESULT f_sync (
 	res = validate(&fp->obj, &fs);	/* Check validity of the file object */
 	if (res == FR_OK) {
 		if (fp->flag & FA_MODIFIED) {	/* Is there any change to the file? */
-#if !FF_FS_TINY
-			if (fp->flag & FA_DIRTY) {	/* Write-back cached data if needed */
-				if (disk_write(fs->pdrv, fp->buf, fp->sect, 1) != RES_OK) LEAVE_FF(fs, FR_DISK_ERR);
+			if (!WIN_FILE(fp) && (fp->flag & FA_DIRTY)) {	/* Write-back cached data if needed */
+				if (disk_write(fs->pdrv, FILE_BUF(fp), fp->sect, 1) != RES_OK) LEAVE_FF(fs, FR_DISK_ERR);
 				fp->flag &= (BYTE)~FA_DIRTY;
 			}
-#endif
 			/* Update the directory entry */
 			tm = GET_FATTIME();				/* Modified time */
 #if FF_FS_EXFAT
@@ -4097,6 +4104,48 @@ FRESULT f_close (
 
 
 
+#if FF_FS_TINY && FF_FS_FILEBUF
+/*-----------------------------------------------------------------------*/
+/* Give/Take Back a Private Sector Buffer                                */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_setbuf (
+	FIL* fp,	/* Pointer to the file object */
+	BYTE* buf	/* Sector buffer of SS bytes to use from now on (null: use win[] again) */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+
+
+	res = validate(&fp->obj, &fs);		/* Check validity of the file object */
+	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);
+	if (buf == fp->buf) LEAVE_FF(fs, FR_OK);
+
+#if !FF_FS_READONLY
+	if (fp->buf && (fp->flag & FA_DIRTY)) {	/* Write-back the private buffer */
+		if (disk_write(fs->pdrv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
+		fp->flag &= (BYTE)~FA_DIRTY;
+	}
+	if (sync_window(fs) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Write-back the window, it may hold file data */
+#endif
+	if (buf && fp->fptr % SS(fs)) {		/* Load the current sector into the new buffer */
+		if (fs->winsect == fp->sect) {
+			mem_cpy(buf, fs->win, SS(fs));
+		} else if (disk_read(fs->pdrv, buf, fp->sect, 1) != RES_OK) {
+			ABORT(fs, FR_DISK_ERR);
+		}
+	}
+	fs->winsect = 0xFFFFFFFF;			/* Invalidate the window: a copy of the file data in it may go stale */
+	fp->buf = buf;
+
+	LEAVE_FF(fs, FR_OK);
+}
+#endif
+
+
+
+
 #if FF_FS_RPATH >= 1
 /*-----------------------------------------------------------------------*/
 /* Change Current Directory or Current Drive, Get Current Directory      */
@@ -4311,15 +4360,15 @@ FRESULT f_lseek (
 				if (dsc == 0) ABORT(fs, FR_INT_ERR);
 				dsc += (DWORD)((ofs - 1) / SS(fs)) & (fs->csize - 1);
 				if (fp->fptr % SS(fs) && dsc != fp->sect) {	/* Refill sector cache if needed */
-#if !FF_FS_TINY
+					if (!WIN_FILE(fp)) {
 #if !FF_FS_READONLY
-					if (fp->flag & FA_DIRTY) {		/* Write-back dirty sector cache */
-						if (disk_write(fs->pdrv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
-						fp->flag &= (BYTE)~FA_DIRTY;
-					}
-#endif
-					if (disk_read(fs->pdrv, fp->buf, dsc, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);	/* Load current sector */
+						if (fp->flag & FA_DIRTY) {		/* Write-back dirty sector cache */
+							if (disk_write(fs->pdrv, FILE_BUF(fp), fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
+							fp->flag &= (BYTE)~FA_DIRTY;
+						}
 #endif
+						if (disk_read(fs->pdrv, FILE_BUF(fp), dsc, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);	/* Load current sector */
+					}
 					fp->sect = dsc;
 				}
 			}
@@ -4391,15 +4440,15 @@ FRESULT f_lseek (
 			fp->flag |= FA_MODIFIED;
 		}
 		if (fp->fptr % SS(fs) && nsect != fp->sect) {	/* Fill sector cache if needed */
-#if !FF_FS_TINY
+			if (!WIN_FILE(fp)) {
 #if !FF_FS_READONLY
-			if (fp->flag & FA_DIRTY) {			/* Write-back dirty sector cache */
-				if (disk_write(fs->pdrv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
-				fp->flag &= (BYTE)~FA_DIRTY;
-			}
-#endif
-			if (disk_read(fs->pdrv, fp->buf, nsect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);	/* Fill sector cache */
+				if (fp->flag & FA_DIRTY) {			/* Write-back dirty sector cache */
+					if (disk_write(fs->pdrv, FILE_BUF(fp), fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
+					fp->flag &= (BYTE)~FA_DIRTY;
+				}
 #endif
+				if (disk_read(fs->pdrv, FILE_BUF(fp), nsect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);	/* Fill sector cache */
+			}
 			fp->sect = nsect;
 		}
 	}
@@ -4750,15 +4799,13 @@ FRESULT f_truncate (
 		}
 		fp->obj.objsize = fp->fptr;	/* Set file size to current read/write point */
 		fp->flag |= FA_MODIFIED;
-#if !FF_FS_TINY
-		if (res == FR_OK && (fp->flag & FA_DIRTY)) {
-			if (disk_write(fs->pdrv, fp->buf, fp->sect, 1) != RES_OK) {
+		if (res == FR_OK && !WIN_FILE(fp) && (fp->flag & FA_DIRTY)) {
+			if (disk_write(fs->pdrv, FILE_BUF(fp), fp->sect, 1) != RES_OK) {
 				res = FR_DISK_ERR;
 			} else {
 				fp->flag &= (BYTE)~FA_DIRTY;
 			}
 		}
-#endif
 		if (res != FR_OK) ABORT(fs, res);
 	}
 
@@ -5501,21 +5548,21 @@ FRESULT f_forward (
 		sect = clst2sect(fs, fp->clust);			/* Get current data sector */
 		if (sect == 0) ABORT(fs, FR_INT_ERR);
 		sect += csect;
-#if FF_FS_TINY
-		if (move_window(fs, sect) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Move sector window to the file data */
-		dbuf = fs->win;
-#else
-		if (fp->sect != sect) {		/* Fill sector cache with file data */
+		if (WIN_FILE(fp)) {
+			if (move_window(fs, sect) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Move sector window to the file data */
+			dbuf = fs->win;
+		} else {
+			if (fp->sect != sect) {		/* Fill sector cache with file data */
 #if !FF_FS_READONLY
-			if (fp->flag & FA_DIRTY) {		/* Write-back dirty sector cache */
-				if (disk_write(fs->pdrv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
-				fp->flag &= (BYTE)~FA_DIRTY;
-			}
+				if (fp->flag & FA_DIRTY) {		/* Write-back dirty sector cache */
+					if (disk_write(fs->pdrv, FILE_BUF(fp), fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
+					fp->flag &= (BYTE)~FA_DIRTY;
+				}
 #endif
-			if (disk_read(fs->pdrv, fp->buf, sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
+				if (disk_read(fs->pdrv, FILE_BUF(fp), sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
+			}
+			dbuf = FILE_BUF(fp);
 		}
-		dbuf = fp->buf;
-#endif
 		fp->sect = sect;
 		rcnt = SS(fs) - (UINT)fp->fptr % SS(fs);	/* Number of bytes left in the sector */
 		if (rcnt > btf) rcnt = btf;					/* Clip it by btr if needed */
@@ -5825,13 +5872,11 @@ FRESULT f_mkfs (
 			b_fat = b_vol + sz_rsv;						/* FAT base */
 			b_data = b_fat + sz_fat * n_fats + sz_dir;	/* Data base */
 
-			/* Align data base to erase block boundary (for flash memory media) */
+			/* Align FAT base and data base to erase block boundary (for flash memory media) */
+			n = ((b_fat + sz_blk - 1) & ~(sz_blk - 1)) - b_fat;	/* Next nearest erase block from current FAT base */
+			sz_rsv += n; b_fat += n; b_data += n;			/* Expand reserved area */
 			n = ((b_data + sz_blk - 1) & ~(sz_blk - 1)) - b_data;	/* Next nearest erase block from current data base */
-			if (fmt == FS_FAT32) {		/* FAT32: Move FAT base */
-				sz_rsv += n; b_fat += n;
-			} else {					/* FAT: Expand FAT size */
-				sz_fat += n / n_fats;
-			}
+			sz_fat += n / n_fats;							/* Expand FAT size */
 
 			/* Determine number of clusters and final check of validity of the FAT sub-type */
 			if (sz_vol < b_data + pau * 16 - b_vol) LEAVE_MKFS(FR_MKFS_ABORTED);	/* Too small volume */
@@ -226,6 +226,15 @@
 /  buffer in the filesystem object (FATFS) is used for the file data transfer. */
 
 
+#define FF_FS_FILEBUF	3
+/* At the tiny configuration, this option lets selected files keep a private
+/  sector buffer anyway (0:Disable or >=1:Enable). A file given a buffer with
+/  f_setbuf() transfers its data through it, like at the normal configuration,
+/  and no longer evicts the common buffer used by the other files, the FAT and
+/  the directory. FATFileSystem takes the buffers from a static pool of
+/  FF_FS_FILEBUF buffers of FF_MIN_SS bytes. */
+
+
 #define FF_FS_EXFAT		0
 /* This option switches support for exFAT filesystem. (0:Disable or 1:Enable)
 /  When enable exFAT, also LFN needs to be enabled.
@@ -239,6 +248,14 @@
 /  This option allows the filesystem to dynamically allocate the buffers based
 /  on underlying sector size. */
 
+#define FF_FS_MEMPOOL	3
+/* With FF_FS_HEAPBUF or FF_USE_LFN == 3, this option takes the memory blocks of
+/  ff_memalloc() from a static pool of FF_FS_MEMPOOL blocks of FF_MIN_SS bytes
+/  instead of the heap (0:Heap or >=1:Pool). Each mounted volume holds one for
+/  its window, the LFN working buffer one during each API call, and f_mkfs()
+/  one. Larger requests fail: f_mkfs() and the directory clear then work a
+/  sector at a time, and volumes with sectors over FF_MIN_SS can't be mounted. */
+
 
 #define FF_FS_NORTC		0
 #define FF_NORTC_MON	1
@@ -288,13 +305,15 @@
 
 /* #include <windows.h>	// O/S definitions  */
 
-#define FLUSH_ON_NEW_CLUSTER    0   /* Sync the file on every new cluster */
-#define FLUSH_ON_NEW_SECTOR     1   /* Sync the file on every new sector */
+#define FLUSH_ON_NEW_CLUSTER    1   /* Sync the file on every new cluster */
+#define FLUSH_ON_NEW_SECTOR     0   /* Sync the file on every new sector */
 /* Only one of these two defines needs to be set to 1. If both are set to 0
    the file is only sync when closed.
    Clusters are group of sectors (eg: 8 sectors). Flushing on new cluster means
    it would be less often than flushing on new sector. Sectors are generally
-   512 Bytes long. */
+   512 Bytes long.
+   Per cluster here: a sync rewrites the FAT and directory sectors, once per
+   sector that took most of the card time of a log run. */
 
 
 /*--- End of configuration options ---*/
@@ -28,6 +28,7 @@
 
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 
 namespace mbed {
 
@@ -143,6 +144,62 @@ static Deferred<const char *> fat_path_prefix(int id, const char *path)
 static mbed::BlockDevice *_ffs[FF_VOLUMES] = {0};
 static SingletonPtr<PlatformMutex> _ffs_mutex;
 
+// Erase block of the drive being formatted, in bytes (see FATFileSystem::format)
+static bd_size_t _ffs_align[FF_VOLUMES] = {0};
+
+#if FF_FS_TINY && FF_FS_FILEBUF
+// Private sector buffers of selected files (see set_private_buffers)
+static BYTE _filebuf[FF_FS_FILEBUF][FF_MIN_SS];
+static FIL *_filebuf_owner[FF_FS_FILEBUF] = {0};
+#if FF_MAX_SS == FF_MIN_SS
+#define FILEBUF_FITS(fs) true
+#else
+#define FILEBUF_FITS(fs) ((fs).ssize <= FF_MIN_SS)
+#endif
+#endif
+
+#if FF_FS_MEMPOOL
+// Blocks of ff_memalloc (windows, LFN and f_mkfs working buffers)
+static uint32_t _mempool[FF_FS_MEMPOOL][FF_MIN_SS / sizeof(uint32_t)];
+static bool _mempool_used[FF_FS_MEMPOOL] = {0};
+#endif
+
+#if MBED_CONF_FILESYSTEM_HANDLE_POOL
+// Open files and directories (filesystem.handle-pool), used with _ffs_mutex held
+union fat_handle_t {
+    FIL file;
+    FATFS_DIR dir;
+};
+static fat_handle_t _handles[MBED_CONF_FILESYSTEM_HANDLE_POOL];
+static bool _handle_used[MBED_CONF_FILESYSTEM_HANDLE_POOL] = {0};
+
+static void *handle_alloc()
+{
+    for (int i = 0; i < MBED_CONF_FILESYSTEM_HANDLE_POOL; i++) {
+        if (!_handle_used[i]) {
+            _handle_used[i] = true;
+            return &_handles[i];
+        }
+    }
+    return NULL;
+}
+
+static void handle_free(void *h)
+{
+    for (int i = 0; i < MBED_CONF_FILESYSTEM_HANDLE_POOL; i++) {
+        if (h == &_handles[i]) {
+            _handle_used[i] = false;
+        }
+    }
+}
+
+#define HANDLE_NEW(type)    static_cast<type *>(handle_alloc())
+#define HANDLE_DELETE(h)    handle_free(h)
+#else
+#define HANDLE_NEW(type)    new type
+#define HANDLE_DELETE(h)    delete h
+#endif
+
 // FAT driver functions
 extern "C" DWORD get_fattime(void)
 {
@@ -157,14 +214,36 @@ extern "C" DWORD get_fattime(void)
            | (DWORD)(ptm->tm_sec / 2);
 }
 
+// Called by FatFs with _ffs_mutex held (FATFileSystem methods)
 extern "C" void *ff_memalloc(UINT size)
 {
+#if FF_FS_MEMPOOL
+    if (size > FF_MIN_SS) {
+        return NULL;
+    }
+    for (int i = 0; i < FF_FS_MEMPOOL; i++) {
+        if (!_mempool_used[i]) {
+            _mempool_used[i] = true;
+            return _mempool[i];
+        }
+    }
+    return NULL;
+#else
     return malloc(size);
+#endif
 }
 
 extern "C" void ff_memfree(void *p)
 {
+#if FF_FS_MEMPOOL
+    for (int i = 0; i < FF_FS_MEMPOOL; i++) {
+        if (p == _mempool[i]) {
+            _mempool_used[i] = false;
+        }
+    }
+#else
     free(p);
+#endif
 }
 
 // Implementation of diskio functions (see ChaN/diskio.h)
@@ -238,8 +317,11 @@ extern "C" DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
     debug_if(FFS_DBG, "disk_ioctl(%d)\n", cmd);
     switch (cmd) {
         case CTRL_SYNC:
+            // Commit data held by cached block devices (BufferedBlockDevice)
             if (_ffs[pdrv] == NULL) {
                 return RES_NOTRDY;
+            } else if (_ffs[pdrv]->sync()) {
+                return RES_ERROR;
             } else {
                 return RES_OK;
             }
@@ -258,7 +340,8 @@ extern "C" DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
                 return RES_OK;
             }
         case GET_BLOCK_SIZE:
-            *((DWORD *)buff) = 1; // default when not known
+            // f_mkfs aligns the FAT and the data area to it, the device is initialized by then
+            *((DWORD *)buff) = _ffs_align[pdrv] ? _ffs_align[pdrv] / disk_get_sector_size(pdrv) : 1; // default when not known
             return RES_OK;
         case CTRL_TRIM:
             if (_ffs[pdrv] == NULL) {
@@ -280,7 +363,7 @@ extern "C" DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
 
 // Filesystem implementation (See FATFilySystem.h)
 FATFileSystem::FATFileSystem(const char *name, BlockDevice *bd)
-    : FileSystem(name), _id(-1)
+    : FileSystem(name), _id(-1), _private_prefixes(NULL)
 {
     if (bd) {
         mount(bd);
@@ -342,7 +425,7 @@ int FATFileSystem::unmount()
 
 /* See http://elm-chan.org/fsw/ff/en/mkfs.html for details of f_mkfs() and
  * associated arguments. */
-int FATFileSystem::format(BlockDevice *bd, bd_size_t cluster_size)
+int FATFileSystem::format(BlockDevice *bd, bd_size_t cluster_size, bd_size_t align)
 {
     FATFileSystem fs;
     fs.lock();
@@ -365,7 +448,7 @@ int FATFileSystem::format(BlockDevice *bd, bd_size_t cluster_size)
     if (bd->get_erase_value() < 0) {
         // erase is unknown, need to write 1s
         bd_size_t program_size = bd->get_program_size();
-        void *buf = malloc(program_size);
+        void *buf = ff_memalloc(program_size);
         if (!buf) {
             bd->deinit();
             fs.unlock();
@@ -377,14 +460,14 @@ int FATFileSystem::format(BlockDevice *bd, bd_size_t cluster_size)
         for (bd_addr_t i = 0; i < header; i += program_size) {
             err = bd->program(buf, i, program_size);
             if (err) {
-                free(buf);
+                ff_memfree(buf);
                 bd->deinit();
                 fs.unlock();
                 return err;
             }
         }
 
-        free(buf);
+        ff_memfree(buf);
     }
 
     // trim entire device to indicate it is unneeded
@@ -408,7 +491,9 @@ int FATFileSystem::format(BlockDevice *bd, bd_size_t cluster_size)
     }
 
     // Logical drive number, Partitioning rule, Allocation unit size (bytes per cluster)
+    _ffs_align[fs._id] = align;
     FRESULT res = f_mkfs(fs._fsid, FM_ANY | FM_SFD, cluster_size, NULL, 0);
+    _ffs_align[fs._id] = 0;
     if (res != FR_OK) {
         fs.unmount();
         fs.unlock();
@@ -426,6 +511,11 @@ int FATFileSystem::format(BlockDevice *bd, bd_size_t cluster_size)
 }
 
 int FATFileSystem::reformat(BlockDevice *bd, int allocation_unit)
+{
+    return reformat(bd, allocation_unit, 0);
+}
+
+int FATFileSystem::reformat(BlockDevice *bd, int allocation_unit, bd_size_t align)
 {
     lock();
     if (_id != -1) {
@@ -445,7 +535,7 @@ int FATFileSystem::reformat(BlockDevice *bd, int allocation_unit)
         return -ENODEV;
     }
 
-    int err = FATFileSystem::format(bd, allocation_unit);
+    int err = FATFileSystem::format(bd, allocation_unit, align);
     if (err) {
         unlock();
         return err;
@@ -559,6 +649,48 @@ int FATFileSystem::statvfs(const char *path, struct statvfs *buf)
     return 0;
 }
 
+void FATFileSystem::set_private_buffers(const char *const *prefixes)
+{
+    lock();
+    _private_prefixes = prefixes;
+    unlock();
+}
+
+bool FATFileSystem::wants_private_buffer(const char *path) const
+{
+    if (!_private_prefixes) {
+        return false;
+    }
+
+    const char *name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    for (const char *const *prefix = _private_prefixes; *prefix; prefix++) {
+        if (strncmp(name, *prefix, strlen(*prefix)) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int FATFileSystem::get_layout(layout_t *layout)
+{
+    lock();
+    if (_id == -1) {
+        unlock();
+        return -EINVAL;
+    }
+
+    bd_size_t ssize = disk_get_sector_size(_id);
+    layout->fat_type = (_fs.fs_type == FS_FAT32) ? 32 : (_fs.fs_type == FS_FAT16) ? 16 : 12;
+    layout->fat_start = (bd_addr_t)_fs.fatbase * ssize;
+    layout->fat_size = (bd_size_t)_fs.fsize * ssize;
+    layout->data_start = (bd_addr_t)_fs.database * ssize;
+    layout->cluster_size = (bd_size_t)_fs.csize * ssize;
+    layout->clusters = _fs.n_fatent - 2;
+    unlock();
+    return 0;
+}
+
 void FATFileSystem::lock()
 {
     _ffs_mutex->lock();
@@ -575,7 +707,6 @@ int FATFileSystem::file_open(fs_file_t *file, const char *path, int flags)
 {
     debug_if(FFS_DBG, "open(%s) on filesystem [%s], drv [%d]\n", path, getName(), _id);
 
-    FIL *fh = new FIL;
     Deferred<const char *> fpath = fat_path_prefix(_id, path);
 
     /* POSIX flags -> FatFS open mode */
@@ -601,15 +732,34 @@ int FATFileSystem::file_open(fs_file_t *file, const char *path, int flags)
     }
 
     lock();
+    FIL *fh = HANDLE_NEW(FIL);
+    if (!fh) {
+        unlock();
+        return -ENOMEM;
+    }
     FRESULT res = f_open(fh, fpath, openmode);
 
     if (res != FR_OK) {
+        HANDLE_DELETE(fh);
         unlock();
         debug_if(FFS_DBG, "f_open('w') failed: %d\n", res);
-        delete fh;
         return fat_error_remap(res);
     }
 
+#if FF_FS_TINY && FF_FS_FILEBUF
+    // A sector larger than the pool buffers keeps the file on the window
+    if ((openmode & FA_WRITE) && FILEBUF_FITS(_fs) && wants_private_buffer(path)) {
+        for (int i = 0; i < FF_FS_FILEBUF; i++) {
+            if (!_filebuf_owner[i]) {
+                if (f_setbuf(fh, _filebuf[i]) == FR_OK) {
+                    _filebuf_owner[i] = fh;
+                }
+                break;
+            }
+        }
+    }
+#endif
+
     unlock();
 
     *file = fh;
@@ -622,9 +772,16 @@ int FATFileSystem::file_close(fs_file_t file)
 
     lock();
     FRESULT res = f_close(fh);
+#if FF_FS_TINY && FF_FS_FILEBUF
+    for (int i = 0; i < FF_FS_FILEBUF; i++) {
+        if (_filebuf_owner[i] == fh) {
+            _filebuf_owner[i] = NULL;
+        }
+    }
+#endif
+    HANDLE_DELETE(fh);
     unlock();
 
-    delete fh;
     return fat_error_remap(res);
 }
 
@@ -749,6 +906,7 @@ int FATFileSystem::file_truncate(fs_file_t file, off_t length)
         return fat_error_remap(res);
     }
 
+    unlock();
     return 0;
 }
 
@@ -756,18 +914,23 @@ int FATFileSystem::file_truncate(fs_file_t file, off_t length)
 ////// Dir operations //////
 int FATFileSystem::dir_open(fs_dir_t *dir, const char *path)
 {
-    FATFS_DIR *dh = new FATFS_DIR;
     Deferred<const char *> fpath = fat_path_prefix(_id, path);
 
     lock();
+    FATFS_DIR *dh = HANDLE_NEW(FATFS_DIR);
+    if (!dh) {
+        unlock();
+        return -ENOMEM;
+    }
     FRESULT res = f_opendir(dh, fpath);
-    unlock();
 
     if (res != FR_OK) {
+        HANDLE_DELETE(dh);
+        unlock();
         debug_if(FFS_DBG, "f_opendir() failed: %d\n", res);
-        delete dh;
         return fat_error_remap(res);
     }
+    unlock();
 
     *dir = dh;
     return 0;
@@ -779,9 +942,9 @@ int FATFileSystem::dir_close(fs_dir_t dir)
 
     lock();
     FRESULT res = f_closedir(dh);
+    HANDLE_DELETE(dh);
     unlock();
 
-    delete dh;
     return fat_error_remap(res);
 }
 
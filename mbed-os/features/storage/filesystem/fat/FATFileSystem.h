@@ -64,9 +64,15 @@ public:
      *    and is currently limited to a max of 32,768 bytes. If the cluster size is set to zero, a cluster size
      *    is determined from the device's allocation unit. Defaults to zero.
      *
+     *  @param align
+     *    Boundary in bytes the FAT and the data area (first cluster) start
+     *    on, usually the SD card allocation unit (SDBlockDevice::read_sd_status).
+     *    A power of two multiple of the sector, at most 32768 sectors. Zero
+     *    for no alignment. Defaults to zero.
+     *
      *  @return         0 on success, negative error code on failure.
      */
-    static int format(BlockDevice *bd, bd_size_t cluster_size = 0);
+    static int format(BlockDevice *bd, bd_size_t cluster_size = 0, bd_size_t align = 0);
 
     /** Mount a file system to a block device.
      *
@@ -100,6 +106,15 @@ public:
      */
     virtual int reformat(BlockDevice *bd, int allocation_unit);
 
+    /** Reformat a file system with aligned FAT and data area, see format().
+     *
+     *  @param bd               Block device to reformat and mount, NULL for the mounted one.
+     *  @param allocation_unit  Bytes per cluster, 0 for the default.
+     *  @param align            Boundary of the FAT and the data area in bytes, 0 for none.
+     *  @return                 0 on success, negative error code on failure.
+     */
+    int reformat(BlockDevice *bd, int allocation_unit, bd_size_t align);
+
     /** Reformat a file system, results in an empty and mounted file system.
      *
      *  @param bd       Block device to reformat and mount. If NULL, the mounted
@@ -153,6 +168,39 @@ public:
      */
     virtual int statvfs(const char *path, struct statvfs *buf);
 
+    /** Select the files that get a private sector buffer.
+     *
+     *  A file whose name (last path component) starts with one of the
+     *  prefixes and that is opened for writing takes a buffer from a static
+     *  pool of FF_FS_FILEBUF sectors, shared by all the volumes, until it is
+     *  closed. Its partial sector then stays in that buffer: appending to
+     *  several files in turn no longer writes back and reads again the sector
+     *  window shared by the other files, the FAT and the directory. When the
+     *  pool is empty, or without FF_FS_TINY and FF_FS_FILEBUF, files are
+     *  opened as usual.
+     *
+     *  @param prefixes NULL-terminated list of name prefixes, kept by pointer.
+     *                  NULL for none (the default).
+     */
+    void set_private_buffers(const char *const *prefixes);
+
+    /** Position of the file system structures on the block device */
+    struct layout_t {
+        int fat_type;               ///< 12, 16 or 32
+        bd_addr_t fat_start;        ///< First FAT
+        bd_size_t fat_size;         ///< Bytes per FAT
+        bd_addr_t data_start;       ///< First cluster
+        bd_size_t cluster_size;     ///< Bytes per cluster
+        uint32_t clusters;          ///< Number of clusters
+    };
+
+    /** Get the layout of the mounted file system.
+     *
+     *  @param layout   Destination of the layout, in bytes from the start of the device.
+     *  @return         0 on success, negative error code on failure.
+     */
+    int get_layout(layout_t *layout);
+
 protected:
 #if !(DOXYGEN_ONLY)
     /** Open a file on the file system.
@@ -285,6 +333,9 @@ private:
     FATFS _fs; // Work area (file system object) for logical drive.
     char _fsid[sizeof("0:")];
     int _id;
+    const char *const *_private_prefixes;
+
+    bool wants_private_buffer(const char *path) const;
 
 protected:
     virtual void lock();
@@ -1,8 +1,39 @@
+/*
+    Converts the logger data files to CSV.
+    Record stream files (see "Logger/log_record.h") are demultiplexed into one
+    CSV per record type (RUNx_imu.csv, RUNx_analog.csv, ...).
+    Event files (RUNx/eventY) go to RUNx_eventY_imu.csv and RUNx_eventY_event.csv.
+    The summary file (RUNx/summary) goes to RUNx_summary_window.csv and
+    RUNx_summary_stats.csv (see also "tools/summary_view.c").
+    Files from older firmware (array of packets) are converted to RUNx.csv.
+
+    Without arguments it asks for the folder and the runs to convert.
+    "read_struct --batch <folder> [jobs]" converts every run of the folder
+    (a copy of the card) without asking, keeping convert_manifest.txt
+    there: size, mtime and content hash of each file already converted,
+    and the output version. Unchanged runs are skipped from their size and
+    mtime alone (hashed only if the mtime changed), parts added to a run
+    are appended to its CSVs, a changed part reconverts the run, and the
+    runs are converted in parallel (jobs threads, default one per CPU).
+    Build: gcc -O2 -o read_struct read_struct2.0.c -lpthread
+*/
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "Logger/log_record.h"
 
 #define NUM_PACKETS 50
+#define CHUNK_SIZE 65536
+#define OUTPUT_VERSION 1                            // Bump when a CSV changes: --batch then converts everything again
+#define MANIFEST_NAME "convert_manifest.txt"
 
 
 typedef struct
@@ -21,58 +52,804 @@ typedef struct
     uint32_t timestamp;
 } packet;
 
-int main()
+/* Per-type output streams */
+typedef struct
+{
+    const char *suffix;                             // Output file is <prefix>_<suffix>.csv
+    const char *columns;                            // CSV header
+    void (*print)(FILE *f, uint32_t time, const uint8_t *payload);
+} rec_stream_t;
+
+static void print_imu(FILE *f, uint32_t time, const uint8_t *payload)
+{
+    rec_imu_t r;
+    memcpy(&r, payload, sizeof(r));
+    fprintf(f, "%d,%d,%d,%d,%d,%d,%u\n", r.acc[0], r.acc[1], r.acc[2], r.gyr[0], r.gyr[1], r.gyr[2], time);
+}
+
+static void print_analog(FILE *f, uint32_t time, const uint8_t *payload)
+{
+    rec_analog_t r;
+    memcpy(&r, payload, sizeof(r));
+    fprintf(f, "%u,%u,%u,%u\n", r.analog[0], r.analog[1], r.analog[2], time);
+}
+
+static void print_pulses(FILE *f, uint32_t time, const uint8_t *payload)
+{
+    rec_pulses_t r;
+    memcpy(&r, payload, sizeof(r));
+    fprintf(f, "%u,%u,%u\n", r.pulses[0], r.pulses[1], time);
+}
+
+static void print_event(FILE *f, uint32_t time, const uint8_t *payload)
+{
+    rec_event_t r;
+    memcpy(&r, payload, sizeof(r));
+    fprintf(f, "%u,%u,%u,%u,%u\n", r.trigger_time, r.pre, r.post, r.rate, r.source);
+    (void)time;
+}
+
+/* offset_usN: read time of device N from the middle of the group's bus burst (last raw read
+   before decimation), to align the devices with each other, not to the timestamp */
+static void print_imu_group(FILE *f, uint32_t time, const uint8_t *payload)
+{
+    rec_imu_group_t r;
+    int i;
+    memcpy(&r, payload, sizeof(r));
+    fprintf(f, "%u", r.mask);
+    for (i = 0; i < IMU_GROUP_MAX; i++)
+    {
+        const rec_imu_t *m = &r.imu[i];
+        fprintf(f, ",%d,%d,%d,%d,%d,%d,%d", m->acc[0], m->acc[1], m->acc[2], m->gyr[0], m->gyr[1], m->gyr[2], r.offset_us[i]);
+    }
+    fprintf(f, ",%u\n", time);
+}
+
+static void print_qenc(FILE *f, uint32_t time, const uint8_t *payload)
+{
+    rec_qenc_t r;
+    memcpy(&r, payload, sizeof(r));
+    fprintf(f, "%d,%d,%u\n", r.position, r.velocity, time);
+}
+
+static void print_rate(FILE *f, uint32_t time, const uint8_t *payload)
+{
+    rec_rate_t r;
+    memcpy(&r, payload, sizeof(r));
+    fprintf(f, "%u,%u,%u\n", r.rate, r.cause, time);
+}
+
+static void print_window(FILE *f, uint32_t time, const uint8_t *payload)
+{
+    rec_window_t r;
+    memcpy(&r, payload, sizeof(r));
+    fprintf(f, "%u,%u,%u,%u\n", r.count, r.part, r.last_ms, time);
+}
+
+static void print_summary(FILE *f, uint32_t time, const uint8_t *payload)
+{
+    rec_summary_t r;
+    memcpy(&r, payload, sizeof(r));
+    fprintf(f, "%u,%d,%d,%d,%u,%u\n", r.channel, r.min, r.max, r.mean, r.rms, time);
+}
+
+/* Demultiplexer table, indexed by tag. Types without print are consumed but not written. */
+static const rec_stream_t streams[REC_NUM_TAGS] =
+{
+    [REC_IMU]    = { "imu",    "lsmaccx,lsmaccy,lsmaccz,lsmangx,lsmangy,lsmangz,timestamp", print_imu },
+    [REC_ANALOG] = { "analog", "a0,a1,a2,timestamp", print_analog },
+    [REC_PULSES] = { "pulses", "f1,f2,timestamp", print_pulses },
+    [REC_EVENT]  = { "event",  "trigger_time,pre,post,rate,source", print_event },
+    [REC_IMU_GROUP] = { "imus", "mask,"
+                        "lsmaccx0,lsmaccy0,lsmaccz0,lsmangx0,lsmangy0,lsmangz0,offset_us0,"
+                        "lsmaccx1,lsmaccy1,lsmaccz1,lsmangx1,lsmangy1,lsmangz1,offset_us1,timestamp", print_imu_group },
+    [REC_QENC]   = { "encoder0", "position,velocity,timestamp", print_qenc },
+    [REC_QENC1]  = { "encoder1", "position,velocity,timestamp", print_qenc },
+    [REC_RATE]   = { "rate",   "rate,cause,timestamp", print_rate },
+    [REC_WINDOW] = { "window", "count,part,last_ms,timestamp", print_window },
+    [REC_SUMMARY] = { "stats", "channel,min,max,mean,rms,timestamp", print_summary },
+};
+
+/* Open a CSV output, with its header unless appending to a non-empty one */
+static FILE *open_csv(const char *name, const char *columns, int append)
+{
+    FILE *f = fopen(name, append ? "at" : "wt");
+
+    if (f != NULL)
+    {
+        fseek(f, 0, SEEK_END);
+        if (ftell(f) == 0)
+            fprintf(f, "%s\n", columns);
+    }
+    return f;
+}
+
+/* Read the header of a record stream file, of any version. Returns 0 if it isn't one. */
+static int read_header(FILE *fp, log_header_t *header)
+{
+    memset(header, 0, sizeof(*header));
+    if (fread(header, LOG_HEADER_V2_SIZE, 1, fp) != 1 || header->magic != LOG_MAGIC)
+        return 0;
+    if (header->version >= 3 && fread(&header->run_id, sizeof(header->run_id), 1, fp) != 1)
+        return 0;
+    return 1;
+}
+
+/* Demultiplex one record stream file, after its header. Returns 0 on success, 1 on a corrupted stream.
+   With append, the CSVs that already exist are continued. A part stops at its last block of the run. */
+static int convert_records(FILE *fp, const log_header_t *file_header, FILE *out[], const char *prefix, int append)
+{
+    uint8_t *chunk = (uint8_t *)malloc(CHUNK_SIZE);    // One per thread in --batch
+    uint32_t len = 0, pos = 0, base = 0, time = 0;     // base: stream offset of chunk[0]
+    rec_mark_check_t marks = { file_header->run_id, 0, 0 };
+    int eof = 0, result = 0;
+
+    if (chunk == NULL)
+        return 1;
+    while (1)
+    {
+        /* Keep at least one full record in the chunk */
+        if (!eof && len - pos < REC_MAX_SIZE + 1 + sizeof(rec_time_t))
+        {
+            memmove(chunk, chunk + pos, len - pos);
+            base += pos;
+            len -= pos;
+            pos = 0;
+            len += fread(chunk + len, 1, CHUNK_SIZE - len, fp);
+            eof = feof(fp);
+        }
+        if (pos >= len)
+            break;
+
+        uint8_t tag = chunk[pos] & REC_TAG_MASK;
+        uint32_t size = (tag < REC_NUM_TAGS) ? rec_payload_size[tag] : 0;
+        uint32_t header = (chunk[pos] & REC_SAME_TIME) ? 1 : 2;
+
+        if (!rec_mark_valid(&marks, base + pos, chunk + pos, len - pos))
+        {
+            printf("\nFim dos dados da corrida no byte %u (bloco %u sem marcador): o resto do arquivo é ignorado\n",
+                   (unsigned)(LOG_HEADER_SIZE(file_header->version) + base + pos), marks.seq);
+            break;                                  // Stale data of a pre-allocated part after a power loss
+        }
+        if (size == 0)
+        {
+            printf("\nRegistro inválido (tag 0x%02X)\n", chunk[pos]);
+            result = 1;
+            break;
+        }
+        if (pos + header + size > len)
+            break;                                  // Truncated last record (power loss)
+
+        if (header == 2)
+            time += chunk[pos + 1];
+        pos += header;
+
+        if (tag == REC_TIME)
+        {
+            rec_time_t r;
+            memcpy(&r, chunk + pos, sizeof(r));
+            time = r.time_stamp;
+        }
+        else if (streams[tag].print != NULL)
+        {
+            if (out[tag] == NULL)
+            {
+                char name[300];
+                sprintf(name, "%s_%s.csv", prefix, streams[tag].suffix);
+                out[tag] = open_csv(name, streams[tag].columns, append);
+            }
+            if (out[tag] != NULL)
+                streams[tag].print(out[tag], time, chunk + pos);
+        }
+        pos += size;
+    }
+    free(chunk);
+    return result;
+}
+
+/* Convert one file from older firmware (array of packets) */
+static void convert_packets(FILE *fp, FILE **f, const char *foldername, int RUN, int append)
+{
+    packet x[NUM_PACKETS];
+    size_t n, i;
+
+    if (*f == NULL)
+    {
+        char filename[300];
+        sprintf(filename, "%s/RUN%d.csv", foldername, RUN);
+        *f = open_csv(filename, "lsmaccx,lsmaccy,lsmaccz,lsmangx,lsmangy,lsmangz,a0,a1,a2,f1,f2,timestamp", append);
+        if (*f == NULL)
+            return;
+    }
+
+    while ((n = fread((void *)x, sizeof(packet), NUM_PACKETS, fp)) > 0)
+    {
+        for (i = 0; i < n; i++)
+        {
+            fprintf(*f, "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d\n", x[i].acclsmx, x[i].acclsmy, x[i].acclsmz,
+            x[i].anglsmx, x[i].anglsmy, x[i].anglsmz, x[i].A0, x[i].A1, x[i].A2,
+            x[i].pulses_chan1, x[i].pulses_chan2, x[i].timestamp);
+        }
+    }
+}
+
+/* Batch conversion (--batch): files of a run against the manifest */
+enum file_kind { FILE_PART, FILE_EVENT, FILE_SUMMARY };
+enum file_state { STATE_SAME, STATE_NEW, STATE_CHANGED };
+
+typedef struct
+{
+    char name[48];                                  // Relative to the folder: RUNx/partN, RUNx/eventN, RUNx/summary
+    int version;                                    // OUTPUT_VERSION it was converted with
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash;
+} manifest_entry_t;
+
+typedef struct
+{
+    manifest_entry_t entry;                         // As found now (hash once checked)
+    int kind, index;
+    int state;
+    int same_size;                                  // STATE_CHANGED with the size and version of the manifest
+    uint64_t old_hash;                              // Its hash in the manifest
+} run_file_t;
+
+typedef struct
+{
+    int run;
+    run_file_t *files;
+    int num_files;
+} run_job_t;
+
+static const char *batch_folder;
+static manifest_entry_t *manifest;                  // Guarded by batch_lock once the workers run
+static size_t manifest_len, manifest_size;
+static run_job_t *jobs;
+static int num_jobs, next_job, runs_converted;
+static pthread_mutex_t batch_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *grow(void *v, size_t *size, size_t item)
+{
+    *size = *size ? 2 * *size : 64;
+    v = realloc(v, *size * item);
+    if (v == NULL)
+    {
+        fprintf(stderr, "Sem memória\n");
+        exit(1);
+    }
+    return v;
+}
+
+/* Multiply-xorshift hash over 64-bit words (bytes for the tail) */
+static int hash_file(const char *name, uint64_t *hash)
+{
+    FILE *f = fopen(name, "rb");
+    uint8_t *buf = (uint8_t *)malloc(CHUNK_SIZE);
+    uint64_t h = 0xcbf29ce484222325ULL;
+    size_t n, i;
+
+    if (f == NULL || buf == NULL)
+    {
+        if (f != NULL)
+            fclose(f);
+        free(buf);
+        return 0;
+    }
+    while ((n = fread(buf, 1, CHUNK_SIZE, f)) > 0)
+    {
+        for (i = 0; i + 8 <= n; i += 8)
+        {
+            uint64_t w;
+            memcpy(&w, buf + i, 8);
+            h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+            h ^= h >> 32;
+        }
+        for (; i < n; i++)
+            h = ((h ^ buf[i]) * 0x100000001b3ULL) ^ (h >> 32);
+    }
+    fclose(f);
+    free(buf);
+    *hash = h;
+    return 1;
+}
+
+static manifest_entry_t *find_entry(const char *name)
+{
+    for (size_t i = 0; i < manifest_len; i++)
+    {
+        if (strcmp(manifest[i].name, name) == 0)
+            return &manifest[i];
+    }
+    return NULL;
+}
+
+static void add_entry(const manifest_entry_t *e)
+{
+    if (manifest_len == manifest_size)
+        manifest = (manifest_entry_t *)grow(manifest, &manifest_size, sizeof(manifest_entry_t));
+    manifest[manifest_len++] = *e;
+}
+
+/* Entries of a run (kind: "part" for its parts only, "" for all) */
+static int is_run_entry(const manifest_entry_t *e, int run, const char *kind)
+{
+    char prefix[32];
+
+    sprintf(prefix, "RUN%d/%s", run, kind);
+    return strncmp(e->name, prefix, strlen(prefix)) == 0;
+}
+
+static void remove_run_entries(int run)
+{
+    size_t kept = 0;
+
+    for (size_t i = 0; i < manifest_len; i++)
+    {
+        if (!is_run_entry(&manifest[i], run, ""))
+            manifest[kept++] = manifest[i];
+    }
+    manifest_len = kept;
+}
+
+static void load_manifest(void)
+{
+    char name[300], line[200];
+    manifest_entry_t e;
+    FILE *f;
+
+    sprintf(name, "%s/%s", batch_folder, MANIFEST_NAME);
+    f = fopen(name, "rt");
+    if (f == NULL)
+        return;
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        if (line[0] != '#' && sscanf(line, "%d %" SCNu64 " %" SCNd64 " %" SCNx64 " %47s", &e.version, &e.size,
+                                     &e.mtime, &e.hash, e.name) == 5)
+            add_entry(&e);
+    }
+    fclose(f);
+}
+
+/* Written after every run, so an interrupted batch doesn't append a part twice */
+static void save_manifest(void)
+{
+    char name[300], temp[310];
+    FILE *f;
+
+    sprintf(name, "%s/%s", batch_folder, MANIFEST_NAME);
+    sprintf(temp, "%s.tmp", name);
+    f = fopen(temp, "wt");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Não foi possível escrever %s\n", temp);
+        return;
+    }
+    fprintf(f, "# read_struct --batch: version size mtime hash file\n");
+    for (size_t i = 0; i < manifest_len; i++)
+    {
+        const manifest_entry_t *e = &manifest[i];
+        fprintf(f, "%d %" PRIu64 " %" PRId64 " %016" PRIx64 " %s\n", e->version, e->size, e->mtime, e->hash, e->name);
+    }
+    fclose(f);
+    if (rename(temp, name) != 0)
+    {
+        remove(name);                               // Windows doesn't replace
+        rename(temp, name);
+    }
+}
+
+static int stat_file(const char *name, uint64_t *size, int64_t *mtime)
+{
+    char path[300];
+    struct stat st;
+
+    sprintf(path, "%s/%s", batch_folder, name);
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+        return 0;
+    *size = st.st_size;
+    *mtime = st.st_mtime;
+    return 1;
+}
+
+/* partN, eventN and summary of a run, with their size and mtime */
+static int list_run(int run, run_file_t **files)
+{
+    static const char *kinds[] = { "part", "event" };
+    size_t size = 0;
+    int n = 0;
+
+    *files = NULL;
+    for (int kind = FILE_PART; kind <= FILE_SUMMARY; kind++)
+    {
+        for (int index = 1; ; index++)
+        {
+            run_file_t f;
+
+            memset(&f, 0, sizeof(f));
+            if (kind == FILE_SUMMARY)
+                sprintf(f.entry.name, "RUN%d/summary", run);
+            else
+                sprintf(f.entry.name, "RUN%d/%s%d", run, kinds[kind], index);
+            if (!stat_file(f.entry.name, &f.entry.size, &f.entry.mtime))
+                break;
+            f.entry.version = OUTPUT_VERSION;
+            f.kind = kind;
+            f.index = index;
+            if ((size_t)n == size)
+                *files = (run_file_t *)grow(*files, &size, sizeof(run_file_t));
+            (*files)[n++] = f;
+            if (kind == FILE_SUMMARY)
+                break;
+        }
+    }
+    return n;
+}
+
+/* Convert one record stream (or old packet array) file to the CSVs of prefix */
+static void convert_file(const char *name, FILE *out[], FILE **packets, const char *prefix, int run, int append)
+{
+    char path[300];
+    log_header_t header;
+    FILE *fp;
+
+    sprintf(path, "%s/%s", batch_folder, name);
+    fp = fopen(path, "rb");
+    if (fp == NULL)
+        return;
+    if (read_header(fp, &header))
+        convert_records(fp, &header, out, prefix, append);
+    else if (packets != NULL)
+    {
+        rewind(fp);
+        convert_packets(fp, packets, batch_folder, run, append);
+    }
+    fclose(fp);
+}
+
+static void close_outputs(FILE *out[])
+{
+    for (int i = 0; i < REC_NUM_TAGS; i++)
+    {
+        if (out[i] != NULL)
+            fclose(out[i]);
+        out[i] = NULL;
+    }
+}
+
+static void convert_run(run_job_t *job)
 {
-    char error, first = 0;
-    int  RUN, part = 0;
-    char filename[50];
+    int run = job->run, full = 0, redo, first_new = 0, old_parts = 0, parts = 0, converted = 0, others = 0;
+    char prefix[300], name[300];
+
+    /* What the manifest knows of these files, under the lock as other runs update it */
+    pthread_mutex_lock(&batch_lock);
+    for (size_t i = 0; i < manifest_len; i++)
+        old_parts += is_run_entry(&manifest[i], run, "part");
+    for (int i = 0; i < job->num_files; i++)
+    {
+        run_file_t *f = &job->files[i];
+        manifest_entry_t *e = find_entry(f->entry.name);
+
+        f->state = STATE_NEW;
+        if (e != NULL && e->version == OUTPUT_VERSION && e->size == f->entry.size && e->mtime == f->entry.mtime)
+        {
+            f->state = STATE_SAME;
+            f->entry.hash = e->hash;
+        }
+        else if (e != NULL)
+        {
+            f->state = STATE_CHANGED;               // Unless the content is the same (copied, mtime lost)
+            f->same_size = e->version == OUTPUT_VERSION && e->size == f->entry.size;
+            f->old_hash = e->hash;
+        }
+    }
+    pthread_mutex_unlock(&batch_lock);
+
+    for (int i = 0; i < job->num_files; i++)
+    {
+        run_file_t *f = &job->files[i];
+
+        if (f->state == STATE_SAME)
+            continue;
+        sprintf(name, "%s/%s", batch_folder, f->entry.name);
+        hash_file(name, &f->entry.hash);
+        if (f->state == STATE_CHANGED && f->same_size && f->entry.hash == f->old_hash)
+            f->state = STATE_SAME;
+    }
+
+    /* Parts: only new ones after unchanged ones are appended, anything else redoes the run */
+    for (int i = 0; i < job->num_files; i++)
+    {
+        const run_file_t *f = &job->files[i];
+
+        if (f->kind != FILE_PART)
+            continue;
+        parts++;
+        if (f->state == STATE_CHANGED || (f->state == STATE_SAME && first_new))
+            full = 1;
+        if (f->state == STATE_NEW && !first_new)
+            first_new = f->index;
+    }
+    if (old_parts > parts)
+        full = 1;
+    redo = full;
+    if (first_new == 1)
+        full = 1;                                   // From the first part, outputs of an earlier conversion go
+    if (full)
+    {
+        for (int tag = 0; tag < REC_NUM_TAGS; tag++)
+        {
+            if (streams[tag].suffix != NULL)
+            {
+                sprintf(name, "%s/RUN%d_%s.csv", batch_folder, run, streams[tag].suffix);
+                remove(name);
+            }
+        }
+        sprintf(name, "%s/RUN%d.csv", batch_folder, run);
+        remove(name);
+        first_new = 1;
+    }
+    if (first_new)
+    {
+        FILE *out[REC_NUM_TAGS] = { NULL };
+        FILE *packets = NULL;
+
+        sprintf(prefix, "%s/RUN%d", batch_folder, run);
+        for (int i = 0; i < job->num_files; i++)
+        {
+            if (job->files[i].kind == FILE_PART && job->files[i].index >= first_new)
+            {
+                convert_file(job->files[i].entry.name, out, &packets, prefix, run, 1);
+                converted++;
+            }
+        }
+        close_outputs(out);
+        if (packets != NULL)
+            fclose(packets);
+    }
+
+    /* Event files and the summary have their own outputs */
+    for (int i = 0; i < job->num_files; i++)
+    {
+        const run_file_t *f = &job->files[i];
+        FILE *out[REC_NUM_TAGS] = { NULL };
+
+        if (f->kind == FILE_PART || f->state == STATE_SAME)
+            continue;
+        if (f->kind == FILE_EVENT)
+            sprintf(prefix, "%s/RUN%d_event%d", batch_folder, run, f->index);
+        else
+            sprintf(prefix, "%s/RUN%d_summary", batch_folder, run);
+        convert_file(f->entry.name, out, NULL, prefix, run, 0);
+        close_outputs(out);
+        others++;
+    }
+
+    pthread_mutex_lock(&batch_lock);
+    remove_run_entries(run);
+    for (int i = 0; i < job->num_files; i++)
+        add_entry(&job->files[i].entry);
+    save_manifest();
+    runs_converted += converted || others;
+    if (converted || others)
+        printf("RUN%d: %d de %d partes%s, %d outros arquivos\n", run, converted, parts,
+               redo ? " (corrida refeita)" : "", others);
+    pthread_mutex_unlock(&batch_lock);
+}
+
+static void *batch_worker(void *arg)
+{
+    (void)arg;
+    while (1)
+    {
+        int i;
+
+        pthread_mutex_lock(&batch_lock);
+        i = next_job++;
+        pthread_mutex_unlock(&batch_lock);
+        if (i >= num_jobs)
+            return NULL;
+        convert_run(&jobs[i]);
+    }
+}
+
+static int batch_main(const char *folder, int threads)
+{
+    struct timespec t0, t1;
+    size_t jobs_size = 0, runs_size = 0;
+    int *runs = NULL, num_runs = 0;
+    pthread_t *workers;
+    struct dirent *d;
+    DIR *dir;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    batch_folder = folder;
+    dir = opendir(folder);
+    if (dir == NULL)
+    {
+        printf("Pasta %s não encontrada\n", folder);
+        return 1;
+    }
+    load_manifest();
+
+    /* Runs with a file the manifest doesn't have as it is (size, mtime, version) */
+    while ((d = readdir(dir)) != NULL)
+    {
+        run_file_t *files;
+        int run, n, known = 0, same = 0;
+        char rest;
+
+        if (sscanf(d->d_name, "RUN%d%c", &run, &rest) != 1 || run <= 0)
+            continue;
+        n = list_run(run, &files);
+        if ((size_t)num_runs == runs_size)
+            runs = (int *)grow(runs, &runs_size, sizeof(int));
+        runs[num_runs++] = run;
+        for (size_t i = 0; i < manifest_len; i++)
+            known += is_run_entry(&manifest[i], run, "");
+        for (int i = 0; i < n; i++)
+        {
+            manifest_entry_t *e = find_entry(files[i].entry.name);
+            same += e != NULL && e->version == OUTPUT_VERSION && e->size == files[i].entry.size &&
+                    e->mtime == files[i].entry.mtime;
+        }
+        if (same == n && known == n)
+        {
+            free(files);
+            continue;
+        }
+        if ((size_t)num_jobs == jobs_size)
+            jobs = (run_job_t *)grow(jobs, &jobs_size, sizeof(run_job_t));
+        jobs[num_jobs].run = run;
+        jobs[num_jobs].files = files;
+        jobs[num_jobs].num_files = n;
+        num_jobs++;
+    }
+    closedir(dir);
+
+    workers = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    for (int i = 0; i < threads; i++)
+        pthread_create(&workers[i], NULL, batch_worker, NULL);
+    for (int i = 0; i < threads; i++)
+        pthread_join(workers[i], NULL);
+
+    /* Forget the runs that are not in the folder anymore */
+    size_t kept = 0;
+    for (size_t i = 0; i < manifest_len; i++)
+    {
+        int run = 0, found = 0;
+
+        sscanf(manifest[i].name, "RUN%d", &run);
+        for (int r = 0; r < num_runs && !found; r++)
+            found = runs[r] == run;
+        if (found)
+            manifest[kept++] = manifest[i];
+    }
+    manifest_len = kept;
+    save_manifest();
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("%d corridas: %d convertidas, %d já estavam, %.2f s\n", num_runs, runs_converted, num_runs - runs_converted,
+           (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+    for (int i = 0; i < num_jobs; i++)
+        free(jobs[i].files);
+    free(jobs);
+    free(runs);
+    free(workers);
+    free(manifest);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int  RUN, part, event, i;
     char foldername[30];
+    char name[70];
+    char prefix[70];
     FILE *f, *fp;
+    FILE *out[REC_NUM_TAGS];
+
+    if (argc >= 3 && strcmp(argv[1], "--batch") == 0)
+    {
+        long threads = (argc >= 4) ? atol(argv[3]) : sysconf(_SC_NPROCESSORS_ONLN);
+        return batch_main(argv[2], threads > 0 ? (int)threads : 1);
+    }
 
     printf("Insira o nome da pasta em que se encontram os dados: ");
-    scanf(" %s", foldername);
+    scanf(" %29s", foldername);
     while(1)
     {
-        error = 0;
-        part = 0;
         printf("Insira o número da corrida a ser lida (negativo para sair): ");
-        scanf(" %d", &RUN);
-
-        if(RUN < 0)
+        if (scanf(" %d", &RUN) != 1 || RUN < 0)
             break;
 
-        sprintf(filename, "%s/RUN%d.csv", foldername, RUN);
-        f = fopen(filename, "wt");
-        // printf("file = %ld\r\n", f);
-        
-        fprintf(f, "lsmaccx,lsmaccy,lsmaccz,lsmangx,lsmangy,lsmangz,a0,a1,a2,f1,f2,timestamp\n");
-    
-            char name[70];
-            sprintf(name, "%s/%s%d/%s%d", foldername,"RUN", RUN, "part", part+1);
-            printf("filename = %s\n", name);
-            fp = fopen(name, "r");
-            packet x[NUM_PACKETS];
-            
+        f = NULL;
+        memset(out, 0, sizeof(out));
+
+        /* Convert every part of the run */
+        for (part = 1; ; part++)
+        {
+            log_header_t header;
+
+            sprintf(name, "%s/%s%d/%s%d", foldername, "RUN", RUN, "part", part);
+            fp = fopen(name, "rb");
             if (fp == NULL)
+                break;
+            printf("filename = %s\n", name);
+            printf("\n~~~~~~~~PART %d ~~~~~~~~\n", part);
+
+            if (read_header(fp, &header))
+            {
+                sprintf(prefix, "%s/RUN%d", foldername, RUN);
+                convert_records(fp, &header, out, prefix, 0);
+            }
+            else
             {
-                error = 1;
+                rewind(fp);
+                convert_packets(fp, &f, foldername, RUN, 0);
+            }
+            fclose(fp);
+        }
+
+        if (part == 1)
+            printf("Corrida %d não encontrada\n", RUN);
+
+        /* Each event file has its own outputs */
+        for (event = 1; ; event++)
+        {
+            FILE *ev_out[REC_NUM_TAGS] = { NULL };
+            log_header_t header;
+
+            sprintf(name, "%s/%s%d/%s%d", foldername, "RUN", RUN, "event", event);
+            fp = fopen(name, "rb");
+            if (fp == NULL)
                 break;
-            }   
-        
-            printf("\n~~~~~~~~PART %d ~~~~~~~~", part);
-            
-            while(1){
-  	
-	    fread((void *)x, sizeof(packet), 1, fp); 
-	    fprintf(f, "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d\n", x->acclsmx, x->acclsmy, x->acclsmz, x->anglsmx, x->anglsmy, x->anglsmz, x->A0, x->A1, x->A2, 
-	    x->pulses_chan1, x->pulses_chan2, x->timestamp);
-            if (feof(fp)) break;
-	    }
+            printf("filename = %s\n", name);
+
+            if (read_header(fp, &header))
+            {
+                sprintf(prefix, "%s/RUN%d_event%d", foldername, RUN, event);
+                convert_records(fp, &header, ev_out, prefix, 0);
+            }
+            fclose(fp);
+            for (i = 0; i < REC_NUM_TAGS; i++)
+            {
+                if (ev_out[i] != NULL)
+                    fclose(ev_out[i]);
+            }
+        }
+
+        /* Summary of the run, when the firmware wrote one */
+        sprintf(name, "%s/%s%d/%s", foldername, "RUN", RUN, "summary");
+        fp = fopen(name, "rb");
+        if (fp != NULL)
+        {
+            FILE *sum_out[REC_NUM_TAGS] = { NULL };
+            log_header_t header;
+
+            printf("filename = %s\n", name);
+            if (read_header(fp, &header))
+            {
+                sprintf(prefix, "%s/RUN%d_summary", foldername, RUN);
+                convert_records(fp, &header, sum_out, prefix, 0);
+            }
             fclose(fp);
-            fp = NULL;
+            for (i = 0; i < REC_NUM_TAGS; i++)
+            {
+                if (sum_out[i] != NULL)
+                    fclose(sum_out[i]);
+            }
+        }
+
+        if (f != NULL)
             fclose(f);
-            f = NULL;
+        for (i = 0; i < REC_NUM_TAGS; i++)
+        {
+            if (out[i] != NULL)
+                fclose(out[i]);
+        }
     }
-    
+
     return 0;
 }
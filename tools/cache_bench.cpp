@@ -0,0 +1,203 @@
+/*
+    Host benchmark of the BufferedBlockDevice write-back cache under FAT.
+    The logger record stream (as in "fs_bench.cpp") is written through
+    FATFileSystem on BufferedBlockDevice with 1 to 16 sectors of cache, on the
+    SD card timing model (SDTimingBlockDevice) over a HeapBlockDevice. A
+    ProfilingBlockDevice on the virtual clock counts what reaches the card.
+
+    For each cache size it reports the program calls the card received and
+    their mean size, throughput, worst write() and sync() latency and the cache
+    statistics. The file is then read back through a fresh mount without the
+    cache and compared with what was written.
+
+    Usage: cache_bench [seconds] [spi_hz] [sync_every]
+           default: 300 1000000 50
+    Build (from tools/, see "host/mbed_config.h"):
+        M=../mbed-os; S=$M/features/storage
+        g++ -O2 -std=gnu++14 -include host/mbed_config.h -Ihost -I$M -I$M/platform -I$M/drivers -I$S \
+            -I$S/blockdevice -I$S/filesystem -I$S/filesystem/fat -I$S/filesystem/fat/ChaN \
+            -o cache_bench cache_bench.cpp host/mbed_stubs.cpp ../Logger/RecordEncoder.cpp \
+            $S/blockdevice/{Heap,SDTiming,Profiling,Buffered}BlockDevice.cpp \
+            $S/filesystem/{File,Dir,FileSystem}.cpp $S/filesystem/fat/FATFileSystem.cpp \
+            $S/filesystem/fat/ChaN/{ff,ffunicode}.cpp $M/platform/File{Base,Handle,Path,SystemHandle}.cpp
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "HeapBlockDevice.h"
+#include "SDTimingBlockDevice.h"
+#include "ProfilingBlockDevice.h"
+#include "BufferedBlockDevice.h"
+#include "FATFileSystem.h"
+#include "File.h"
+#include "../Logger/RecordEncoder.h"
+
+#define DEVICE_SIZE (1024ULL * 1024 * 1024)         // 1 GB card, sectors are allocated when written
+#define SECTOR 512
+#define SAMPLE_FREQ 200                             // As in main.cpp
+#define BLOCK_SIZE 512
+
+using namespace mbed;
+
+static const uint32_t cache_sizes[] = { 0, 1, 2, 4, 8, 16 };  // Sectors, 0 is FAT directly on the card
+
+/* FNV-1a, to compare the written and read back streams */
+static uint32_t hash_add(uint32_t hash, const uint8_t *data, size_t size)
+{
+    while (size--)
+    {
+        hash ^= *data++;
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+/* One logger sample, as in "fs_bench.cpp" */
+static void make_sample(uint32_t n, rec_imu_t *imu, rec_analog_t *analog, rec_pulses_t *pulses)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        imu->acc[i] = (rand() & 0x3FF) - 512;
+        imu->gyr[i] = (rand() & 0xFF) - 128;
+        if (n % 7 == 0)
+            analog->analog[i] = rand() & 0xFFF0;
+    }
+    pulses->pulses[0] = n % 3;
+    pulses->pulses[1] = 0;
+}
+
+/* Read the file back without the cache, returns true if it matches */
+static bool verify(BlockDevice *bd, uint32_t bytes, uint32_t hash)
+{
+    FATFileSystem fs("verify");
+    File file;
+    uint8_t buf[1000];                              // Not a multiple of the sector on purpose
+    uint32_t total = 0, read_hash = 2166136261u;
+    ssize_t n;
+
+    if (fs.mount(bd) != 0 || file.open(&fs, "RUN1/part1", O_RDONLY) != 0)
+        return false;
+    while ((n = file.read(buf, sizeof(buf))) > 0)
+    {
+        read_hash = hash_add(read_hash, buf, n);
+        total += n;
+    }
+    file.close();
+    fs.unmount();
+    return total == bytes && read_hash == hash;
+}
+
+static void run(uint32_t cache_units, uint32_t seconds, uint32_t sync_every, const SDTimingBlockDevice::timing_t &timing)
+{
+    HeapBlockDevice heap(DEVICE_SIZE, SECTOR);
+    SDTimingBlockDevice sd(&heap, timing);
+    ProfilingBlockDevice card(&sd, callback(&sd, &SDTimingBlockDevice::clock));
+    BufferedBlockDevice cache(&card, cache_units ? cache_units : 1);
+    BlockDevice *bd = cache_units ? (BlockDevice *)&cache : (BlockDevice *)&card;
+    FATFileSystem fs("sd");
+    File file;
+    uint64_t write_max = 0, sync_max = 0;
+    uint32_t samples, since_sync = 0, bytes = 0, hash = 2166136261u;
+    bool ok = true;
+
+    FATFileSystem::format(bd);
+    if (fs.mount(bd) != 0 || fs.mkdir("RUN1", 0777) != 0 || file.open(&fs, "RUN1/part1", O_WRONLY | O_CREAT | O_APPEND) != 0)
+    {
+        printf("%5u mount/open failed\n", cache_units);
+        return;
+    }
+
+    uint8_t block[BLOCK_SIZE];
+    RecordEncoder encoder(block, BLOCK_SIZE);
+    rec_imu_t imu;
+    rec_analog_t analog, last_analog;
+    rec_pulses_t pulses;
+
+    auto flush = [&]()
+    {
+        uint64_t t0 = sd.now();
+
+        if (file.write(encoder.data(), encoder.length()) != (ssize_t)encoder.length())
+            ok = false;
+        if (sd.now() - t0 > write_max)
+            write_max = sd.now() - t0;
+        hash = hash_add(hash, encoder.data(), encoder.length());
+        bytes += encoder.length();
+        encoder.clear();
+    };
+
+    srand(1);
+    memset(&analog, 0, sizeof(analog));
+    memset(&last_analog, 0, sizeof(last_analog));
+    encoder.begin(SAMPLE_FREQ);
+    card.reset();
+    cache.reset_cache_stats();
+    uint64_t start = sd.now();
+    for (samples = 0; ok && samples < seconds * SAMPLE_FREQ; samples++)
+    {
+        uint32_t time = samples * 1000 / SAMPLE_FREQ;
+
+        make_sample(samples, &imu, &analog, &pulses);
+        while (!encoder.put(REC_IMU, time, &imu))
+            flush();
+        if (memcmp(&analog, &last_analog, sizeof(analog)) != 0)
+        {
+            while (!encoder.put(REC_ANALOG, time, &analog))
+                flush();
+            last_analog = analog;
+        }
+        if (pulses.pulses[0] || pulses.pulses[1])
+        {
+            while (!encoder.put(REC_PULSES, time, &pulses))
+                flush();
+        }
+
+        if (sync_every && ++since_sync >= sync_every)
+        {
+            uint64_t t0 = sd.now();
+
+            file.sync();
+            if (sd.now() - t0 > sync_max)
+                sync_max = sd.now() - t0;
+            since_sync = 0;
+        }
+    }
+    flush();
+    file.close();
+    uint64_t elapsed = sd.now() - start;
+    fs.unmount();
+
+    ProfilingBlockDevice::profile_t profile;
+    BufferedBlockDevice::cache_stats_t stats;
+    const ProfilingBlockDevice::op_profile_t *prog = &profile.op[ProfilingBlockDevice::PROFILE_PROGRAM];
+
+    card.snapshot(&profile);
+    cache.get_cache_stats(&stats);
+    if (cache_units)
+        cache.deinit();                             // FAT unmount leaves the device initialized
+
+    printf("%5u %8u %7.2f %7.1f %8.2f %7.2f %6u %6u %7u %s\n", cache_units, prog->count,
+           prog->count ? prog->bytes / 1024.0 / prog->count : 0.0,
+           elapsed ? bytes / 1024.0 / (elapsed / 1e6) : 0.0, write_max / 1000.0, sync_max / 1000.0,
+           stats.max_run, stats.fills, stats.bypassed,
+           ok && verify(&heap, bytes, hash) ? "ok" : "MISMATCH");
+}
+
+int main(int argc, char *argv[])
+{
+    SDTimingBlockDevice::timing_t timing;
+    uint32_t seconds = (argc > 1) ? atoi(argv[1]) : 300;
+    uint32_t sync_every = (argc > 3) ? atoi(argv[3]) : 50;
+
+    if (argc > 2)
+        timing.spi_hz = atoi(argv[2]);
+
+    printf("%u s of logging at %u Hz, SPI %u Hz, sync every %u samples\n\n", seconds, SAMPLE_FREQ, timing.spi_hz, sync_every);
+    printf("%5s %8s %7s %7s %8s %7s %6s %6s %7s %s\n", "cache", "programs", "KB/prog", "KB/s", "write ms", "sync ms",
+           "run", "fills", "bypass", "readback");
+    for (unsigned i = 0; i < sizeof(cache_sizes) / sizeof(cache_sizes[0]); i++)
+        run(cache_sizes[i], seconds, sync_every, timing);
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+    Host micro-benchmark of the CRC16 of SD card data blocks (CCITT 0x1021,
+    initial value 0, as SDBlockDevice computes it with CRC_ENABLED).
+    Four ways of computing it over 512-byte blocks:
+     - bitwise: a bit at a time, MbedCRC without tables,
+     - table: a byte at a time from Table_CRC_16bit_CCITT (crc-slices 1),
+     - MbedCRC: as configured by drivers.crc-slices (host/mbed_config.h),
+     - chunked: MbedCRC updated every 64 bytes, as SDBlockDevice streams a
+       block (CRC_CHUNK).
+    All four are checked against the bitwise result on random blocks and
+    against the check value of "123456789" (0x31c3).
+
+    It reports the host time stamp counter cycles and nanoseconds per byte,
+    the best of several rounds. These are host figures: what they compare
+    is the methods, the STM32F1 numbers are larger (no cache, flash wait
+    states) but in about the same ratios.
+
+    Usage: crc_bench [blocks]
+           default: 20000
+    Build (from tools/, see "host/mbed_config.h"):
+        M=../mbed-os
+        g++ -O2 -std=gnu++14 -include host/mbed_config.h -Ihost -I$M -I$M/platform -I$M/drivers \
+            -o crc_bench crc_bench.cpp host/mbed_stubs.cpp $M/drivers/{MbedCRC,TableCRC}.cpp
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "drivers/MbedCRC.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define BLOCK 512
+#define CHUNK 64                                    // CRC_CHUNK in SDBlockDevice.cpp
+#define ROUNDS 5
+
+using namespace mbed;
+
+typedef uint16_t (*crc_fn_t)(const uint8_t *data, uint32_t size);
+
+static uint16_t crc_bitwise(const uint8_t *data, uint32_t size)
+{
+    uint16_t crc = 0;
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ POLY_16BIT_CCITT : (crc << 1);
+    }
+    return crc;
+}
+
+static uint16_t crc_table(const uint8_t *data, uint32_t size)
+{
+    uint16_t crc = 0;
+
+    for (uint32_t i = 0; i < size; i++)
+        crc = Table_CRC_16bit_CCITT[(data[i] ^ (crc >> 8)) & 0xff] ^ (crc << 8);
+    return crc;
+}
+
+static MbedCRC<POLY_16BIT_CCITT, 16> sd_crc(0, 0, false, false);   // As SDBlockDevice::_crc16
+
+static uint16_t crc_mbed(const uint8_t *data, uint32_t size)
+{
+    uint32_t crc;
+
+    sd_crc.compute((void *)data, size, &crc);
+    return crc;
+}
+
+static uint16_t crc_chunked(const uint8_t *data, uint32_t size)
+{
+    uint32_t crc;
+
+    sd_crc.compute_partial_start(&crc);
+    for (uint32_t i = 0; i < size; i += CHUNK)
+        sd_crc.compute_partial((void *)(data + i), (size - i < CHUNK) ? size - i : CHUNK, &crc);
+    sd_crc.compute_partial_stop(&crc);
+    return crc;
+}
+
+static const struct
+{
+    const char *name;
+    crc_fn_t fn;
+} methods[] = {
+    { "bitwise", crc_bitwise }, { "table", crc_table }, { "MbedCRC", crc_mbed }, { "chunked", crc_chunked }
+};
+
+static uint64_t cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static uint64_t nanoseconds()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t blocks = (argc > 1) ? atoi(argv[1]) : 20000;
+    uint8_t *data = (uint8_t *)malloc((size_t)blocks * BLOCK);
+    const char *check = "123456789";
+    const uint32_t methods_count = sizeof(methods) / sizeof(methods[0]);
+    double bitwise_ns = 0;
+
+    if (data == NULL || blocks == 0)
+    {
+        fprintf(stderr, "can't allocate %u blocks\n", blocks);
+        return 1;
+    }
+    srand(1);
+    for (size_t i = 0; i < (size_t)blocks * BLOCK; i++)
+        data[i] = rand();
+
+    printf("CRC16 CCITT over %u blocks of %u bytes, drivers.crc-slices %d\n\n", blocks, BLOCK,
+           MBED_CONF_DRIVERS_CRC_SLICES);
+    printf("%-8s %6s %10s %8s %8s %7s %s\n", "method", "check", "cycles/B", "ns/B", "us/block", "speedup", "blocks");
+    for (uint32_t m = 0; m < methods_count; m++)
+    {
+        uint64_t best_cycles = UINT64_MAX, best_ns = UINT64_MAX;
+        uint32_t sink = 0, mismatches = 0;
+        uint16_t check_crc = methods[m].fn((const uint8_t *)check, strlen(check));
+
+        for (uint32_t b = 0; b < blocks && b < 1000; b++)
+        {
+            if (methods[m].fn(data + (size_t)b * BLOCK, BLOCK) != crc_bitwise(data + (size_t)b * BLOCK, BLOCK))
+                mismatches++;
+        }
+        for (int round = 0; round < ROUNDS; round++)
+        {
+            uint64_t c0 = cycles(), t0 = nanoseconds();
+
+            for (uint32_t b = 0; b < blocks; b++)
+                sink += methods[m].fn(data + (size_t)b * BLOCK, BLOCK);
+            uint64_t c = cycles() - c0, t = nanoseconds() - t0;
+            if (t < best_ns)
+            {
+                best_ns = t;
+                best_cycles = c;
+            }
+        }
+
+        double bytes = (double)blocks * BLOCK;
+        double ns = best_ns / bytes;
+        if (m == 0)
+            bitwise_ns = ns;                        // Speedup relative to bitwise
+        printf("%-8s %6s %10.2f %8.2f %8.2f %7.1f %s%s\n", methods[m].name, check_crc == 0x31c3 ? "ok" : "BAD",
+               best_cycles / bytes, ns, ns * BLOCK / 1000.0, bitwise_ns / ns, mismatches ? "MISMATCH" : "ok",
+               sink == 0x12345678 ? " " : "");      // Keeps the loop from being optimized out
+    }
+    free(data);
+    return 0;
+}
@@ -0,0 +1,124 @@
+/*
+    Host benchmark for the decimation filter ("Logger/Decimator.h").
+    For each ratio it reports the filter cost (ns/sample and, on x86, TSC
+    cycles/sample at the input rate) and the frequency response: gain of a
+    full-scale/2 sine, relative to the output rate fs. Tones above 0.5 fs show
+    how much they are attenuated before aliasing.
+
+    Usage: decim_bench [ratio ...]          default: 2 4 8 16
+    Build: g++ -O2 -o decim_bench decim_bench.cpp ../Logger/Decimator.cpp
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+#include "../Logger/Decimator.h"
+
+#define BENCH_SAMPLES (1 << 20)
+#define SETTLE 64                                   // Output samples ignored (filter transient)
+#define MEASURE 2048                                // Output samples measured
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench_speed(int ratio)
+{
+    static int16_t in[BENCH_SAMPLES];
+    static int16_t out[BENCH_SAMPLES];
+    Decimator dec(ratio);
+    uint32_t n = 0;
+
+    srand(1);
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+        in[i] = (rand() & 0xFFFF) - 32768;
+
+    double t0 = now_ns();
+#ifdef HAVE_TSC
+    uint64_t c0 = __rdtsc();
+#endif
+    for (int rep = 0; rep < 8; rep++)
+        n += dec.process(in, BENCH_SAMPLES, out);
+#ifdef HAVE_TSC
+    uint64_t c1 = __rdtsc();
+#endif
+    double t1 = now_ns();
+    double samples = 8.0 * BENCH_SAMPLES;
+
+    printf("ratio %2d: %6.2f ns/sample", ratio, (t1 - t0) / samples);
+#ifdef HAVE_TSC
+    printf(", %6.2f cycles/sample", (c1 - c0) / samples);
+#endif
+    printf(" (%u outputs, check %d)\n", n, out[n % BENCH_SAMPLES / 8]);
+}
+
+/* Gain of a tone at freq (relative to the output rate), in dB */
+static double gain_db(int ratio, double freq)
+{
+    Decimator dec(ratio);
+    double amp = 16000.0, sum = 0.0;
+    int outputs = 0;
+    uint32_t i = 0;
+
+    while (outputs < SETTLE + MEASURE)
+    {
+        int16_t out;
+        int16_t in = lrint(amp * sin(2.0 * M_PI * freq * i / ratio));
+
+        i++;
+        if (!dec.put(in, out))
+            continue;
+        if (outputs++ >= SETTLE)
+            sum += (double)out * out;
+    }
+
+    double rms = sqrt(sum / MEASURE);
+    return 20.0 * log10((rms + 1e-9) / (amp / sqrt(2.0)));
+}
+
+int main(int argc, char *argv[])
+{
+    static const double freqs[] = { 0.05, 0.1, 0.2, 0.25, 0.3, 0.4, 0.5, 0.6, 0.8, 1.0, 1.5, 2.5 };
+    int ratios[16] = { 2, 4, 8, 16 };
+    int num_ratios = 4;
+
+    if (argc > 1)
+    {
+        num_ratios = 0;
+        for (int i = 1; i < argc && num_ratios < 16; i++)
+            ratios[num_ratios++] = atoi(argv[i]);
+    }
+
+    printf("== Cost ==\n");
+    for (int r = 0; r < num_ratios; r++)
+        bench_speed(ratios[r]);
+
+    printf("\n== Frequency response (dB, freq relative to output rate) ==\n");
+    printf("freq  ");
+    for (int r = 0; r < num_ratios; r++)
+        printf("   R=%-3d", ratios[r]);
+    printf("\n");
+    for (unsigned f = 0; f < sizeof(freqs) / sizeof(freqs[0]); f++)
+    {
+        printf("%4.2f  ", freqs[f]);
+        for (int r = 0; r < num_ratios; r++)
+        {
+            /* Tones above the input Nyquist can't be generated */
+            if (freqs[f] >= ratios[r] / 2.0)
+                printf("%8s", "-");
+            else
+                printf("%8.2f", gain_db(ratios[r], freqs[f]));
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,253 @@
+/*
+    Host benchmark of private sector buffers (FF_FS_FILEBUF) for concurrent
+    FAT files. Three logger streams are appended in turn, as during a run:
+     - part1: the record stream in encoder blocks, synced every 50 samples,
+     - event1: a frame of IMU data every 4 samples, as an event dump,
+     - trace: 64 tracepoint entries at a time, without stdio buffer.
+    None of them writes whole sectors at sector boundaries, so at the tiny
+    configuration each stream takes the shared window in turn: its partial
+    sector is written back and the next stream's one read again. The run is
+    repeated with private buffers for none, part1, then part1 and event1
+    (the pool holds FF_FS_FILEBUF buffers), on the SD card timing model
+    (SDTimingBlockDevice) over a HeapBlockDevice. A ProfilingBlockDevice on
+    the virtual clock counts what reaches the card.
+
+    For each configuration it reports the card reads and programs, the bytes
+    programmed per byte logged, throughput and worst write() latency. The
+    files are then read back through a fresh mount and compared with what
+    was written.
+
+    Usage: filebuf_bench [seconds] [spi_hz]
+           default: 300 1000000
+    Build (from tools/, see "host/mbed_config.h"):
+        M=../mbed-os; S=$M/features/storage
+        g++ -O2 -std=gnu++14 -include host/mbed_config.h -Ihost -I$M -I$M/platform -I$M/drivers -I$S \
+            -I$S/blockdevice -I$S/filesystem -I$S/filesystem/fat -I$S/filesystem/fat/ChaN \
+            -o filebuf_bench filebuf_bench.cpp host/mbed_stubs.cpp ../Logger/RecordEncoder.cpp \
+            $S/blockdevice/{Heap,SDTiming,Profiling}BlockDevice.cpp \
+            $S/filesystem/{File,Dir,FileSystem}.cpp $S/filesystem/fat/FATFileSystem.cpp \
+            $S/filesystem/fat/ChaN/{ff,ffunicode}.cpp $M/platform/File{Base,Handle,Path,SystemHandle}.cpp
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "HeapBlockDevice.h"
+#include "SDTimingBlockDevice.h"
+#include "ProfilingBlockDevice.h"
+#include "FATFileSystem.h"
+#include "File.h"
+#include "../Logger/RecordEncoder.h"
+
+#define DEVICE_SIZE (1024ULL * 1024 * 1024)         // 1 GB card, sectors are allocated when written
+#define SECTOR 512
+#define SAMPLE_FREQ 200                             // As in main.cpp
+#define BLOCK_SIZE 512
+#define SYNC_EVERY 50                               // SAVE_WHEN in main.cpp
+#define EVENT_EVERY 4                               // Samples per event frame written
+#define EVENT_FRAME 40                              // Bytes per event frame
+#define TRACE_PER_SAMPLE 4                          // Tracepoints per sample
+#define TRACE_DUMP 64                               // Entries per dump (TRACE_RING / 2)
+#define TRACE_ENTRY 8                               // sizeof(trace_entry_t)
+#define TRACE_HEADER 16                             // sizeof(trace_header_t)
+
+using namespace mbed;
+
+enum { PART, EVENT, TRACE, STREAMS };
+
+static const char *const stream_names[STREAMS] = { "RUN1/part1", "RUN1/event1", "RUN1/trace" };
+
+/* Files given a private buffer, per configuration */
+static const char *const none[] = { NULL };
+static const char *const part_only[] = { "part", NULL };
+static const char *const part_event[] = { "part", "event", NULL };
+static const struct
+{
+    const char *name;
+    const char *const *prefixes;
+} configs[] = { { "shared", none }, { "part", part_only }, { "part+event", part_event } };
+
+/* FNV-1a, to compare the written and read back streams */
+static uint32_t hash_add(uint32_t hash, const uint8_t *data, size_t size)
+{
+    while (size--)
+    {
+        hash ^= *data++;
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+/* One logger sample, as in "fs_bench.cpp" */
+static void make_sample(uint32_t n, rec_imu_t *imu, rec_analog_t *analog, rec_pulses_t *pulses)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        imu->acc[i] = (rand() & 0x3FF) - 512;
+        imu->gyr[i] = (rand() & 0xFF) - 128;
+        if (n % 7 == 0)
+            analog->analog[i] = rand() & 0xFFF0;
+    }
+    pulses->pulses[0] = n % 3;
+    pulses->pulses[1] = 0;
+}
+
+/* Read the files back without private buffers, returns true if they match */
+static bool verify(BlockDevice *bd, const uint32_t *bytes, const uint32_t *hash)
+{
+    FATFileSystem fs("verify");
+    uint8_t buf[1000];                              // Not a multiple of the sector on purpose
+    bool ok = fs.mount(bd) == 0;
+
+    for (int s = 0; ok && s < STREAMS; s++)
+    {
+        File file;
+        uint32_t total = 0, read_hash = 2166136261u;
+        ssize_t n;
+
+        if (file.open(&fs, stream_names[s], O_RDONLY) != 0)
+            return false;
+        while ((n = file.read(buf, sizeof(buf))) > 0)
+        {
+            read_hash = hash_add(read_hash, buf, n);
+            total += n;
+        }
+        file.close();
+        ok = total == bytes[s] && read_hash == hash[s];
+    }
+    fs.unmount();
+    return ok;
+}
+
+static void run(const char *name, const char *const *prefixes, uint32_t seconds, const SDTimingBlockDevice::timing_t &timing)
+{
+    HeapBlockDevice heap(DEVICE_SIZE, SECTOR);
+    SDTimingBlockDevice sd(&heap, timing);
+    ProfilingBlockDevice card(&sd, callback(&sd, &SDTimingBlockDevice::clock));
+    FATFileSystem fs("sd");
+    File files[STREAMS];
+    uint64_t write_max = 0;
+    uint32_t samples, bytes[STREAMS] = { 0 }, hash[STREAMS], total = 0;
+    bool ok = true;
+
+    FATFileSystem::format(&card);
+    fs.set_private_buffers(prefixes);
+    if (fs.mount(&card) != 0 || fs.mkdir("RUN1", 0777) != 0)
+    {
+        printf("%-10s mount failed\n", name);
+        return;
+    }
+    for (int s = 0; s < STREAMS; s++)
+    {
+        hash[s] = 2166136261u;
+        if (files[s].open(&fs, stream_names[s], O_WRONLY | O_CREAT | O_TRUNC) != 0)
+        {
+            printf("%-10s open failed\n", name);
+            return;
+        }
+    }
+
+    uint8_t block[BLOCK_SIZE];
+    uint8_t event[EVENT_FRAME], trace[TRACE_DUMP * TRACE_ENTRY];
+    RecordEncoder encoder(block, BLOCK_SIZE);
+    rec_imu_t imu;
+    rec_analog_t analog, last_analog;
+    rec_pulses_t pulses;
+    uint32_t traced = 0;
+
+    auto write = [&](int s, const uint8_t *data, uint32_t size)
+    {
+        uint64_t t0 = sd.now();
+
+        if (files[s].write(data, size) != (ssize_t)size)
+            ok = false;
+        if (sd.now() - t0 > write_max)
+            write_max = sd.now() - t0;
+        hash[s] = hash_add(hash[s], data, size);
+        bytes[s] += size;
+    };
+    auto flush = [&]()
+    {
+        write(PART, encoder.data(), encoder.length());
+        encoder.clear();
+    };
+
+    srand(1);
+    memset(&analog, 0, sizeof(analog));
+    memset(&last_analog, 0, sizeof(last_analog));
+    memset(trace, 0x5A, sizeof(trace));
+    encoder.begin(SAMPLE_FREQ);
+    card.reset();
+    uint64_t start = sd.now();
+    write(TRACE, trace, TRACE_HEADER);
+    for (samples = 0; ok && samples < seconds * SAMPLE_FREQ; samples++)
+    {
+        uint32_t time = samples * 1000 / SAMPLE_FREQ;
+
+        make_sample(samples, &imu, &analog, &pulses);
+        while (!encoder.put(REC_IMU, time, &imu))
+            flush();
+        if (memcmp(&analog, &last_analog, sizeof(analog)) != 0)
+        {
+            while (!encoder.put(REC_ANALOG, time, &analog))
+                flush();
+            last_analog = analog;
+        }
+        if (pulses.pulses[0] || pulses.pulses[1])
+        {
+            while (!encoder.put(REC_PULSES, time, &pulses))
+                flush();
+        }
+
+        if (samples % EVENT_EVERY == 0)
+        {
+            memcpy(event, &imu, sizeof(imu) < sizeof(event) ? sizeof(imu) : sizeof(event));
+            write(EVENT, event, sizeof(event));
+        }
+        traced += TRACE_PER_SAMPLE;
+        if (traced >= TRACE_DUMP)
+        {
+            trace[0] = (uint8_t)samples;
+            write(TRACE, trace, sizeof(trace));
+            traced -= TRACE_DUMP;
+        }
+        if ((samples + 1) % SYNC_EVERY == 0)
+            files[PART].sync();
+    }
+    flush();
+    for (int s = 0; s < STREAMS; s++)
+    {
+        files[s].close();
+        total += bytes[s];
+    }
+    uint64_t elapsed = sd.now() - start;
+    fs.unmount();
+
+    ProfilingBlockDevice::profile_t profile;
+    const ProfilingBlockDevice::op_profile_t *read = &profile.op[ProfilingBlockDevice::PROFILE_READ];
+    const ProfilingBlockDevice::op_profile_t *prog = &profile.op[ProfilingBlockDevice::PROFILE_PROGRAM];
+
+    card.snapshot(&profile);
+    printf("%-10s %8u %8u %9.2f %7.1f %8.2f %s\n", name, read->count, prog->count,
+           total ? (double)prog->bytes / total : 0.0,
+           elapsed ? total / 1024.0 / (elapsed / 1e6) : 0.0, write_max / 1000.0,
+           ok && verify(&heap, bytes, hash) ? "ok" : "MISMATCH");
+}
+
+int main(int argc, char *argv[])
+{
+    SDTimingBlockDevice::timing_t timing;
+    uint32_t seconds = (argc > 1) ? atoi(argv[1]) : 300;
+
+    if (argc > 2)
+        timing.spi_hz = atoi(argv[2]);
+
+    printf("%u s of logging at %u Hz to 3 files, SPI %u Hz, %u private buffers\n\n", seconds, SAMPLE_FREQ,
+           timing.spi_hz, FF_FS_FILEBUF);
+    printf("%-10s %8s %8s %9s %7s %8s %s\n", "private", "reads", "programs", "prog/data", "KB/s", "write ms",
+           "readback");
+    for (unsigned i = 0; i < sizeof(configs) / sizeof(configs[0]); i++)
+        run(configs[i].name, configs[i].prefixes, seconds, timing);
+    return 0;
+}
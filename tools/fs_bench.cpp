@@ -0,0 +1,294 @@
+/*
+    Host benchmark of the logger storage backends: FATFileSystem against
+    LittleFileSystem with several geometries, on a HeapBlockDevice behind the
+    SD card timing model of SDTimingBlockDevice (SPI clock, command overhead,
+    busy time per sector, optional GC stalls), all on a virtual clock so
+    results are reproducible.
+
+    The workload is the logger's own record stream ("Logger/RecordEncoder.h"):
+    one IMU, three noisy analog inputs and two pulse channels at SAMPLE_FREQ,
+    written in BLOCK_SIZE chunks with a sync every SAVE_WHEN samples, as in
+    main.cpp. For each backend it reports the sustained append throughput,
+    mean and worst-case latency of write() and sync(), and RAM use (object
+    size, heap in use with the file open and its peak while logging).
+    File system CPU time is not part of the model.
+
+    Usage: fs_bench [seconds] [spi_hz] [sync_every] [gc_kb gc_ms]
+           default: 300 1000000 50, no GC stalls
+    Build (from tools/, see "host/mbed_config.h"):
+        M=../mbed-os; S=$M/features/storage
+        g++ -O2 -std=gnu++14 -include host/mbed_config.h -Ihost -I$M -I$M/platform -I$M/drivers -I$S \
+            -I$S/blockdevice -I$S/filesystem -I$S/filesystem/fat -I$S/filesystem/fat/ChaN \
+            -I$S/filesystem/littlefs -I$S/filesystem/littlefs/littlefs -o fs_bench fs_bench.cpp \
+            host/mbed_stubs.cpp ../Logger/RecordEncoder.cpp $S/blockdevice/{Heap,SDTiming}BlockDevice.cpp \
+            $S/filesystem/{File,Dir,FileSystem}.cpp $S/filesystem/fat/FATFileSystem.cpp \
+            $S/filesystem/fat/ChaN/{ff,ffunicode}.cpp $S/filesystem/littlefs/LittleFileSystem.cpp \
+            $M/platform/File{Base,Handle,Path,SystemHandle}.cpp $M/drivers/TableCRC.cpp \
+            -x c $S/filesystem/littlefs/littlefs/lfs.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <malloc.h>
+#include "HeapBlockDevice.h"
+#include "SDTimingBlockDevice.h"
+#include "FATFileSystem.h"
+#include "LittleFileSystem.h"
+#include "File.h"
+#include "../Logger/RecordEncoder.h"
+
+#define DEVICE_SIZE (1024ULL * 1024 * 1024)         // 1 GB card, sectors are allocated when written
+#define SECTOR 512
+#define SAMPLE_FREQ 200                             // As in main.cpp
+#define BLOCK_SIZE 512
+
+using namespace mbed;
+
+/* Heap accounting: glibc's malloc family wrapped through its __libc_ entry
+   points, so the file system allocations are counted exactly, with their peak */
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+static size_t heap_used, heap_peak;
+static bool heap_paused;                            // Set around the HeapBlockDevice storage
+
+static void *heap_count(void *ptr)
+{
+    if (ptr != NULL && !heap_paused)
+    {
+        heap_used += malloc_usable_size(ptr);
+        if (heap_used > heap_peak)
+            heap_peak = heap_used;
+    }
+    return ptr;
+}
+
+extern "C" void *malloc(size_t size)
+{
+    return heap_count(__libc_malloc(size));
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+    return heap_count(__libc_calloc(n, size));
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    if (ptr != NULL && !heap_paused)
+        heap_used -= malloc_usable_size(ptr);
+    return heap_count(__libc_realloc(ptr, size));
+}
+
+extern "C" void free(void *ptr)
+{
+    if (ptr != NULL && !heap_paused)
+        heap_used -= malloc_usable_size(ptr);
+    __libc_free(ptr);
+}
+
+/* Card storage, left out of the heap accounting */
+class UncountedHeapBlockDevice : public HeapBlockDevice
+{
+public:
+    UncountedHeapBlockDevice(bd_size_t size) : HeapBlockDevice(size, SECTOR) {}
+
+    virtual int init()
+    {
+        heap_paused = true;
+        int err = HeapBlockDevice::init();
+        heap_paused = false;
+        return err;
+    }
+    virtual int deinit()
+    {
+        heap_paused = true;
+        int err = HeapBlockDevice::deinit();
+        heap_paused = false;
+        return err;
+    }
+    virtual int program(const void *buffer, bd_addr_t addr, bd_size_t size)
+    {
+        heap_paused = true;                         // Sectors are allocated on first program
+        int err = HeapBlockDevice::program(buffer, addr, size);
+        heap_paused = false;
+        return err;
+    }
+};
+
+/* Latency of one kind of operation */
+typedef struct
+{
+    uint32_t count;
+    uint64_t total_us;
+    uint64_t max_us;
+} op_stats_t;
+
+static void op_add(op_stats_t *s, uint64_t us)
+{
+    s->count++;
+    s->total_us += us;
+    if (us > s->max_us)
+        s->max_us = us;
+}
+
+/* Backend under test, littlefs geometry is read/prog/block size and lookahead (blocks) */
+typedef struct
+{
+    const char *name;
+    bool fat;
+    lfs_size_t read_size, prog_size, block_size, lookahead;
+} backend_t;
+
+static const backend_t backends[] =
+{
+    { "fat",                        true,  0, 0, 0, 0 },
+    { "littlefs 64/64/512/512",     false, 64, 64, 512, 512 },      // Vendored defaults
+    { "littlefs 512/512/4096/512",  false, 512, 512, 4096, 512 },
+    { "littlefs 512/512/16384/512", false, 512, 512, 16384, 512 },
+    { "littlefs 512/512/512/32768", false, 512, 512, 512, 32768 },
+    { "littlefs mbed_app.json",     false, MBED_LFS_READ_SIZE, MBED_LFS_PROG_SIZE, MBED_LFS_BLOCK_SIZE, MBED_LFS_LOOKAHEAD },
+};
+
+/* One logger sample, with the signal statistics of a bench run */
+static void make_sample(uint32_t n, rec_imu_t *imu, rec_analog_t *analog, rec_pulses_t *pulses)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        imu->acc[i] = (rand() & 0x3FF) - 512;
+        imu->gyr[i] = (rand() & 0xFF) - 128;
+        if (n % 7 == 0)
+            analog->analog[i] = rand() & 0xFFF0;
+    }
+    pulses->pulses[0] = n % 3;
+    pulses->pulses[1] = 0;
+}
+
+static void run(const backend_t *b, uint32_t seconds, uint32_t sync_every, const SDTimingBlockDevice::timing_t &timing)
+{
+    UncountedHeapBlockDevice heap(DEVICE_SIZE);
+    SDTimingBlockDevice bd(&heap, timing);
+    FileSystem *fs;
+    size_t fs_size;
+    op_stats_t wr = {0, 0, 0}, sy = {0, 0, 0};
+    uint32_t samples, since_sync = 0, bytes = 0;
+    size_t heap_base, heap_open;
+    File file;
+
+    if (b->fat)
+    {
+        FATFileSystem::format(&bd);
+        fs = new FATFileSystem("sd");
+        fs_size = sizeof(FATFileSystem);
+    }
+    else
+    {
+        LittleFileSystem::format(&bd, b->read_size, b->prog_size, b->block_size, b->lookahead);
+        fs = new LittleFileSystem("sd", NULL, b->read_size, b->prog_size, b->block_size, b->lookahead);
+        fs_size = sizeof(LittleFileSystem);
+    }
+    heap_base = heap_used;                          // The object itself is counted apart
+
+    if (fs->mount(&bd) != 0 || fs->mkdir("RUN1", 0777) != 0 || file.open(fs, "RUN1/part1", O_WRONLY | O_CREAT | O_APPEND) != 0)
+    {
+        printf("%-26s mount/open failed\n", b->name);
+        delete fs;
+        return;
+    }
+
+    uint8_t block[BLOCK_SIZE];
+    RecordEncoder encoder(block, BLOCK_SIZE);
+    rec_imu_t imu;
+    rec_analog_t analog, last_analog;
+    rec_pulses_t pulses;
+    bool ok = true;
+
+    /* Same encoding as store_packet() and flush_block() in main.cpp */
+    auto flush = [&]()
+    {
+        uint64_t t0 = bd.now();
+
+        if (file.write(encoder.data(), encoder.length()) != (ssize_t)encoder.length())
+            ok = false;
+        op_add(&wr, bd.now() - t0);
+        bytes += encoder.length();
+        encoder.clear();
+    };
+
+    srand(1);
+    memset(&analog, 0, sizeof(analog));
+    memset(&last_analog, 0, sizeof(last_analog));
+    encoder.begin(SAMPLE_FREQ);
+    heap_open = heap_used - heap_base;              // Once per run transients (FAT mkdir clears the
+    heap_peak = heap_used;                          // new cluster from a 32 KB heap buffer) left out
+    uint64_t start = bd.now();
+    for (samples = 0; ok && samples < seconds * SAMPLE_FREQ; samples++)
+    {
+        uint32_t time = samples * 1000 / SAMPLE_FREQ;
+
+        make_sample(samples, &imu, &analog, &pulses);
+        while (!encoder.put(REC_IMU, time, &imu))
+            flush();
+        if (memcmp(&analog, &last_analog, sizeof(analog)) != 0)
+        {
+            while (!encoder.put(REC_ANALOG, time, &analog))
+                flush();
+            last_analog = analog;
+        }
+        if (pulses.pulses[0] || pulses.pulses[1])
+        {
+            while (!encoder.put(REC_PULSES, time, &pulses))
+                flush();
+        }
+
+        if (sync_every && ++since_sync >= sync_every)
+        {
+            uint64_t t0 = bd.now();
+
+            file.sync();
+            op_add(&sy, bd.now() - t0);
+            since_sync = 0;
+        }
+    }
+    flush();
+    if (!ok)
+        printf("%-26s write failed after %u bytes\n", b->name, bytes);
+    file.close();
+    uint64_t elapsed = bd.now() - start;
+    fs->unmount();
+    delete fs;
+
+    printf("%-26s %7.1f %9.2f %9.2f %8.2f %7.2f %7zu %7zu %7zu\n", b->name,
+           elapsed ? bytes / 1024.0 / (elapsed / 1e6) : 0.0,
+           wr.count ? wr.total_us / 1000.0 / wr.count : 0.0, wr.max_us / 1000.0,
+           sy.count ? sy.total_us / 1000.0 / sy.count : 0.0, sy.max_us / 1000.0,
+           fs_size, heap_open, heap_peak - heap_base);
+}
+
+int main(int argc, char *argv[])
+{
+    SDTimingBlockDevice::timing_t timing;
+    uint32_t seconds = (argc > 1) ? atoi(argv[1]) : 300;
+    uint32_t sync_every = (argc > 3) ? atoi(argv[3]) : 50;
+
+    if (argc > 2)
+        timing.spi_hz = atoi(argv[2]);
+    if (argc > 5)
+    {
+        timing.gc_interval = atoi(argv[4]) * 1024;
+        timing.gc_stall_us = atoi(argv[5]) * 1000;
+    }
+
+    printf("%u s of logging at %u Hz, SPI %u Hz, sync every %u samples", seconds, SAMPLE_FREQ, timing.spi_hz, sync_every);
+    if (timing.gc_interval)
+        printf(", %u ms GC stall every %u KB", timing.gc_stall_us / 1000, timing.gc_interval / 1024);
+    printf("\n\n");
+    printf("%-26s %7s %9s %9s %8s %7s %7s %7s %7s\n", "backend", "KB/s", "write ms", "max", "sync ms", "max", "object", "open", "peak");
+    for (unsigned i = 0; i < sizeof(backends) / sizeof(backends[0]); i++)
+        run(&backends[i], seconds, sync_every, timing);
+    return 0;
+}
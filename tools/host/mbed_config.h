@@ -0,0 +1,20 @@
+/*
+    Host build configuration, in place of the mbed_config.h generated by
+    mbed-cli. Only the options used by the storage stack are set; littlefs
+    geometry, the handle pool and the CRC tables follow mbed_app.json.
+*/
+
+#ifndef HOST_MBED_CONFIG_H
+#define HOST_MBED_CONFIG_H
+
+#define MBED_LFS_READ_SIZE      512
+#define MBED_LFS_PROG_SIZE      512
+#define MBED_LFS_BLOCK_SIZE     4096
+#define MBED_LFS_LOOKAHEAD      4096
+#define MBED_LFS_INTRINSICS     true
+#define MBED_LFS_ENABLE_INFO    false
+
+#define MBED_CONF_FILESYSTEM_HANDLE_POOL    6
+#define MBED_CONF_DRIVERS_CRC_SLICES        4
+
+#endif // HOST_MBED_CONFIG_H
@@ -0,0 +1,33 @@
+/*
+    Host build: the few mbed platform functions the storage stack links
+    against, without the rest of the platform (retarget, critical sections).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "platform/mbed_assert.h"
+#include "platform/mbed_atomic.h"
+#include "platform/FileHandle.h"
+
+extern "C" void mbed_assert_internal(const char *expr, const char *file, int line)
+{
+    fprintf(stderr, "assertion failed: %s, file: %s, line %d\n", expr, file, line);
+    abort();
+}
+
+extern "C" uint32_t core_util_atomic_incr_u32(volatile uint32_t *valuePtr, uint32_t delta)
+{
+    return __atomic_add_fetch(valuePtr, delta, __ATOMIC_SEQ_CST);
+}
+
+extern "C" uint32_t core_util_atomic_decr_u32(volatile uint32_t *valuePtr, uint32_t delta)
+{
+    return __atomic_sub_fetch(valuePtr, delta, __ATOMIC_SEQ_CST);
+}
+
+namespace mbed {
+void remove_filehandle(FileHandle *file)
+{
+    (void)file;
+}
+}
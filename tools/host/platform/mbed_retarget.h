@@ -0,0 +1,19 @@
+/*
+    Host build of mbed-os/platform/mbed_retarget.h.
+    mbed defines ssize_t and fsblkcnt_t itself, with other sizes than glibc
+    on 64-bit Linux. The system types are declared first and mbed's are
+    renamed, everything else comes from the real header.
+*/
+
+#ifndef HOST_MBED_RETARGET_H
+#define HOST_MBED_RETARGET_H
+
+#include <sys/types.h>
+
+#define ssize_t     mbed_ssize_t
+#define fsblkcnt_t  mbed_fsblkcnt_t
+#include_next <platform/mbed_retarget.h>
+#undef ssize_t
+#undef fsblkcnt_t
+
+#endif // HOST_MBED_RETARGET_H
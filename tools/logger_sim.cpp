@@ -0,0 +1,726 @@
+/*
+    Host simulation of the complete logger: "main.cpp" with the Logger and
+    LSM6DS3 sources and the real mbed storage stack (FATFileSystem or
+    LittleFileSystem, ProfilingBlockDevice, ...), built for Linux against the
+    simulated peripherals of "sim/". The card is a HeapBlockDevice or an image
+    file behind SDTimingBlockDevice, the inputs come from a script, and time
+    is virtual (see "sim/sim.h"), so runs are reproducible and independent of
+    the PC.
+
+    A run presses the start button once the logger waits for it, logs for
+    the given time, presses it again and decodes what reached the card:
+    samples expected from the ticker against samples stored, longest gap,
+    deepest acquisition queue, what the time went to (card, I2C, ADC, code
+    between reads of the time), the longest card operation and the host CPU
+    time per sample. --speedup multiplies the ticker rates; --find-max
+    searches the highest speedup without loss (each trial in a fresh
+    process), i.e. the maximum sustainable sample rate.
+
+    --replay feeds a recorded RUN directory (or part file) back through the
+    logger instead of the script signals, with its original timestamps
+    ("sim/replay.h"), for as long as the recording unless --seconds is
+    given. --speedup N replays it N times faster, --find-max as fast as it
+    goes through without loss. The output is checked against the recording:
+    byte-exact, equivalent (same samples at the same relative times) or
+    different, with the counts. --save copies the run's files from the
+    card, --queue-csv writes the queue depth every 100 ms.
+
+    Script lines (default: one LSM6DS3 at 0xD6, the three analog inputs,
+    both frequency channels and the first encoder busy, start button on PB_4):
+        imu <addr> [ax|ay|az|gx|gy|gz <offset> <amplitude> <freq_hz> [noise]]
+        analog <pin> <offset> <amplitude> <freq_hz> [noise]     (0..65535)
+        pulses <pin> <hz>
+        encoder <ch1 pin> <offset> <amplitude> <freq_hz> [noise]  (counts)
+        button <pin>                        start/stop button
+        edge <pin> rise|fall
+        at <ms> <line>                      apply a line at ms from the start press
+
+    Usage: logger_sim [--seconds N] [--speedup X] [--find-max] [--spi HZ]
+                      [--gc KB MS] [--image FILE] [--card-mb N] [--loop-us N]
+                      [--cpu-scale X] [--adc-us N] [--crc-ns N] [--console] [--replay RUN]
+                      [--save DIR] [--queue-csv FILE] [script]
+    Build (from tools/, see "sim/mbed.h"):
+        M=../mbed-os; S=$M/features/storage
+        g++ -O2 -std=gnu++14 -include sim/sim_config.h -Isim -Ihost -I$M -I$M/platform -I$M/drivers -I$S \
+            -I$S/blockdevice -I$S/filesystem -I$S/filesystem/fat -I$S/filesystem/fat/ChaN \
+            -I$S/filesystem/littlefs -I$S/filesystem/littlefs/littlefs -I../Logger -I../LSM6DS3 \
+            -o logger_sim logger_sim.cpp sim/{sim,peripherals,sim_stdio,run_reader,replay,SDBlockDevice,FileBlockDevice}.cpp \
+            host/mbed_stubs.cpp ../main.cpp ../Logger/{CardBench,CardLayout,DebugSink,Decimator,EventCapture,IMUGroup,MotionGate,PartRotator,QuadEncoder,RecordEncoder,SummaryStream,Telemetry,Trace}.cpp \
+            ../LSM6DS3/{LSM6DS3,LSM6DS3Bus}.cpp $S/blockdevice/{Heap,SDTiming,Profiling,Buffered}BlockDevice.cpp \
+            $S/filesystem/{File,Dir,FileSystem}.cpp $S/filesystem/fat/FATFileSystem.cpp \
+            $S/filesystem/fat/ChaN/{ff,ffunicode}.cpp $S/filesystem/littlefs/LittleFileSystem.cpp \
+            $M/platform/File{Base,Handle,Path,SystemHandle}.cpp $M/drivers/TableCRC.cpp \
+            -x c $S/filesystem/littlefs/littlefs/lfs.c ../Logger/telemetry_frame.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "sim.h"
+#include "sim_stdio.h"
+#include "replay.h"
+
+int logger_main();                                  // main() of "main.cpp"
+
+/* Outcome of one run */
+typedef struct
+{
+    double speedup;
+    double rate_hz;                                 // Stored sample rate
+    uint64_t expected, stored;
+    uint32_t max_gap_ms;
+    uint64_t dropped;                               // Bytes written after a buffer overflow closed the file
+    double drop_s;
+    double card_pct, bus_pct, adc_pct, loop_pct;    // Of the logging time
+    double max_card_ms;
+    uint32_t queue_max, queue_overwrites;           // Acquisition queue
+    uint64_t bytes;                                 // Written to the run's part files
+    double run_s, host_s;                           // Logging time, host CPU time
+    double cpu_us;                                  // Host CPU per stored sample
+    bool finished;
+
+    /* Replay verification, recorded samples against the samples written again */
+    uint64_t equal, differing, pulse_differing, missing;
+    uint64_t extra;                                 // Output samples where the recording has none (its losses)
+    uint64_t pulses_in, pulses_out;
+    bool byte_exact;
+} result_t;
+
+static const char *default_script =
+    "imu 0xD6 ax 0 2000 2 40\n"
+    "imu 0xD6 ay 0 2000 3 40\n"
+    "imu 0xD6 az 16384 1000 1 40\n"
+    "imu 0xD6 gx 0 500 1.5 8\n"
+    "imu 0xD6 gy 0 500 2.5 8\n"
+    "imu 0xD6 gz 0 300 0.5 8\n"
+    "analog PB_1 30000 8000 0.5 200\n"
+    "analog PB_0 20000 2000 5 200\n"
+    "analog PA_7 40000 0 0 100\n"
+    "pulses PB_5 300\n"
+    "pulses PB_6 40\n"
+    "encoder PA_8 0 100000 0.2\n"
+    "button PB_4\n";
+
+static std::string script;
+static const char *replay_path, *save_dir, *queue_csv;
+static PinName button = PB_4;
+static bool replay_to_end;
+static sim::stats_t at_start, at_stop;
+static std::vector<struct timed_line *> timed;      // Scheduled at the start press
+
+/* Apply one script line, returns false if it is not valid */
+static bool apply(const char *line);
+
+/* Script line applied at a later time */
+typedef struct timed_line
+{
+    std::string line;
+    uint32_t ms;
+    sim::event_t event;
+
+    void fire()
+    {
+        apply(line.c_str());
+    }
+} timed_line_t;
+
+static bool apply(const char *line)
+{
+    char word[16], arg[16], what[16];
+    sim::signal_t s = { 0, 0, 0, 0 };
+    float hz;
+    unsigned int ms;
+    int n;
+
+    if (sscanf(line, " %15s%n", word, &n) != 1 || word[0] == '#')
+        return true;
+    line += n;
+
+    if (strcmp(word, "at") == 0)
+    {
+        if (sscanf(line, "%u%n", &ms, &n) != 1)
+            return false;
+
+        timed_line_t *t = new timed_line_t;         // Lives until the end of the simulation
+        t->line = line + n;
+        t->ms = ms;
+        t->event.period = 0;
+        t->event.fire = mbed::callback(t, &timed_line_t::fire);
+        timed.push_back(t);
+        return true;
+    }
+    if (strcmp(word, "imu") == 0)
+    {
+        static const char *channels[SIM_IMU_CHANNELS] = { "ax", "ay", "az", "gx", "gy", "gz" };
+        unsigned int addr;
+
+        n = sscanf(line, "%i %15s %f %f %f %f", &addr, what, &s.offset, &s.amplitude, &s.freq_hz, &s.noise);
+        if (n == 1)
+        {
+            sim::set_imu_present(addr, true);
+            return true;
+        }
+        for (int c = 0; n >= 5 && c < SIM_IMU_CHANNELS; c++)
+        {
+            if (strcmp(what, channels[c]) == 0)
+            {
+                sim::set_imu(addr, c, s);
+                return true;
+            }
+        }
+        return false;
+    }
+    if (strcmp(word, "analog") == 0)
+    {
+        if (sscanf(line, "%15s %f %f %f %f", arg, &s.offset, &s.amplitude, &s.freq_hz, &s.noise) < 4 ||
+                sim::pin_by_name(arg) == NC)
+            return false;
+        sim::set_analog(sim::pin_by_name(arg), s);
+        return true;
+    }
+    if (strcmp(word, "pulses") == 0)
+    {
+        if (sscanf(line, "%15s %f", arg, &hz) != 2 || sim::pin_by_name(arg) == NC)
+            return false;
+        sim::set_pulses(sim::pin_by_name(arg), hz);
+        return true;
+    }
+    if (strcmp(word, "encoder") == 0)
+    {
+        if (sscanf(line, "%15s %f %f %f %f", arg, &s.offset, &s.amplitude, &s.freq_hz, &s.noise) < 4 ||
+                sim::pin_by_name(arg) == NC)
+            return false;
+        sim::set_encoder(sim::pin_by_name(arg), s);
+        return true;
+    }
+    if (strcmp(word, "button") == 0)
+    {
+        if (sscanf(line, "%15s", arg) != 1 || sim::pin_by_name(arg) == NC)
+            return false;
+        button = sim::pin_by_name(arg);
+        return true;
+    }
+    if (strcmp(word, "edge") == 0)
+    {
+        if (sscanf(line, "%15s %15s", arg, what) != 2 || sim::pin_by_name(arg) == NC)
+            return false;
+        sim::edge(sim::pin_by_name(arg), strcmp(what, "rise") == 0);
+        return true;
+    }
+    return false;
+}
+
+static bool load_script(const char *text)
+{
+    int number = 1;
+
+    for (const char *line = text; *line; number++)
+    {
+        const char *end = strchr(line, '\n');
+        std::string l(line, end ? end - line : strlen(line));
+
+        if (!apply(l.c_str()))
+        {
+            fprintf(stderr, "script line %d: %s\n", number, l.c_str());
+            return false;
+        }
+        line = end ? end + 1 : line + l.size();
+    }
+    return true;
+}
+
+/* Start and stop presses, retried until the logger has armed the button */
+static struct press
+{
+    sim::event_t event;
+    bool stop;
+
+    void fire()
+    {
+        if (!sim::edge_handled(button, false))
+        {
+            event.due = sim::now() + 10000.0;
+            sim::schedule(&event);
+            return;
+        }
+
+        if (!stop)
+        {
+            sim::stats.start_us = sim::now();
+            sim::stats.max_card_us = 0;             // Longest card operation while logging
+            at_start = sim::stats;
+            for (size_t i = 0; i < timed.size(); i++)
+            {
+                timed[i]->event.due = sim::now() + timed[i]->ms * 1000.0;
+                sim::schedule(&timed[i]->event);
+            }
+            stop = true;
+            event.due = sim::now() + sim::config.duration_ms * 1000.0;
+            sim::schedule(&event);
+        }
+        else if (replay_to_end && (sim::replay_end_us() == 0 || sim::now() < sim::replay_end_us()))
+        {
+            event.due = std::max(sim::replay_end_us(), sim::now() + 10000.0);    // The end of the recording
+            sim::schedule(&event);
+            return;
+        }
+        else
+        {
+            sim::stats.stop_us = sim::now();
+            at_stop = sim::stats;
+        }
+        sim::edge(button, false);
+    }
+} button_press;
+
+/* Stored samples and the longest gap between them */
+static void count_samples(const std::vector<sim::sample_t> &samples, result_t *r)
+{
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        if (samples[i].imu_mask == 0)
+            continue;
+        if (r->stored > 0 && samples[i].time - samples[i - 1].time > r->max_gap_ms)
+            r->max_gap_ms = samples[i].time - samples[i - 1].time;
+        r->stored++;
+    }
+}
+
+/* All the part files of a run in one buffer */
+static std::vector<uint8_t> run_bytes(const char *dir, FILE *(*open)(const char *, const char *),
+                                      int (*close)(FILE *))
+{
+    std::vector<uint8_t> bytes;
+    char name[256];
+    uint8_t chunk[4096];
+    FILE *fp;
+    size_t n;
+
+    for (int part = 1; snprintf(name, sizeof(name), "%s/part%d", dir, part), (fp = open(name, "rb")) != NULL; part++)
+    {
+        while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+            bytes.insert(bytes.end(), chunk, chunk + n);
+        close(fp);
+    }
+    return bytes;
+}
+
+static bool same_sample(const sim::sample_t &a, const sim::sample_t &b)
+{
+    for (int i = 0; i < QENC_MAX; i++)
+    {
+        if (a.qenc[i].position != b.qenc[i].position)   // Not the velocity: it spans the ticks each run lost
+            return false;
+    }
+    return a.imu_mask == b.imu_mask && memcmp(a.imu, b.imu, sizeof(a.imu)) == 0 &&
+           memcmp(&a.analog, &b.analog, sizeof(a.analog)) == 0;
+}
+
+/* Replay output against the recording, matching samples by their time since the first one
+   (both in ms, so up to a sample apart), equal values first */
+static void verify_replay(const std::vector<sim::sample_t> &out, double speedup, result_t *r)
+{
+    const std::vector<sim::sample_t> &in = sim::replay_samples();
+    double window = 1000.0 / (sim::replay_sample_freq() * speedup);    // One sample (ms)
+    size_t first = 0;
+    std::vector<bool> matched(in.size(), false);
+
+    for (size_t j = 0; j < out.size() && !in.empty(); j++)
+    {
+        double t = out[j].time - out[0].time;
+        size_t best = in.size();
+
+        while (first < in.size() && (in[first].time - in[0].time) / speedup < t - window)
+            first++;
+        for (size_t k = first; k < in.size() && (in[k].time - in[0].time) / speedup <= t + window; k++)
+        {
+            if (matched[k])
+                continue;
+            if (same_sample(in[k], out[j]))
+            {
+                best = k;
+                break;
+            }
+            if (fabs((in[k].time - in[0].time) / speedup - t) <= window / 2)
+                best = k;                           // Nearest, if none is equal
+        }
+        if (best == in.size())
+        {
+            r->extra++;
+            continue;
+        }
+        matched[best] = true;
+        if (same_sample(in[best], out[j]))
+            r->equal++;
+        else
+            r->differing++;
+        if (memcmp(&in[best].pulses, &out[j].pulses, sizeof(out[j].pulses)) != 0)
+            r->pulse_differing++;
+    }
+    for (size_t i = 0; i < in.size(); i++)
+    {
+        r->missing += !matched[i];
+        r->pulses_in += in[i].pulses.pulses[0] + in[i].pulses.pulses[1];
+    }
+    for (size_t j = 0; j < out.size(); j++)
+        r->pulses_out += out[j].pulses.pulses[0] + out[j].pulses.pulses[1];
+
+    r->byte_exact = run_bytes(replay_path, fopen, fclose) == run_bytes(sim::stdio_last_dir(), sim_fopen, sim_fclose);
+}
+
+/* Copy the run's part files and storage report from the card */
+static void save_run(const char *to)
+{
+    static const char *names[] = { "storage.txt", "trace", "bench.txt", "card.txt", "memory.txt", "summary" };
+    const int num_names = sizeof(names) / sizeof(names[0]);
+    char from[256], dest[256], name[32];
+    uint8_t chunk[4096];
+    FILE *in, *out;
+    size_t n;
+
+    mkdir(to, 0777);
+    for (int i = 0; ; i++)
+    {
+        if (i < num_names)
+            snprintf(name, sizeof(name), "%s", names[i]);
+        else
+            snprintf(name, sizeof(name), "part%d", i - num_names + 1);
+        snprintf(from, sizeof(from), "%s/%s", sim::stdio_last_dir(), name);
+        if ((in = sim_fopen(from, "rb")) == NULL)
+        {
+            if (i < num_names)
+                continue;                           // Only with STORAGE_PROFILE, TRACE, CARD_BENCH, SUMMARY_MS
+            break;
+        }
+        snprintf(dest, sizeof(dest), "%s/%s", to, name);
+        if ((out = fopen(dest, "wb")) != NULL)
+        {
+            while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0)
+                fwrite(chunk, 1, n, out);
+            fclose(out);
+        }
+        sim_fclose(in);
+    }
+}
+
+static double percent(uint64_t part, uint64_t whole)
+{
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+static void run(double speedup, uint32_t seconds, result_t *r)
+{
+    std::vector<sim::sample_t> samples;
+    struct timespec t0, t1;
+    uint16_t sample_freq = 0;
+
+    memset(r, 0, sizeof(*r));
+    r->speedup = speedup;
+    sim::config.speedup = speedup;
+    sim::config.duration_ms = seconds * 1000;
+    replay_to_end = (seconds == 0);                 // Stop after the last recorded sample
+    sim::stats.start_us = sim::stats.stop_us = UINT64_MAX;
+    if (!load_script(script.c_str()))
+        exit(1);
+    button_press.stop = false;
+    button_press.event.due = sim::config.start_ms * 1000.0;
+    button_press.event.period = 0;
+    button_press.event.fire = mbed::callback(&button_press, &press::fire);
+    sim::schedule(&button_press.event);
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t0);
+    sim::heap_exempt(false);                        // Heap statistics of the logger only
+    logger_main();
+    sim::heap_exempt(true);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t1);
+    r->finished = sim::stats.reset;
+    r->host_s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    sim::stdio_close_all();
+
+    sim::read_run(sim::stdio_last_dir(), sim_fopen, sim_fclose, samples, &sample_freq);
+    count_samples(samples, r);
+    r->bytes = run_bytes(sim::stdio_last_dir(), sim_fopen, sim_fclose).size();
+    r->dropped = sim::stdio_dropped(NULL);
+    if (r->dropped)
+    {
+        uint64_t first_us;
+        sim::stdio_dropped(&first_us);
+        r->drop_s = (first_us - at_start.start_us) / 1e6;
+    }
+    if (sim::replay_loaded())
+        verify_replay(samples, speedup, r);
+    if (save_dir != NULL)
+        save_run(save_dir);
+
+    /* Ticker interrupts per stored sample (OVERSAMPLE) from the ticker and header rates */
+    double tick_hz = sim::stats.tick_hz_x1000 / 1000.0;
+    r->rate_hz = sample_freq * speedup;
+    uint64_t oversample = (r->rate_hz > 0 && tick_hz > r->rate_hz) ? (uint64_t)(tick_hz / r->rate_hz + 0.5) : 1;
+    r->expected = at_stop.ticks / oversample;
+
+    r->run_s = (at_stop.stop_us - at_start.start_us) / 1e6;
+    r->card_pct = percent(at_stop.card_us - at_start.card_us, at_stop.stop_us - at_start.start_us);
+    r->bus_pct = percent(at_stop.bus_us - at_start.bus_us, at_stop.stop_us - at_start.start_us);
+    r->adc_pct = percent(at_stop.adc_us - at_start.adc_us, at_stop.stop_us - at_start.start_us);
+    r->loop_pct = percent(at_stop.loop_us - at_start.loop_us, at_stop.stop_us - at_start.start_us);
+    r->max_card_ms = at_stop.max_card_us / 1000.0;
+    r->queue_max = at_stop.queue_max;
+    r->queue_overwrites = at_stop.queue_overwrites;
+    r->cpu_us = r->stored ? r->host_s * 1e6 / r->stored : 0;
+
+    if (queue_csv != NULL)
+    {
+        FILE *f = fopen(queue_csv, "w");
+        const std::vector<uint32_t> &depths = sim::queue_depths();
+
+        if (f != NULL)
+        {
+            fprintf(f, "time_ms,max_depth\n");
+            for (size_t i = 0; i < depths.size(); i++)
+                fprintf(f, "%lu,%u\n", (unsigned long)(i * sim::config.queue_ms), depths[i]);
+            fclose(f);
+        }
+    }
+}
+
+/* A run in a child process, so the logger globals start fresh */
+static bool run_child(double speedup, uint32_t seconds, result_t *r)
+{
+    int fd[2];
+    pid_t pid;
+    bool ok;
+
+    if (pipe(fd) != 0)
+        return false;
+    fflush(stdout);
+    if ((pid = fork()) == 0)
+    {
+        close(fd[0]);
+        run(speedup, seconds, r);
+        ok = write(fd[1], r, sizeof(*r)) == sizeof(*r);
+        _exit(ok ? 0 : 1);
+    }
+    close(fd[1]);
+    ok = pid > 0 && read(fd[0], r, sizeof(*r)) == sizeof(*r);
+    close(fd[0]);
+    if (pid > 0)
+        waitpid(pid, NULL, 0);
+    if (!ok)
+    {
+        memset(r, 0, sizeof(*r));
+        r->speedup = speedup;
+    }
+    return ok;
+}
+
+static bool sustained(const result_t *r)
+{
+    /* Up to 2 samples may still be in the buffer at the stop press */
+    bool ok = r->finished && r->dropped == 0 && r->queue_overwrites == 0 && r->stored + 2 >= r->expected;
+
+    if (sim::replay_loaded())
+        ok = ok && r->differing == 0 && r->missing <= 2;
+    return ok;
+}
+
+static void print_header()
+{
+    printf("%7s %8s %8s %8s %6s %6s %5s %6s %6s %6s %6s %8s %7s\n", "speedup", "rate Hz", "expected", "stored",
+           "lost", "gap ms", "queue", "card%", "I2C%", "ADC%", "code%", "card max", "CPU us");
+}
+
+static void print_result(const result_t *r)
+{
+    printf("%7.2f %8.0f %8llu %8llu %6lld %6u %5u %6.1f %6.1f %6.1f %6.1f %8.2f %7.1f", r->speedup, r->rate_hz,
+           (unsigned long long)r->expected, (unsigned long long)r->stored, (long long)(r->expected - r->stored),
+           r->max_gap_ms, r->queue_max, r->card_pct, r->bus_pct, r->adc_pct, r->loop_pct, r->max_card_ms, r->cpu_us);
+    if (!r->finished)
+        printf("  did not finish");
+    else if (r->dropped || r->queue_overwrites)
+        printf("  buffer overflow at %.1f s, %u samples and %llu bytes dropped", r->drop_s, r->queue_overwrites,
+               (unsigned long long)r->dropped);
+    if (sim::replay_loaded() && r->finished)
+        printf("  %s", (r->byte_exact) ? "byte-exact" : (r->differing || r->missing > 2) ? "DIFFERS" : "equivalent");
+    printf("\n");
+}
+
+static void print_details(const result_t *r)
+{
+    printf("\nthroughput: %.0f samples/s, %.1f KB/s to the card; %.0f x real time on this host (%.0f samples/s)\n",
+           r->stored / r->run_s, r->bytes / 1024.0 / r->run_s, r->host_s > 0 ? r->run_s / r->host_s : 0,
+           r->host_s > 0 ? r->stored / r->host_s : 0);
+    printf("drops: %lld acquisition ticks missed, %u samples overwritten in the full queue, %llu bytes after the overflow\n",
+           (long long)(r->expected - r->stored), r->queue_overwrites, (unsigned long long)r->dropped);
+    if (!sim::replay_loaded())
+        return;
+    printf("replay of %s: %llu samples, %llu equal, %llu differing, %llu missing, %llu more in gaps of the recording; "
+           "pulses %llu recorded, %llu logged (%llu samples differ); output %s byte-exact\n",
+           replay_path, (unsigned long long)sim::replay_samples().size(), (unsigned long long)r->equal,
+           (unsigned long long)r->differing, (unsigned long long)r->missing, (unsigned long long)r->extra,
+           (unsigned long long)r->pulses_in, (unsigned long long)r->pulses_out, (unsigned long long)r->pulse_differing,
+           r->byte_exact ? "is" : "is not");
+}
+
+static char *read_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    char *text;
+    long size;
+
+    if (f == NULL)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    rewind(f);
+    text = (char *)calloc(size + 1, 1);
+    if (fread(text, 1, size, f) != (size_t)size)
+        size = 0;
+    text[size] = 0;
+    fclose(f);
+    return text;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t seconds = 60;
+    double speedup = 1.0;
+    bool find_max = false, seconds_set = false;
+    result_t r;
+
+    sim::heap_exempt(true);
+    script = default_script;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *a = argv[i];
+        bool more = i + 1 < argc;
+
+        if (strcmp(a, "--seconds") == 0 && more)
+        {
+            seconds = atoi(argv[++i]);
+            seconds_set = true;
+        }
+        else if (strcmp(a, "--speedup") == 0 && more)
+            speedup = atof(argv[++i]);
+        else if (strcmp(a, "--find-max") == 0)
+            find_max = true;
+        else if (strcmp(a, "--spi") == 0 && more)
+            sim::config.timing.spi_hz = atoi(argv[++i]);
+        else if (strcmp(a, "--gc") == 0 && i + 2 < argc)
+        {
+            sim::config.timing.gc_interval = atoi(argv[++i]) * 1024;
+            sim::config.timing.gc_stall_us = atoi(argv[++i]) * 1000;
+        }
+        else if (strcmp(a, "--image") == 0 && more)
+            sim::config.image = argv[++i];
+        else if (strcmp(a, "--card-mb") == 0 && more)
+            sim::config.card_size = atoll(argv[++i]) * 1024 * 1024;
+        else if (strcmp(a, "--loop-us") == 0 && more)
+            sim::config.loop_us = atoi(argv[++i]);
+        else if (strcmp(a, "--cpu-scale") == 0 && more)
+            sim::config.cpu_scale = atof(argv[++i]);
+        else if (strcmp(a, "--adc-us") == 0 && more)
+            sim::config.adc_us = atoi(argv[++i]);
+        else if (strcmp(a, "--crc-ns") == 0 && more)
+            sim::config.crc_ns = atoi(argv[++i]);
+        else if (strcmp(a, "--console") == 0)
+            sim::config.console = true;
+        else if (strcmp(a, "--replay") == 0 && more)
+            replay_path = argv[++i];
+        else if (strcmp(a, "--save") == 0 && more)
+            save_dir = argv[++i];
+        else if (strcmp(a, "--queue-csv") == 0 && more)
+            queue_csv = argv[++i];
+        else if (a[0] != '-')
+        {
+            char *text = read_file(a);
+            if (text == NULL)
+            {
+                fprintf(stderr, "can't read %s\n", a);
+                return 1;
+            }
+            script = text;
+            free(text);
+        }
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", a);
+            return 1;
+        }
+    }
+
+    if (replay_path != NULL)
+    {
+        if (!sim::replay_load(replay_path))
+        {
+            fprintf(stderr, "no samples in %s\n", replay_path);
+            return 1;
+        }
+        if (script == default_script)
+            script = "button PB_4\n";              // Inputs from the recording
+        if (!seconds_set)
+            seconds = 0;
+        printf("replay of %s, ", replay_path);
+    }
+
+    if (seconds > 0)
+        printf("%u s per run, ", seconds);
+    printf("SPI %u Hz", sim::config.timing.spi_hz);
+    if (sim::config.timing.gc_interval)
+        printf(", %u ms GC stall every %u KB", sim::config.timing.gc_stall_us / 1000, sim::config.timing.gc_interval / 1024);
+    if (sim::config.cpu_scale > 0)
+        printf(", code time = host CPU x %.1f", sim::config.cpu_scale);
+    else
+        printf(", %u us of code per read of the time", sim::config.loop_us);
+    printf("\n\n");
+    print_header();
+
+    if (!find_max)
+    {
+        run(speedup, seconds, &r);
+        print_result(&r);
+        print_details(&r);
+        return sustained(&r) ? 0 : 3;
+    }
+
+    /* Double (or halve) until the outcome changes, then bisect */
+    double good = 0, bad = 0;
+    for (int i = 0; i < 16 && (good == 0 || bad == 0); i++)
+    {
+        run_child(speedup, seconds, &r);
+        print_result(&r);
+        if (sustained(&r))
+        {
+            good = speedup;
+            speedup *= 2;
+        }
+        else
+        {
+            bad = speedup;
+            speedup /= 2;
+        }
+    }
+    for (int i = 0; i < 6 && good > 0 && bad > 0; i++)
+    {
+        speedup = (good + bad) / 2;
+        run_child(speedup, seconds, &r);
+        print_result(&r);
+        if (sustained(&r))
+            good = speedup;
+        else
+            bad = speedup;
+    }
+    if (good == 0)
+        printf("\nno speedup tried was sustained\n");
+    else
+        printf("\nmaximum sustained speedup %.2f (%.0f Hz stored)\n", good, good * r.rate_hz / r.speedup);
+    return 0;
+}
@@ -0,0 +1,307 @@
+/*
+    RAM budget of the logger from the GCC linker map (mbed compile leaves
+    it at BUILD/<target>/GCC_ARM/<project>.map).
+    Every input section placed in RAM (the "RAM" memory region, or the .data
+    and .bss output sections of a map without regions) is counted under a
+    subsystem: by object file for the libraries and the Logger sources, by
+    symbol for the globals of main.cpp. The heap and stack reservations of
+    the linker script come last, with the RAM left over.
+    With -v, the sections of each subsystem follow, largest first.
+
+    Usage:
+        ram_report [-v] <map>
+    Build: gcc -O2 -o ram_report ram_report.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MAX_LINE 1024
+#define MAX_SECTIONS 4096
+
+/* Subsystems, in report order */
+enum
+{
+    SUB_ACQUISITION, SUB_ENCODING, SUB_STORAGE, SUB_FILESYSTEM, SUB_EVENTS, SUB_TRACE, SUB_DEBUG,
+    SUB_RTOS, SUB_MBED, SUB_LIBC, SUB_OTHER, SUBSYSTEMS
+};
+
+static const char *sub_names[SUBSYSTEMS] = {
+    "acquisition", "encoding", "storage", "filesystem", "events", "trace", "debug/telemetry",
+    "rtos", "mbed-os", "libc", "other"
+};
+
+/* Object files, by path substring, first match */
+static const struct
+{
+    const char *path;
+    int sub;
+} object_rules[] = {
+    { "IMUGroup", SUB_ACQUISITION }, { "Decimator", SUB_ACQUISITION }, { "LSM6DS3", SUB_ACQUISITION },
+    { "QuadEncoder", SUB_ACQUISITION }, { "MotionGate", SUB_ACQUISITION },
+    { "RecordEncoder", SUB_ENCODING }, { "SummaryStream", SUB_ENCODING },
+    { "PartRotator", SUB_STORAGE }, { "CardBench", SUB_STORAGE }, { "CardLayout", SUB_STORAGE },
+    { "BlockDevice", SUB_STORAGE }, { "COMPONENT_SD", SUB_STORAGE },
+    { "filesystem", SUB_FILESYSTEM },
+    { "EventCapture", SUB_EVENTS },
+    { "Trace", SUB_TRACE },
+    { "DebugSink", SUB_DEBUG }, { "Telemetry", SUB_DEBUG }, { "telemetry_frame", SUB_DEBUG },
+    { "rtos", SUB_RTOS }, { "rtx", SUB_RTOS }, { "RTX", SUB_RTOS },
+    { "mbed-os", SUB_MBED },
+    { "lib", SUB_LIBC },                            // libc.a(...), libstdc++, libgcc, libnosys
+};
+
+/* Globals of main.cpp (static locals by their own name) */
+static const struct
+{
+    const char *name;
+    int sub;
+} main_rules[] = {
+    { "buffer", SUB_ACQUISITION }, { "acq_pck", SUB_ACQUISITION }, { "imu_dec", SUB_ACQUISITION },
+    { "adc_dec", SUB_ACQUISITION }, { "imus", SUB_ACQUISITION }, { "imu_bus", SUB_ACQUISITION },
+    { "imu0", SUB_ACQUISITION }, { "imu0_if", SUB_ACQUISITION }, { "imu1", SUB_ACQUISITION },
+    { "imu1_if", SUB_ACQUISITION }, { "pot0", SUB_ACQUISITION }, { "pot1", SUB_ACQUISITION },
+    { "pot2", SUB_ACQUISITION }, { "acq", SUB_ACQUISITION }, { "t", SUB_ACQUISITION },
+    { "freq_chan1", SUB_ACQUISITION }, { "freq_chan2", SUB_ACQUISITION }, { "start", SUB_ACQUISITION },
+    { "qenc", SUB_ACQUISITION }, { "qenc_pins", SUB_ACQUISITION }, { "gate", SUB_ACQUISITION },
+    { "block", SUB_ENCODING }, { "encoder", SUB_ENCODING }, { "last_analog", SUB_ENCODING },
+    { "last_qenc", SUB_ENCODING }, { "rate_changes", SUB_ENCODING }, { "log_rate", SUB_ENCODING },
+    { "part_rate", SUB_ENCODING }, { "summary", SUB_ENCODING }, { "summary_block", SUB_ENCODING },
+    { "summary_buffer", SUB_STORAGE },
+    { "sd", SUB_STORAGE }, { "card", SUB_STORAGE }, { "storage", SUB_STORAGE }, { "cache_buffer", SUB_STORAGE },
+    { "parts", SUB_STORAGE }, { "part_buffers", SUB_STORAGE }, { "text_buffer", SUB_STORAGE },
+    { "bench", SUB_STORAGE }, { "layout", SUB_STORAGE }, { "profile", SUB_STORAGE },
+    { "fileSystem", SUB_FILESYSTEM }, { "private_files", SUB_FILESYSTEM },
+    { "events", SUB_EVENTS }, { "event_buffer", SUB_EVENTS }, { "imu_int1", SUB_EVENTS },
+    { "trace", SUB_TRACE },
+    { "pc", SUB_DEBUG }, { "telemetry", SUB_DEBUG }, { "signal_wave", SUB_DEBUG },
+};
+
+typedef struct
+{
+    char name[96];                                  // Section name, without .data. / .bss.
+    char object[96];                                // Object file (last path component)
+    uint64_t size;
+    int bss;
+    int sub;
+} section_t;
+
+static section_t sections[MAX_SECTIONS];
+static int num_sections;
+
+/* Name of a main.cpp global from its section: plain, or the last
+   identifier of a mangled static local (_ZZ4mainE7acq_pck) */
+static const char *symbol_name(const char *section, char *out, size_t size)
+{
+    const char *s = strchr(section + 1, '.');
+    const char *p;
+
+    s = (s != NULL) ? s + 1 : section;
+    if (strncmp(s, "_Z", 2) != 0)
+    {
+        snprintf(out, size, "%s", s);
+        return out;
+    }
+    p = s + strlen(s);
+    while (p > s && !(p[-1] >= '0' && p[-1] <= '9'))
+        p--;
+    snprintf(out, size, "%s", p);
+    return out;
+}
+
+static int classify(const char *section, const char *object)
+{
+    char name[96];
+    size_t i;
+
+    if (strstr(object, "main.") != NULL && strstr(object, ".a(") == NULL)
+    {
+        symbol_name(section, name, sizeof(name));
+        for (i = 0; i < sizeof(main_rules) / sizeof(main_rules[0]); i++)
+        {
+            if (strcmp(name, main_rules[i].name) == 0)
+                return main_rules[i].sub;
+        }
+        return SUB_OTHER;
+    }
+    for (i = 0; i < sizeof(object_rules) / sizeof(object_rules[0]); i++)
+    {
+        if (strstr(object, object_rules[i].path) != NULL)
+            return object_rules[i].sub;
+    }
+    return SUB_OTHER;
+}
+
+static void add_section(const char *name, uint64_t size, const char *object, const char *output)
+{
+    section_t *s;
+    const char *base = strrchr(object, '/');
+
+    if (size == 0 || num_sections == MAX_SECTIONS)
+        return;
+    s = &sections[num_sections++];
+    s->size = size;
+    s->bss = strstr(output, "bss") != NULL || strcmp(name, "COMMON") == 0;
+    s->sub = classify(name, object);
+    snprintf(s->name, sizeof(s->name), "%.95s", name);
+    snprintf(s->object, sizeof(s->object), "%.95s", base ? base + 1 : object);
+}
+
+static int by_size(const void *a, const void *b)
+{
+    const section_t *x = (const section_t *)a, *y = (const section_t *)b;
+
+    if (x->sub != y->sub)
+        return x->sub - y->sub;
+    return (x->size < y->size) - (x->size > y->size);
+}
+
+int main(int argc, char *argv[])
+{
+    char line[MAX_LINE], pending[MAX_LINE] = "", output[128] = "";
+    uint64_t ram_origin = 0, ram_length = 0, heap = 0, stack = 0, fill = 0;
+    uint64_t data[SUBSYSTEMS] = { 0 }, bss[SUBSYSTEMS] = { 0 }, total = 0;
+    int verbose = 0, in_map = 0, in_memory = 0;
+    const char *path;
+    FILE *f;
+
+    if (argc > 1 && strcmp(argv[1], "-v") == 0)
+    {
+        verbose = 1;
+        argv++;
+        argc--;
+    }
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: ram_report [-v] <map>\n");
+        return 1;
+    }
+    path = argv[1];
+    if ((f = fopen(path, "r")) == NULL)
+    {
+        perror(path);
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        char name[MAX_LINE], object[MAX_LINE];
+        unsigned long long addr, size, origin, length;
+        int n;
+
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strncmp(line, "Memory Configuration", 20) == 0)
+            in_memory = 1;
+        else if (strncmp(line, "Linker script and memory map", 28) == 0)
+        {
+            in_memory = 0;
+            in_map = 1;
+        }
+        if (in_memory)
+        {
+            if (sscanf(line, "%1023s %llx %llx", name, &origin, &length) == 3 && strcmp(name, "RAM") == 0)
+            {
+                ram_origin = origin;
+                ram_length = length;
+            }
+            continue;
+        }
+        if (!in_map)
+            continue;
+
+        /* Output section: ".bss   0x20000100   0x1234" (or name alone, wrapped) */
+        if (line[0] == '.')
+        {
+            n = sscanf(line, "%127s %llx %llx", output, &addr, &size);
+            if (n == 3 && strcmp(output, ".heap") == 0)
+                heap = size;
+            else if (n == 3 && strncmp(output, ".stack", 6) == 0)
+                stack = size;
+            pending[0] = '\0';
+            continue;
+        }
+
+        /* Input section: " .bss.name  0x20000100  0x40 obj.o", maybe wrapped after the name */
+        if (line[0] == ' ' && (line[1] == '.' || strncmp(line + 1, "COMMON", 6) == 0 ||
+                               strncmp(line + 1, "*fill*", 6) == 0))
+        {
+            n = sscanf(line, "%1023s %llx %llx %1023[^\n]", name, &addr, &size, object);
+            if (n == 1)
+            {
+                snprintf(pending, sizeof(pending), "%s", name);
+                continue;
+            }
+        }
+        else if (pending[0] != '\0' && sscanf(line, " %llx %llx %1023[^\n]", &addr, &size, object) == 3)
+        {
+            snprintf(name, sizeof(name), "%s", pending);
+            n = 4;
+        }
+        else
+        {
+            pending[0] = '\0';
+            continue;
+        }
+        pending[0] = '\0';
+        if (n < 3 || strcmp(output, ".heap") == 0 || strncmp(output, ".stack", 6) == 0)
+            continue;
+        if (ram_length ? (addr < ram_origin || addr >= ram_origin + ram_length)
+                       : (strncmp(output, ".data", 5) != 0 && strncmp(output, ".bss", 4) != 0))
+            continue;
+        if (strcmp(name, "*fill*") == 0)
+            fill += size;
+        else
+            add_section(name, size, n == 4 ? object : "", output);
+    }
+    fclose(f);
+
+    for (int i = 0; i < num_sections; i++)
+    {
+        if (sections[i].bss)
+            bss[sections[i].sub] += sections[i].size;
+        else
+            data[sections[i].sub] += sections[i].size;
+        total += sections[i].size;
+    }
+    total += fill;
+
+    if (ram_length)
+        printf("RAM %llu B at 0x%08llx\n\n", (unsigned long long)ram_length, (unsigned long long)ram_origin);
+    printf("%-16s %8s %8s %8s %6s\n", "subsystem", "data", "bss", "total", ram_length ? "% RAM" : "");
+    for (int s = 0; s < SUBSYSTEMS; s++)
+    {
+        if (data[s] + bss[s] == 0)
+            continue;
+        printf("%-16s %8llu %8llu %8llu", sub_names[s], (unsigned long long)data[s], (unsigned long long)bss[s],
+               (unsigned long long)(data[s] + bss[s]));
+        if (ram_length)
+            printf(" %6.1f", 100.0 * (data[s] + bss[s]) / ram_length);
+        printf("\n");
+    }
+    if (fill)
+        printf("%-16s %8s %8s %8llu\n", "alignment", "", "", (unsigned long long)fill);
+    printf("%-16s %8s %8s %8llu", "static total", "", "", (unsigned long long)total);
+    if (ram_length)
+        printf(" %6.1f", 100.0 * total / ram_length);
+    printf("\n");
+    if (heap || stack)
+        printf("%-16s %8s %8s %8llu\n%-16s %8s %8s %8llu\n", "heap", "", "", (unsigned long long)heap, "stack", "",
+               "", (unsigned long long)stack);
+    if (ram_length)
+        printf("%-16s %8s %8s %8lld\n", "left", "", "", (long long)(ram_length - total - heap - stack));
+
+    if (verbose)
+    {
+        qsort(sections, num_sections, sizeof(sections[0]), by_size);
+        for (int i = 0; i < num_sections; i++)
+        {
+            if (i == 0 || sections[i].sub != sections[i - 1].sub)
+                printf("\n%s:\n", sub_names[sections[i].sub]);
+            printf("  %8llu %-4s %-48s %s\n", (unsigned long long)sections[i].size, sections[i].bss ? "bss" : "data",
+                   sections[i].name, sections[i].object);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,665 @@
+/*
+    Host resampler: merges the parts of a run into one time line and writes
+    every channel on a uniform time grid, to RUNx_grid.csv next to RUNx.
+    The parts are read in order through a fixed buffer and the grid rows are
+    written as soon as no later record can change them, so the memory used
+    doesn't depend on the length of the run.
+
+    Time: the records' ms timestamps (uint32_t since the run start) are
+    extended to 64 bits, so a run longer than 49.7 days keeps counting
+    after the overflow. The grid is at multiples of the period from the
+    run start, the same instants in every segment.
+    Gaps: a longer time than GAP_PERIODS sample periods without any record
+    (or -g ms), or a pause of the sample rate (REC_RATE 0), ends a segment.
+    No rows are written inside a gap. The segment column counts them.
+    Rate changes (motion gating) change the sample period used for the gaps
+    and for the channels below, not the grid.
+
+    Channels, empty until their first record in the run:
+    - IMU: linear interpolation between samples, or the previous sample with
+      -hold. Empty in a hole of that channel longer than a gap.
+    - Analog inputs and encoders, written when they change: the value holds
+      until the sample before the change; with linear interpolation it goes
+      to the new value between those two samples. A new part starts them at
+      0, as the logger does.
+    - Pulses, written when something was counted: counts per second
+      (count times the sample rate), 0 at the samples without a record.
+    Every value is wa * a + wb * b of two records of its channel group, one
+    loop over the group's channels per grid row.
+
+    Usage:
+        resample [-p period_ms] [-g gap_ms] [-hold] <RUNx dir>...
+        period: 1000 / sample rate of the first part by default
+    Build: gcc -O2 -o resample resample.c -lm
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "../Logger/log_record.h"
+
+#define READ_CHUNK      65536                       // Part bytes read at a time
+#define GRID_BLOCK      256                         // Grid rows computed before being written
+#define GAP_PERIODS     4                           // Default gap: no record for 4 sample periods
+#define MAX_GAPS_SHOWN  20
+
+#define GROUP_MAX       6                           // Channels of the widest group
+
+enum group_kind
+{
+    KIND_SAMPLED,                                   // A record at every sample
+    KIND_HOLD,                                      // A record when the value changes
+    KIND_COUNT                                      // A record when not 0
+};
+
+enum group_id
+{
+    G_IMU0, G_IMU1, G_ANALOG, G_PULSES, G_QENC0, G_QENC1,
+    NUM_GROUPS
+};
+
+typedef struct
+{
+    const char *columns;
+    int width;
+    int kind;
+} group_def_t;
+
+static const group_def_t group_defs[NUM_GROUPS] =
+{
+    { "lsmaccx,lsmaccy,lsmaccz,lsmangx,lsmangy,lsmangz", 6, KIND_SAMPLED },         // REC_IMU, or device 0 of REC_IMU_GROUP
+    { "lsmaccx1,lsmaccy1,lsmaccz1,lsmangx1,lsmangy1,lsmangz1", 6, KIND_SAMPLED },   // Device 1 of REC_IMU_GROUP
+    { "a0,a1,a2", 3, KIND_HOLD },
+    { "f1,f2", 2, KIND_COUNT },                     // Pulses per second
+    { "position0,velocity0", 2, KIND_HOLD },
+    { "position1,velocity1", 2, KIND_HOLD },
+};
+
+#define NUM_COLUMNS     (6 + 6 + 3 + 2 + 2 + 2)
+
+/* A record of a group, with the sample period in effect */
+typedef struct
+{
+    double time;
+    double period;
+    double prev;                                    // Time of the sample before
+    double v[GROUP_MAX];
+} knot_t;
+
+typedef struct
+{
+    knot_t *knots;                                  // Records of the current segment from first
+    size_t first, count, size;
+    double held[GROUP_MAX];                         // Value of a KIND_HOLD group
+    int seen;                                       // A record in the run so far
+    int column;                                     // First output column
+} group_t;
+
+typedef struct
+{
+    double start, end;
+} gap_t;
+
+/* Options */
+static double grid_ms, gap_ms;
+static int hold;
+
+/* Run state */
+static uint64_t time_ms;                            // Unwrapped time of the current record
+static double period;                               // Sample period in effect (ms), 0 paused
+static double tick, tick_period;                    // Last sample time and its period
+static double prev_tick;                            // Sample before it in the segment
+static int has_tick, in_segment, segment, new_part, paused;
+static double latency;                              // Rows are final this long before the last sample
+static int64_t next_row;                            // Grid index of the next row
+static group_t groups[NUM_GROUPS];
+static FILE *out;
+
+static double block_time[GRID_BLOCK];
+static double block[GRID_BLOCK][NUM_COLUMNS];
+static int block_rows;
+
+static gap_t *gaps;
+static size_t num_gaps, gaps_size;
+static uint64_t num_ticks, num_rows;
+static int num_wraps;
+
+static void *grow(void *array, size_t *size, size_t item)
+{
+    *size = *size ? 2 * *size : 256;
+    array = realloc(array, *size * item);
+    if (array == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return array;
+}
+
+/* Number with at most decimals decimals, without trailing zeros */
+static char *put_number(char *p, double v, int decimals)
+{
+    static const int64_t scale[] = { 1, 10, 100, 1000 };
+    int64_t x = llround(v * scale[decimals]);
+    char digits[24];
+    int n = 0;
+
+    if (x < 0)
+    {
+        *p++ = '-';
+        x = -x;
+    }
+    do
+    {
+        digits[n++] = '0' + x % 10;
+        x /= 10;
+    } while (x > 0 || n <= decimals);
+    while (decimals > 0 && digits[0] == '0')        // Trailing zeros of the fraction
+    {
+        memmove(digits, digits + 1, --n);
+        decimals--;
+    }
+    while (n > decimals)
+        *p++ = digits[--n];
+    if (decimals > 0)
+    {
+        *p++ = '.';
+        while (n > 0)
+            *p++ = digits[--n];
+    }
+    return p;
+}
+
+static void write_block(void)
+{
+    char line[32 * (NUM_COLUMNS + 2)];
+
+    for (int r = 0; r < block_rows; r++)
+    {
+        char *p = put_number(line, block_time[r], 3);
+
+        *p++ = ',';
+        p = put_number(p, segment, 0);
+        for (int c = 0; c < NUM_COLUMNS; c++)
+        {
+            *p++ = ',';
+            if (!isnan(block[r][c]))
+                p = put_number(p, block[r][c], 2);
+        }
+        *p++ = '\n';
+        fwrite(line, 1, p - line, out);
+    }
+    num_rows += block_rows;
+    block_rows = 0;
+}
+
+static double gap_between(const knot_t *a, const knot_t *b)
+{
+    return gap_ms > 0 ? gap_ms : GAP_PERIODS * fmax(a->period, b->period);
+}
+
+/* Linear segment from (t0, a) to (t1, b) at t, as weights of a and b */
+static void ramp(double t, double t0, double t1, double *wa, double *wb)
+{
+    double f = (t1 > t0) ? (t - t0) / (t1 - t0) : 1;
+
+    f = fmin(fmax(f, 0), 1);
+    *wa = 1 - f;
+    *wb = f;
+}
+
+/* Value of a group at t as wa * a + wb * b. Returns 0 if it has none. */
+static int weigh(group_t *g, int kind, double t, const knot_t **a, const knot_t **b, double *wa, double *wb)
+{
+    size_t i = g->first;
+
+    if (!g->seen)
+        return 0;
+    while (i + 1 < g->count && g->knots[i + 1].time <= t)
+        i++;
+    g->first = i;                                   // Rows only go forward
+    *a = (i < g->count && g->knots[i].time <= t) ? &g->knots[i] : NULL;
+    *b = (*a == NULL) ? ((i < g->count) ? &g->knots[i] : NULL) : ((i + 1 < g->count) ? &g->knots[i + 1] : NULL);
+    *wa = *wb = 0;
+
+    switch (kind)
+    {
+        case KIND_SAMPLED:
+            if (*a == NULL)
+                return 0;
+            if ((*a)->time == t)
+                *wa = 1;
+            else if (*b == NULL || (*b)->time - (*a)->time > gap_between(*a, *b))
+                return 0;                           // Hole in this channel
+            else if (hold)
+                *wa = 1;
+            else
+                ramp(t, (*a)->time, (*b)->time, wa, wb);
+            return 1;
+
+        case KIND_HOLD:
+            if (*a == NULL)
+                return 0;                           // Restated at every segment start
+            if (hold || *b == NULL || t <= (*b)->prev)
+                *wa = 1;
+            else
+                ramp(t, fmax((*a)->time, (*b)->prev), (*b)->time, wa, wb);
+            return 1;
+
+        default:                                    // KIND_COUNT, with a 0 at every sample without a record
+            if (*a == NULL)
+                return 1;                           // 0 before the first sample of the segment
+            if (hold || *b == NULL || (*a)->time == t)
+                *wa = 1;
+            else
+                ramp(t, (*a)->time, (*b)->time, wa, wb);
+            return 1;
+    }
+}
+
+/* Grid rows up to limit */
+static void write_rows(double limit)
+{
+    double t;
+
+    while ((t = next_row * grid_ms) <= limit)
+    {
+        double *row = block[block_rows];
+
+        for (int gi = 0; gi < NUM_GROUPS; gi++)
+        {
+            group_t *g = &groups[gi];
+            const knot_t *a, *b;
+            double wa, wb;
+            int w = group_defs[gi].width;
+            double *col = row + g->column;
+
+            if (!weigh(g, group_defs[gi].kind, t, &a, &b, &wa, &wb))
+            {
+                for (int c = 0; c < w; c++)
+                    col[c] = NAN;
+                continue;
+            }
+            if (a == NULL && b == NULL)
+            {
+                for (int c = 0; c < w; c++)
+                    col[c] = 0;
+                continue;
+            }
+            if (a == NULL)
+                a = b;
+            if (b == NULL)
+                b = a;
+            for (int c = 0; c < w; c++)
+                col[c] = wa * a->v[c] + wb * b->v[c];
+        }
+        block_time[block_rows++] = t;
+        if (block_rows == GRID_BLOCK)
+            write_block();
+        next_row++;
+    }
+}
+
+static void compact(group_t *g)
+{
+    if (g->first > 0)
+    {
+        memmove(g->knots, g->knots + g->first, (g->count - g->first) * sizeof(knot_t));
+        g->count -= g->first;
+        g->first = 0;
+    }
+}
+
+static void add_knot(group_t *g, double t, const double *v, int width)
+{
+    knot_t *k;
+
+    if (g->count > g->first && g->knots[g->count - 1].time == t)
+        k = &g->knots[g->count - 1];                // Same sample: the record replaces the restated value
+    else
+    {
+        if (g->count == g->size)
+        {
+            compact(g);
+            if (g->count == g->size)
+                g->knots = (knot_t *)grow(g->knots, &g->size, sizeof(knot_t));
+        }
+        k = &g->knots[g->count++];
+    }
+    k->time = t;
+    k->period = period ? period : tick_period;
+    k->prev = prev_tick;
+    memcpy(k->v, v, width * sizeof(double));
+    g->seen = 1;
+}
+
+static void end_segment(void)
+{
+    write_rows(tick);
+    write_block();
+    for (int gi = 0; gi < NUM_GROUPS; gi++)
+        groups[gi].first = groups[gi].count = 0;
+    in_segment = 0;
+}
+
+/* Before the records of a sample at t */
+static void sample_at(double t)
+{
+    if (has_tick && t <= tick)
+        return;                                     // Same sample, or out of order: kept at the last one
+    latency = fmax(latency, (gap_ms > 0 ? gap_ms : GAP_PERIODS * period) + period);  // Before the rows, for a new rate
+    if (has_tick && in_segment)
+    {
+        double gap = gap_ms > 0 ? gap_ms : GAP_PERIODS * fmax(tick_period, period);
+
+        if (paused || t - tick > gap)
+        {
+            if (num_gaps == gaps_size)
+                gaps = (gap_t *)grow(gaps, &gaps_size, sizeof(gap_t));
+            gaps[num_gaps].start = tick;
+            gaps[num_gaps++].end = t;
+            end_segment();
+            segment++;
+        }
+        else
+            write_rows(t - latency);
+    }
+    if (!in_segment)
+    {
+        next_row = (int64_t)ceil(t / grid_ms);
+        in_segment = 1;
+        prev_tick = t - period;
+    }
+    else
+        prev_tick = tick;
+
+    for (int gi = 0; gi < NUM_GROUPS; gi++)
+    {
+        group_t *g = &groups[gi];
+
+        if (!g->seen || group_defs[gi].kind == KIND_SAMPLED)
+            continue;
+        if (group_defs[gi].kind == KIND_COUNT)
+        {
+            static const double zero[GROUP_MAX];
+            add_knot(g, t, zero, group_defs[gi].width);  // Replaced by a record of this sample
+            continue;
+        }
+        if (new_part)
+            memset(g->held, 0, sizeof(g->held));    // The logger starts every part at 0
+        if (new_part || g->count == 0)
+            add_knot(g, t, g->held, group_defs[gi].width);
+    }
+    new_part = paused = 0;
+    tick = t;
+    tick_period = period;
+    has_tick = 1;
+    num_ticks++;
+}
+
+static void put_imu(int gi, const rec_imu_t *imu)
+{
+    double v[6];
+
+    for (int i = 0; i < 3; i++)
+    {
+        v[i] = imu->acc[i];
+        v[3 + i] = imu->gyr[i];
+    }
+    add_knot(&groups[gi], tick, v, 6);
+}
+
+static void put_hold(int gi, const double *v)
+{
+    group_t *g = &groups[gi];
+
+    memcpy(g->held, v, group_defs[gi].width * sizeof(double));
+    add_knot(g, tick, v, group_defs[gi].width);
+}
+
+static void record(uint8_t tag, const uint8_t *payload)
+{
+    double v[GROUP_MAX];
+
+    if (tag == REC_RATE)
+    {
+        rec_rate_t r;
+
+        memcpy(&r, payload, sizeof(r));
+        period = r.rate ? 1000.0 / r.rate : 0;
+        if (r.rate == 0)
+            paused = 1;
+        return;
+    }
+    if (tag != REC_IMU && tag != REC_IMU_GROUP && tag != REC_ANALOG && tag != REC_PULSES &&
+        tag != REC_QENC && tag != REC_QENC1)
+        return;
+
+    sample_at((double)time_ms);
+    switch (tag)
+    {
+        case REC_IMU:
+        {
+            rec_imu_t r;
+            memcpy(&r, payload, sizeof(r));
+            put_imu(G_IMU0, &r);
+            break;
+        }
+        case REC_IMU_GROUP:
+        {
+            rec_imu_group_t r;
+            memcpy(&r, payload, sizeof(r));
+            for (int d = 0; d < IMU_GROUP_MAX; d++)
+            {
+                if (r.mask & (1 << d))
+                    put_imu(G_IMU0 + d, &r.imu[d]);
+            }
+            break;
+        }
+        case REC_ANALOG:
+        {
+            rec_analog_t r;
+            memcpy(&r, payload, sizeof(r));
+            for (int i = 0; i < 3; i++)
+                v[i] = r.analog[i];
+            put_hold(G_ANALOG, v);
+            break;
+        }
+        case REC_PULSES:
+        {
+            rec_pulses_t r;
+            double rate = tick_period > 0 ? 1000.0 / tick_period : 1;
+            memcpy(&r, payload, sizeof(r));
+            for (int i = 0; i < 2; i++)
+                v[i] = r.pulses[i] * rate;
+            add_knot(&groups[G_PULSES], tick, v, 2);
+            break;
+        }
+        default:                                    // REC_QENC + i
+        {
+            rec_qenc_t r;
+            memcpy(&r, payload, sizeof(r));
+            v[0] = r.position;
+            v[1] = r.velocity;
+            put_hold(G_QENC0 + (tag - REC_QENC), v);
+            break;
+        }
+    }
+}
+
+/* Reads a part through a READ_CHUNK buffer. Returns 0 if it doesn't exist. */
+static int read_part(const char *name, uint8_t *buf, int first)
+{
+    FILE *f = fopen(name, "rb");
+    log_header_t header;
+    rec_mark_check_t marks;
+    size_t len, pos = 0, base = 0;                  // base: file offset of buf[0]
+    int eof = 0;
+
+    if (f == NULL)
+        return 0;
+    len = fread(buf, 1, READ_CHUNK, f);
+    memset(&header, 0, sizeof(header));
+    if (len >= LOG_HEADER_V2_SIZE)
+        memcpy(&header, buf, LOG_HEADER_V2_SIZE);
+    if (header.magic != LOG_MAGIC || len < LOG_HEADER_SIZE(header.version))
+    {
+        fprintf(stderr, "%s is not a record stream\n", name);
+        fclose(f);
+        return 1;
+    }
+    pos = LOG_HEADER_SIZE(header.version);
+    if (header.version >= 3)
+        memcpy(&header.run_id, buf + LOG_HEADER_V2_SIZE, sizeof(header.run_id));
+    marks.run_id = header.run_id;
+    marks.next = 0;
+    marks.seq = 0;
+    period = header.sample_freq ? 1000.0 / header.sample_freq : 0;  // Until a REC_RATE
+    if (first && grid_ms <= 0)
+        grid_ms = period > 0 ? period : 1;
+    new_part = 1;
+
+    for (;;)
+    {
+        if (!eof && len - pos < REC_MAX_SIZE + sizeof(rec_time_t) + 1)
+        {
+            memmove(buf, buf + pos, len - pos);
+            base += pos;
+            len -= pos;
+            pos = 0;
+            size_t got = fread(buf + len, 1, READ_CHUNK - len, f);
+            len += got;
+            eof = (got == 0);
+        }
+        if (pos >= len)
+            break;
+
+        uint8_t tag = buf[pos] & REC_TAG_MASK;
+        uint32_t payload_size = (tag < REC_NUM_TAGS) ? rec_payload_size[tag] : 0;
+        uint32_t head = (buf[pos] & REC_SAME_TIME) ? 1 : 2;
+
+        if (!rec_mark_valid(&marks, base + pos - LOG_HEADER_SIZE(header.version), buf + pos, len - pos))
+        {
+            fprintf(stderr, "%s: end of the run's data at byte %lu (block %u without its marker), rest ignored\n",
+                    name, (unsigned long)(base + pos), marks.seq);
+            break;                                  // Stale data of a pre-allocated part after a power loss
+        }
+        if (payload_size == 0 || pos + head + payload_size > len)
+            break;                                  // Unknown tag or truncated record
+        if (head == 2)
+            time_ms += buf[pos + 1];
+        pos += head;
+        if (tag == REC_TIME)
+        {
+            rec_time_t r;
+            uint64_t t;
+
+            memcpy(&r, buf + pos, sizeof(r));
+            t = (time_ms & ~(uint64_t)0xFFFFFFFF) | r.time_stamp;
+            if (t + 0x80000000u < time_ms)
+            {
+                t += (uint64_t)1 << 32;             // uint32_t overflow of the logger's time
+                num_wraps++;
+            }
+            time_ms = t;
+        }
+        else
+            record(tag, buf + pos);
+        pos += payload_size;
+    }
+    fclose(f);
+    return 1;
+}
+
+static void resample_run(const char *dir, double period_option)
+{
+    static uint8_t buf[READ_CHUNK];
+    char name[1024], out_name[1024];
+    size_t dir_len = strlen(dir);
+    int parts;
+    clock_t start = clock();
+
+    while (dir_len > 1 && dir[dir_len - 1] == '/')
+        dir_len--;
+    snprintf(out_name, sizeof(out_name), "%.*s_grid.csv", (int)dir_len, dir);
+    out = fopen(out_name, "wt");
+    if (out == NULL)
+    {
+        fprintf(stderr, "Can't create %s\n", out_name);
+        return;
+    }
+    fprintf(out, "time_ms,segment");
+    for (int gi = 0, column = 0; gi < NUM_GROUPS; gi++)
+    {
+        groups[gi].first = groups[gi].count = 0;
+        groups[gi].seen = 0;
+        memset(groups[gi].held, 0, sizeof(groups[gi].held));
+        groups[gi].column = column;
+        column += group_defs[gi].width;
+        fprintf(out, ",%s", group_defs[gi].columns);
+    }
+    fprintf(out, "\n");
+
+    grid_ms = period_option;
+    time_ms = 0;
+    has_tick = in_segment = segment = paused = 0;
+    latency = 0;
+    num_gaps = 0;
+    num_ticks = num_rows = 0;
+    num_wraps = 0;
+
+    for (parts = 0; ; parts++)
+    {
+        snprintf(name, sizeof(name), "%.*s/part%d", (int)dir_len, dir, parts + 1);
+        if (!read_part(name, buf, parts == 0))
+            break;
+    }
+    if (in_segment)
+        end_segment();
+    fclose(out);
+
+    if (parts == 0)
+    {
+        printf("%.*s: no part files\n", (int)dir_len, dir);
+        remove(out_name);
+        return;
+    }
+    printf("%.*s: %d parts, %llu samples, %.3f s, %zu gaps, %d time overflows -> %s\n", (int)dir_len, dir, parts,
+           (unsigned long long)num_ticks, has_tick ? tick / 1000 : 0.0, num_gaps, num_wraps, out_name);
+    printf("    %llu rows every %g ms (%s) in %.2f s\n", (unsigned long long)num_rows, grid_ms,
+           hold ? "hold" : "linear", (double)(clock() - start) / CLOCKS_PER_SEC);
+    for (size_t i = 0; i < num_gaps && i < MAX_GAPS_SHOWN; i++)
+        printf("    gap %.3f s to %.3f s (%.3f s)\n", gaps[i].start / 1000, gaps[i].end / 1000,
+               (gaps[i].end - gaps[i].start) / 1000);
+    if (num_gaps > MAX_GAPS_SHOWN)
+        printf("    ... %zu more\n", num_gaps - MAX_GAPS_SHOWN);
+}
+
+int main(int argc, char **argv)
+{
+    double period_option = 0;
+    int i = 1;
+
+    for (; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+            period_option = atof(argv[++i]);
+        else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc)
+            gap_ms = atof(argv[++i]);
+        else if (strcmp(argv[i], "-hold") == 0)
+            hold = 1;
+        else
+            break;
+    }
+    if (i >= argc || period_option < 0)
+    {
+        fprintf(stderr, "Usage: %s [-p period_ms] [-g gap_ms] [-hold] <RUNx dir>...\n", argv[0]);
+        return 1;
+    }
+    for (; i < argc; i++)
+        resample_run(argv[i], period_option);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include "FileBlockDevice.h"
+#include "platform/mbed_assert.h"
+
+using namespace mbed;
+
+FileBlockDevice::FileBlockDevice(const char *path, bd_size_t size, bd_size_t block)
+    : _path(path), _size(size), _block(block), _fd(-1)
+{
+}
+
+FileBlockDevice::~FileBlockDevice()
+{
+    deinit();
+}
+
+int FileBlockDevice::init()
+{
+    if (_fd >= 0) {
+        return BD_ERROR_OK;
+    }
+
+    _fd = ::open(_path, O_RDWR | O_CREAT, 0644);
+    if (_fd < 0) {
+        return BD_ERROR_DEVICE_ERROR;
+    }
+
+    // Sparse until written, reads of new space return zeros
+    off_t end = lseek(_fd, 0, SEEK_END);
+    if (end < 0 || ((bd_size_t)end < _size && ftruncate(_fd, _size) != 0)) {
+        ::close(_fd);
+        _fd = -1;
+        return BD_ERROR_DEVICE_ERROR;
+    }
+    return BD_ERROR_OK;
+}
+
+int FileBlockDevice::deinit()
+{
+    if (_fd >= 0) {
+        ::close(_fd);
+        _fd = -1;
+    }
+    return BD_ERROR_OK;
+}
+
+int FileBlockDevice::read(void *buffer, bd_addr_t addr, bd_size_t size)
+{
+    MBED_ASSERT(is_valid_read(addr, size));
+    return pread(_fd, buffer, size, addr) == (ssize_t)size ? BD_ERROR_OK : BD_ERROR_DEVICE_ERROR;
+}
+
+int FileBlockDevice::program(const void *buffer, bd_addr_t addr, bd_size_t size)
+{
+    MBED_ASSERT(is_valid_program(addr, size));
+    return pwrite(_fd, buffer, size, addr) == (ssize_t)size ? BD_ERROR_OK : BD_ERROR_DEVICE_ERROR;
+}
+
+int FileBlockDevice::erase(bd_addr_t addr, bd_size_t size)
+{
+    // As on an SD card, programs overwrite without an erase
+    MBED_ASSERT(is_valid_erase(addr, size));
+    return BD_ERROR_OK;
+}
+
+bd_size_t FileBlockDevice::get_read_size() const
+{
+    return _block;
+}
+
+bd_size_t FileBlockDevice::get_program_size() const
+{
+    return _block;
+}
+
+bd_size_t FileBlockDevice::get_erase_size() const
+{
+    return _block;
+}
+
+bd_size_t FileBlockDevice::size() const
+{
+    return _size;
+}
+
+const char *FileBlockDevice::get_type() const
+{
+    return "FILE";
+}
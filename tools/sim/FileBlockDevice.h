@@ -0,0 +1,41 @@
+/*
+    Block device stored in a host file, so a simulated card can be kept
+    between runs or inspected on the PC (it's a plain FAT image, mountable
+    with "mount -o loop" or readable with mtools).
+*/
+
+#ifndef SIM_FILE_BLOCK_DEVICE_H
+#define SIM_FILE_BLOCK_DEVICE_H
+
+#include "BlockDevice.h"
+
+class FileBlockDevice : public mbed::BlockDevice {
+public:
+    /** Lifetime of the block device
+     *
+     *  @param path     Image file, created or extended to size
+     *  @param size     Device size in bytes
+     *  @param block    Read, program and erase size
+     */
+    FileBlockDevice(const char *path, mbed::bd_size_t size, mbed::bd_size_t block = 512);
+    virtual ~FileBlockDevice();
+
+    virtual int init();
+    virtual int deinit();
+    virtual int read(void *buffer, mbed::bd_addr_t addr, mbed::bd_size_t size);
+    virtual int program(const void *buffer, mbed::bd_addr_t addr, mbed::bd_size_t size);
+    virtual int erase(mbed::bd_addr_t addr, mbed::bd_size_t size);
+    virtual mbed::bd_size_t get_read_size() const;
+    virtual mbed::bd_size_t get_program_size() const;
+    virtual mbed::bd_size_t get_erase_size() const;
+    virtual mbed::bd_size_t size() const;
+    virtual const char *get_type() const;
+
+private:
+    const char *_path;
+    mbed::bd_size_t _size;
+    mbed::bd_size_t _block;
+    int _fd;
+};
+
+#endif // SIM_FILE_BLOCK_DEVICE_H
@@ -0,0 +1,122 @@
+#include "SDBlockDevice.h"
+
+using namespace mbed;
+
+SDBlockDevice::SDBlockDevice(PinName mosi, PinName miso, PinName sclk, PinName cs, uint64_t hz, bool crc_on)
+    : _sd(NULL), _start(0), _crc_on(crc_on)
+{
+    (void)mosi;
+    (void)miso;
+    (void)sclk;
+    (void)cs;
+    (void)hz;                                       // sim::config.timing.spi_hz is used
+}
+
+SDBlockDevice::~SDBlockDevice()
+{
+    delete _sd;
+}
+
+void SDBlockDevice::begin()
+{
+    _start = _sd->now();
+}
+
+int SDBlockDevice::end(int err, bd_size_t data)
+{
+    uint64_t us = _sd->now() - _start;
+
+    if (_crc_on) {
+        us += data * sim::config.crc_ns / 1000;
+    }
+
+    sim::stats.card_ops++;
+    if (us > sim::stats.max_card_us) {
+        sim::stats.max_card_us = us;
+    }
+    sim::busy(&sim::stats.card_us, us);             // Interrupts fire during the operation
+    return err;
+}
+
+int SDBlockDevice::init()
+{
+    int err;
+
+    sim::heap_exempt(true);                         // The card's memory, not the logger's
+    if (!_sd) {
+        _sd = new SDTimingBlockDevice(sim::card_storage(), sim::config.timing);
+    }
+    err = _sd->init();
+    sim::heap_exempt(false);
+    return err;
+}
+
+int SDBlockDevice::deinit()
+{
+    return _sd ? _sd->deinit() : BD_ERROR_OK;
+}
+
+int SDBlockDevice::sync()
+{
+    begin();
+    return end(_sd->sync());
+}
+
+int SDBlockDevice::read(void *buffer, bd_addr_t addr, bd_size_t size)
+{
+    begin();
+    return end(_sd->read(buffer, addr, size), size);
+}
+
+int SDBlockDevice::program(const void *buffer, bd_addr_t addr, bd_size_t size)
+{
+    begin();
+    return end(_sd->program(buffer, addr, size), size);
+}
+
+int SDBlockDevice::erase(bd_addr_t addr, bd_size_t size)
+{
+    begin();
+    return end(_sd->erase(addr, size));
+}
+
+int SDBlockDevice::trim(bd_addr_t addr, bd_size_t size)
+{
+    begin();
+    return end(_sd->trim(addr, size));
+}
+
+bd_size_t SDBlockDevice::get_read_size() const
+{
+    return _sd->get_read_size();
+}
+
+bd_size_t SDBlockDevice::get_program_size() const
+{
+    return _sd->get_program_size();
+}
+
+bd_size_t SDBlockDevice::get_erase_size() const
+{
+    return _sd->get_erase_size();
+}
+
+bd_size_t SDBlockDevice::size() const
+{
+    return _sd->size();
+}
+
+const char *SDBlockDevice::get_type() const
+{
+    return "SD";
+}
+
+int SDBlockDevice::read_sd_status(sd_status_t *status)
+{
+    status->au_size = 4 * 1024 * 1024;
+    status->erase_aus = 1;
+    status->erase_timeout_s = 1;
+    status->erase_offset_s = 1;
+    status->speed_class = 10;
+    return BD_ERROR_OK;
+}
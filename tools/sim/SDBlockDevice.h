@@ -0,0 +1,54 @@
+/*
+    Host simulation build of SDBlockDevice: the card is sim::card_storage()
+    (heap or image file) behind SDTimingBlockDevice, and the time of every
+    operation is spent on the simulation clock. With crc_on, the CRC16 of
+    the data blocks adds config.crc_ns per byte read or programmed.
+*/
+
+#ifndef SIM_SD_BLOCK_DEVICE_H
+#define SIM_SD_BLOCK_DEVICE_H
+
+#include "BlockDevice.h"
+#include "SDTimingBlockDevice.h"
+#include "sim.h"
+
+class SDBlockDevice : public mbed::BlockDevice {
+public:
+    SDBlockDevice(PinName mosi, PinName miso, PinName sclk, PinName cs, uint64_t hz = 1000000, bool crc_on = 0);
+    virtual ~SDBlockDevice();
+
+    virtual int init();
+    virtual int deinit();
+    virtual int sync();
+    virtual int read(void *buffer, mbed::bd_addr_t addr, mbed::bd_size_t size);
+    virtual int program(const void *buffer, mbed::bd_addr_t addr, mbed::bd_size_t size);
+    virtual int erase(mbed::bd_addr_t addr, mbed::bd_size_t size);
+    virtual int trim(mbed::bd_addr_t addr, mbed::bd_size_t size);
+    virtual mbed::bd_size_t get_read_size() const;
+    virtual mbed::bd_size_t get_program_size() const;
+    virtual mbed::bd_size_t get_erase_size() const;
+    virtual mbed::bd_size_t size() const;
+    virtual const char *get_type() const;
+
+    struct sd_status_t {
+        mbed::bd_size_t au_size;
+        uint16_t erase_aus;
+        uint8_t erase_timeout_s;
+        uint8_t erase_offset_s;
+        uint8_t speed_class;
+    };
+
+    /** A class 10 card with 4 MB AUs, the usual SDHC geometry */
+    int read_sd_status(sd_status_t *status);
+
+private:
+    mbed::SDTimingBlockDevice *_sd;
+    uint64_t _start;
+    bool _crc_on;
+
+    /** Account the time since begin() to the card, plus the CRC of data bytes */
+    void begin();
+    int end(int err, mbed::bd_size_t data = 0);
+};
+
+#endif // SIM_SD_BLOCK_DEVICE_H
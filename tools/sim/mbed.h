@@ -0,0 +1,287 @@
+/*
+    Host simulation build of "mbed.h": the drivers used by the logger, on the
+    virtual time and signals of "sim.h". Only the calls the logger makes are
+    provided.
+
+    The card is "/sd" as on the target: the C stdio and POSIX calls of the
+    logger are renamed to the sim_ versions of "sim_stdio.h", which open
+    files on the mbed FileSystem when the path has its name, and fall back
+    to the host otherwise. The logger's main() is renamed to logger_main() and run by
+    "logger_sim.cpp".
+*/
+
+#ifndef SIM_MBED_H
+#define SIM_MBED_H
+
+#include <stdio.h>
+#include <cstdio>                                   // Before the renames, it #undefs fopen...
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+
+/* Card files through the mbed FileSystem, see "sim_stdio.cpp" */
+#define fopen       sim_fopen
+#define fclose      sim_fclose
+#define fileno      sim_fileno
+#define fsync       sim_fsync
+#define ftruncate   sim_ftruncate
+#define remove      sim_remove
+#define mkdir       sim_mkdir
+#define opendir     sim_opendir
+#define readdir     sim_readdir
+#define closedir    sim_closedir
+
+#include "platform/mbed_retarget.h"                 // Declares the sim_ POSIX calls with the mbed types
+#include "sim_stdio.h"
+
+#include "platform/mbed_toolchain.h"
+#include "platform/mbed_critical.h"
+#include "platform/mbed_error.h"
+#include "platform/Callback.h"
+#include "platform/CircularBuffer.h"
+#include "platform/mbed_stats.h"
+#include "hal/us_ticker_api.h"
+#include "sim.h"
+
+namespace mbed {
+
+class DigitalOut {
+public:
+    DigitalOut(PinName pin, int value = 0) : _value(value)
+    {
+        (void)pin;
+    }
+    void write(int value)
+    {
+        _value = value;
+    }
+    int read()
+    {
+        return _value;
+    }
+    DigitalOut &operator= (int value)
+    {
+        write(value);
+        return *this;
+    }
+    operator int()
+    {
+        return read();
+    }
+
+private:
+    int _value;
+};
+
+class PwmOut {
+public:
+    PwmOut(PinName pin)
+    {
+        (void)pin;
+    }
+    void period_us(int us)
+    {
+        (void)us;
+    }
+    void write(float value)
+    {
+        (void)value;
+    }
+};
+
+class AnalogIn {
+public:
+    AnalogIn(PinName pin) : _pin(pin) {}
+    unsigned short read_u16();
+    float read()
+    {
+        return read_u16() / 65535.0f;
+    }
+
+private:
+    PinName _pin;
+};
+
+class InterruptIn {
+public:
+    InterruptIn(PinName pin, PinMode mode = PullDefault) : _pin(pin)
+    {
+        (void)mode;
+    }
+    void rise(Callback<void()> func)
+    {
+        sim::on_edge(_pin, true, func);
+    }
+    void fall(Callback<void()> func)
+    {
+        sim::on_edge(_pin, false, func);
+    }
+
+private:
+    PinName _pin;
+};
+
+class Timer {
+public:
+    Timer() : _running(false), _start(0), _elapsed(0) {}
+    void start();
+    void stop();
+    void reset();
+    float read()
+    {
+        return read_us() / 1000000.0f;
+    }
+    int read_ms()
+    {
+        return read_us() / 1000;
+    }
+    int read_us()
+    {
+        return (int)read_high_resolution_us();
+    }
+    uint64_t read_high_resolution_us();
+
+private:
+    bool _running;
+    uint64_t _start;
+    uint64_t _elapsed;
+};
+
+class Ticker {
+public:
+    Ticker();
+    ~Ticker();
+    void attach(Callback<void()> func, float t)
+    {
+        attach_us(func, t * 1000000.0f);
+    }
+    void attach_us(Callback<void()> func, uint64_t t);
+    void detach();
+
+private:
+    sim::event_t _event;
+    Callback<void()> _func;
+
+    void tick();
+};
+
+class I2C {
+public:
+    I2C(PinName sda, PinName scl) : _hz(100000)
+    {
+        (void)sda;
+        (void)scl;
+    }
+    void frequency(int hz)
+    {
+        _hz = hz;
+    }
+    int write(int address, const char *data, int length, bool repeated = false);
+    int read(int address, char *data, int length, bool repeated = false);
+    void lock() {}
+    void unlock() {}
+
+private:
+    int _hz;
+
+    void transfer_time(int length);
+};
+
+class SPI {
+public:
+    SPI(PinName mosi, PinName miso, PinName sclk, PinName ssel = NC)
+    {
+        (void)mosi;
+        (void)miso;
+        (void)sclk;
+        (void)ssel;
+    }
+    void format(int bits, int mode = 0)
+    {
+        (void)bits;
+        (void)mode;
+    }
+    void frequency(int hz = 1000000)
+    {
+        (void)hz;
+    }
+    int write(int value)
+    {
+        (void)value;
+        return 0xFF;
+    }
+    int write(const char *tx_buffer, int tx_length, char *rx_buffer, int rx_length)
+    {
+        (void)tx_buffer;
+        memset(rx_buffer, 0xFF, rx_length);
+        return tx_length > rx_length ? tx_length : rx_length;
+    }
+    void lock() {}
+    void unlock() {}
+};
+
+class SerialBase {
+public:
+    enum IrqType {
+        RxIrq = 0,
+        TxIrq
+    };
+};
+
+/* Transmits instantly, to stderr if config.console is set */
+class RawSerial : public SerialBase {
+public:
+    RawSerial(PinName tx, PinName rx, int baud = 9600)
+    {
+        (void)tx;
+        (void)rx;
+        (void)baud;
+    }
+    int putc(int c);
+    int writeable()
+    {
+        return 1;
+    }
+    void attach(Callback<void()> func, IrqType type = RxIrq);
+};
+
+/* CircularBuffer reporting its depth to the simulation */
+template<typename T, uint32_t BufferSize, typename CounterType = uint32_t>
+class SimCircularBuffer : public CircularBuffer<T, BufferSize, CounterType> {
+    typedef CircularBuffer<T, BufferSize, CounterType> Base;
+
+public:
+    void push(const T &data)
+    {
+        bool overwrite = Base::full();
+        Base::push(data);
+        sim::queue_depth(this, sizeof(T) * BufferSize, Base::size(), overwrite);
+    }
+    bool pop(T &data)
+    {
+        bool ok = Base::pop(data);
+        sim::queue_depth(this, sizeof(T) * BufferSize, Base::size(), false);
+        return ok;
+    }
+};
+
+} // namespace mbed
+
+void wait_us(int us);
+void wait_ms(int ms);
+void wait(float s);
+void NVIC_SystemReset();
+
+using namespace mbed;
+using namespace std;
+
+/* Tracepoint cycles: virtual time at the 72 MHz of the target (see "Trace.h") */
+#define TRACE_CLOCK()   ((uint32_t)(sim::now() * 72))
+#define TRACE_CLOCK_HZ  72000000
+
+#define CircularBuffer SimCircularBuffer
+#define main logger_main                            // Run by logger_sim.cpp
+
+#endif // SIM_MBED_H
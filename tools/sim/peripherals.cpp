@@ -0,0 +1,141 @@
+#include "mbed.h"
+#include "replay.h"
+#include "QuadEncoder.h"
+
+namespace mbed {
+
+unsigned short AnalogIn::read_u16()
+{
+    sim::busy(&sim::stats.adc_us, sim::config.adc_us);
+    return sim::analog_value(_pin);
+}
+
+void Timer::start()
+{
+    if (!_running) {
+        _start = sim::now();
+        _running = true;
+    }
+}
+
+void Timer::stop()
+{
+    if (_running) {
+        _elapsed += sim::now() - _start;
+        _running = false;
+    }
+}
+
+void Timer::reset()
+{
+    _start = sim::now();
+    _elapsed = 0;
+}
+
+uint64_t Timer::read_high_resolution_us()
+{
+    sim::poll();
+    return _elapsed + (_running ? sim::now() - _start : 0);
+}
+
+Ticker::Ticker()
+{
+    _event.active = false;
+}
+
+Ticker::~Ticker()
+{
+    detach();
+}
+
+void Ticker::attach_us(Callback<void()> func, uint64_t t)
+{
+    detach();
+    _func = func;
+    _event.period = t / sim::config.speedup;
+    _event.due = sim::now() + _event.period;
+    _event.fire = callback(this, &Ticker::tick);
+    sim::schedule(&_event);
+
+    uint64_t hz_x1000 = 1e9 / _event.period;
+    if (hz_x1000 > sim::stats.tick_hz_x1000) {
+        sim::stats.tick_hz_x1000 = hz_x1000;
+    }
+    if (sim::now() >= sim::stats.start_us) {
+        sim::replay_begin(_event.due, _event.period);   // Acquisition started
+    }
+}
+
+void Ticker::detach()
+{
+    sim::cancel(&_event);
+}
+
+void Ticker::tick()
+{
+    if (sim::now() >= sim::stats.start_us && sim::now() < sim::stats.stop_us) {
+        sim::stats.ticks++;
+    }
+    _func();
+}
+
+// Address, data bytes and acknowledges, plus start and stop
+void I2C::transfer_time(int length)
+{
+    sim::busy(&sim::stats.bus_us, (9 * (length + 1) + 2) * 1000000ULL / _hz);
+}
+
+int I2C::write(int address, const char *data, int length, bool repeated)
+{
+    (void)repeated;
+    if (!sim::i2c_write(address, (const uint8_t *)data, length)) {
+        transfer_time(0);                           // Address not acknowledged
+        return -1;
+    }
+    transfer_time(length);
+    return 0;
+}
+
+int I2C::read(int address, char *data, int length, bool repeated)
+{
+    (void)repeated;
+    if (!sim::i2c_read(address, (uint8_t *)data, length)) {
+        transfer_time(0);
+        return -1;
+    }
+    transfer_time(length);
+    return 0;
+}
+
+int RawSerial::putc(int c)
+{
+    if (sim::config.console) {
+        fputc(c, stderr);
+    }
+    return c;
+}
+
+void RawSerial::attach(Callback<void()> func, IrqType type)
+{
+    // The line is always free: a TX handler empties the queue at once
+    if (type == TxIrq && func) {
+        func();
+    }
+}
+
+} // namespace mbed
+
+/* Encoder timers: CH1 and CH2 pins of TIM1, TIM2 and TIM3 as in the PWM pin map of the target */
+uint32_t qenc_timer_init(PinName ch1, PinName ch2, uint8_t filter)
+{
+    (void)filter;
+    if ((ch1 == PA_8 && ch2 == PA_9) || (ch1 == PA_0 && ch2 == PA_1) || (ch1 == PA_6 && ch2 == PA_7)) {
+        return (uint32_t)ch1 + 1;
+    }
+    return 0;
+}
+
+uint16_t qenc_timer_count(uint32_t timer)
+{
+    return sim::encoder_count((PinName)(timer - 1));
+}
@@ -0,0 +1,201 @@
+#include <string.h>
+#include <algorithm>
+#include "replay.h"
+
+namespace sim
+{
+
+/* As wired in "main.cpp" */
+static const uint8_t imu_addrs[IMU_GROUP_MAX] = { 0xD6, 0xD4 };
+static const PinName analog_pins[3] = { PB_1, PB_0, PA_7 };
+static const PinName pulse_pins[2] = { PB_5, PB_6 };
+static const PinName qenc_pins[QENC_MAX] = { PA_8, PA_0 };   // CH1 of each encoder timer
+
+typedef struct
+{
+    double due;
+    PinName pin;
+} replay_edge_t;
+
+static std::vector<sample_t> samples;
+static uint16_t sample_freq;
+static bool started;
+static size_t current;                              // Sample shown
+static double origin_us, tick_us;
+static std::vector<replay_edge_t> edges;            // Pending frequency channel edges, by time
+static event_t event;
+
+bool replay_load(const char *path)
+{
+    uint8_t masks = 0;
+
+    samples.clear();
+    if (!read_run(path, fopen, fclose, samples, &sample_freq))
+    {
+        FILE *fp = fopen(path, "rb");               // A single part file
+
+        if (fp == NULL)
+            return false;
+        read_part(fp, samples, &sample_freq);
+        fclose(fp);
+    }
+
+    for (size_t i = 0; i < samples.size(); i++)
+        masks |= samples[i].imu_mask;
+    for (int d = 0; d < IMU_GROUP_MAX; d++)
+    {
+        if (masks & (1 << d))
+            set_imu_present(imu_addrs[d], true);
+    }
+    return !samples.empty();
+}
+
+bool replay_loaded()
+{
+    return !samples.empty();
+}
+
+const std::vector<sample_t> &replay_samples()
+{
+    return samples;
+}
+
+uint16_t replay_sample_freq()
+{
+    return sample_freq;
+}
+
+/* Acquisition tick at which sample k was taken */
+static double tick_time(size_t k)
+{
+    return origin_us + (samples[k].time - samples[0].time) * 1000.0 / config.speedup;
+}
+
+static bool edge_before(const replay_edge_t &a, const replay_edge_t &b)
+{
+    return a.due < b.due;
+}
+
+/* Pulses of sample k, spread over the time since the previous tick */
+static void add_edges(size_t k)
+{
+    if (k >= samples.size())
+        return;
+
+    double from = (k > 0) ? tick_time(k - 1) : tick_time(0) - tick_us;
+    double to = tick_time(k);
+
+    for (int ch = 0; ch < 2; ch++)
+    {
+        uint16_t count = samples[k].pulses.pulses[ch];
+
+        for (uint16_t j = 0; j < count; j++)
+        {
+            replay_edge_t e = { from + (j + 1) * (to - from) / (count + 1), pulse_pins[ch] };
+            edges.push_back(e);
+        }
+    }
+    std::sort(edges.begin(), edges.end(), edge_before);
+}
+
+static void schedule_next()
+{
+    double due = -1;
+
+    if (current + 1 < samples.size())
+        due = tick_time(current + 1) - tick_us / 2;
+    if (!edges.empty() && (due < 0 || edges.front().due < due))
+        due = edges.front().due;
+    if (due >= 0)
+    {
+        event.due = due;
+        event.period = 0;
+        schedule(&event);
+    }
+}
+
+/* Sample k is shown from half a tick before its tick */
+static void step()
+{
+    while (!edges.empty() && edges.front().due <= now())
+    {
+        PinName pin = edges.front().pin;
+
+        edges.erase(edges.begin());
+        edge(pin, false);
+    }
+    while (current + 1 < samples.size() && tick_time(current + 1) - tick_us / 2 <= now())
+    {
+        current++;
+        add_edges(current + 1);
+    }
+    schedule_next();
+}
+
+void replay_begin(double first_us, double period_us)
+{
+    if (samples.empty() || started)
+        return;
+
+    started = true;
+    origin_us = first_us;
+    tick_us = period_us;
+    current = 0;
+    edges.clear();
+    add_edges(0);
+    add_edges(1);
+    event.fire = mbed::callback(step);
+    schedule_next();
+}
+
+double replay_end_us()
+{
+    return started ? tick_time(samples.size() - 1) + tick_us / 2 : 0;
+}
+
+bool replay_imu(uint8_t addr, rec_imu_t *imu)
+{
+    if (!started)
+        return false;
+    for (int d = 0; d < IMU_GROUP_MAX; d++)
+    {
+        if (imu_addrs[d] == addr && (samples[current].imu_mask & (1 << d)))
+        {
+            *imu = samples[current].imu[d];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool replay_analog(PinName pin, uint16_t *value)
+{
+    if (!started)
+        return false;
+    for (int i = 0; i < 3; i++)
+    {
+        if (analog_pins[i] == pin)
+        {
+            *value = samples[current].analog.analog[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool replay_qenc(PinName ch1, int32_t *position)
+{
+    if (samples.empty())
+        return false;
+    for (int i = 0; i < QENC_MAX; i++)
+    {
+        if (qenc_pins[i] == ch1)
+        {
+            *position = started ? samples[current].qenc[i].position : 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,38 @@
+/*
+    Recorded run fed back to the logger's inputs: the IMUs, the analog inputs,
+    the frequency channels and the encoder timers show the recorded samples
+    with their original timestamps, relative to the first acquisition tick,
+    so each tick reads the sample recorded at the same point of the original
+    run. Pins and I2C addresses are those of "main.cpp".
+*/
+
+#ifndef SIM_REPLAY_H
+#define SIM_REPLAY_H
+
+#include <vector>
+#include "sim.h"
+#include "run_reader.h"
+
+namespace sim
+{
+
+/* Load a RUN directory or one part file from the host, false if it has no samples */
+bool replay_load(const char *path);
+bool replay_loaded();
+const std::vector<sample_t> &replay_samples();
+uint16_t replay_sample_freq();
+
+/* Acquisition ticker started: first tick at first_us, then every period_us */
+void replay_begin(double first_us, double period_us);
+
+/* Half a tick after the last recorded sample, 0 until the ticker started */
+double replay_end_us();
+
+/* Values of the sample shown now, false to use the signals instead */
+bool replay_imu(uint8_t addr, rec_imu_t *imu);
+bool replay_analog(PinName pin, uint16_t *value);
+bool replay_qenc(PinName ch1, int32_t *position);   // 0 from loading to the first tick, as at the run start
+
+}
+
+#endif // SIM_REPLAY_H
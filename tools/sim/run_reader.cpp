@@ -0,0 +1,129 @@
+#include <string.h>
+#include "run_reader.h"
+
+namespace sim
+{
+
+static void start_sample(sample_t *s, bool *open, std::vector<sample_t> &samples, uint32_t time)
+{
+    if (*open)
+        samples.push_back(*s);
+    s->time = time;
+    s->imu_mask = 0;
+    memset(&s->pulses, 0, sizeof(s->pulses));
+    *open = true;
+}
+
+bool read_part(FILE *fp, std::vector<sample_t> &samples, uint16_t *sample_freq)
+{
+    static uint8_t data[4096];
+    log_header_t header;
+    rec_mark_check_t marks;
+    sample_t s;
+    bool open = false;                              // s has records
+    uint32_t len = 0, pos = 0, base = 0, time = 0;
+
+    memset(&header, 0, sizeof(header));
+    if (fread(&header, LOG_HEADER_V2_SIZE, 1, fp) != 1 || header.magic != LOG_MAGIC)
+        return false;
+    if (header.version >= 3 && fread(&header.run_id, sizeof(header.run_id), 1, fp) != 1)
+        return false;
+    marks.run_id = header.run_id;
+    marks.next = 0;
+    marks.seq = 0;
+    *sample_freq = header.sample_freq;
+    memset(&s, 0, sizeof(s));                       // Analog and encoders are 0 at the start of every file
+
+    for (;;)
+    {
+        if (len - pos < REC_MAX_SIZE + 1 + sizeof(rec_time_t) && !feof(fp))
+        {
+            memmove(data, data + pos, len - pos);
+            base += pos;
+            len = len - pos + fread(data + len - pos, 1, sizeof(data) - (len - pos), fp);
+            pos = 0;
+        }
+        if (pos >= len)
+            break;
+
+        uint8_t tag = data[pos] & REC_TAG_MASK;
+        uint32_t head = (data[pos] & REC_SAME_TIME) ? 1 : 2;
+
+        if (!rec_mark_valid(&marks, base + pos, data + pos, len - pos))
+            break;                                  // Stale data after the last block of the run
+        if (tag == 0 || tag >= REC_NUM_TAGS || pos + head + rec_payload_size[tag] > len)
+            break;                                  // Corrupted or truncated last record
+        if (head == 2)
+            time += data[pos + 1];
+        const uint8_t *payload = data + pos + head;
+
+        switch (tag)
+        {
+            case REC_TIME:
+            {
+                rec_time_t t;
+                memcpy(&t, payload, sizeof(t));
+                time = t.time_stamp;
+                break;
+            }
+            case REC_IMU:
+                start_sample(&s, &open, samples, time);
+                s.imu_mask = 1;
+                memcpy(&s.imu[0], payload, sizeof(rec_imu_t));
+                break;
+            case REC_IMU_GROUP:
+            {
+                rec_imu_group_t group;
+                memcpy(&group, payload, sizeof(group));
+                start_sample(&s, &open, samples, time);
+                s.imu_mask = group.mask;
+                memcpy(s.imu, group.imu, sizeof(s.imu));
+                break;
+            }
+            case REC_ANALOG:
+            case REC_PULSES:
+            case REC_QENC:
+            case REC_QENC1:
+                if (!open || s.time != time)        // Sample without IMU
+                {
+                    start_sample(&s, &open, samples, time);
+                }
+                if (tag == REC_ANALOG)
+                    memcpy(&s.analog, payload, sizeof(s.analog));
+                else if (tag != REC_PULSES)
+                    memcpy(&s.qenc[tag - REC_QENC], payload, sizeof(rec_qenc_t));
+                else
+                    memcpy(&s.pulses, payload, sizeof(s.pulses));
+                break;
+            default:
+                break;
+        }
+        pos += head + rec_payload_size[tag];
+    }
+    if (open)
+        samples.push_back(s);
+    return true;
+}
+
+bool read_run(const char *dir, FILE *(*open)(const char *, const char *), int (*close)(FILE *),
+              std::vector<sample_t> &samples, uint16_t *sample_freq)
+{
+    char name[256];
+    FILE *fp;
+    int part;
+
+    for (part = 1; ; part++)
+    {
+        snprintf(name, sizeof(name), "%s/part%d", dir, part);
+        if ((fp = open(name, "rb")) == NULL)
+            break;
+
+        bool ok = read_part(fp, samples, sample_freq);
+        close(fp);
+        if (!ok)
+            break;
+    }
+    return part > 1;
+}
+
+}
@@ -0,0 +1,37 @@
+/*
+    Decoding of the logger's record stream ("log_record.h") back into the
+    samples it was written from, for the simulation driver and the replay.
+*/
+
+#ifndef SIM_RUN_READER_H
+#define SIM_RUN_READER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include "../../Logger/log_record.h"
+
+namespace sim
+{
+
+/* One stored sample: the IMU record(s) and the analog, pulse and encoder records of its time */
+typedef struct
+{
+    uint32_t time;                                  // ms since run start
+    uint8_t imu_mask;                               // Bit d: imu[d] is valid
+    rec_imu_t imu[IMU_GROUP_MAX];
+    rec_analog_t analog;                            // Held from the last analog record
+    rec_pulses_t pulses;                            // Zero without a pulses record
+    rec_qenc_t qenc[QENC_MAX];                      // Held from the last record of each encoder
+} sample_t;
+
+/* Appends the samples of one part file, returns false if it has no valid header */
+bool read_part(FILE *fp, std::vector<sample_t> &samples, uint16_t *sample_freq);
+
+/* Reads dir/part1, dir/part2, ... with the given stdio calls, false if there is no part */
+bool read_run(const char *dir, FILE *(*open)(const char *, const char *), int (*close)(FILE *),
+              std::vector<sample_t> &samples, uint16_t *sample_freq);
+
+}
+
+#endif // SIM_RUN_READER_H
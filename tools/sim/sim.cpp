@@ -0,0 +1,542 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <new>
+#include "sim.h"
+#include "HeapBlockDevice.h"
+#include "FileBlockDevice.h"
+#include "replay.h"
+#include "platform/mbed_critical.h"
+#include "platform/mbed_stats.h"
+#include "hal/us_ticker_api.h"
+
+using namespace mbed;
+
+namespace sim
+{
+
+config_t config =
+{
+    1.0,                                            // speedup
+    2,                                              // loop_us
+    0.0,                                            // cpu_scale
+    20,                                             // adc_us
+    100,                                            // start_ms
+    60000,                                          // duration_ms
+    SDTimingBlockDevice::timing_t(),
+    NULL,                                           // image
+    1024ULL * 1024 * 1024,                          // card_size
+    1,                                              // seed
+    false,                                          // console
+    100,                                            // queue_ms
+    140,                                            // crc_ns: slice-by-4 at 72 MHz, tables in flash (estimate)
+};
+
+stats_t stats;
+
+/* Clock */
+static uint64_t clock_us;
+static std::vector<event_t *> events;
+static bool in_event;                               // An interrupt is running
+static uint64_t last_cpu_ns;
+static double cpu_carry_us;
+
+uint64_t now()
+{
+    return clock_us;
+}
+
+static event_t *next_event()
+{
+    event_t *next = NULL;
+
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        if (next == NULL || events[i]->due < next->due)
+            next = events[i];
+    }
+    return next;
+}
+
+void advance(uint64_t us)
+{
+    uint64_t target = clock_us + us;
+    event_t *e;
+
+    if (in_event)                                   // No nesting, as on a single priority level
+    {
+        clock_us = target;
+        return;
+    }
+
+    while ((e = next_event()) != NULL && e->due <= target)
+    {
+        if (e->due > clock_us)
+            clock_us = (uint64_t)ceil(e->due);      // Not before it is due
+        if (e->period > 0)
+            e->due += e->period;
+        else
+            cancel(e);
+
+        in_event = true;
+        e->fire();
+        in_event = false;
+    }
+    clock_us = target;
+}
+
+void busy(uint64_t *counter, uint64_t us)
+{
+    *counter += us;
+    advance(us);
+}
+
+void poll()
+{
+    stats.polls++;
+    if (config.cpu_scale > 0)
+    {
+        struct timespec ts;
+        uint64_t ns;
+
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+        if (last_cpu_ns != 0)
+        {
+            cpu_carry_us += (ns - last_cpu_ns) * config.cpu_scale / 1000.0;
+            uint64_t us = (uint64_t)cpu_carry_us;
+            cpu_carry_us -= us;
+            busy(&stats.loop_us, us);
+        }
+        last_cpu_ns = ns;
+    }
+    else
+    {
+        busy(&stats.loop_us, config.loop_us);
+    }
+}
+
+void schedule(event_t *e)
+{
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        if (events[i] == e)
+            return;
+    }
+    e->active = true;
+    heap_exempt(true);
+    events.push_back(e);
+    heap_exempt(false);
+}
+
+void cancel(event_t *e)
+{
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        if (events[i] == e)
+        {
+            events.erase(events.begin() + i);
+            break;
+        }
+    }
+    e->active = false;
+}
+
+/* Signals */
+static uint32_t noise_state;
+
+static float noise()
+{
+    if (noise_state == 0)
+        noise_state = config.seed ? config.seed : 1;
+    noise_state ^= noise_state << 13;               // xorshift32
+    noise_state ^= noise_state >> 17;
+    noise_state ^= noise_state << 5;
+    return (noise_state / 4294967296.0f) * 2 - 1;
+}
+
+float signal_value(const signal_t *s, uint64_t us)
+{
+    float v = s->offset;
+
+    if (s->amplitude != 0 && s->freq_hz != 0)
+        v += s->amplitude * sinf(2 * (float)M_PI * s->freq_hz * fmodf(us / 1e6f, 1 / s->freq_hz));
+    if (s->noise != 0)
+        v += s->noise * noise();
+    return v;
+}
+
+static signal_t analog[SIM_NUM_PINS];
+
+void set_analog(PinName pin, const signal_t &s)
+{
+    analog[pin] = s;
+}
+
+uint16_t analog_value(PinName pin)
+{
+    float v = signal_value(&analog[pin], clock_us);
+    uint16_t v12;
+
+    if (replay_analog(pin, &v12))
+        return v12;                                 // Recorded, already quantized
+
+    v = (v < 0) ? 0 : (v > 65535) ? 65535 : v;
+    v12 = (uint16_t)v >> 4;                         // 12-bit ADC, scaled as AnalogIn::read_u16()
+    return (v12 << 4) | (v12 >> 8);
+}
+
+static signal_t encoders[SIM_NUM_PINS];
+
+void set_encoder(PinName ch1, const signal_t &s)
+{
+    encoders[ch1] = s;
+}
+
+uint16_t encoder_count(PinName ch1)
+{
+    int32_t position;
+
+    if (!replay_qenc(ch1, &position))
+        position = (int32_t)floorf(signal_value(&encoders[ch1], clock_us));
+    return (uint16_t)position;
+}
+
+/* LSM6DS3 register file, outputs refreshed from the signals when read */
+#define IMU_REGS        0x80
+#define IMU_WHO_AM_I    0x0F
+#define IMU_STATUS      0x1E
+#define IMU_OUTX_L_G    0x22
+#define IMU_OUTX_L_XL   0x28
+
+typedef struct
+{
+    uint8_t regs[IMU_REGS];
+    uint8_t ptr;                                    // Register address, auto-incremented
+    signal_t ch[SIM_IMU_CHANNELS];
+} imu_t;
+
+static std::map<uint8_t, imu_t> imus;               // By 8-bit I2C address
+
+void set_imu_present(uint8_t addr, bool present)
+{
+    if (!present)
+    {
+        imus.erase(addr);
+    }
+    else if (imus.find(addr) == imus.end())
+    {
+        imu_t &imu = imus[addr];
+
+        memset(&imu, 0, sizeof(imu));
+        imu.regs[IMU_WHO_AM_I] = 0x69;
+    }
+}
+
+void set_imu(uint8_t addr, int channel, const signal_t &s)
+{
+    set_imu_present(addr, true);
+    imus[addr].ch[channel] = s;
+}
+
+static void imu_refresh(uint8_t addr, imu_t *imu)
+{
+    rec_imu_t recorded;
+    bool replay = replay_imu(addr, &recorded);
+
+    for (int c = 0; c < SIM_IMU_CHANNELS; c++)
+    {
+        float v = signal_value(&imu->ch[c], clock_us);
+        int16_t raw = (v < -32768) ? -32768 : (v > 32767) ? 32767 : (int16_t)v;
+
+        if (replay)
+            raw = (c < 3) ? recorded.acc[c] : recorded.gyr[c - 3];
+        uint8_t reg = (c < 3) ? IMU_OUTX_L_XL + 2 * c : IMU_OUTX_L_G + 2 * (c - 3);
+
+        imu->regs[reg] = raw & 0xFF;
+        imu->regs[reg + 1] = (raw >> 8) & 0xFF;
+    }
+    imu->regs[IMU_STATUS] = 0x07;                   // Temperature, gyro and accel data available
+}
+
+bool i2c_write(uint8_t addr, const uint8_t *data, int len)
+{
+    std::map<uint8_t, imu_t>::iterator it = imus.find(addr & 0xFE);
+
+    if (it == imus.end())
+        return false;
+    if (len > 0)
+        it->second.ptr = data[0] % IMU_REGS;
+    for (int i = 1; i < len; i++)
+    {
+        it->second.regs[it->second.ptr] = data[i];
+        it->second.ptr = (it->second.ptr + 1) % IMU_REGS;
+    }
+    return true;
+}
+
+bool i2c_read(uint8_t addr, uint8_t *data, int len)
+{
+    std::map<uint8_t, imu_t>::iterator it = imus.find(addr & 0xFE);
+
+    if (it == imus.end())
+        return false;
+    imu_refresh(it->first, &it->second);
+    for (int i = 0; i < len; i++)
+    {
+        data[i] = it->second.regs[it->second.ptr];
+        it->second.ptr = (it->second.ptr + 1) % IMU_REGS;
+    }
+    return true;
+}
+
+/* Acquisition queue: the largest CircularBuffer, while logging */
+static const void *queue;
+static uint32_t queue_bytes;
+static std::vector<uint32_t> depths;
+
+void queue_depth(const void *buffer, uint32_t bytes, uint32_t depth, bool overwrite)
+{
+    if (bytes > queue_bytes)
+    {
+        queue = buffer;
+        queue_bytes = bytes;
+    }
+    if (buffer != queue || clock_us < stats.start_us || clock_us >= stats.stop_us)
+        return;
+
+    size_t slot = (clock_us - stats.start_us) / (config.queue_ms * 1000ULL);
+    if (slot >= depths.size())
+    {
+        heap_exempt(true);                          // Not the logger's memory
+        depths.resize(slot + 1, 0);
+        heap_exempt(false);
+    }
+    depths[slot] = std::max(depths[slot], depth);
+    stats.queue_max = std::max(stats.queue_max, depth);
+    if (overwrite)
+        stats.queue_overwrites++;
+}
+
+const std::vector<uint32_t> &queue_depths()
+{
+    return depths;
+}
+
+/* Pins */
+static Callback<void()> rise_handler[SIM_NUM_PINS], fall_handler[SIM_NUM_PINS];
+
+void on_edge(PinName pin, bool rising, Callback<void()> handler)
+{
+    if (pin < 0 || pin >= SIM_NUM_PINS)
+        return;
+    if (rising)
+        rise_handler[pin] = handler;
+    else
+        fall_handler[pin] = handler;
+}
+
+void edge(PinName pin, bool rising)
+{
+    Callback<void()> &handler = rising ? rise_handler[pin] : fall_handler[pin];
+
+    if (handler)
+        handler();
+}
+
+bool edge_handled(PinName pin, bool rising)
+{
+    return rising ? (bool)rise_handler[pin] : (bool)fall_handler[pin];
+}
+
+/* Edge sources */
+typedef struct edge_source
+{
+    PinName pin;
+    bool rising;
+    event_t event;
+
+    void fire()
+    {
+        edge(pin, rising);
+    }
+} edge_source_t;
+
+static edge_source_t pulses[SIM_NUM_PINS];
+
+void set_pulses(PinName pin, float hz)
+{
+    edge_source_t *p = &pulses[pin];
+
+    cancel(&p->event);
+    if (hz > 0)
+    {
+        p->pin = pin;
+        p->rising = false;
+        p->event.period = 1e6 / hz;
+        p->event.due = clock_us + p->event.period;
+        p->event.fire = callback(p, &edge_source_t::fire);
+        schedule(&p->event);
+    }
+}
+
+/* Card */
+BlockDevice *card_storage()
+{
+    static BlockDevice *storage;
+
+    if (storage == NULL)
+    {
+        if (config.image != NULL)
+            storage = new FileBlockDevice(config.image, config.card_size);
+        else
+            storage = new HeapBlockDevice(config.card_size, 512);
+    }
+    return storage;
+}
+
+#define SIM_PIN_NAME(name) #name,
+static const char *pin_names[SIM_NUM_PINS] = { SIM_PINS(SIM_PIN_NAME) };
+#undef SIM_PIN_NAME
+
+PinName pin_by_name(const char *name)
+{
+    for (int i = 0; i < SIM_NUM_PINS; i++)
+    {
+        if (strcmp(pin_names[i], name) == 0)
+            return (PinName)i;
+    }
+    return NC;
+}
+
+const char *pin_name(PinName pin)
+{
+    return (pin >= 0 && pin < SIM_NUM_PINS) ? pin_names[pin] : "NC";
+}
+
+}
+
+/* mbed platform on the virtual clock */
+extern "C" uint32_t us_ticker_read()
+{
+    sim::poll();
+    return (uint32_t)sim::now();
+}
+
+extern "C" void core_util_critical_section_enter(void)
+{
+}
+
+extern "C" void core_util_critical_section_exit(void)
+{
+}
+
+extern "C" void error(const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    exit(2);
+}
+
+void wait_us(int us)
+{
+    sim::busy(&sim::stats.loop_us, us);
+}
+
+void wait_ms(int ms)
+{
+    wait_us(ms * 1000);
+}
+
+void wait(float s)
+{
+    wait_us(s * 1000000.0f);
+}
+
+void NVIC_SystemReset()
+{
+    sim::stats.reset = true;                        // The logger returns from main() right after
+}
+
+/* Heap statistics: a header before each block keeps its size. GCC takes
+   the free() of what operator new returned for a mismatch. */
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#define HEAP_HEADER 16                              // Keeps the alignment of malloc()
+
+static mbed_stats_heap_t heap_stats;
+static int heap_exempt_depth;
+
+void sim::heap_exempt(bool exempt)
+{
+    heap_exempt_depth += exempt ? 1 : -1;
+}
+
+extern "C" void mbed_stats_heap_get(mbed_stats_heap_t *stats)
+{
+    *stats = heap_stats;
+}
+
+void *operator new(size_t size)
+{
+    uint8_t *p = (uint8_t *)malloc(size + HEAP_HEADER);
+
+    if (p == NULL)
+        throw std::bad_alloc();
+    *(size_t *)p = (heap_exempt_depth > 0) ? 0 : size + 1;   // 0: not counted
+    if (heap_exempt_depth == 0)
+    {
+        heap_stats.current_size += size;
+        heap_stats.total_size += size;
+        heap_stats.alloc_cnt++;
+        if (heap_stats.current_size > heap_stats.max_size)
+            heap_stats.max_size = heap_stats.current_size;
+    }
+    return p + HEAP_HEADER;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    if (ptr == NULL)
+        return;
+
+    uint8_t *p = (uint8_t *)ptr - HEAP_HEADER;
+    size_t size = *(size_t *)p;
+
+    if (size != 0)
+    {
+        heap_stats.current_size -= size - 1;
+        heap_stats.alloc_cnt--;
+    }
+    free(p);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete(void *ptr, size_t size) noexcept
+{
+    (void)size;
+    operator delete(ptr);
+}
+
+void operator delete[](void *ptr, size_t size) noexcept
+{
+    (void)size;
+    operator delete(ptr);
+}
@@ -0,0 +1,154 @@
+/*
+    Logger host simulation kernel: virtual clock, interrupt sources and the
+    signals seen by the simulated peripherals (see "mbed.h" in this folder).
+
+    Time only moves when the logger is busy: card operations take what
+    SDTimingBlockDevice says, I2C transfers their bus time, ADC reads
+    config.adc_us, and every read of the time (Timer, us_ticker_read) stands
+    for the code run since the previous one, config.loop_us (or the host CPU
+    time scaled by config.cpu_scale). Interrupts fire at their exact virtual
+    time, in the middle of whatever the logger was doing.
+*/
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <vector>
+#include "platform/Callback.h"
+#include "SDTimingBlockDevice.h"
+
+/* Pins of the STM32F103, as in the mbed target */
+#define SIM_PINS(X) \
+    X(PA_0) X(PA_1) X(PA_2) X(PA_3) X(PA_4) X(PA_5) X(PA_6) X(PA_7) \
+    X(PA_8) X(PA_9) X(PA_10) X(PA_11) X(PA_12) X(PA_13) X(PA_14) X(PA_15) \
+    X(PB_0) X(PB_1) X(PB_2) X(PB_3) X(PB_4) X(PB_5) X(PB_6) X(PB_7) \
+    X(PB_8) X(PB_9) X(PB_10) X(PB_11) X(PB_12) X(PB_13) X(PB_14) X(PB_15) \
+    X(PC_13) X(PC_14) X(PC_15)
+
+#define SIM_PIN_ENUM(name) name,
+typedef enum
+{
+    SIM_PINS(SIM_PIN_ENUM)
+    SIM_NUM_PINS,
+    NC = -1
+} PinName;
+#undef SIM_PIN_ENUM
+
+typedef enum
+{
+    PullNone,
+    PullUp,
+    PullDown,
+    PullDefault = PullNone
+} PinMode;
+
+namespace sim
+{
+
+/* Simulation parameters, set before the logger starts */
+typedef struct
+{
+    double speedup;                                 // Ticker rates multiplied by this
+    uint32_t loop_us;                               // Charged at every read of the time
+    double cpu_scale;                               // If > 0, host CPU time x cpu_scale instead of loop_us
+    uint32_t adc_us;                                // AnalogIn conversion time
+    uint32_t start_ms;                              // Start button press, from boot (or once the button is armed)
+    uint32_t duration_ms;                           // Stop button press, from the start press
+    mbed::SDTimingBlockDevice::timing_t timing;     // SD card model
+    const char *image;                              // Card image file, NULL for a heap card
+    uint64_t card_size;                             // Card size in bytes
+    uint32_t seed;                                  // Signal noise
+    bool console;                                   // Debug UART output to stderr
+    uint32_t queue_ms;                              // Interval of the queue depth series
+    uint32_t crc_ns;                                // CPU time per byte of SD data CRC16, when the logger turns it on
+} config_t;
+
+/* What the logger did with its time */
+typedef struct
+{
+    uint64_t card_us;                               // Card operations
+    uint64_t bus_us;                                // I2C transfers
+    uint64_t adc_us;                                // ADC conversions
+    uint64_t loop_us;                               // Code between reads of the time
+    uint64_t max_card_us;                           // Longest card operation
+    uint32_t card_ops;
+    uint64_t polls;                                 // Reads of the time
+    uint64_t ticks;                                 // Ticker interrupts while logging
+    uint64_t tick_hz_x1000;                         // Fastest ticker rate (mHz)
+    uint64_t start_us, stop_us;                     // Button presses
+    uint32_t queue_max;                             // Deepest acquisition queue while logging
+    uint32_t queue_overwrites;                      // Pushes into the full queue
+    bool reset;                                     // NVIC_SystemReset() reached
+} stats_t;
+
+extern config_t config;
+extern stats_t stats;
+
+/* Interrupt source: fires at due (µs, fractional), then every period if non-zero */
+typedef struct event
+{
+    double due;
+    double period;
+    mbed::Callback<void()> fire;
+    bool active;
+} event_t;
+
+/* Input signal: offset + amplitude * sin(2 pi freq_hz t) + uniform noise in [-noise, noise] */
+typedef struct
+{
+    float offset;
+    float amplitude;
+    float freq_hz;
+    float noise;
+} signal_t;
+
+#define SIM_IMU_CHANNELS 6                          // acc x, y, z, gyr x, y, z
+
+/* Clock */
+uint64_t now();
+void advance(uint64_t us);
+void poll();
+void schedule(event_t *e);
+void cancel(event_t *e);
+void busy(uint64_t *counter, uint64_t us);          // advance() and account the time to counter
+
+/* Signals, time is virtual time */
+float signal_value(const signal_t *s, uint64_t us);
+void set_analog(PinName pin, const signal_t &s);
+uint16_t analog_value(PinName pin);                 // Full scale 0..65535
+void set_imu(uint8_t addr, int channel, const signal_t &s);
+void set_imu_present(uint8_t addr, bool present);
+void set_pulses(PinName pin, float hz);             // Falling edges at hz, 0 to stop
+void set_encoder(PinName ch1, const signal_t &s);   // Position in counts of the encoder on ch1 (and CH2)
+uint16_t encoder_count(PinName ch1);                // Timer counter, the position modulo 2^16
+
+/* Pin edges, delivered to the handler set by the InterruptIn on the pin */
+void on_edge(PinName pin, bool rising, mbed::Callback<void()> handler);
+void edge(PinName pin, bool rising);
+bool edge_handled(PinName pin, bool rising);
+
+/* I2C devices: write/read bursts, false if no device acknowledges addr */
+bool i2c_write(uint8_t addr, const uint8_t *data, int len);
+bool i2c_read(uint8_t addr, uint8_t *data, int len);
+
+/* Acquisition queue depth, reported by every CircularBuffer (see "mbed.h"):
+   the largest one is followed, the deepest point of each config.queue_ms */
+void queue_depth(const void *buffer, uint32_t bytes, uint32_t depth, bool overwrite);
+const std::vector<uint32_t> &queue_depths();
+
+/* Heap statistics of the logger (mbed_stats_heap_get): its C++ allocations,
+   those of the mbed storage stack, without the ones the simulation makes
+   itself between heap_exempt(true) and heap_exempt(false) */
+void heap_exempt(bool exempt);
+
+/* Card storage under the SD timing model */
+mbed::BlockDevice *card_storage();
+
+/* Pin name lookup, NC if unknown */
+PinName pin_by_name(const char *name);
+const char *pin_name(PinName pin);
+
+}
+
+#endif // SIM_H
@@ -0,0 +1,14 @@
+/*
+    Simulation build configuration, passed with -include: the host storage
+    configuration plus the microsecond ticker, which "sim.cpp" drives from
+    the virtual clock.
+*/
+
+#ifndef SIM_CONFIG_H
+#define SIM_CONFIG_H
+
+#include "../host/mbed_config.h"
+
+#define DEVICE_USTICKER         1
+
+#endif // SIM_CONFIG_H
@@ -0,0 +1,332 @@
+/*
+    C stdio and POSIX file calls of the logger (renamed in "mbed.h"), on the
+    mbed FileSystem named by the first path component, as mbed_retarget does
+    on the target. Streams are glibc FILEs over the FileHandle (fopencookie),
+    with a 1 KB buffer like newlib's. fclose() leaves the FILE itself valid:
+    the logger keeps writing to a closed file after a buffer overflow, those
+    bytes are counted as dropped.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <vector>
+
+#define fsync       sim_fsync
+#define ftruncate   sim_ftruncate
+#define mkdir       sim_mkdir
+#define opendir     sim_opendir
+#define readdir     sim_readdir
+#define closedir    sim_closedir
+#include "platform/mbed_retarget.h"                 // Not <unistd.h> and <sys/stat.h>, which it replaces
+#undef fsync
+#undef ftruncate
+#undef mkdir
+#undef opendir
+#undef readdir
+#undef closedir
+
+#include "platform/FilePath.h"
+#include "platform/FileSystemHandle.h"
+#include "platform/FileHandle.h"
+#include "platform/DirHandle.h"
+#include "sim.h"
+#include "sim_stdio.h"
+
+using namespace mbed;
+
+#define SIM_FD_BASE         1000                    // sim_fileno() of card files
+#define SIM_STDIO_BUFFER    1024
+
+typedef struct
+{
+    FILE *stream;
+    FileHandle *file;
+    bool closed;
+} sim_file_t;
+
+static std::vector<sim_file_t *> files;
+static char last_dir[64];
+static uint64_t dropped, first_drop_us;
+
+static sim_file_t *find(FILE *stream)
+{
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (files[i]->stream == stream)
+            return files[i];
+    }
+    return NULL;
+}
+
+/* Card file system of a path, NULL for a host path */
+static FileSystemHandle *card_fs(const char *path, const char **name)
+{
+    FilePath fp(path);
+
+    if (!fp.exists() || !fp.isFileSystem())
+        return NULL;
+    *name = fp.fileName();
+    return fp.fileSystem();
+}
+
+static ssize_t cookie_read(void *cookie, char *buf, size_t size)
+{
+    sim_file_t *f = (sim_file_t *)cookie;
+    ssize_t n;
+
+    if (f->closed)
+        return 0;
+    n = f->file->read(buf, size);
+    return (n < 0) ? -1 : n;
+}
+
+static ssize_t cookie_write(void *cookie, const char *buf, size_t size)
+{
+    sim_file_t *f = (sim_file_t *)cookie;
+    ssize_t n;
+
+    if (f->closed)
+    {
+        if (dropped == 0)
+            first_drop_us = sim::now();
+        dropped += size;
+        return size;
+    }
+    n = f->file->write(buf, size);
+    return (n < 0) ? 0 : n;                         // 0 is the error return of a cookie write
+}
+
+static int cookie_seek(void *cookie, off64_t *offset, int whence)
+{
+    sim_file_t *f = (sim_file_t *)cookie;
+    off_t pos;
+
+    if (f->closed)
+        return -1;
+    pos = f->file->seek(*offset, whence);
+    if (pos < 0)
+        return -1;
+    *offset = pos;
+    return 0;
+}
+
+static int cookie_close(void *cookie)
+{
+    sim_file_t *f = (sim_file_t *)cookie;
+
+    if (!f->closed)
+        f->file->close();
+    f->closed = true;
+    return 0;
+}
+
+FILE *sim_fopen(const char *path, const char *mode)
+{
+    static const cookie_io_functions_t io = { cookie_read, cookie_write, cookie_seek, cookie_close };
+    const char *name;
+    FileSystemHandle *fs = card_fs(path, &name);
+    FileHandle *file;
+    int flags, err;
+
+    if (fs == NULL)
+        return fopen(path, mode);
+
+    /* As in mbed_retarget */
+    switch (mode[0])
+    {
+        case 'r':
+            flags = O_RDONLY;
+            break;
+        case 'w':
+            flags = O_WRONLY | O_CREAT | O_TRUNC;
+            break;
+        case 'a':
+            flags = O_WRONLY | O_CREAT | O_APPEND;
+            break;
+        default:
+            errno = EINVAL;
+            return NULL;
+    }
+    if (strchr(mode, '+') != NULL)
+        flags = (flags & ~O_ACCMODE) | O_RDWR;
+
+    err = fs->open(&file, name, flags);
+    if (err < 0)
+    {
+        errno = -err;
+        return NULL;
+    }
+
+    sim::heap_exempt(true);                         // The FILE, in newlib's memory on the target
+    sim_file_t *f = new sim_file_t;
+    f->file = file;
+    f->closed = false;
+    f->stream = fopencookie(f, mode, io);
+    setvbuf(f->stream, NULL, _IOFBF, SIM_STDIO_BUFFER);
+    files.push_back(f);
+    sim::heap_exempt(false);
+    return f->stream;
+}
+
+int sim_fclose(FILE *stream)
+{
+    sim_file_t *f = find(stream);
+
+    if (f == NULL)
+        return fclose(stream);
+
+    int err = fflush(stream);
+    if (!f->closed)
+        f->file->close();
+    f->closed = true;
+    return err;
+}
+
+int sim_fileno(FILE *stream)
+{
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (files[i]->stream == stream)
+            return SIM_FD_BASE + i;
+    }
+    return fileno(stream);
+}
+
+extern "C" int sim_fsync(int fd)
+{
+    if (fd < SIM_FD_BASE || (size_t)(fd - SIM_FD_BASE) >= files.size() || files[fd - SIM_FD_BASE]->closed)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    int err = files[fd - SIM_FD_BASE]->file->sync();
+    if (err < 0)
+    {
+        errno = -err;
+        return -1;
+    }
+    return 0;
+}
+
+extern "C" int sim_ftruncate(int fd, off_t length)
+{
+    if (fd < SIM_FD_BASE || (size_t)(fd - SIM_FD_BASE) >= files.size() || files[fd - SIM_FD_BASE]->closed)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    int err = files[fd - SIM_FD_BASE]->file->truncate(length);
+    if (err < 0)
+    {
+        errno = -err;
+        return -1;
+    }
+    return 0;
+}
+
+int sim_remove(const char *path)
+{
+    const char *name;
+    FileSystemHandle *fs = card_fs(path, &name);
+
+    if (fs == NULL)
+        return remove(path);
+
+    int err = fs->remove(name);
+    if (err < 0)
+    {
+        errno = -err;
+        return -1;
+    }
+    return 0;
+}
+
+extern "C" int sim_mkdir(const char *path, mode_t mode)
+{
+    const char *name;
+    FileSystemHandle *fs = card_fs(path, &name);
+
+    if (fs == NULL)
+    {
+        errno = ENOENT;                             // Only card directories
+        return -1;
+    }
+
+    int err = fs->mkdir(name, mode);
+    if (err < 0)
+    {
+        errno = -err;
+        return -1;
+    }
+    snprintf(last_dir, sizeof(last_dir), "%s", path);
+    return 0;
+}
+
+extern "C" DIR *sim_opendir(const char *path)
+{
+    const char *name;
+    FileSystemHandle *fs = card_fs(path, &name);
+    DirHandle *dir;
+
+    if (fs == NULL)
+    {
+        errno = ENOENT;                             // Only card directories
+        return NULL;
+    }
+
+    int err = fs->open(&dir, name);
+    if (err < 0)
+    {
+        errno = -err;
+        return NULL;
+    }
+    return dir;
+}
+
+extern "C" struct dirent *sim_readdir(DIR *dir)
+{
+    static struct dirent ent;
+
+    return (dir->read(&ent) > 0) ? &ent : NULL;
+}
+
+extern "C" int sim_closedir(DIR *dir)
+{
+    int err = dir->close();
+    if (err < 0)
+    {
+        errno = -err;
+        return -1;
+    }
+    return 0;
+}
+
+namespace sim
+{
+
+const char *stdio_last_dir()
+{
+    return last_dir;
+}
+
+uint64_t stdio_dropped(uint64_t *first_us)
+{
+    if (first_us != NULL)
+        *first_us = first_drop_us;
+    return dropped;
+}
+
+void stdio_close_all()
+{
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        fclose(files[i]->stream);
+        delete files[i];
+    }
+    files.clear();
+}
+
+}
@@ -0,0 +1,31 @@
+/*
+    Card files of the logger, see "sim_stdio.cpp". Declared apart from
+    "mbed.h" so the simulation driver can use them without the renames.
+*/
+
+#ifndef SIM_STDIO_H
+#define SIM_STDIO_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+FILE *sim_fopen(const char *path, const char *mode);
+int sim_fclose(FILE *stream);
+int sim_fileno(FILE *stream);
+int sim_remove(const char *path);
+
+namespace sim
+{
+
+/* Directory of the last mkdir() on a card, "" if none */
+const char *stdio_last_dir();
+
+/* Bytes written to closed card files, and the time of the first one */
+uint64_t stdio_dropped(uint64_t *first_us);
+
+/* Close every card stream, the logger leaves them open on reset */
+void stdio_close_all();
+
+}
+
+#endif // SIM_STDIO_H
@@ -0,0 +1,402 @@
+/*
+    Host viewer for the run summary RUNx/summary (see "Logger/SummaryStream.h").
+    Without a channel it prints the envelope of every channel over the whole
+    run. With a channel it plots the run in text: one line per slice of
+    windows, with the min..max range, the mean and the RMS. With a time
+    range too, it lists the windows in it and then decodes the raw records
+    of that channel from the part files holding them only (REC_WINDOW gives
+    the part of each window), as "time_ms,value" lines.
+    The summary of a 30 min run is read and parsed in a few ms.
+
+    Usage:
+        summary_view <RUNx dir> [channel [from_ms to_ms]]
+        channels: lsmaccx lsmaccy lsmaccz lsmangx lsmangy lsmangz a0 a1 a2
+                  f1 f2 velocity0 velocity1 (read_struct column names)
+    Build: gcc -O2 -o summary_view summary_view.c -lm
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "../Logger/log_record.h"
+
+#define PLOT_ROWS   40                              // Lines of the whole-run plot
+#define PLOT_WIDTH  60                              // Characters of its value axis
+
+static const char *channel_names[SUM_CHANNELS] = {
+    "lsmaccx", "lsmaccy", "lsmaccz", "lsmangx", "lsmangy", "lsmangz",
+    "a0", "a1", "a2", "f1", "f2", "velocity0", "velocity1"
+};
+
+typedef struct
+{
+    uint32_t start_ms;
+    rec_window_t window;
+    uint16_t mask;                                  // Channels present, bit per SUM_*
+    rec_summary_t channel[SUM_CHANNELS];
+} window_t;
+
+/* Envelope of several windows, count-weighted mean and RMS */
+typedef struct
+{
+    int32_t min, max;
+    double sum, sum_sq;
+    uint32_t count;
+} envelope_t;
+
+static window_t *windows;
+static size_t num_windows, windows_size;
+
+static uint8_t *read_file(const char *name, size_t *size)
+{
+    FILE *f = fopen(name, "rb");
+    uint8_t *data;
+    long length;
+
+    if (f == NULL)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    length = ftell(f);
+    rewind(f);
+    data = (uint8_t *)malloc(length > 0 ? length : 1);
+    if (data == NULL || fread(data, 1, length, f) != (size_t)length)
+    {
+        fprintf(stderr, "Can't read %s\n", name);
+        exit(1);
+    }
+    fclose(f);
+    *size = length;
+    return data;
+}
+
+/* Calls record() for every record of a stream file, stops when it returns 0.
+   Returns 0 if the file is not a record stream. */
+static int parse_records(const uint8_t *data, size_t size,
+                         int (*record)(uint8_t tag, uint32_t time, const uint8_t *payload, void *arg), void *arg)
+{
+    log_header_t header;
+    size_t pos;
+    uint32_t time = 0;
+
+    if (size < LOG_HEADER_V2_SIZE)
+        return 0;
+    memcpy(&header, data, LOG_HEADER_V2_SIZE);
+    if (header.magic != LOG_MAGIC || size < LOG_HEADER_SIZE(header.version))
+        return 0;
+    pos = LOG_HEADER_SIZE(header.version);          // The summary file has no block markers
+
+    while (pos < size)
+    {
+        uint8_t tag = data[pos] & REC_TAG_MASK;
+        uint32_t payload_size = (tag < REC_NUM_TAGS) ? rec_payload_size[tag] : 0;
+        uint32_t head = (data[pos] & REC_SAME_TIME) ? 1 : 2;
+
+        if (payload_size == 0 || pos + head + payload_size > size)
+            break;                                  // Unknown tag, stale data or truncated record
+        if (head == 2)
+            time += data[pos + 1];
+        pos += head;
+        if (tag == REC_TIME)
+        {
+            rec_time_t r;
+            memcpy(&r, data + pos, sizeof(r));
+            time = r.time_stamp;
+        }
+        else if (!record(tag, time, data + pos, arg))
+            break;
+        pos += payload_size;
+    }
+    return 1;
+}
+
+static int summary_record(uint8_t tag, uint32_t time, const uint8_t *payload, void *arg)
+{
+    (void)arg;
+    if (tag == REC_WINDOW)
+    {
+        if (num_windows == windows_size)
+        {
+            windows_size = windows_size ? 2 * windows_size : 1024;
+            windows = (window_t *)realloc(windows, windows_size * sizeof(window_t));
+            if (windows == NULL)
+            {
+                fprintf(stderr, "Out of memory\n");
+                exit(1);
+            }
+        }
+        memset(&windows[num_windows], 0, sizeof(window_t));
+        windows[num_windows].start_ms = time;
+        memcpy(&windows[num_windows].window, payload, sizeof(rec_window_t));
+        num_windows++;
+    }
+    else if (tag == REC_SUMMARY && num_windows > 0)
+    {
+        rec_summary_t r;
+
+        memcpy(&r, payload, sizeof(r));
+        if (r.channel < SUM_CHANNELS)
+        {
+            windows[num_windows - 1].channel[r.channel] = r;
+            windows[num_windows - 1].mask |= 1 << r.channel;
+        }
+    }
+    return 1;
+}
+
+static void envelope_add(envelope_t *e, const window_t *w, int ch)
+{
+    const rec_summary_t *s = &w->channel[ch];
+
+    if (e->count == 0 || s->min < e->min)
+        e->min = s->min;
+    if (e->count == 0 || s->max > e->max)
+        e->max = s->max;
+    e->sum += (double)s->mean * w->window.count;
+    e->sum_sq += (double)s->rms * s->rms * w->window.count;
+    e->count += w->window.count;
+}
+
+static void print_channels(void)
+{
+    printf("%-10s %10s %10s %10s %10s %8s\n", "channel", "min", "max", "mean", "rms", "samples");
+    for (int ch = 0; ch < SUM_CHANNELS; ch++)
+    {
+        envelope_t e = { 0 };
+
+        for (size_t i = 0; i < num_windows; i++)
+        {
+            if (windows[i].mask & (1 << ch))
+                envelope_add(&e, &windows[i], ch);
+        }
+        if (e.count)
+            printf("%-10s %10d %10d %10.0f %10.0f %8u\n", channel_names[ch], e.min, e.max, e.sum / e.count,
+                   sqrt(e.sum_sq / e.count), e.count);
+    }
+}
+
+static void plot_channel(int ch)
+{
+    uint32_t first = windows[0].start_ms, last = windows[num_windows - 1].window.last_ms;
+    uint32_t slice = (last - first) / PLOT_ROWS + 1;
+    envelope_t all = { 0 };
+    size_t i = 0;
+
+    for (size_t k = 0; k < num_windows; k++)
+    {
+        if (windows[k].mask & (1 << ch))
+            envelope_add(&all, &windows[k], ch);
+    }
+    if (all.count == 0)
+    {
+        printf("%s is not in the summary\n", channel_names[ch]);
+        return;
+    }
+    printf("%s from %d to %d\n", channel_names[ch], all.min, all.max);
+    printf("%9s %10s %10s %10s %10s\n", "time_s", "min", "mean", "max", "rms");
+
+    for (uint32_t row_start = first; row_start <= last; row_start += slice)
+    {
+        envelope_t e = { 0 };
+        char bar[PLOT_WIDTH + 1];
+        double range = (double)all.max - all.min + 1;
+
+        while (i < num_windows && windows[i].start_ms < row_start + slice)
+        {
+            if (windows[i].mask & (1 << ch))
+                envelope_add(&e, &windows[i], ch);
+            i++;
+        }
+        memset(bar, ' ', PLOT_WIDTH);
+        bar[PLOT_WIDTH] = '\0';
+        if (e.count == 0)
+        {
+            printf("%9.1f %10s %10s %10s %10s |%s|\n", row_start / 1000.0, "-", "-", "-", "-", bar);
+            continue;
+        }
+
+        double mean = e.sum / e.count;
+        int from = (int)((e.min - all.min) * PLOT_WIDTH / range);
+        int to = (int)((e.max - all.min) * PLOT_WIDTH / range);
+        int at = (int)((mean - all.min) * PLOT_WIDTH / range);
+
+        for (int c = from; c <= to && c < PLOT_WIDTH; c++)
+            bar[c] = '-';
+        bar[at < PLOT_WIDTH ? at : PLOT_WIDTH - 1] = '#';
+        printf("%9.1f %10d %10.0f %10d %10.0f |%s|\n", row_start / 1000.0, e.min, mean, e.max,
+               sqrt(e.sum_sq / e.count), bar);
+    }
+}
+
+/* Raw records of one channel in a time range */
+typedef struct
+{
+    int ch;
+    uint32_t from, to;
+    uint32_t printed;
+} raw_query_t;
+
+static int raw_record(uint8_t tag, uint32_t time, const uint8_t *payload, void *arg)
+{
+    raw_query_t *q = (raw_query_t *)arg;
+    int ch = q->ch;
+    int32_t value;
+
+    if (time > q->to)
+        return 0;
+    if (time < q->from)
+        return 1;
+
+    if (ch <= SUM_GYR_Z && (tag == REC_IMU || tag == REC_IMU_GROUP))
+    {
+        rec_imu_t imu;
+
+        if (tag == REC_IMU_GROUP)
+        {
+            rec_imu_group_t group;
+            memcpy(&group, payload, sizeof(group));
+            if (!(group.mask & 1))
+                return 1;
+            imu = group.imu[0];
+        }
+        else
+            memcpy(&imu, payload, sizeof(imu));
+        value = (ch <= SUM_ACC_Z) ? imu.acc[ch - SUM_ACC_X] : imu.gyr[ch - SUM_GYR_X];
+    }
+    else if (ch >= SUM_ANALOG0 && ch <= SUM_ANALOG2 && tag == REC_ANALOG)
+    {
+        rec_analog_t r;
+        memcpy(&r, payload, sizeof(r));
+        value = r.analog[ch - SUM_ANALOG0];
+    }
+    else if ((ch == SUM_PULSES1 || ch == SUM_PULSES2) && tag == REC_PULSES)
+    {
+        rec_pulses_t r;
+        memcpy(&r, payload, sizeof(r));
+        value = r.pulses[ch - SUM_PULSES1];
+    }
+    else if (ch >= SUM_QENC0 && tag == REC_QENC + (ch - SUM_QENC0))
+    {
+        rec_qenc_t r;
+        memcpy(&r, payload, sizeof(r));
+        value = r.velocity;
+    }
+    else
+        return 1;
+
+    printf("%u,%d\n", time, value);
+    q->printed++;
+    return 1;
+}
+
+static void print_raw(const char *dir, int ch, uint32_t from, uint32_t to)
+{
+    raw_query_t q = { ch, from, to, 0 };
+    int first_part = 0, last_part = 0;
+    char name[300];
+
+    /* Windows in the range, and the parts their samples are in */
+    printf("%9s %6s %5s %10s %10s %10s %10s\n", "start_ms", "count", "part", "min", "max", "mean", "rms");
+    for (size_t i = 0; i < num_windows; i++)
+    {
+        const window_t *w = &windows[i];
+        const rec_summary_t *s = &w->channel[ch];
+
+        if (w->window.last_ms < from)
+            continue;
+        if (w->start_ms > to)
+        {
+            last_part = w->window.part;             // The range may end in the part this one starts in
+            break;
+        }
+        if (first_part == 0)
+            first_part = w->window.part;
+        last_part = w->window.part + 1;             // A window may run into the next part
+        if (w->mask & (1 << ch))
+            printf("%9u %6u %5u %10d %10d %10d %10u\n", w->start_ms, w->window.count, w->window.part,
+                   s->min, s->max, s->mean, s->rms);
+    }
+    if (first_part == 0)
+    {
+        printf("No window between %u and %u ms\n", from, to);
+        return;
+    }
+
+    printf("\ntime_ms,%s\n", channel_names[ch]);
+    for (int part = first_part; part <= last_part; part++)
+    {
+        size_t size;
+        uint8_t *data;
+
+        snprintf(name, sizeof(name), "%s/part%d", dir, part);
+        data = read_file(name, &size);
+        if (data == NULL)
+            break;
+        if (!parse_records(data, size, raw_record, &q))
+            fprintf(stderr, "%s is not a record stream\n", name);
+        free(data);
+    }
+    fprintf(stderr, "%u raw records from part%d..part%d\n", q.printed, first_part, last_part);
+}
+
+int main(int argc, char **argv)
+{
+    char name[300];
+    size_t size;
+    uint8_t *data;
+    int ch = -1;
+    clock_t t0;
+
+    if (argc < 2 || argc == 4 || argc > 5)
+    {
+        fprintf(stderr, "Usage: summary_view <RUNx dir> [channel [from_ms to_ms]]\n");
+        return 1;
+    }
+    if (argc >= 3)
+    {
+        for (int c = 0; c < SUM_CHANNELS; c++)
+        {
+            if (strcmp(argv[2], channel_names[c]) == 0)
+                ch = c;
+        }
+        if (ch < 0)
+        {
+            fprintf(stderr, "Unknown channel %s\n", argv[2]);
+            return 1;
+        }
+    }
+
+    t0 = clock();
+    snprintf(name, sizeof(name), "%s/summary", argv[1]);
+    data = read_file(name, &size);
+    if (data == NULL)
+    {
+        fprintf(stderr, "Can't open %s\n", name);
+        return 1;
+    }
+    if (!parse_records(data, size, summary_record, NULL))
+    {
+        fprintf(stderr, "%s is not a record stream\n", name);
+        return 1;
+    }
+    free(data);
+    if (num_windows == 0)
+    {
+        printf("No window in %s\n", name);
+        return 0;
+    }
+    printf("%zu windows, %.1f s, %zu bytes, read in %.1f ms\n\n", num_windows,
+           (windows[num_windows - 1].window.last_ms - windows[0].start_ms) / 1000.0, size,
+           (clock() - t0) * 1000.0 / CLOCKS_PER_SEC);
+
+    if (ch < 0)
+        print_channels();
+    else if (argc == 3)
+        plot_channel(ch);
+    else
+        print_raw(argv[1], ch, strtoul(argv[3], NULL, 10), strtoul(argv[4], NULL, 10));
+    free(windows);
+    return 0;
+}
@@ -0,0 +1,388 @@
+/*
+    Host receiver for the logger live telemetry (see "Logger/telemetry_frame.h").
+    Decodes the COBS framed stream from a serial port and prints one CSV line per
+    frame on stdout. Statistics (frames, CRC errors, lost frames) go to stderr.
+
+    Usage:
+        telemetry_rx <device> [baud]        e.g. telemetry_rx /dev/ttyUSB0 115200
+        telemetry_rx --selftest [frames]    loopback test through a pseudo-terminal
+    Build: gcc -O2 -o telemetry_rx telemetry_rx.c ../Logger/telemetry_frame.c
+*/
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/select.h>
+#include <sys/wait.h>
+#include <time.h>
+#include "../Logger/telemetry_frame.h"
+
+#define RX_BUFFER_SIZE 256
+
+typedef struct
+{
+    uint8_t buf[RX_BUFFER_SIZE];                    // Current COBS block
+    size_t len;
+    int overflow;                                   // Block longer than any valid frame
+    int has_seq;
+    uint8_t next_seq;
+    unsigned long frames, crc_errors, malformed, lost;
+} rx_state_t;
+
+typedef struct
+{
+    uint8_t seq, channels;
+    uint32_t time_stamp;
+    rec_imu_t imu;
+    rec_analog_t analog;
+    rec_pulses_t pulses;
+} tlm_sample_t;
+
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+/* Parse a decoded frame. Returns 0 if it's a valid sample frame. */
+static int parse_frame(const uint8_t *frame, size_t len, tlm_sample_t *s)
+{
+    size_t pos = TLM_HEADER_SIZE;
+
+    if (len < TLM_HEADER_SIZE + 2 || frame[0] != TLM_TYPE_SAMPLE)
+        return -1;
+    if (crc16_ccitt(frame, len - 2) != ((frame[len - 2] << 8) | frame[len - 1]))
+        return -2;
+
+    s->seq = frame[1];
+    s->channels = frame[2];
+    memcpy(&s->time_stamp, frame + 3, sizeof(s->time_stamp));
+
+    if (s->channels & TLM_CH_IMU)
+    {
+        memcpy(&s->imu, frame + pos, sizeof(s->imu));
+        pos += sizeof(s->imu);
+    }
+    if (s->channels & TLM_CH_ANALOG)
+    {
+        memcpy(&s->analog, frame + pos, sizeof(s->analog));
+        pos += sizeof(s->analog);
+    }
+    if (s->channels & TLM_CH_PULSES)
+    {
+        memcpy(&s->pulses, frame + pos, sizeof(s->pulses));
+        pos += sizeof(s->pulses);
+    }
+    return (pos + 2 == len) ? 0 : -1;
+}
+
+static void print_sample(FILE *out, const tlm_sample_t *s)
+{
+    fprintf(out, "%u,%u", s->seq, s->time_stamp);
+    if (s->channels & TLM_CH_IMU)
+        fprintf(out, ",%d,%d,%d,%d,%d,%d", s->imu.acc[0], s->imu.acc[1], s->imu.acc[2], s->imu.gyr[0], s->imu.gyr[1], s->imu.gyr[2]);
+    else
+        fprintf(out, ",,,,,,");
+    if (s->channels & TLM_CH_ANALOG)
+        fprintf(out, ",%u,%u,%u", s->analog.analog[0], s->analog.analog[1], s->analog.analog[2]);
+    else
+        fprintf(out, ",,,");
+    if (s->channels & TLM_CH_PULSES)
+        fprintf(out, ",%u,%u\n", s->pulses.pulses[0], s->pulses.pulses[1]);
+    else
+        fprintf(out, ",,\n");
+}
+
+/* Feed received bytes. Calls handler for each valid frame. */
+static void rx_feed(rx_state_t *rx, const uint8_t *data, size_t len,
+                    void (*handler)(const tlm_sample_t *s, void *ctx), void *ctx)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        if (data[i] != 0)
+        {
+            if (rx->len < RX_BUFFER_SIZE)
+                rx->buf[rx->len++] = data[i];
+            else
+                rx->overflow = 1;
+            continue;
+        }
+
+        /* Delimiter: decode the block */
+        if (rx->len > 0)
+        {
+            uint8_t frame[TLM_MAX_FRAME];
+            tlm_sample_t s;
+            size_t n = rx->overflow ? 0 : cobs_decode(rx->buf, rx->len, frame, sizeof(frame));
+            int res = (n > 0) ? parse_frame(frame, n, &s) : -1;
+
+            if (res == -2)
+                rx->crc_errors++;
+            else if (res < 0)
+                rx->malformed++;
+            else
+            {
+                if (rx->has_seq)
+                    rx->lost += (uint8_t)(s.seq - rx->next_seq);
+                rx->has_seq = 1;
+                rx->next_seq = s.seq + 1;
+                rx->frames++;
+                handler(&s, ctx);
+            }
+        }
+        rx->len = 0;
+        rx->overflow = 0;
+    }
+}
+
+static void print_stats(const rx_state_t *rx)
+{
+    fprintf(stderr, "frames=%lu crc_errors=%lu malformed=%lu lost=%lu\n",
+            rx->frames, rx->crc_errors, rx->malformed, rx->lost);
+}
+
+static speed_t baud_to_speed(long baud)
+{
+    switch (baud)
+    {
+        case 9600:   return B9600;
+        case 19200:  return B19200;
+        case 38400:  return B38400;
+        case 57600:  return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        default:     return 0;
+    }
+}
+
+static int set_raw(int fd, speed_t speed)
+{
+    struct termios tio;
+
+    if (tcgetattr(fd, &tio) < 0)
+        return -1;
+    cfmakeraw(&tio);
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    if (speed != 0)
+    {
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+    }
+    return tcsetattr(fd, TCSANOW, &tio);
+}
+
+static void print_handler(const tlm_sample_t *s, void *ctx)
+{
+    print_sample((FILE *)ctx, s);
+}
+
+/* Build the wire bytes of a sample frame, the same way the logger does */
+static size_t build_frame(uint8_t seq, uint32_t time_stamp, uint8_t *wire)
+{
+    uint8_t frame[TLM_MAX_FRAME];
+    rec_imu_t imu = { { (int16_t)seq, (int16_t)-seq, 0 }, { 1, 0, -1 } };
+    rec_analog_t analog = { { (uint16_t)(time_stamp & 0xFFFF), 0, 4095 } };
+    rec_pulses_t pulses = { { seq, 0 } };
+    size_t len = TLM_HEADER_SIZE, n;
+    uint16_t crc;
+
+    frame[0] = TLM_TYPE_SAMPLE;
+    frame[1] = seq;
+    frame[2] = TLM_CH_ALL;
+    memcpy(frame + 3, &time_stamp, sizeof(time_stamp));
+    memcpy(frame + len, &imu, sizeof(imu));
+    len += sizeof(imu);
+    memcpy(frame + len, &analog, sizeof(analog));
+    len += sizeof(analog);
+    memcpy(frame + len, &pulses, sizeof(pulses));
+    len += sizeof(pulses);
+    crc = crc16_ccitt(frame, len);
+    frame[len++] = crc >> 8;
+    frame[len++] = crc & 0xFF;
+
+    n = cobs_encode(frame, len, wire);
+    wire[n++] = 0;
+    return n;
+}
+
+/* Flip a bit of the first data byte (not a COBS code byte) from the middle of the wire
+   frame on, so the frame still decodes and only its CRC can reject it */
+static void corrupt_data_byte(uint8_t *wire, size_t n)
+{
+    size_t code = 0, i;
+
+    for (i = 1; i < n - 1; i++)
+    {
+        if (i == code + wire[code])
+            code = i;                               // Next code byte
+        else if (i >= n / 2)
+        {
+            wire[i] ^= (wire[i] == 0x10) ? 0x20 : 0x10;  // Never 0, the frame delimiter
+            return;
+        }
+    }
+}
+
+typedef struct
+{
+    unsigned long checked, mismatches;
+} selftest_t;
+
+static void selftest_handler(const tlm_sample_t *s, void *ctx)
+{
+    selftest_t *t = (selftest_t *)ctx;
+
+    /* Frame i carries seq i and timestamp 5 * i */
+    if (s->channels != TLM_CH_ALL || s->time_stamp % 5 != 0 || (uint8_t)(s->time_stamp / 5) != s->seq ||
+        s->imu.acc[0] != (int16_t)s->seq || s->analog.analog[0] != (uint16_t)s->time_stamp ||
+        s->pulses.pulses[0] != s->seq)
+        t->mismatches++;
+    t->checked++;
+}
+
+/* Send frames through a pseudo-terminal pair, corrupting one of every 97, and check the decoder */
+static int selftest(unsigned long count)
+{
+    int master, slave;
+    pid_t child;
+    rx_state_t rx;
+    selftest_t t = { 0, 0 };
+    unsigned long corrupted = 0, i;
+    struct timespec t0, t1;
+    double elapsed;
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+    {
+        perror("posix_openpt");
+        return 1;
+    }
+    slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    if (slave < 0 || set_raw(slave, 0) < 0 || set_raw(master, 0) < 0)
+    {
+        perror("pty");
+        return 1;
+    }
+
+    for (i = 0; i < count; i++)
+        corrupted += (i % 97 == 50);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    child = fork();
+    if (child == 0)
+    {
+        /* Logger side */
+        uint8_t wire[TLM_MAX_WIRE];
+
+        close(slave);
+        for (i = 0; i < count; i++)
+        {
+            size_t n = build_frame((uint8_t)i, 5 * i, wire);
+            if (i % 97 == 50)
+                corrupt_data_byte(wire, n);
+            if (write(master, wire, n) != (ssize_t)n)
+                _exit(1);
+        }
+        tcdrain(master);
+        _exit(0);
+    }
+
+    /* Receiver side: stop after the last frame or on timeout */
+    memset(&rx, 0, sizeof(rx));
+    while (rx.frames + rx.crc_errors + rx.malformed < count)
+    {
+        uint8_t data[512];
+        fd_set fds;
+        struct timeval tv = { 2, 0 };
+        ssize_t n;
+
+        FD_ZERO(&fds);
+        FD_SET(slave, &fds);
+        if (select(slave + 1, &fds, NULL, NULL, &tv) <= 0)
+            break;
+        n = read(slave, data, sizeof(data));
+        if (n <= 0)
+            break;
+        rx_feed(&rx, data, n, selftest_handler, &t);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    waitpid(child, NULL, 0);
+    close(slave);
+    close(master);
+
+    elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    print_stats(&rx);
+    fprintf(stderr, "%.0f frames/s, %.0f bytes/s\n", rx.frames / elapsed,
+            rx.frames * (double)build_frame(0, 0, (uint8_t[TLM_MAX_WIRE]){0}) / elapsed);
+
+    if (rx.frames == count - corrupted && rx.crc_errors == corrupted && rx.malformed == 0 &&
+        rx.lost == corrupted && t.mismatches == 0)
+    {
+        fprintf(stderr, "selftest OK\n");
+        return 0;
+    }
+    fprintf(stderr, "selftest FAILED (expected %lu frames, %lu CRC errors, 0 malformed, %lu mismatches)\n",
+            count - corrupted, corrupted, t.mismatches);
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    rx_state_t rx;
+    int fd;
+    long baud = 115200;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <device> [baud] | --selftest [frames]\n", argv[0]);
+        return 1;
+    }
+    if (strcmp(argv[1], "--selftest") == 0)
+        return selftest(argc > 2 ? strtoul(argv[2], NULL, 0) : 10000);
+
+    if (argc > 2)
+        baud = strtol(argv[2], NULL, 0);
+    if (baud_to_speed(baud) == 0)
+    {
+        fprintf(stderr, "unsupported baud rate %ld\n", baud);
+        return 1;
+    }
+
+    fd = open(argv[1], O_RDONLY | O_NOCTTY);
+    if (fd < 0 || set_raw(fd, baud_to_speed(baud)) < 0)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    signal(SIGINT, on_signal);
+    memset(&rx, 0, sizeof(rx));
+    printf("seq,timestamp,lsmaccx,lsmaccy,lsmaccz,lsmangx,lsmangy,lsmangz,a0,a1,a2,f1,f2\n");
+    while (!stop)
+    {
+        uint8_t data[512];
+        ssize_t n = read(fd, data, sizeof(data));
+
+        if (n <= 0)
+            break;
+        rx_feed(&rx, data, n, print_handler, stdout);
+        fflush(stdout);
+    }
+    close(fd);
+    print_stats(&rx);
+    return 0;
+}
@@ -0,0 +1,244 @@
+/*
+    Host viewer for the logger tracepoint dump RUNx/trace (see "Logger/Trace.h"
+    and "Logger/trace_format.h").
+    Prints the latency of every span (count, total, share of the traced time,
+    p50/p90/p99/max) and the interval between marks (the tick jitter), and
+    optionally writes the timeline as Chrome trace JSON, to open in
+    chrome://tracing or https://ui.perfetto.dev. Spans cut by lost entries
+    are left out.
+
+    Usage:
+        trace_view <trace> [trace.json]
+    Build: gcc -O2 -o trace_view trace_view.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "../Logger/trace_format.h"
+
+#define TID_LOOP    1                               // Main loop, with the card operations it makes
+#define TID_ISR     2                               // Tracepoints taken in interrupts
+
+#define TRACE_ID_NAME(id, name) name,
+static const char *id_names[] = { TRACE_IDS(TRACE_ID_NAME) };
+#undef TRACE_ID_NAME
+
+typedef struct
+{
+    uint32_t *v;                                    // Durations (spans) or intervals (marks), cycles
+    size_t n, size;
+} samples_t;
+
+typedef struct
+{
+    int open;                                       // 1: a begin is waiting for its end, -1: cut by lost entries
+    uint64_t begin;
+    uint16_t arg;
+    int is_mark;
+    uint64_t last_mark;
+    uint64_t marks;
+    uint64_t total;                                 // Cycles in complete spans
+    uint64_t unmatched;                             // Begins or ends without the other
+    samples_t samples;
+} id_stats_t;
+
+static id_stats_t stats[256];
+
+static void add_sample(samples_t *s, uint32_t value)
+{
+    if (s->n == s->size)
+    {
+        s->size = s->size ? 2 * s->size : 256;
+        s->v = (uint32_t *)realloc(s->v, s->size * sizeof(uint32_t));
+        if (s->v == NULL)
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    s->v[s->n++] = value;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Nearest rank percentile of sorted samples */
+static uint32_t percentile(const samples_t *s, double p)
+{
+    size_t rank = (size_t)(p * s->n + 0.999999);
+
+    return s->v[(rank > 0 ? rank : 1) - 1];
+}
+
+static const char *id_name(int id)
+{
+    static char name[16];
+
+    if (id < TRACE_NUM_IDS)
+        return id_names[id];
+    snprintf(name, sizeof(name), "id%d", id);       // From a newer logger
+    return name;
+}
+
+static void json_event(FILE *json, int *first, const char *name, int id, const char *ph, double ts_us,
+                       double dur_us, int tid, uint16_t arg)
+{
+    if (json == NULL)
+        return;
+    fprintf(json, "%s\n{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,", *first ? "" : ",",
+            name ? name : id_name(id), ph, ts_us);
+    if (ph[0] == 'X')
+        fprintf(json, "\"dur\":%.3f,", dur_us);
+    if (ph[0] == 'i')
+        fprintf(json, "\"s\":\"%s\",", tid == TID_ISR ? "t" : "g");
+    fprintf(json, "\"pid\":1,\"tid\":%d,\"args\":{\"arg\":%u}}", tid, arg);
+    *first = 0;
+}
+
+int main(int argc, char **argv)
+{
+    trace_header_t header;
+    trace_entry_t e;
+    FILE *in, *json = NULL;
+    uint64_t now = 0, first_time = 0, entries = 0, lost = 0, lost_at = 0;
+    uint32_t last_cycles = 0;
+    double us_per_cycle;
+    int first = 1;
+
+    if (argc < 2 || argc > 3)
+    {
+        fprintf(stderr, "Usage: %s <trace> [trace.json]\n", argv[0]);
+        return 2;
+    }
+    if ((in = fopen(argv[1], "rb")) == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    if (fread(&header, sizeof(header), 1, in) != 1 || header.magic != TRACE_MAGIC ||
+        header.version != TRACE_VERSION || header.clock_hz == 0)
+    {
+        fprintf(stderr, "%s: not a trace dump\n", argv[1]);
+        return 1;
+    }
+    us_per_cycle = 1e6 / header.clock_hz;
+    if (argc == 3)
+    {
+        if ((json = fopen(argv[2], "w")) == NULL)
+        {
+            perror(argv[2]);
+            return 1;
+        }
+        fprintf(json, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+        fprintf(json, "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"main loop\"}},",
+                TID_LOOP);
+        fprintf(json, "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"interrupts\"}}",
+                TID_ISR);
+        first = 0;
+    }
+
+    while (fread(&e, sizeof(e), 1, in) == 1)
+    {
+        id_stats_t *s = &stats[e.id];
+
+        /* Signed: an ISR can take its time before a main loop entry and its slot after it */
+        if (entries == 0)
+            first_time = now = 1000000000ULL;       // Room for that before the first entry
+        else
+            now += (int32_t)(e.cycles - last_cycles);
+        last_cycles = e.cycles;
+        entries++;
+
+        switch (e.kind)
+        {
+            case TRACE_KIND_BEGIN:
+                if (s->open == 1)
+                    s->unmatched++;
+                s->open = 1;
+                s->begin = now;
+                s->arg = e.arg;
+                break;
+            case TRACE_KIND_END:
+                if (s->open != 1)
+                {
+                    if (s->open == 0)
+                        s->unmatched++;
+                    s->open = 0;
+                    break;
+                }
+                s->open = 0;
+                s->total += now - s->begin;
+                add_sample(&s->samples, (uint32_t)(now - s->begin));
+                json_event(json, &first, NULL, e.id, "X", (s->begin - first_time) * us_per_cycle,
+                           (now - s->begin) * us_per_cycle, TID_LOOP, s->arg);
+                break;
+            case TRACE_KIND_MARK:
+                s->is_mark = 1;
+                if (s->marks > 0 && lost_at <= s->last_mark)
+                    add_sample(&s->samples, (uint32_t)(now - s->last_mark));
+                s->marks++;
+                s->last_mark = now;
+                json_event(json, &first, NULL, e.id, "i", (now - first_time) * us_per_cycle, 0,
+                           e.id == TRACE_TICK ? TID_ISR : TID_LOOP, e.arg);
+                break;
+            case TRACE_KIND_LOST:
+                lost += e.arg;
+                lost_at = now;
+                for (int id = 0; id < 256; id++)
+                    stats[id].open = -1;
+                json_event(json, &first, "lost", 0, "i", (now - first_time) * us_per_cycle, 0, TID_LOOP, e.arg);
+                break;
+            default:
+                break;
+        }
+    }
+    fclose(in);
+    if (json != NULL)
+    {
+        fprintf(json, "\n]}\n");
+        fclose(json);
+    }
+
+    double traced_us = (now - first_time) * us_per_cycle;
+    printf("%s: %llu entries, %.3f s at %lu Hz, %llu entries lost\n", argv[1], (unsigned long long)entries,
+           traced_us / 1e6, (unsigned long)header.clock_hz, (unsigned long long)lost);
+    printf("%-14s %8s %10s %6s %9s %9s %9s %9s %9s\n", "span", "count", "total_ms", "time%", "p50_us", "p90_us",
+           "p99_us", "max_us", "unmatched");
+    for (int id = 0; id < 256; id++)
+    {
+        id_stats_t *s = &stats[id];
+
+        if (s->is_mark || s->samples.n == 0)
+            continue;
+        qsort(s->samples.v, s->samples.n, sizeof(uint32_t), compare_u32);
+        printf("%-14s %8zu %10.2f %6.2f %9.1f %9.1f %9.1f %9.1f %9llu\n", id_name(id), s->samples.n,
+               s->total * us_per_cycle / 1000, traced_us > 0 ? 100 * s->total * us_per_cycle / traced_us : 0,
+               percentile(&s->samples, 0.50) * us_per_cycle, percentile(&s->samples, 0.90) * us_per_cycle,
+               percentile(&s->samples, 0.99) * us_per_cycle, s->samples.v[s->samples.n - 1] * us_per_cycle,
+               (unsigned long long)s->unmatched);
+    }
+    printf("%-14s %8s %10s %6s %9s %9s %9s %9s\n", "mark interval", "count", "", "", "p50_us", "p99_us", "min_us", "max_us");
+    for (int id = 0; id < 256; id++)
+    {
+        id_stats_t *s = &stats[id];
+
+        if (!s->is_mark)
+            continue;
+        if (s->samples.n == 0)
+        {
+            printf("%-14s %8llu\n", id_name(id), (unsigned long long)s->marks);
+            continue;
+        }
+        qsort(s->samples.v, s->samples.n, sizeof(uint32_t), compare_u32);
+        printf("%-14s %8llu %10s %6s %9.1f %9.1f %9.1f %9.1f\n", id_name(id), (unsigned long long)s->marks, "", "",
+               percentile(&s->samples, 0.50) * us_per_cycle, percentile(&s->samples, 0.99) * us_per_cycle,
+               s->samples.v[0] * us_per_cycle, s->samples.v[s->samples.n - 1] * us_per_cycle);
+    }
+    return 0;
+}